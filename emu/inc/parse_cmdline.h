@@ -1,6 +1,8 @@
 /*
  * parse_cmdline.h
  *
+ * 10/17/26 DJG Added ram option
+ * 10/17/26 DJG Added cylinder cache options
  * 09/12/23 JST Changes to support 5.10 kernel and --sync option
  * 05/17/21 DJG Added option to initialize
  * 11/09/14 DJG Added new command line options
@@ -27,6 +29,11 @@ typedef struct {
    int value;
 } CONTROLLER;
 
+// Values for ram option
+#define RAM_NONE 0
+#define RAM_NORMAL 1
+#define RAM_HUGE 2
+
 #define CONTROLLER_DEFAULT 1
 #define CONTROLLER_CROMEMCO 2
 DEF_EXTERN CONTROLLER mfm_controller_info[]
@@ -60,6 +67,9 @@ typedef struct {
    uint32_t rpm;                // Drive RPM. 0 if not set.
    uint32_t start_time_ns;	// Time to shift start of reading from index
    int sync;                    // Open emu file with O_DSYNC
+   int cache_count;             // Number of cylinders to cache, 0 disables
+   int cache_readahead;         // Cylinders each side of seek to prefetch
+   int ram;                     // Keep emulation file in memory, RAM_*
 } DRIVE_PARAMS;
 char *parse_print_cmdline(DRIVE_PARAMS *drive_params, int print);
 void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params);
@@ -16,6 +16,15 @@
 
 // Copyright 2024 David Gesswein.
 // This file is part of MFM disk utilities.
+// 10/17/26 DJG Only write the part of a track changed by the host
+// 10/17/26 DJG Combine writes to a track that hasn't been written yet and
+//    find pending tracks for a cylinder with an index instead of searching
+// 10/17/26 DJG Changed track buffer to lock free queue with eventfd wakeup
+//    instead of polling when full
+// 10/17/26 DJG Added --ram to keep emulation file in memory with dirty tracks
+//    written by background thread
+// 10/17/26 DJG Added cylinder cache with read ahead thread to reduce seek time
+// 10/17/26 DJG Skip pin check when built with simulated PRU
 // 05/01/24 DJG Don't segfault if log file can't be opened
 // 03/13/24 DJG Fix detection of mfm_emu script not run
 // 02/23/24 DJG Increase priority of main thread to process seeks as timely as
@@ -91,7 +100,8 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
 
 // MFM program include files
 #include <prussdrv.h>
@@ -121,23 +131,112 @@ uint32_t pru_clock_hz = 200000000UL;
 // File syste read/write threads
 pthread_t read_thread;
 pthread_t write_thread;
+// Thread reading cylinders into cache before they are needed
+pthread_t prefetch_thread;
 
 // This is a circular buffer holding tracks to write to the file. The flash
 // can't keep up with random writes so this is needed to prevent timeouts when
-// the writes block. Buffer is empty when get==put
+// the writes block. Buffer is empty when get==put. emu_proc is the only
+// thread that adds to the buffer and emu_proc_write the only one that
+// removes so the indexes are updated with release stores after the entry
+// is filled or used and read with acquire loads. When the buffer is full or
+// empty the thread waiting sets its waiting flag and blocks reading its
+// eventfd which the other thread writes after updating its index.
+//
+// If the host writes a track again before it is written to the file the new
+// data replaces the data in the buffer so it is only written once. The
+// entry state is used to claim the entry so the data isn't changed while the
+// write thread is writing it.
+#define TRACK_WRITTEN 0    // Not waiting to be written
+#define TRACK_PENDING 1    // Waiting for write thread
+#define TRACK_WRITING 2    // Being written by write thread
+#define TRACK_UPDATING 3   // Being replaced with newer data by emu_proc
 struct {
    int drive;        // Drive, cylinder and head data is for, drive -1 signals
    int cyl;          // write thread to exit
    int head;
    int size;         // Size of track data
    char *buf;        // Track data
+   int start;        // Offset and length of the data changed by the host
+   int len;          // which needs to be written to the file
+   atomic_int state; // TRACK_* state
 } *track_buffer;
+// Index of latest track buffer entry for each drive's tracks indexed by
+// cyl * num_head + head, -1 if none. The entry may have been written and
+// reused so the entry drive, cylinder, and head must be checked. Only
+// updated by emu_proc. When the cache is enabled it is updated with
+// cyl_cache_mutex locked.
+int *track_buffer_index[MAX_DRIVES];
+// Number of writes combined with an entry waiting to be written
+uint32_t track_buffer_combined;
+// Buffer for reading track written by the host from the PRU so it can be
+// compared with the previous data to find what was changed.
+uint8_t *track_scratch;
+// If the current cylinder for each drive was sent to the PRU from the
+// emu_proc cylinder buffer this points to it, NULL otherwise. Tracks written
+// are updated in it so it has the previous data for the next write.
+uint8_t *cyl_sent_data[MAX_DRIVES];
+// Number of tracks written by the host that weren't changed
+uint32_t tracks_unchanged;
+// Bytes written to emulation file and bytes that would have been written
+// if whole tracks were written. Updated by write thread.
+uint64_t track_bytes_written, track_bytes_full;
 // Circular buffer indexes
-volatile int track_buffer_get;
-volatile int track_buffer_put;
-
-// Semaphore to let write thread know more data is available
-sem_t write_sem;
+atomic_int track_buffer_get;
+atomic_int track_buffer_put;
+// Set when thread is waiting for an entry to be added or removed
+atomic_int track_buffer_get_waiting;
+atomic_int track_buffer_put_waiting;
+// eventfd to wake thread waiting for entry to be added or removed
+int track_buffer_get_fd;
+int track_buffer_put_fd;
+// Total number of tracks put in buffer. Used to detect buffers being reused
+// while a cylinder is read into the cache.
+volatile uint32_t track_buffer_puts;
+
+// Cache of cylinder data so seeks to recently used or prefetched cylinders
+// only need to copy the data to the PRU. Entries and the track buffer put
+// index are protected by cyl_cache_mutex when the cache is enabled.
+#define CACHE_EMPTY 0
+#define CACHE_LOADING 1
+#define CACHE_VALID 2
+struct {
+   int drive;        // Drive and cylinder data is for
+   int cyl;
+   int state;        // CACHE_EMPTY, CACHE_LOADING, or CACHE_VALID
+   int discard;      // Set if track written while loading, data is stale
+   uint32_t last_use; // cyl_cache_counter value when last used
+   uint8_t *buf;     // Cylinder data
+} *cyl_cache;
+pthread_mutex_t cyl_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signaled when a cylinder is finished loading
+pthread_cond_t cyl_cache_loaded_cond = PTHREAD_COND_INITIALIZER;
+// Signaled when prefetch thread has a new cylinder to read around or
+// should exit
+pthread_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+// Drive and cylinder to read around, cyl -1 if no request
+int prefetch_drive, prefetch_cyl = -1;
+int prefetch_exit;
+// Counter for LRU replacement and statistics
+uint32_t cyl_cache_counter;
+uint32_t cyl_cache_hits, cyl_cache_misses, cyl_cache_prefetches;
+
+// Emulation file data when the whole file is kept in memory with --ram.
+// Tracks written by the host are marked in the dirty bitmap and written to
+// the file by the write thread. Dirty bits, counts, and track data being
+// changed are protected by ram_mutex.
+struct {
+   uint8_t *data;       // Data for all cylinders in file order
+   size_t size;         // Size of memory allocated
+   uint32_t *dirty;     // Bit per track, index cyl * num_head + head
+   int *dirty_start;    // Offset and length in track of data to write
+   int *dirty_len;      // for dirty tracks
+} ram_image[MAX_DRIVES];
+pthread_mutex_t ram_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signaled when tracks are marked dirty or write thread should exit
+pthread_cond_t ram_dirty_cond = PTHREAD_COND_INITIALIZER;
+int ram_dirty_count, ram_max_dirty_count;
+int ram_exit;
 
 // Log for run information
 FILE *log_file;
@@ -252,6 +351,10 @@ void shutdown(void)
    if (log_file) {
       clock_gettime(CLOCK, &tv_start);
       shutdown_stop = tv_start.tv_sec + tv_start.tv_nsec / 1e9;
+      if (track_bytes_full > 0) {
+         fprintf(log_file,"   Wrote %" PRIu64 " bytes of changed track data, %.1f%% of track size\n",
+            track_bytes_written, track_bytes_written * 100.0 / track_bytes_full);
+      }
       fprintf(log_file,"   Shutdown time %.1f seconds\n",
          shutdown_stop - shutdown_start);
 
@@ -273,7 +376,8 @@ void shutdown_signal(void)
 // return: Number of entries used. Last entry can't
 //         be used to maximum return is size-1
 int track_buffers_used(int size) {
-   int used = track_buffer_put - track_buffer_get;
+   int used = atomic_load_explicit(&track_buffer_put, memory_order_acquire) -
+      atomic_load_explicit(&track_buffer_get, memory_order_acquire);
 
    if (used < 0) {
       used += size;
@@ -282,68 +386,677 @@ int track_buffers_used(int size) {
    return used;
 }
 
-// This routine update the buffer parameters and put pointer and posts
-// write thread semaphore to write data in buffer
+// Find cylinder in cache. Must be called with cyl_cache_mutex locked.
+//
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// return: Cache index or -1 if not in cache
+static int cyl_cache_find(DRIVE_PARAMS *drive_params, int drive, int cyl)
+{
+   int i;
+
+   for (i = 0; i < drive_params->cache_count; i++) {
+      if (cyl_cache[i].state != CACHE_EMPTY && cyl_cache[i].drive == drive &&
+            cyl_cache[i].cyl == cyl) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+// Update track in cache when it is written. Must be called with
+// cyl_cache_mutex locked.
+//
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// head: Head
+// buf: Track data
+// size: Size of track data
+static void cyl_cache_update_track(DRIVE_PARAMS *drive_params, int drive,
+      int cyl, int head, char *buf, int size)
+{
+   int ndx;
+
+   ndx = cyl_cache_find(drive_params, drive, cyl);
+   if (ndx >= 0) {
+      // If being read from file the data read may be older than this
+      // write so don't use it
+      if (cyl_cache[ndx].state == CACHE_LOADING) {
+         cyl_cache[ndx].discard = 1;
+      } else {
+         memcpy(&cyl_cache[ndx].buf[size * head], buf, size);
+      }
+   }
+}
+
+// Wait until the other thread changes the track buffer index. Returns
+// without waiting if the index has already changed from value.
+//
+// index: Index the other thread updates
+// waiting: Our waiting flag
+// fd: Our eventfd
+// value: Value of index we are waiting for to change
+static void track_buffer_wait(atomic_int *index, atomic_int *waiting, int fd,
+      int value)
+{
+   eventfd_t count;
+
+   // The flag must be set before checking the index again so the other
+   // thread either sees the flag or we see the changed index. A left over
+   // wakeup from a previous wait just causes us to check again.
+   atomic_store(waiting, 1);
+   if (atomic_load(index) == value) {
+      eventfd_read(fd, &count);
+   }
+   atomic_store(waiting, 0);
+}
+
+// Update track buffer index and wake other thread if it is waiting for it
+// to change.
+//
+// index: Index to update
+// value: New value
+// waiting: Other thread's waiting flag
+// fd: Other thread's eventfd
+static void track_buffer_update(atomic_int *index, int value,
+      atomic_int *waiting, int fd)
+{
+   atomic_store(index, value);
+   if (atomic_load(waiting)) {
+      eventfd_write(fd, 1);
+   }
+}
+
+// Find the range of bytes that are different between the previous and new
+// track data.
+//
+// prev: Previous track data
+// new: New track data
+// size: Size of track data
+// start: Returns offset of first byte different
+// len: Returns number of bytes from first to last byte different
+// return: 0 if data the same, 1 if different
+static int track_diff(uint8_t *prev, uint8_t *new, int size, int *start,
+      int *len)
+{
+   int first, last;
+
+   for (first = 0; first < size && prev[first] == new[first]; first++) {
+   }
+   if (first == size) {
+      return 0;
+   }
+   for (last = size - 1; prev[last] == new[last]; last--) {
+   }
+   *start = first;
+   *len = last - first + 1;
+   return 1;
+}
+
+// Combine range of data to write with the range already waiting to be
+// written.
+//
+// start: Offset of range waiting to be written, updated with combined range
+// len: Length of range waiting to be written, updated with combined range
+// new_start: Offset of new range
+// new_len: Length of new range
+static void track_range_merge(int *start, int *len, int new_start,
+      int new_len)
+{
+   int end = *start + *len;
+
+   if (new_start + new_len > end) {
+      end = new_start + new_len;
+   }
+   if (new_start < *start) {
+      *start = new_start;
+   }
+   *len = end - *start;
+}
+
+// Find latest track buffer entry for a track that is between get and put.
+//
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// head: Head
+// get: Get index to search from
+// put: Put index to search to
+// return: Track buffer index or -1 if not found
+static int track_buffer_find(DRIVE_PARAMS *drive_params, int drive, int cyl,
+      int head, int get, int put)
+{
+   int buffer_count = drive_params->buffer_count;
+   int ndx;
+
+   ndx = track_buffer_index[drive][cyl *
+      drive_params->emu_file_info[drive].num_head + head];
+   if (ndx >= 0 && track_buffer[ndx].drive == drive &&
+         track_buffer[ndx].cyl == cyl && track_buffer[ndx].head == head &&
+         (ndx - get + buffer_count) % buffer_count <
+         (put - get + buffer_count) % buffer_count) {
+      return ndx;
+   }
+   return -1;
+}
+
+// Copy cylinder tracks in the track buffer between get and put to
+// cylinder data.
 //
-// buffer_count: Number of buffers
-// drive: drive number data is for
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// get: Get index to search from
+// put: Put index to search to
+// data: Cylinder data
+static void track_buffer_copy_cyl(DRIVE_PARAMS *drive_params, int drive,
+      int cyl, int get, int put, uint8_t *data)
+{
+   int head, ndx;
+
+   for (head = 0; head < drive_params->emu_file_info[drive].num_head;
+         head++) {
+      ndx = track_buffer_find(drive_params, drive, cyl, head, get, put);
+      if (ndx >= 0) {
+         memcpy(&data[track_buffer[ndx].size * head], track_buffer[ndx].buf,
+            track_buffer[ndx].size);
+      }
+   }
+}
+
+// This routine reads the track data from the PRU and compares it with the
+// previous data for the track to find what the host changed. If nothing
+// changed nothing is written. If the track is already waiting to be
+// written the changed data is copied to that buffer. Otherwise it updates
+// the buffer parameters and put pointer and wakes the write thread to write
+// data in buffer. If the cylinder is in the cache the track data is also
+// updated in the cache.
+//
+// drive_params: Drive parameters
+// drive: drive number data is for, -1 to tell write thread to exit
 // cyl: cylinder to write to
 // head: head/track to write to
 // size: size of track data
-void update_buffer(int buffer_count, int drive, int cyl, int head, int size) {
-   int next_put;
+void update_buffer(DRIVE_PARAMS *drive_params, int drive, int cyl, int head,
+      int size) {
+   int put, next_put, ndx, cache_ndx;
+   int buffer_count = drive_params->buffer_count;
+   int expected = TRACK_PENDING;
+   int start = 0, len = size;
+   uint8_t *prev = NULL;
+
+   put = atomic_load_explicit(&track_buffer_put, memory_order_relaxed);
+   if (drive != -1) {
+      pru_read_mem(MEM_DDR, track_scratch, size,
+         size*head + drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+      if (drive_params->cache_count > 0) {
+         pthread_mutex_lock(&cyl_cache_mutex);
+      }
+      // Find the previous data for the track. The latest data waiting
+      // to be written, the cached cylinder, or the data sent to the PRU
+      // all have the complete track.
+      ndx = track_buffer_find(drive_params, drive, cyl, head,
+         atomic_load_explicit(&track_buffer_get, memory_order_acquire), put);
+      if (ndx >= 0) {
+         prev = (uint8_t *) track_buffer[ndx].buf;
+      } else if (drive_params->cache_count > 0 &&
+            (cache_ndx = cyl_cache_find(drive_params, drive, cyl)) >= 0 &&
+            cyl_cache[cache_ndx].state == CACHE_VALID) {
+         prev = &cyl_cache[cache_ndx].buf[size * head];
+      } else if (cyl_sent_data[drive] != NULL) {
+         prev = &cyl_sent_data[drive][size * head];
+      }
+      if (prev != NULL && !track_diff(prev, track_scratch, size, &start,
+            &len)) {
+         if (drive_params->cache_count > 0) {
+            pthread_mutex_unlock(&cyl_cache_mutex);
+         }
+         tracks_unchanged++;
+         return;
+      }
+      if (cyl_sent_data[drive] != NULL) {
+         memcpy(&cyl_sent_data[drive][size * head], track_scratch, size);
+      }
+      if (ndx >= 0 && atomic_compare_exchange_strong(&track_buffer[ndx].state,
+            &expected, TRACK_UPDATING)) {
+         memcpy(&track_buffer[ndx].buf[start], &track_scratch[start], len);
+         track_range_merge(&track_buffer[ndx].start, &track_buffer[ndx].len,
+            start, len);
+         if (drive_params->cache_count > 0) {
+            cyl_cache_update_track(drive_params, drive, cyl, head,
+               (char *) track_scratch, size);
+            pthread_mutex_unlock(&cyl_cache_mutex);
+         }
+         atomic_store_explicit(&track_buffer[ndx].state, TRACK_PENDING,
+            memory_order_release);
+         track_buffer_combined++;
+         return;
+      }
+      if (drive_params->cache_count > 0) {
+         pthread_mutex_unlock(&cyl_cache_mutex);
+      }
+   }
 
-   next_put = (track_buffer_put + 1) % buffer_count;
-   if (next_put == track_buffer_get) {
+   next_put = (put + 1) % buffer_count;
+   if (next_put == atomic_load_explicit(&track_buffer_get,
+         memory_order_acquire)) {
       msg(MSG_INFO, "Track buffer full\n");
    }
    // If no free buffers wait until one is free
-   while (next_put == track_buffer_get) {
-      usleep(10000);
+   while (next_put == atomic_load_explicit(&track_buffer_get,
+         memory_order_acquire)) {
+      track_buffer_wait(&track_buffer_get, &track_buffer_put_waiting,
+         track_buffer_put_fd, next_put);
+   }
+   if (drive != -1) {
+      memcpy(track_buffer[put].buf, track_scratch, size);
+   }
+   track_buffer[put].drive = drive;
+   track_buffer[put].cyl = cyl;
+   track_buffer[put].head = head;
+   track_buffer[put].size = size;
+   track_buffer[put].start = start;
+   track_buffer[put].len = len;
+   atomic_store_explicit(&track_buffer[put].state, TRACK_PENDING,
+      memory_order_relaxed);
+   if (drive_params->cache_count > 0) {
+      pthread_mutex_lock(&cyl_cache_mutex);
+   }
+   if (drive != -1) {
+      track_buffer_index[drive][cyl *
+         drive_params->emu_file_info[drive].num_head + head] = put;
+      if (drive_params->cache_count > 0) {
+         cyl_cache_update_track(drive_params, drive, cyl, head,
+            track_buffer[put].buf, size);
+      }
+   }
+   track_buffer_puts++;
+   track_buffer_update(&track_buffer_put, next_put,
+      &track_buffer_get_waiting, track_buffer_get_fd);
+   if (drive_params->cache_count > 0) {
+      pthread_mutex_unlock(&cyl_cache_mutex);
+   }
+}
+
+// Get least recently used cache entry that isn't being loaded and
+// mark it loading for the specified cylinder. Must be called with
+// cyl_cache_mutex locked.
+//
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// return: Cache index or -1 if none available
+static int cyl_cache_alloc(DRIVE_PARAMS *drive_params, int drive, int cyl)
+{
+   int i;
+   int ndx = -1;
+
+   for (i = 0; i < drive_params->cache_count; i++) {
+      if (cyl_cache[i].state == CACHE_EMPTY) {
+         ndx = i;
+         break;
+      }
+      if (cyl_cache[i].state == CACHE_VALID && (ndx == -1 ||
+            cyl_cache[i].last_use - cyl_cache[ndx].last_use > 0x80000000)) {
+         ndx = i;
+      }
+   }
+   if (ndx >= 0) {
+      cyl_cache[ndx].drive = drive;
+      cyl_cache[ndx].cyl = cyl;
+      cyl_cache[ndx].state = CACHE_LOADING;
+      cyl_cache[ndx].discard = 0;
    }
-   track_buffer[track_buffer_put].drive = drive;
-   track_buffer[track_buffer_put].cyl = cyl;
-   track_buffer[track_buffer_put].head = head;
-   track_buffer[track_buffer_put].size = size;
-   track_buffer_put = next_put;
+   return ndx;
+}
 
-   sem_post(&write_sem);
+// Read the cylinder for a cache entry from the file and copy any later
+// data in the track buffer to it. Must be called with cyl_cache_mutex
+// locked. The mutex is unlocked while reading the file.
+//
+// drive_params: Drive parameters
+// ndx: Cache index returned by cyl_cache_alloc
+// return: 1 if cylinder now valid in cache, 0 if data couldn't be used
+static int cyl_cache_load(DRIVE_PARAMS *drive_params, int ndx)
+{
+   int drive = cyl_cache[ndx].drive;
+   int cyl = cyl_cache[ndx].cyl;
+   EMU_FILE_INFO *emu_file_info = &drive_params->emu_file_info[drive];
+   int track_size = emu_file_info->track_data_size_bytes +
+      emu_file_info->track_header_size_bytes;
+   int get_hold, put_hold, used;
+   uint32_t puts_hold;
+
+   // Track buffers from get to put may not have been written to the file
+   // before our read so need to be copied to the cylinder data
+   get_hold = atomic_load_explicit(&track_buffer_get, memory_order_acquire);
+   put_hold = atomic_load_explicit(&track_buffer_put, memory_order_relaxed);
+   puts_hold = track_buffer_puts;
+   used = track_buffers_used(drive_params->buffer_count);
+   pthread_mutex_unlock(&cyl_cache_mutex);
+
+   emu_file_read_cyl(drive_params->fd[drive], emu_file_info, cyl,
+      cyl_cache[ndx].buf, track_size * emu_file_info->num_head);
+
+   pthread_mutex_lock(&cyl_cache_mutex);
+   // If a track on this cylinder was written while reading or the buffers
+   // we need have been reused we can't tell if the file or buffer data is
+   // the latest so discard it.
+   if (cyl_cache[ndx].discard || track_buffer_puts - puts_hold >=
+         drive_params->buffer_count - used) {
+      cyl_cache[ndx].state = CACHE_EMPTY;
+      pthread_cond_broadcast(&cyl_cache_loaded_cond);
+      return 0;
+   }
+   track_buffer_copy_cyl(drive_params, drive, cyl, get_hold, put_hold,
+      cyl_cache[ndx].buf);
+   cyl_cache[ndx].state = CACHE_VALID;
+   cyl_cache[ndx].last_use = ++cyl_cache_counter;
+   pthread_cond_broadcast(&cyl_cache_loaded_cond);
+   return 1;
 }
 
-// Get the cylinder data and send to PRU. The cylinder is read from the file
-// and if the track buffer has later data it is copied to the cylinder data.
-// The data is then sent to the PRU
+// Get the cylinder data and send to PRU. If the file is in memory the
+// data is sent from memory. If the cache is enabled and
+// the cylinder is in the cache the cached data is sent. Otherwise the
+// cylinder is read from the file and if the track buffer has later data
+// it is copied to the cylinder data. The data is then sent to the PRU.
+// The prefetch thread is then told to read the cylinders around this one.
 //
 // drive_params: Drive parameters
 // drive: Drive number
 // cyl: Cylinder
 // cyl_size: Cylinder size in bytes including headers
 // track_size: Track size in bytes including header
-// data: Cylinder data
+// data: Cylinder data buffer for when cache not used
 void send_PRU_cyl_data(DRIVE_PARAMS *drive_params, int drive, int cyl,
       int cyl_size, int track_size, uint8_t *data) {
-   int get_hold, index;
+   int get_hold;
+   int ndx = -1;
+
+   if (drive_params->ram != RAM_NONE) {
+      pru_write_mem(MEM_DDR, &ram_image[drive].data[(size_t) cyl * cyl_size],
+         cyl_size, drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+      return;
+   }
+   if (drive_params->cache_count > 0) {
+      pthread_mutex_lock(&cyl_cache_mutex);
+      // If prefetch is reading it wait for it to finish since that is faster
+      // than reading it again
+      while ((ndx = cyl_cache_find(drive_params, drive, cyl)) >= 0 &&
+            cyl_cache[ndx].state == CACHE_LOADING) {
+         pthread_cond_wait(&cyl_cache_loaded_cond, &cyl_cache_mutex);
+      }
+      if (ndx >= 0) {
+         cyl_cache_hits++;
+         cyl_cache[ndx].last_use = ++cyl_cache_counter;
+      } else {
+         cyl_cache_misses++;
+         ndx = cyl_cache_alloc(drive_params, drive, cyl);
+         // We are the only thread adding to the track buffer so the load
+         // can't be discarded
+         if (ndx >= 0 && !cyl_cache_load(drive_params, ndx)) {
+            ndx = -1;
+         }
+      }
+      if (ndx >= 0) {
+         pru_write_mem(MEM_DDR, cyl_cache[ndx].buf, cyl_size,
+            drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+         cyl_sent_data[drive] = NULL;
+      }
+      prefetch_drive = drive;
+      prefetch_cyl = cyl;
+      pthread_cond_signal(&prefetch_cond);
+      pthread_mutex_unlock(&cyl_cache_mutex);
+      if (ndx >= 0) {
+         return;
+      }
+   }
 
    // We need to have get index from before we read from file to ensure we
    // check all data that hasn't been written before the read. Put can't
    // change during this routine.
-   get_hold = track_buffer_get;
+   get_hold = atomic_load_explicit(&track_buffer_get, memory_order_acquire);
    emu_file_read_cyl(drive_params->fd[drive],
          &drive_params->emu_file_info[drive], cyl, data,  cyl_size);
-   // We need to go from get pointer to put pointer to ensure the last
-   // data we move is the latest. We may move data we overwrite again.
-   index = get_hold;
-   while (index != track_buffer_put) {
-      // If our drive and cylinder then move the track data to the correct
-      // location in cylinder buffer
-      if (track_buffer[index].drive == drive && track_buffer[index].cyl == cyl) {
-         memcpy(&data[track_size * track_buffer[index].head],
-               track_buffer[index].buf, track_buffer[index].size);
+   // Put can't change since we are the only thread adding to the buffer.
+   track_buffer_copy_cyl(drive_params, drive, cyl, get_hold,
+      atomic_load_explicit(&track_buffer_put, memory_order_relaxed), data);
+
+   pru_write_mem(MEM_DDR, data, cyl_size, drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+   cyl_sent_data[drive] = data;
+}
+
+// Read the emulation files into memory for --ram. The memory is locked
+// so it won't be paged out.
+//
+// drive_params: Drive parameters
+static void ram_load(DRIVE_PARAMS *drive_params)
+{
+   int i, cyl;
+   size_t huge_size = 2*1024*1024;
+
+   for (i = 0; i < drive_params->num_drives; i++) {
+      EMU_FILE_INFO *emu_file_info = &drive_params->emu_file_info[i];
+      int cyl_size = emu_file_info->num_head *
+         (emu_file_info->track_data_size_bytes +
+         emu_file_info->track_header_size_bytes);
+      int num_tracks = emu_file_info->num_cyl * emu_file_info->num_head;
+
+      ram_image[i].size = (size_t) cyl_size * emu_file_info->num_cyl;
+      ram_image[i].data = MAP_FAILED;
+      if (drive_params->ram == RAM_HUGE) {
+         // Size must be a multiple of the huge page size
+         ram_image[i].size = (ram_image[i].size + huge_size - 1) /
+            huge_size * huge_size;
+         ram_image[i].data = mmap(NULL, ram_image[i].size,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1, 0);
+         if (ram_image[i].data == MAP_FAILED) {
+            msg(MSG_ERR, "Unable to use huge pages, using normal pages: %s\n",
+               strerror(errno));
+         }
       }
-      index = (index + 1) % drive_params->buffer_count;
+      if (ram_image[i].data == MAP_FAILED) {
+         ram_image[i].size = (size_t) cyl_size * emu_file_info->num_cyl;
+         ram_image[i].data = mmap(NULL, ram_image[i].size,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         if (ram_image[i].data == MAP_FAILED) {
+            msg(MSG_FATAL, "Unable to allocate %zu bytes for emulation file: %s\n",
+               ram_image[i].size, strerror(errno));
+            exit(1);
+         }
+      }
+      if (mlock(ram_image[i].data, ram_image[i].size) != 0) {
+         msg(MSG_ERR, "Unable to lock emulation file memory: %s\n",
+            strerror(errno));
+      }
+      ram_image[i].dirty = calloc((num_tracks + 31) / 32, sizeof(uint32_t));
+      ram_image[i].dirty_start = malloc(num_tracks * sizeof(int));
+      ram_image[i].dirty_len = malloc(num_tracks * sizeof(int));
+      if (ram_image[i].dirty == NULL || ram_image[i].dirty_start == NULL ||
+            ram_image[i].dirty_len == NULL) {
+         msg(MSG_FATAL, "Dirty bitmap malloc failed\n");
+         exit(1);
+      }
+      for (cyl = 0; cyl < emu_file_info->num_cyl; cyl++) {
+         emu_file_read_cyl(drive_params->fd[i], emu_file_info, cyl,
+            &ram_image[i].data[(size_t) cyl * cyl_size], cyl_size);
+      }
+      msg(MSG_INFO, "Drive %d loaded %.1f MB into memory\n", i,
+         ram_image[i].size / 1e6);
    }
+}
 
-   pru_write_mem(MEM_DDR, data, cyl_size, drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+// Copy track written by the host from the PRU to memory and mark the
+// changed part dirty for the write thread to write to the file.
+//
+// drive_params: Drive parameters
+// drive: Drive number
+// cyl: Cylinder
+// head: Head
+// track_size: Track size in bytes including header
+static void ram_write_track(DRIVE_PARAMS *drive_params, int drive, int cyl,
+      int head, int track_size)
+{
+   int num_head = drive_params->emu_file_info[drive].num_head;
+   int track = cyl * num_head + head;
+   uint8_t *data = &ram_image[drive].data[(size_t) track * track_size];
+   int start, len;
+
+   // Only we change the data so it can be compared without the lock
+   pru_read_mem(MEM_DDR, track_scratch, track_size,
+      track_size*head + drive*DDR_DRIVE_BUFFER_MAX_SIZE);
+   if (!track_diff(data, track_scratch, track_size, &start, &len)) {
+      tracks_unchanged++;
+      return;
+   }
+   pthread_mutex_lock(&ram_mutex);
+   memcpy(&data[start], &track_scratch[start], len);
+   if (!(ram_image[drive].dirty[track / 32] & (1u << (track % 32)))) {
+      ram_image[drive].dirty[track / 32] |= 1u << (track % 32);
+      ram_image[drive].dirty_start[track] = start;
+      ram_image[drive].dirty_len[track] = len;
+      ram_dirty_count++;
+      if (ram_dirty_count > ram_max_dirty_count) {
+         ram_max_dirty_count = ram_dirty_count;
+      }
+      pthread_cond_signal(&ram_dirty_cond);
+   } else {
+      track_range_merge(&ram_image[drive].dirty_start[track],
+         &ram_image[drive].dirty_len[track], start, len);
+   }
+   pthread_mutex_unlock(&ram_mutex);
+}
+
+// This thread writes dirty tracks from memory to the file for --ram.
+// Tracks are written in file order. A track written again by the host
+// before we write it is only written once. Only the part of the track
+// changed is written.
+//
+// arg: drive_params pointer
+static void *emu_proc_ram_write(void *arg)
+{
+   DRIVE_PARAMS *drive_params = arg;
+   EMU_FILE_INFO *emu_file_info;
+   int i, track, num_tracks, track_size = 0;
+   int start, len;
+   uint8_t *buf;
+
+   for (i = 0; i < drive_params->num_drives; i++) {
+      emu_file_info = &drive_params->emu_file_info[i];
+      if (emu_file_info->track_data_size_bytes +
+            emu_file_info->track_header_size_bytes > track_size) {
+         track_size = emu_file_info->track_data_size_bytes +
+            emu_file_info->track_header_size_bytes;
+      }
+   }
+   buf = malloc(track_size);
+   if (buf == NULL) {
+      msg(MSG_FATAL, "Write track buffer malloc failed\n");
+      exit(1);
+   }
+
+   pthread_mutex_lock(&ram_mutex);
+   while (1) {
+      while (ram_dirty_count == 0 && !ram_exit) {
+         pthread_cond_wait(&ram_dirty_cond, &ram_mutex);
+      }
+      // Exit once all data is written
+      if (ram_dirty_count == 0) {
+         break;
+      }
+      for (i = 0; i < drive_params->num_drives; i++) {
+         emu_file_info = &drive_params->emu_file_info[i];
+         num_tracks = emu_file_info->num_cyl * emu_file_info->num_head;
+         track_size = emu_file_info->track_data_size_bytes +
+            emu_file_info->track_header_size_bytes;
+         for (track = 0; track < num_tracks; track++) {
+            if (ram_image[i].dirty[track / 32] == 0) {
+               track |= 31;
+               continue;
+            }
+            if (ram_image[i].dirty[track / 32] & (1u << (track % 32))) {
+               ram_image[i].dirty[track / 32] &= ~(1u << (track % 32));
+               ram_dirty_count--;
+               start = ram_image[i].dirty_start[track];
+               len = ram_image[i].dirty_len[track];
+               // Copy so the host can write the track again while we
+               // are writing the file
+               memcpy(&buf[start],
+                  &ram_image[i].data[(size_t) track * track_size + start], len);
+               pthread_mutex_unlock(&ram_mutex);
+               emu_file_rewrite_track_range(drive_params->fd[i], emu_file_info,
+                  track / emu_file_info->num_head,
+                  track % emu_file_info->num_head, buf, start, len);
+               track_bytes_written += len;
+               track_bytes_full += track_size;
+               pthread_mutex_lock(&ram_mutex);
+            }
+         }
+      }
+   }
+   pthread_mutex_unlock(&ram_mutex);
+   free(buf);
+
+   // Done with files
+   for (i = 0; i < MAX_DRIVES; i++) {
+      emu_file_close(drive_params->fd[i], 0);
+   }
+
+   return NULL;
+}
+
+// This thread reads the cylinders on each side of the last cylinder sent
+// to the PRU into the cache so seeks to nearby cylinders don't have to wait
+// for the file read. The closest cylinders are read first. If a new seek
+// happens the remaining cylinders are skipped.
+//
+// arg: drive_params pointer
+static void *emu_proc_prefetch(void *arg)
+{
+   DRIVE_PARAMS *drive_params = arg;
+   int drive, cyl, pcyl, dist, dir, ndx;
+
+   pthread_mutex_lock(&cyl_cache_mutex);
+   while (1) {
+      while (prefetch_cyl == -1 && !prefetch_exit) {
+         pthread_cond_wait(&prefetch_cond, &cyl_cache_mutex);
+      }
+      if (prefetch_exit) {
+         break;
+      }
+      drive = prefetch_drive;
+      cyl = prefetch_cyl;
+      prefetch_cyl = -1;
+      for (dist = 1; dist <= drive_params->cache_readahead &&
+            prefetch_cyl == -1 && !prefetch_exit; dist++) {
+         for (dir = 1; dir >= -1 && prefetch_cyl == -1; dir -= 2) {
+            pcyl = cyl + dist * dir;
+            if (pcyl < 0 ||
+                  pcyl >= drive_params->emu_file_info[drive].num_cyl) {
+               continue;
+            }
+            ndx = cyl_cache_find(drive_params, drive, pcyl);
+            if (ndx >= 0) {
+               // Keep it from being replaced by the other cylinders we read
+               if (cyl_cache[ndx].state == CACHE_VALID) {
+                  cyl_cache[ndx].last_use = ++cyl_cache_counter;
+               }
+            } else {
+               ndx = cyl_cache_alloc(drive_params, drive, pcyl);
+               if (ndx >= 0 && cyl_cache_load(drive_params, ndx)) {
+                  cyl_cache_prefetches++;
+               }
+            }
+         }
+      }
+   }
+   pthread_mutex_unlock(&cyl_cache_mutex);
+
+   return NULL;
 }
 
 // Returns 1 if changed since last call
@@ -484,11 +1197,10 @@ static void *emu_proc(void *arg)
             for (trk = 0; trk < drive_params->emu_file_info[i].num_head; trk++) {
                // For each dirty track read the data from PRU, put in
                // buffer and tell writer it has more data.
-               if (dirty & (1 << trk)) {
-                  pru_read_mem(MEM_DDR, track_buffer[track_buffer_put].buf,
-                     track_size[i], track_size[i]*trk +
-                     i*DDR_DRIVE_BUFFER_MAX_SIZE);
-
+               if ((dirty & (1 << trk)) && drive_params->ram != RAM_NONE) {
+                  ram_write_track(drive_params, i, cyl[i], trk,
+                     track_size[i]);
+               } else if (dirty & (1 << trk)) {
                   num_used_buf = track_buffers_used(drive_params->buffer_count);
                   // -1 is because last buffer can't be used
                   num_free_buf = drive_params->buffer_count - num_used_buf - 1;
@@ -496,7 +1208,7 @@ static void *emu_proc(void *arg)
                   if (num_free_buf < min_free_buf) {
                      min_free_buf = num_free_buf;
                   }
-                  update_buffer(drive_params->buffer_count, i, cyl[i], trk, track_size[i]);
+                  update_buffer(drive_params, i, cyl[i], trk, track_size[i]);
 
                   // Do linear delay based on number of buffers full
                   // We will do one delay after all data transfered
@@ -524,11 +1236,42 @@ static void *emu_proc(void *arg)
    }
    // Tell PRU we saw the exiting flag
    pru_write_word(MEM_PRU0_DATA,PRU0_DRIVE0_CUR_CYL, 0);
-   update_buffer(drive_params->buffer_count, -1, 0, 0, 0);
+   if (drive_params->ram != RAM_NONE) {
+      pthread_mutex_lock(&ram_mutex);
+      ram_exit = 1;
+      pthread_cond_signal(&ram_dirty_cond);
+      pthread_mutex_unlock(&ram_mutex);
+   } else {
+      update_buffer(drive_params, -1, 0, 0, 0);
+   }
+
+   if (drive_params->cache_count > 0) {
+      pthread_mutex_lock(&cyl_cache_mutex);
+      prefetch_exit = 1;
+      pthread_cond_signal(&prefetch_cond);
+      pthread_mutex_unlock(&cyl_cache_mutex);
+      pthread_join(prefetch_thread, NULL);
+   }
 
    if (log_file) {
       fprintf(log_file,"   Max seek time %.1f ms min free buffers %d, %u seeks %u writes\n",
          max_seek_time, min_free_buf, total_seeks, total_writes);
+      if (drive_params->ram == RAM_NONE) {
+         fprintf(log_file,"   %u track writes combined with track waiting to be written\n",
+            track_buffer_combined);
+      }
+      fprintf(log_file,"   %u track writes didn't change data\n",
+         tracks_unchanged);
+      if (drive_params->cache_count > 0 &&
+            cyl_cache_hits + cyl_cache_misses > 0) {
+         fprintf(log_file,"   Cylinder cache hit rate %.1f%%, %u hits %u misses %u prefetched\n",
+            cyl_cache_hits * 100.0 / (cyl_cache_hits + cyl_cache_misses),
+            cyl_cache_hits, cyl_cache_misses, cyl_cache_prefetches);
+      }
+      if (drive_params->ram != RAM_NONE) {
+         fprintf(log_file,"   Emulation file in memory, max %d tracks waiting to be written\n",
+            ram_max_dirty_count);
+      }
    }
 
    return NULL;
@@ -540,25 +1283,44 @@ static void *emu_proc(void *arg)
 static void *emu_proc_write(void *arg)
 {
    DRIVE_PARAMS *drive_params = arg;
-   int i;
+   int i, get, expected;
 
    while (1) {
+      get = atomic_load_explicit(&track_buffer_get, memory_order_relaxed);
       // wait until data available
-      sem_wait(&write_sem);
+      while (get == atomic_load_explicit(&track_buffer_put,
+            memory_order_acquire)) {
+         track_buffer_wait(&track_buffer_put, &track_buffer_get_waiting,
+            track_buffer_get_fd, get);
+      }
 
       // drive -1 signals we are done
-      if (track_buffer[track_buffer_get].drive == -1) {
+      if (track_buffer[get].drive == -1) {
          break;
       }
+      // Claim entry so emu_proc doesn't change the data while we write it.
+      // emu_proc only holds it long enough to copy the data.
+      expected = TRACK_PENDING;
+      while (!atomic_compare_exchange_weak(&track_buffer[get].state,
+            &expected, TRACK_WRITING)) {
+         expected = TRACK_PENDING;
+         sched_yield();
+      }
 
-      emu_file_rewrite_track(
-         drive_params->fd[track_buffer[track_buffer_get].drive],
-         &drive_params->emu_file_info[track_buffer[track_buffer_get].drive],
-         track_buffer[track_buffer_get].cyl,
-         track_buffer[track_buffer_get].head,
-         track_buffer[track_buffer_get].buf,
-         track_buffer[track_buffer_get].size);
-      track_buffer_get = (track_buffer_get + 1) % drive_params->buffer_count;
+      emu_file_rewrite_track_range(
+         drive_params->fd[track_buffer[get].drive],
+         &drive_params->emu_file_info[track_buffer[get].drive],
+         track_buffer[get].cyl,
+         track_buffer[get].head,
+         track_buffer[get].buf,
+         track_buffer[get].start,
+         track_buffer[get].len);
+      track_bytes_written += track_buffer[get].len;
+      track_bytes_full += track_buffer[get].size;
+      atomic_store(&track_buffer[get].state, TRACK_WRITTEN);
+      track_buffer_update(&track_buffer_get,
+         (get + 1) % drive_params->buffer_count,
+         &track_buffer_put_waiting, track_buffer_put_fd);
    }
 
    // Done with files
@@ -579,6 +1341,10 @@ void check_select_input()
    char buf[100];
    int rc;
 
+#ifdef SIM_PRU
+   // No pins to check
+   return;
+#endif
    fd = open(ocp_pin, O_RDONLY);
    if (fd >= 0) {
       // Make sure correct setup run
@@ -819,18 +1585,67 @@ int main(int argc, char *argv[])
    pru_write_word(MEM_PRU1_DATA, PRU1_ZERO_BIT_THRESHOLD, zero_threshold);
    pru_write_word(MEM_PRU1_DATA, PRU1_BIT_PRU_CLOCKS, bit_period);
 
-   track_buffer = malloc(drive_params.buffer_count * sizeof(*track_buffer));
-   if (track_buffer == NULL) {
-      msg(MSG_FATAL, "Track buffer malloc failed\n");
+   track_scratch = malloc(max_buffer);
+   if (track_scratch == NULL) {
+      msg(MSG_FATAL, "Track scratch buffer malloc failed\n");
       exit(1);
    }
-   memset(track_buffer, 0, drive_params.buffer_count * sizeof(*track_buffer));
-   for (i = 0; i < drive_params.buffer_count; i++) {
-      track_buffer[i].buf = malloc(max_buffer);
-      if (track_buffer[i].buf == NULL) {
-         msg(MSG_FATAL, "Track buffer buf malloc failed\n");
+
+   // Track buffers aren't used when the file is in memory
+   if (drive_params.ram == RAM_NONE) {
+      track_buffer = malloc(drive_params.buffer_count * sizeof(*track_buffer));
+      if (track_buffer == NULL) {
+         msg(MSG_FATAL, "Track buffer malloc failed\n");
          exit(1);
       }
+      memset(track_buffer, 0, drive_params.buffer_count * sizeof(*track_buffer));
+      for (i = 0; i < drive_params.buffer_count; i++) {
+         track_buffer[i].buf = malloc(max_buffer);
+         if (track_buffer[i].buf == NULL) {
+            msg(MSG_FATAL, "Track buffer buf malloc failed\n");
+            exit(1);
+         }
+      }
+      for (i = 0; i < drive_params.num_drives; i++) {
+         int num_tracks = drive_params.emu_file_info[i].num_cyl *
+            drive_params.emu_file_info[i].num_head;
+
+         track_buffer_index[i] = malloc(num_tracks * sizeof(int));
+         if (track_buffer_index[i] == NULL) {
+            msg(MSG_FATAL, "Track buffer index malloc failed\n");
+            exit(1);
+         }
+         memset(track_buffer_index[i], 0xff, num_tracks * sizeof(int));
+      }
+   } else {
+      ram_load(&drive_params);
+   }
+
+   if (drive_params.cache_count > 0) {
+      int max_cyl_size = 0;
+
+      for (i = 0; i < drive_params.num_drives; i++) {
+         EMU_FILE_INFO *curr_info = &drive_params.emu_file_info[i];
+         int cyl_size = curr_info->num_head *
+            (curr_info->track_data_size_bytes +
+            curr_info->track_header_size_bytes);
+
+         if (cyl_size > max_cyl_size) {
+            max_cyl_size = cyl_size;
+         }
+      }
+      cyl_cache = calloc(drive_params.cache_count, sizeof(*cyl_cache));
+      if (cyl_cache == NULL) {
+         msg(MSG_FATAL, "Cylinder cache malloc failed\n");
+         exit(1);
+      }
+      for (i = 0; i < drive_params.cache_count; i++) {
+         cyl_cache[i].buf = malloc(max_cyl_size);
+         if (cyl_cache[i].buf == NULL) {
+            msg(MSG_FATAL, "Cylinder cache buf malloc failed\n");
+            exit(1);
+         }
+      }
    }
 
    // DMA channel 7 and PaRAM blocks 7-8 are reserved in our new dto
@@ -853,7 +1668,18 @@ int main(int argc, char *argv[])
    signal(SIGTERM,(__sighandler_t) shutdown_signal);
    atexit(shutdown);
 
-   sem_init(&write_sem, 0, 0);
+   track_buffer_get_fd = eventfd(0, 0);
+   track_buffer_put_fd = eventfd(0, 0);
+   if (track_buffer_get_fd < 0 || track_buffer_put_fd < 0) {
+      msg(MSG_FATAL, "Unable to create eventfd %s\n", strerror(errno));
+      exit(1);
+   }
+
+   if (drive_params.cache_count > 0 && pthread_create(&prefetch_thread, NULL,
+         &emu_proc_prefetch, &drive_params) != 0) {
+      msg(MSG_FATAL, "Unable to create prefetch thread\n");
+      exit(1);
+   }
 
    if (pthread_create(&read_thread, NULL, &emu_proc, &drive_params)
       != 0) {
@@ -861,8 +1687,8 @@ int main(int argc, char *argv[])
       exit(1);
    }
 
-   if (pthread_create(&write_thread, NULL, &emu_proc_write, &drive_params)
-      != 0) {
+   if (pthread_create(&write_thread, NULL, drive_params.ram != RAM_NONE ?
+         &emu_proc_ram_write : &emu_proc_write, &drive_params) != 0) {
       msg(MSG_FATAL, "Unable to create write thread\n");
       exit(1);
    }
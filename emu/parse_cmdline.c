@@ -4,6 +4,9 @@
 // Call parse_print_cmdline to print drive parameter information in command
 //   line format
 //
+// 10/17/26 DJG Cylinder cache off unless --cache specified
+// 10/17/26 DJG Added --ram option
+// 10/17/26 DJG Added --cache option
 // 02/23/24 DJG Changed default buffers to match autostart script values
 // 09/12/23 JST Changes to support 5.10 kernel and --sync option
 // 05/17/21 DJG removed --fill and added optional argument after --initialize
@@ -49,6 +52,7 @@
 
 static void parse_drive_list(char *arg, DRIVE_PARAMS *drive_params);
 static void parse_buffer_list(char *arg, DRIVE_PARAMS *drive_params);
+static void parse_cache_list(char *arg, DRIVE_PARAMS *drive_params);
 static void parse_filename_list(char *arg, DRIVE_PARAMS *drive_params);
 static int parse_controller(char *arg);
 
@@ -76,9 +80,11 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params)
          {"options", 1, NULL, 'o'},
          {"rpm", 1, NULL, 'R'},
          {"sync", 0, NULL, 's'},
+         {"cache", 2, NULL, 'C'},
+         {"ram", 2, NULL, 'm'},
          {NULL, 0, NULL, 0}
    };
-   char short_options[] = "f:d:h:c:r:b:i::p:q:vn:o:R:s";
+   char short_options[] = "f:d:h:c:r:b:i::p:q:vn:o:R:sC::m::";
    int rc;
    // Loop counters
    int i;
@@ -96,6 +102,9 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params)
    drive_params->buffer_max_time = .6;
    drive_params->sample_rate_hz = 10000000;
    drive_params->sync = 0;
+   // Cylinder cache is off unless --cache is specified
+   drive_params->cache_count = 0;
+   drive_params->cache_readahead = 0;
 
    //drive_params->initialize and ->num_drives need to be zero
 
@@ -177,6 +186,25 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params)
       case 's':
 	 drive_params->sync = 1;
 	 break;
+      case 'C':
+         // Default number of cylinders cached and cylinders to read ahead
+         drive_params->cache_count = 32;
+         drive_params->cache_readahead = 2;
+         if (optarg != NULL) {
+            parse_cache_list(optarg, drive_params);
+         }
+         break;
+      case 'm':
+         if (optarg == NULL) {
+            drive_params->ram = RAM_NORMAL;
+         } else if (strcasecmp(optarg, "huge") == 0) {
+            drive_params->ram = RAM_HUGE;
+         } else {
+            msg(MSG_FATAL, "Unknown ram option %s, only huge is valid\n",
+               optarg);
+            exit(1);
+         }
+         break;
       case '?':
          exit(1);
          break;
@@ -215,6 +243,55 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params)
    }
    drive_params->buffer_time = drive_params->buffer_max_time /
       drive_params->buffer_count;
+   // All cylinders are in memory so cache not needed
+   if (drive_params->ram != RAM_NONE) {
+      drive_params->cache_count = 0;
+   }
+}
+
+// Routine for parsing comma separated cylinder cache information
+//
+// arg: Argument string
+// drive_params: Drive parameters to store cache information in
+static void parse_cache_list(char *arg, DRIVE_PARAMS *drive_params) {
+   int i;
+   char *str, *tok;
+
+   str = arg;
+
+   i = 0;
+   while (1) {
+      tok = strtok(str,",");
+      if (tok == NULL) {
+         break;
+      }
+      switch(i) {
+         case 0:
+            drive_params->cache_count = atoi(tok);
+         break;
+         case 1:
+            drive_params->cache_readahead = atoi(tok);
+         break;
+         default:
+            msg(MSG_FATAL, "Maximum of %d cache parameters may be specified\n",
+               i);
+            exit(1);
+      }
+      str = NULL;  // For next strtok call
+      i++;
+   }
+   if (drive_params->cache_count < 0 || drive_params->cache_readahead < 0) {
+      msg(MSG_FATAL, "Cache parameters can't be negative\n");
+      exit(1);
+   }
+   // Need room for the cylinder being emulated and the cylinders on
+   // each side being prefetched
+   if (drive_params->cache_count != 0 && drive_params->cache_count <
+         drive_params->cache_readahead * 2 + 2) {
+      msg(MSG_FATAL, "Cache must hold at least %d cylinders for read ahead of %d\n",
+         drive_params->cache_readahead * 2 + 2, drive_params->cache_readahead);
+      exit(1);
+   }
 }
 
 // Routine for parsing comma separated buffer information
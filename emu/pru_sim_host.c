@@ -0,0 +1,197 @@
+// Simulated disk controller and PRU programs for mfm_emu. Used with the
+// simulated PRU in ../mfm/pru_sim.c when built with make SIM_PRU=1.
+//
+// Instead of generating and reading the MFM signals the simulated PRU 0
+// acts like a controller using the emulated drive 0. It seeks to random
+// cylinders, reads for one or two rotations, and for MFM_SIM_WRITE_PCT
+// percent of the seeks writes a track before seeking. Writes change a
+// sector sized span of the track data in DDR memory to random bytes and
+// mark the track dirty so only part of the track differs from the
+// emulation file. After MFM_SIM_SEEKS seeks the time mfm_emu took to provide
+// the new cylinder is printed and mfm_emu is sent SIGTERM to exit. The
+// random sequence is the same for each run.
+//
+// Call pru_sim_find_program to get the simulated PRU program
+//
+// 10/17/26 DJG Change track data when writing
+// 10/17/26 DJG Initial version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <prussdrv.h>
+#include <pruss_intc_mapping.h>
+
+#include "msg.h"
+#include "pru_setup.h"
+#include "cmd.h"
+
+// Default number of seeks and percent of seeks with a write
+#define DEFAULT_SEEKS 500
+#define DEFAULT_WRITE_PCT 25
+// Bytes changed by a simulated write
+#define WRITE_BYTES 512
+// PRU clock period in nanoseconds
+#define PRU_CLOCK_NS 5
+
+// Wait for mfm_emu to start PRU with CMD_START then return OK status.
+//
+// pru: PRU number
+// return: 0 if started, 1 if exit requested while waiting
+static int wait_start(int pru)
+{
+   while (pru_read_word(MEM_PRU0_DATA, PRU0_CMD) != CMD_START) {
+      if (pru_read_word(MEM_PRU0_DATA, PRU0_EXIT) || pru_sim_stopping(pru)) {
+         return 1;
+      }
+      usleep(20);
+   }
+   return 0;
+}
+
+// Tell mfm_emu we are exiting and wait for it to acknowledge then signal
+// PRU done.
+//
+// pru: PRU number
+static void host_exit(int pru)
+{
+   pru_write_word(MEM_PRU0_DATA, PRU0_DRIVE0_CUR_CYL, -1);
+   pru_sim_signal_event(PRU_EVTOUT_0);
+   while ((int32_t) pru_read_word(MEM_PRU0_DATA, PRU0_DRIVE0_CUR_CYL) != 0 &&
+         !pru_sim_stopping(pru)) {
+      // mfm_emu may be starting us for the last cylinder it was sent
+      if (pru_read_word(MEM_PRU0_DATA, PRU0_CMD) == CMD_START) {
+         pru_write_word(MEM_PRU0_DATA, PRU0_CMD, CMD_STATUS_OK);
+      }
+      usleep(100);
+   }
+   pru_sim_signal_event(PRU_EVTOUT_0);
+   pru_sim_signal_event(PRU_EVTOUT_1);
+}
+
+// Simulated PRU 0 program. Acts as a controller seeking and writing the
+// emulated drive.
+//
+// pru: PRU number
+static void host_program(int pru)
+{
+   int num_seeks = pru_sim_env("MFM_SIM_SEEKS", DEFAULT_SEEKS);
+   int write_pct = pru_sim_env("MFM_SIM_WRITE_PCT", DEFAULT_WRITE_PCT);
+   unsigned int seed = 1;
+   int num_cyl, num_head;
+   uint64_t rotation_ns, seek_start_ns, seek_ns;
+   uint64_t total_seek_ns = 0, max_seek_ns = 0;
+   int seeks = 0, writes = 0;
+   int cyl, head = 0;
+   int track_header_bytes, track_data_bytes, track_size;
+   int i, start, len;
+   uint8_t write_data[WRITE_BYTES];
+
+   // Drive 0 selected on the rev C board select lines
+   pru_write_word(MEM_PRU0_DATA, PRU0_R31, 1 << R31_SEL2_BIT);
+   if (wait_start(pru)) {
+      host_exit(pru);
+      return;
+   }
+   num_cyl = pru_read_word(MEM_PRU0_DATA, PRU0_DRIVE0_NUM_CYL);
+   num_head = pru_read_word(MEM_PRU0_DATA, PRU0_DRIVE0_NUM_HEAD);
+   rotation_ns = (uint64_t) pru_read_word(MEM_PRU0_DATA, PRU0_ROTATION_TIME) *
+      PRU_CLOCK_NS;
+   track_header_bytes = pru_read_word(MEM_PRU1_DATA,
+      PRU1_DRIVE0_TRACK_HEADER_BYTES);
+   track_data_bytes = pru_read_word(MEM_PRU1_DATA,
+      PRU1_DRIVE0_TRACK_DATA_BYTES);
+   track_size = track_header_bytes + track_data_bytes;
+   pru_write_word(MEM_PRU0_DATA, PRU0_CMD, CMD_STATUS_OK);
+   msg(MSG_INFO, "Simulated controller doing %d seeks, %d%% with write\n",
+      num_seeks, write_pct);
+
+   cyl = 0;
+   while (seeks < num_seeks && !pru_read_word(MEM_PRU0_DATA, PRU0_EXIT)) {
+      // Read the current cylinder
+      head = rand_r(&seed) % num_head;
+      pru_write_word(MEM_PRU0_DATA, PRU0_CUR_SELECT_HEAD, (head ^ 0xf) << 8);
+      pru_sim_sleep_ns(rotation_ns * (1 + rand_r(&seed) % 2));
+      if (rand_r(&seed) % 100 < write_pct) {
+         pru_sim_sleep_ns(rotation_ns);
+         len = track_data_bytes < WRITE_BYTES ? track_data_bytes : WRITE_BYTES;
+         start = rand_r(&seed) % (track_data_bytes - len + 1);
+         for (i = 0; i < len; i++) {
+            write_data[i] = rand_r(&seed);
+         }
+         pru_write_mem(MEM_DDR, write_data, len,
+            track_size * head + track_header_bytes + start);
+         pru_write_word(MEM_PRU1_DATA, PRU1_DRIVE0_TRK_DIRTY,
+            pru_read_word(MEM_PRU1_DATA, PRU1_DRIVE0_TRK_DIRTY) | (1 << head));
+         writes++;
+      }
+
+      // Seek to a different cylinder and wait for mfm_emu to have the
+      // data ready
+      if (num_cyl > 1) {
+         cyl = (cyl + 1 + rand_r(&seed) % (num_cyl - 1)) % num_cyl;
+      }
+      seek_start_ns = pru_sim_time_ns();
+      pru_write_word(MEM_PRU0_DATA, PRU0_DRIVE0_CUR_CYL, cyl);
+      pru_sim_signal_event(PRU_EVTOUT_0);
+      if (wait_start(pru)) {
+         break;
+      }
+      seek_ns = pru_sim_time_ns() - seek_start_ns;
+      pru_write_word(MEM_PRU0_DATA, PRU0_SEEK_TIME, seek_ns / PRU_CLOCK_NS);
+      pru_write_word(MEM_PRU0_DATA, PRU0_CMD, CMD_STATUS_OK);
+      total_seek_ns += seek_ns;
+      if (seek_ns > max_seek_ns) {
+         max_seek_ns = seek_ns;
+      }
+      seeks++;
+   }
+   if (seeks > 0) {
+      msg(MSG_INFO, "Simulated controller %d seeks %d writes, seek time "
+         "average %.3f ms max %.3f ms\n", seeks, writes,
+         total_seek_ns / 1e6 / seeks, max_seek_ns / 1e6);
+   }
+   // Stop mfm_emu the same as systemctl stop
+   if (!pru_read_word(MEM_PRU0_DATA, PRU0_EXIT)) {
+      pthread_kill(pru_sim_main_thread(), SIGTERM);
+   }
+   while (!pru_read_word(MEM_PRU0_DATA, PRU0_EXIT) && !pru_sim_stopping(pru)) {
+      usleep(1000);
+   }
+   host_exit(pru);
+   pru_sim_idle_program(pru);
+}
+
+// Return the simulated PRU program for the PRU program file.
+//
+// filename: PRU program file name without directory
+// return: Simulated program or NULL if not simulated
+PRU_SIM_PROGRAM pru_sim_find_program(char *filename)
+{
+   if (strncmp(filename, "prucode0_", 9) == 0) {
+      return host_program;
+   }
+   if (strncmp(filename, "prucode1_", 9) == 0) {
+      return pru_sim_idle_program;
+   }
+   return NULL;
+}
@@ -9,6 +9,9 @@
 // Copyright 2021 David Gesswein.
 // This file is part of MFM disk utilities.
 //
+// 10/17/26 DJG Made analyze_header decode track once for each controller and
+//    header CRC length then check the CRC parameters against the saved
+//    headers instead of decoding the track for each.
 // 01/13/25 DJG Fixes for xebec_skew processing. Skew not same on all tracks.
 // 10/30/24 DJG Add new option to handle Xebec data skewed one sector from 
 //    header
@@ -335,6 +338,43 @@ static int analyze_model(DRIVE_PARAMS *drive_params, int cyl, int head,
    return matches;
 }
 
+// Count the good headers found decoding a track. 
+//
+// drive_params: Drive parameters track decoded with
+// cyl: Cylinder decoded
+// sector_status_list: Status of the sectors decoded
+// return: Number of good headers. Zero if LBA addresses aren't plausible
+static int count_good_headers(DRIVE_PARAMS *drive_params, int cyl,
+   SECTOR_STATUS sector_status_list[])
+{
+   int good_header_count = 0;
+   // Minimum and maximum LBA to verify they make sense
+   int min_lba_addr = 0x7fffffff;
+   int max_lba_addr = -1;
+   int i;
+
+   for (i = 0; i < drive_params->num_sectors; i++) {
+      if (!(sector_status_list[i].status & SECT_BAD_HEADER) &&
+          !(sector_status_list[i].status & SECT_AMBIGUOUS_CRC)) {
+         good_header_count++;
+         if (sector_status_list[i].lba_addr < min_lba_addr) {
+            min_lba_addr = sector_status_list[i].lba_addr;
+         } else if (sector_status_list[i].lba_addr > max_lba_addr) {
+            max_lba_addr = sector_status_list[i].lba_addr;
+         }
+      }
+   }
+   // If LBA drive make sure addresses are somewhat adjacent and
+   // plausible for the cylinder. If not clear good header count
+   if (mfm_controller_info[drive_params->controller].analyze_type == CINFO_LBA &&
+      (max_lba_addr - min_lba_addr > drive_params->num_sectors ||
+         max_lba_addr - min_lba_addr + 1 < good_header_count ||
+         min_lba_addr > cyl * 16 * 34)) {
+      good_header_count = 0;
+   }
+   return good_header_count;
+}
+
 // Try to find the controller type (header format) and CRC parameters for the
 // header portion of sectors.
 // The data to analyze has already been read before routine called.
@@ -353,7 +393,6 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
 {
    // Loop variables
    int poly, init, cont;
-   int i;
    int controller_type = -1;
    // Numbers of good sectors found
    int good_header_count, previous_good_header_count = 0;
@@ -365,8 +404,13 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
    SECTOR_DECODE_STATUS status;
    // Index into drive_params_list
    int drive_params_list_index = 0;
-   // Minimum and maximum LBA to verify they make sense
-   int min_lba_addr, max_lba_addr;
+   // Headers saved from decoding track with all header checks failing
+   CRC_CAPTURE crc_capture;
+   // Header CRC length crc_capture is for, -1 if none
+   int crc_capture_length;
+   // Non zero if CRC parameters not matching any header in crc_capture
+   // can be skipped
+   int crc_capture_valid = 0;
 
    drive_read_track(drive_params, cyl, head, deltas, max_deltas, 0);
 
@@ -378,6 +422,7 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
    drive_params->header_crc.ecc_max_span = 0;
    drive_params->data_crc.ecc_max_span = 0;
 
+   memset(&crc_capture, 0, sizeof(crc_capture));
    // Try an exhaustive search of all the formats we know about. If we get too
    // many we may have to try something smarter.
    // If LBA format don't try to analyze if cyl and head are zero since CHS
@@ -397,9 +442,10 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
          drive_params->start_time_ns = 
             mfm_controller_info[cont].start_time_ns;
       }
-      // TODO: This would be faster if we just searched in mfm_process_bytes
-      // where we check the CRC instead of decoding the MFM transitions
-      // each time.
+      crc_capture_length = -1;
+      // Decoding the MFM transitions is slow so we decode the track once
+      // saving the header bytes then only decode again with CRC parameters
+      // that match a header.
       for (poly = mfm_controller_info[cont].header_start_poly; 
              poly < mfm_controller_info[cont].header_end_poly; poly++) {
          drive_params->header_crc.poly = mfm_all_poly[poly].poly;
@@ -425,8 +471,28 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
                  mfm_controller_info[controller_type].header_bytes) {
                break;
             }
-            mfm_init_sector_status_list(sector_status_list, drive_params->num_sectors);
             msg_mask_hold = msg_set_err_mask(decode_errors);
+            // The CRC length changes the bytes the decoder checks so
+            // need to decode the track again to save the headers.
+            if (crc_capture_length != drive_params->header_crc.length) {
+               mfm_init_sector_status_list(sector_status_list, 
+                  drive_params->num_sectors);
+               mfm_crc_capture_set(drive_params, &crc_capture);
+               mfm_decode_track(drive_params, cyl, head, deltas, NULL, 
+                  sector_status_list);
+               mfm_crc_capture_set(drive_params, NULL);
+               crc_capture_length = drive_params->header_crc.length;
+               // If track decoded with no headers matching found any
+               // good headers we can't skip decoding.
+               crc_capture_valid = count_good_headers(drive_params, cyl,
+                  sector_status_list) == 0;
+            }
+            if (crc_capture_valid &&
+                  !mfm_crc_capture_match(drive_params, &crc_capture)) {
+               msg_set_err_mask(msg_mask_hold);
+               continue;
+            }
+            mfm_init_sector_status_list(sector_status_list, drive_params->num_sectors);
             // Decode track
             status = mfm_decode_track(drive_params, cyl, head, deltas, NULL, 
                   sector_status_list);
@@ -438,28 +504,8 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
 
             }
             // Now find out how many good sectors we got with these parameters
-            good_header_count = 0;
-            min_lba_addr = 0x7fffffff;
-            max_lba_addr = -1;
-            for (i = 0; i < drive_params->num_sectors; i++) {
-               if (!(sector_status_list[i].status & SECT_BAD_HEADER) &&
-                   !(sector_status_list[i].status & SECT_AMBIGUOUS_CRC)) {
-                  good_header_count++;
-                  if (sector_status_list[i].lba_addr < min_lba_addr) {
-                     min_lba_addr = sector_status_list[i].lba_addr;
-                  } else if (sector_status_list[i].lba_addr > max_lba_addr) {
-                     max_lba_addr = sector_status_list[i].lba_addr;
-                  }
-               }
-            }
-            // If LBA drive make sure addresses are somewhat adjacent and
-            // plausible for the cylinder. If not clear good header count
-            if (mfm_controller_info[cont].analyze_type == CINFO_LBA &&
-               (max_lba_addr - min_lba_addr > drive_params->num_sectors ||
-                  max_lba_addr - min_lba_addr + 1 < good_header_count ||
-                  min_lba_addr > cyl * 16 * 34)) {
-               good_header_count = 0;
-            }
+            good_header_count = count_good_headers(drive_params, cyl,
+               sector_status_list);
             // If we found at least 2 sectors or 1 if sector is large
             // enough to only have one per track 
             if (good_header_count >= 2 || (good_header_count == 1 &&
@@ -492,6 +538,7 @@ static int analyze_header(DRIVE_PARAMS *drive_params, int cyl, int head,
          }
       }
    }
+   mfm_crc_capture_free(&crc_capture);
    return drive_params_list_index;
 }
 
@@ -3,6 +3,7 @@
 // board_initialize sets up this module.
 // board_get_revision returns the revision of the MFM emulator board
 // 
+// 10/17/2026 DJG Added simulated board for SIM_PRU builds
 // 05/15/2026 DJG Improved printing board revision
 // 09/17/2023 DJG Moved set_restore_max_cpu_speed to this file as board_
 //   to only have one copy
@@ -58,6 +59,12 @@ void board_initialize(void) {
    if (board_revision == -1) {
          // Default is A
       board_revision = 0;
+#ifdef SIM_PRU
+      // Simulated PRU acts like the current board revision
+      board_revision = 2;
+      msg(MSG_INFO, "Board revision %s simulated\n", rev_str[board_revision]);
+      return;
+#endif
       for (i = 0; i < ARRAYSIZE(pins); i++) { 
          sprintf(str, "/sys/class/gpio/gpio%d/value", pins[i]);
          fd = open(str, O_RDONLY);
@@ -94,6 +101,10 @@ int board_set_restore_max_cpu_speed(int restore) {
    static int freq_changed = 0;
    char maxfreq[100];
 
+#ifdef SIM_PRU
+   // Leave the speed of the system running the simulation alone
+   return 0;
+#endif
    if (!restore) {
       file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", "r");
       if (file == NULL) {
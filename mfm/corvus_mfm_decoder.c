@@ -6,6 +6,12 @@
 //
 // Copyright 2024 David Gesswein.
 //
+// 10/17/26 DJG Get CONTROLLER_IMS_A820 rotation time from PLL_TRACK steps
+//    so it works when decoding emulation file bits
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Moved static variables into TRACK_STATE and DECODE_CONTEXT
+// 10/17/26 DJG Made static variables thread local for mfm_util --jobs
 // 07/02/24 DJG Fixed ECC length for CONTROLLER_IMS_A820 and added ext2emu support
 // 06/26/24 DJG Added CONTROLLER_IMS_A820
 // 05/19/24 DJG Changed filter_state to not be static. Bad data can cause it
@@ -65,19 +71,7 @@
 #include "mfm_decoder.h"
 #include "msg.h"
 #include "deltas_read.h"
-
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
-{
-   float in, out;
-                 
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
-}
+#include "mfm_pll.h"
 
 // Decode bytes into header or sector data for the various formats we know about.
 // The decoded data will be written to a file if one was specified.
@@ -206,74 +200,75 @@ SECTOR_DECODE_STATUS corvus_process_data(STATE_TYPE *state, uint8_t bytes[],
          SECTOR_DECODE_STATUS init_status)
 
 {
-   static int sector_size;
-   static int bad_block;
-   static SECTOR_STATUS sector_status;
+   // Values saved between processing the header and data are kept in
+   // the track state
+   TRACK_STATE *track_state = drive_params->track_state;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
    uint8_t cromemco_sync[] = {0x04, 0x00, 0xaa, 0xaa, 0xaa, 0x00};
 
    if (*state == PROCESS_HEADER) {
       *state = MARK_ID;
 
-      memset(&sector_status, 0, sizeof(sector_status));
-      sector_status.status |= init_status | SECT_HEADER_FOUND;
-      sector_status.ecc_span_corrected_header = ecc_span;
+      memset(sector_status, 0, sizeof(*sector_status));
+      sector_status->status |= init_status | SECT_HEADER_FOUND;
+      sector_status->ecc_span_corrected_header = ecc_span;
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
 
       if (drive_params->controller == CONTROLLER_CORVUS_H) {
-         sector_status.cyl = bytes[1] | (bytes[2] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[0] >> 5 );
-         sector_status.sector = bytes[0] & 0x1f;
+         sector_status->cyl = bytes[1] | (bytes[2] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[0] >> 5 );
+         sector_status->sector = bytes[0] & 0x1f;
       } else if (drive_params->controller == CONTROLLER_CROMEMCO) {
-         sector_status.cyl = bytes[6] | (bytes[7] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[8]);
-         sector_status.sector = 0; // Only 1 sector
+         sector_status->cyl = bytes[6] | (bytes[7] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[8]);
+         sector_status->sector = 0; // Only 1 sector
          if (memcmp(bytes, cromemco_sync, sizeof(cromemco_sync)) != 0) {
             msg(MSG_ERR, "Bad alignment bytes %x %x %x %x %x %x on cyl %d,%d head %d,%d\n",
                bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5],
-                  exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head);
+                  exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head);
          }
       } else if (drive_params->controller == CONTROLLER_VECTOR4) {
          if (bytes[0] != 0xff) {
             msg(MSG_ERR, "Bad sync byte %x on cyl %d,%d head %d,%d\n",
-               bytes[0], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head);
-            sector_status.status |= SECT_BAD_HEADER;
+               bytes[0], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head);
+            sector_status->status |= SECT_BAD_HEADER;
          }
-         sector_status.cyl = ((bytes[1] & 0xf) << 8)  | bytes[2];
-         sector_status.head = mfm_fix_head(drive_params, exp_head,bytes[1] >> 4);
-         sector_status.sector = bytes[3];
+         sector_status->cyl = ((bytes[1] & 0xf) << 8)  | bytes[2];
+         sector_status->head = mfm_fix_head(drive_params, exp_head,bytes[1] >> 4);
+         sector_status->sector = bytes[3];
       } else if (drive_params->controller == CONTROLLER_VECTOR4_ST506) {
          if (bytes[0] != 0xff) {
             msg(MSG_ERR, "Bad sync byte %x on cyl %d,%d head %d,%d\n",
-               bytes[0], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head);
-            sector_status.status |= SECT_BAD_HEADER;
+               bytes[0], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head);
+            sector_status->status |= SECT_BAD_HEADER;
          }
-         sector_status.cyl = bytes[2];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[1]);
-         sector_status.sector = bytes[3];
+         sector_status->cyl = bytes[2];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[1]);
+         sector_status->sector = bytes[3];
       } else if (drive_params->controller == CONTROLLER_STRIDE_440) {
          int track = (bytes[7] << 8) + bytes[8];
-         sector_status.cyl = track / drive_params->num_head;
-         sector_status.head = track % drive_params->num_head;
-         sector_status.sector = 0;
+         sector_status->cyl = track / drive_params->num_head;
+         sector_status->head = track % drive_params->num_head;
+         sector_status->sector = 0;
       } else if (drive_params->controller == CONTROLLER_IMS_A820) {
-         sector_status.cyl = bytes[0] | (bytes[1] << 8);
-         sector_status.head = bytes[2];
-         sector_status.sector = bytes[3];
+         sector_status->cyl = bytes[0] | (bytes[1] << 8);
+         sector_status->head = bytes[2];
+         sector_status->sector = bytes[3];
       } else if (drive_params->controller == CONTROLLER_SAGA_FOX) {
          if (bytes[0] != 0xf0) {
             msg(MSG_ERR, "Bad sync byte %x on cyl %d,%d head %d,%d\n",
-               bytes[0], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head);
-            sector_status.status |= SECT_BAD_HEADER;
+               bytes[0], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head);
+            sector_status->status |= SECT_BAD_HEADER;
          }
-         sector_status.cyl = bytes[1] | (bytes[2] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3]);
-         sector_status.sector = bytes[4];
+         sector_status->cyl = bytes[1] | (bytes[2] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3]);
+         sector_status->sector = bytes[4];
          *state = MARK_DATA;
       } else {
          msg(MSG_FATAL,"Unknown controller type %d\n",drive_params->controller);
@@ -282,55 +277,55 @@ SECTOR_DECODE_STATUS corvus_process_data(STATE_TYPE *state, uint8_t bytes[],
 
 
       // Don't know how/if these are encoded in header
-      sector_size = drive_params->sector_size;
-      bad_block = 0;
+      track_state->sector_size = drive_params->sector_size;
+      track_state->bad_block = 0;
       msg(MSG_DEBUG,
          "Got exp %d,%d cyl %d head %d sector %d size %d bad block %d\n",
-            exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-            sector_status.sector, sector_size, bad_block);
+            exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+            sector_status->sector, track_state->sector_size, track_state->bad_block);
 
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-            seek_difference, &sector_status, drive_params, sector_status_list);
+      mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+            seek_difference, sector_status, drive_params, sector_status_list);
 
-      sector_status.ecc_span_corrected_data = ecc_span;
+      sector_status->ecc_span_corrected_data = ecc_span;
       if (!mfm_controller_info[drive_params->controller].separate_data &&
-            !(sector_status.status & SECT_BAD_HEADER)) {
+            !(sector_status->status & SECT_BAD_HEADER)) {
          int dheader_bytes = mfm_controller_info[drive_params->controller].data_header_bytes;
-         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, &sector_status,
+         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, sector_status,
                sector_status_list, &bytes[0], total_bytes) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
    } else { // PROCESS_DATA
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
+      sector_status->ecc_span_corrected_data = ecc_span;
       // TODO: If bad sector number the stats such as count of spare/bad
       // sectors is not updated. We need to know the sector # to update
       // our statistics array. This happens with RQDX3
-      if (!(sector_status.status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER))) {
+      if (!(sector_status->status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER))) {
          int dheader_bytes = mfm_controller_info[drive_params->controller].data_header_bytes;
 
          // Bytes[1] is because 0xa1 can't be updated from bytes since
          // won't get encoded as special sync pattern
-         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, &sector_status,
+         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, sector_status,
                sector_status_list, &bytes[1], total_bytes-1) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       *state = MARK_ID;
    }
-   return sector_status.status;
+   return sector_status->status;
 }
 
 // Decode a track's worth of deltas.
@@ -362,18 +357,11 @@ SECTOR_DECODE_STATUS corvus_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int decoded_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency in delta counts
-   float avg_bit_sep_time;     // 200 MHz clocks
-   float nominal_bit_sep_time; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   // PLL filter state. Static works better since next track bit timing
-   // similar to previous though a bad track can put it off enough that
-   // the next track has errors. Retry should fix. TODO: Look at
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
    // Counter for debugging
@@ -387,15 +375,6 @@ SECTOR_DECODE_STATUS corvus_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // so this avoids them.
    #define MARK_NUM_ZEROS 30
    int sync_count = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
-   // And number from last time
-   int last_deltas = 0;
-   // If we get too large a delta we need to process it in less than 32 bit
-   // word number of bits. This holds remaining number to process
-   int remaining_delta = 0;
-   // Maximum delta to process in one pass
-   int max_delta;
    // Intermediate value
    int tmp_raw_word;
    // Collect bytes to further process here
@@ -423,31 +402,20 @@ SECTOR_DECODE_STATUS corvus_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    #define REV_BYTE(n)( (rev_lookup[n&0xf] << 4) | rev_lookup[(n & 0xf0)>>4])
 
 
-   nominal_bit_sep_time = 200e6 /
-       mfm_controller_info[drive_params->controller].clk_rate_hz;
-   max_delta = nominal_bit_sep_time * 22;
-   avg_bit_sep_time = nominal_bit_sep_time;
 
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
 
-   static int total_track_time = -1;
+   pll_track = mfm_pll_track_start(drive_params, deltas, 200e6 /
+      mfm_controller_info[drive_params->controller].clk_rate_hz, 1);
    // This drive uses a PLL based on index signal to determine where
    // the sector boundries are. If first time we need to calculate rotation
    // time from deltas so we can do similar. We will update after each track.
-   if (drive_params->controller == CONTROLLER_IMS_A820 && total_track_time == -1) {
-      num_deltas = deltas_get_count(0);
-      i = 1;
-      for (; i < num_deltas && num_deltas >= 0;) {
-         total_track_time += deltas[i++];
-     
-         if (i >= num_deltas) {
-            // Finished what we had, any more?
-            // If we didn't get too many last time sleep so delta reader can run.
-            // Thread priorities might be better.
-            if (num_deltas - last_deltas <= 2000) {
-               usleep(500);
-            }
-            last_deltas = num_deltas;
-            num_deltas = deltas_get_count(i);
+   // The step times add up to the deltas after the first.
+   if (drive_params->controller == CONTROLLER_IMS_A820 && decode_ctx->total_track_time == -1) {
+      i = 0;
+      while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
+         for (; i < num_steps; i++) {
+            decode_ctx->total_track_time += pll_track->steps[i].delta;
          }
       }
    }
@@ -467,7 +435,7 @@ SECTOR_DECODE_STATUS corvus_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    } else if (drive_params->controller == CONTROLLER_SAGA_FOX) {
       next_header_time = 91000;
    } else if (drive_params->controller == CONTROLLER_IMS_A820) {
-      next_header_time = 98100.0 * total_track_time / 3333333;
+      next_header_time = 98100.0 * decode_ctx->total_track_time / 3333333;
    } else {
       msg(MSG_ERR, "Unknown controller\n");
       exit(1);
@@ -486,47 +454,20 @@ fprintf(out,"$var wire 1 & sector $end\n");
    next_header_time -= drive_params->start_time_ns / CLOCKS_TO_NS;
 
    raw_word = 0;
-   i = 1;
-   last_deltas = 0;
-   num_deltas = deltas_get_count(0);
-   while (num_deltas >= 0) {
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas;) {
-         int delta_process;
-         // If no remaining delta process next else finish remaining
-         if (remaining_delta == 0) {
-            delta_process = deltas[i++];
-            remaining_delta = delta_process;
-         }  else {
-            delta_process = remaining_delta;
-         }
-         // Don't overflow our 32 bit word
-         if (delta_process > max_delta) {
-            delta_process = max_delta;
-         }
-         track_time += delta_process;
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += delta_process;
-         remaining_delta -= delta_process;
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock. Don't update PLL if this is a long burst without
-         // transitions
-         if (remaining_delta == 0) {
-            avg_bit_sep_time = nominal_bit_sep_time + filter(clock_time, &filter_state);
-         }
+      for (; i < num_steps; i++) {
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 #if DEBUG
          //printf("track %d clock %f\n", track_time, clock_time);
          //if (cyl == 70 & head == 5 && track_time > next_header_time)
          if (cyl == 0 && head == 0)
          printf
          ("  delta %d %.2f int %d avg_bit %.2f time %d dec %08x raw %08x byte %d\n",
-               deltas[i], clock_time,
-               int_bit_pos, avg_bit_sep_time, track_time, decoded_word,
+               pll_track->steps[i].delta, pll_track->pll.clock_time,
+               int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time, decoded_word,
                raw_word, byte_cntr);
 #endif
          if (all_raw_bits_count + int_bit_pos >= 32) {
@@ -638,7 +579,7 @@ printf("Found header at %d %d %d\n",tot_raw_bit_cntr, track_time,
                   }
                } else if (drive_params->controller == CONTROLLER_IMS_A820) {
                   // No more headers
-                  next_header_time = track_time + 178300.0 * total_track_time / 3333333;
+                  next_header_time = track_time + 178300.0 * decode_ctx->total_track_time / 3333333;
                   raw_bit_cntr = 0;
                }
 //printf("Next header at %d track time %d\n",next_header_time, track_time);
@@ -651,9 +592,9 @@ printf("Found header at %d %d %d\n",tot_raw_bit_cntr, track_time,
                } else {
                   state = PROCESS_DATA;
                }
-               mfm_mark_header_location(all_raw_bits_count, raw_bit_cntr, 
+               mfm_mark_header_location(drive_params, all_raw_bits_count, raw_bit_cntr, 
                   tot_raw_bit_cntr);
-               mfm_mark_data_location(all_raw_bits_count, raw_bit_cntr,
+               mfm_mark_data_location(drive_params, all_raw_bits_count, raw_bit_cntr,
                   tot_raw_bit_cntr);
                bytes_needed = bytes_crc_len;
                // Must read enough extra bytes to ensure we send last 32
@@ -707,14 +648,6 @@ fprintf(out,"#%lld\n0&\n", bit_time);
             }
          }
       }
-      // Finished what we had, any more?
-      // If we didn't get too many last time sleep so delta reader can run.
-      // Thread priorities might be better.
-      if (num_deltas - last_deltas <= 2000) {
-         usleep(500);
-      }
-      last_deltas = num_deltas;
-      num_deltas = deltas_get_count(i);
    }
    // If in PROCESS_DATA sector_index has been incremented for possible next sector
    if ((state == PROCESS_HEADER && sector_index < drive_params->num_sectors) ||
@@ -738,7 +671,10 @@ fprintf(out,"#%lld\n0&\n", bit_time);
 fclose(out);
 #endif
 
-   // Update rotation time estimate
-   total_track_time = track_time;
+   // Update rotation time estimate. Only used by CONTROLLER_IMS_A820 which
+   // decodes tracks in order
+   if (drive_params->controller == CONTROLLER_IMS_A820) {
+      decode_ctx->total_track_time = track_time;
+   }
    return sector_status;
 }
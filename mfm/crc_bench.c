@@ -0,0 +1,224 @@
+// This is a program to check and time the table driven crc64 against the
+// bit at a time crc64_bitwise. Every polynomial in mfm_all_poly is checked
+// with header, sector, and track sized buffers. The syndrome table ecc64 is
+// checked against ecc64_bitwise with random burst errors including ones
+// longer than can be corrected.
+//
+// crc_bench [iterations]
+//
+// 10/17/26 DJG Build ECC table before timing ECC
+// 10/17/26 DJG Added ECC check
+// 10/17/26 DJG Initial version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "msg.h"
+#include "crc_ecc.h"
+#include "emu_tran_file.h"
+#define DEF_DATA
+#include "mfm_decoder.h"
+
+// Return time in seconds
+static double get_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Time the specified CRC routine.
+//
+// crc_func: CRC routine to time
+// bytes: bytes to calculate CRC over
+// num_bytes: length of bytes
+// crc_info: CRC parameters to use
+// iter: Number of times to calculate CRC
+// sum: XOR of all the CRC values so the calculation isn't optimized away
+// return: Time in seconds
+static double time_crc(uint64_t (*crc_func)(uint8_t *, int, CRC_INFO *),
+   uint8_t *bytes, int num_bytes, CRC_INFO *crc_info, int iter, uint64_t *sum)
+{
+   double start;
+   int i;
+
+   start = get_time();
+   for (i = 0; i < iter; i++) {
+      // Vary the data so each call isn't identical
+      bytes[0] = i;
+      *sum ^= crc_func(bytes, num_bytes, crc_info);
+   }
+   return get_time() - start;
+}
+
+// Check and time ecc64 against ecc64_bitwise for a sector with random
+// burst errors.
+//
+// bytes: Random sector data. Size num_bytes + 8
+// num_bytes: length of bytes to check
+// crc_info: CRC/ECC parameters to use
+// iter: Number of errors to try
+// return: Number of mismatches
+static int check_ecc(uint8_t *bytes, int num_bytes, CRC_INFO *crc_info,
+   int iter)
+{
+   uint8_t *err1, *err2;
+   uint64_t crc, syndrome;
+   int crc_bytes = (crc_info->length + 7) / 8;
+   int len = num_bytes + crc_bytes;
+   int i, b, bit, burst;
+   int span1, span2;
+   int errors = 0;
+   int corrected = 0;
+   double t1 = 0, t2 = 0, start;
+
+   err1 = msg_malloc(len, "CRC bench err1");
+   err2 = msg_malloc(len, "CRC bench err2");
+   // Append CRC so data has no error
+   crc = crc64(bytes, num_bytes, crc_info);
+   for (b = 0; b < crc_bytes; b++) {
+      bytes[num_bytes + b] = crc >> ((crc_bytes - b - 1) * 8);
+   }
+   // Correct an error once so any table ecc64 uses is built before timing
+   memcpy(err2, bytes, len);
+   err2[0] ^= 0x80;
+   ecc64(err2, len, crc64(err2, len, crc_info), crc_info);
+   for (i = 0; i < iter; i++) {
+      memcpy(err1, bytes, len);
+      // Burst up to 4 bits longer than correctable
+      burst = rand() % (crc_info->ecc_max_span + 4) + 1;
+      bit = rand() % (len * 8 - burst + 1);
+      for (b = 0; b < burst; b++) {
+         // Burst always starts and ends with an error bit
+         if (b == 0 || b == burst - 1 || (rand() & 1)) {
+            err1[(bit + b) / 8] ^= 0x80 >> ((bit + b) % 8);
+         }
+      }
+      memcpy(err2, err1, len);
+      syndrome = crc64(err1, len, crc_info);
+      if (syndrome == 0) {
+         continue;
+      }
+      start = get_time();
+      span1 = ecc64_bitwise(err1, len, syndrome, crc_info);
+      t1 += get_time() - start;
+      start = get_time();
+      span2 = ecc64(err2, len, syndrome, crc_info);
+      t2 += get_time() - start;
+      if (span1 != span2 || memcmp(err1, err2, len) != 0) {
+         printf("ECC mismatch poly %llx span %d burst %d bit %d\n",
+            (unsigned long long) crc_info->poly, crc_info->ecc_max_span,
+            burst, bit);
+         errors++;
+      }
+      corrected += span1 != 0;
+   }
+   printf("%-18llx %3d %6d %12.1f %12.1f %8.1f %d/%d corrected\n",
+      (unsigned long long) crc_info->poly, crc_info->ecc_max_span, len,
+      iter / t1 / 1e3, iter / t2 / 1e3, t1 / t2, corrected, iter);
+   free(err1);
+   free(err2);
+   return errors;
+}
+
+int main(int argc, char *argv[])
+{
+   // Header, sector, and track lengths
+   static int lengths[] = {6, 515, 10416};
+   uint8_t *bytes;
+   CRC_INFO crc_info;
+   int iter = 200000;
+   int p, l, i, len;
+   int errors = 0;
+   uint64_t sum1, sum2;
+   double t1, t2;
+
+   if (argc > 1) {
+      iter = atoi(argv[1]);
+   }
+   bytes = msg_malloc(lengths[ARRAYSIZE(lengths)-1], "CRC bench bytes");
+   srand(1);
+   for (i = 0; i < lengths[ARRAYSIZE(lengths)-1]; i++) {
+      bytes[i] = rand();
+   }
+
+   printf("%-18s %3s %6s %12s %12s %8s\n", "Polynomial", "Len", "Bytes",
+      "Bitwise MB/s", "Table MB/s", "Speedup");
+   for (p = 0; p < ARRAYSIZE(mfm_all_poly); p++) {
+      // Length 0 and 8 entries are checksums, not CRCs
+      if (mfm_all_poly[p].poly == 0) {
+         continue;
+      }
+      crc_info.poly = mfm_all_poly[p].poly;
+      crc_info.length = mfm_all_poly[p].length;
+      crc_info.ecc_max_span = 0;
+      for (l = 0; l < ARRAYSIZE(lengths); l++) {
+         len = lengths[l];
+         // Check all lengths up to the test length and a couple initial values
+         for (i = 0; i <= len; i += (i < 64 ? 1 : 61)) {
+            crc_info.init_value = (i & 1) ? 0 : ~(uint64_t) 0 >>
+               (64 - crc_info.length);
+            if (crc64(bytes, i, &crc_info) !=
+                  crc64_bitwise(bytes, i, &crc_info)) {
+               printf("Mismatch poly %llx length %d bytes %d\n",
+                  (unsigned long long) crc_info.poly, crc_info.length, i);
+               errors++;
+            }
+         }
+         crc_info.init_value = 0;
+         // Scale iterations so each test processes the same number of bytes
+         sum1 = sum2 = 0;
+         t1 = time_crc(crc64_bitwise, bytes, len, &crc_info,
+            (double) iter * 6 / len + 1, &sum1);
+         t2 = time_crc(crc64, bytes, len, &crc_info,
+            (double) iter * 6 / len + 1, &sum2);
+         if (sum1 != sum2) {
+            printf("Mismatch poly %llx length %d bytes %d\n",
+               (unsigned long long) crc_info.poly, crc_info.length, len);
+            errors++;
+         }
+         printf("%-18llx %3d %6d %12.1f %12.1f %8.1f\n",
+            (unsigned long long) crc_info.poly, crc_info.length, len,
+            iter * 6 / t1 / 1e6, iter * 6 / t2 / 1e6, t1 / t2);
+      }
+   }
+
+   printf("\n%-18s %3s %6s %12s %12s %8s\n", "Polynomial", "Spn", "Bytes",
+      "Bitwise K/s", "Table K/s", "Speedup");
+   for (p = 0; p < ARRAYSIZE(mfm_all_poly); p++) {
+      if (mfm_all_poly[p].poly == 0 || mfm_all_poly[p].ecc_span == 0) {
+         continue;
+      }
+      crc_info.poly = mfm_all_poly[p].poly;
+      crc_info.length = mfm_all_poly[p].length;
+      crc_info.ecc_max_span = mfm_all_poly[p].ecc_span;
+      crc_info.init_value = 0;
+      errors += check_ecc(bytes, 512, &crc_info, iter / 100 + 1);
+   }
+
+   if (errors) {
+      printf("%d errors\n", errors);
+   } else {
+      printf("All CRC values match\n");
+   }
+   return errors != 0;
+}
@@ -2,10 +2,19 @@
 // and Error Correction Code (ECC) calculations
 // crc_revbits is used to reverse bit order in a word
 // crc64 calculates CRC up to 64 bits long crc of data
+// crc64_bitwise is the original bit at a time crc64, used for short CRC
+//    lengths and for checking the table driven version
 // ecc64 corrects single burst errors
+// ecc64_bitwise is the original bit at a time ecc64
 // checksum64 calculates checksums up to 64 bits long
 // eparity64 currently only calculates single bit even parity of bytes
 //
+// 10/17/26 DJG CRC tables shared by all threads instead of per thread.
+//    Check for carry-less multiply once
+// 10/17/26 DJG Limit ECC table memory and free least recently used tables
+// 10/17/26 DJG Made ecc64 use syndrome lookup tables
+// 10/17/26 DJG Made crc64 table driven (slicing by 8) with carry-less
+//    multiply folding for long buffers when the CPU supports it
 // 12/19/21 DJG Removed length check for partity64 and actually named it epartity64
 // 12/31/15 DJG Added eparity64 function
 // 01/04/15 DJG Added checksum64 function
@@ -30,9 +39,20 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "crc_ecc.h"
 #include "msg.h"
 
+#if defined(__x86_64__)
+#include <wmmintrin.h>
+#define CRC_CLMUL 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+#define CRC_CLMUL 1
+#else
+#define CRC_CLMUL 0
+#endif
+
 // Find last set (leftmost 1). Not defined in Linux so we use a GCC specific call
 // count leftmost zeros.
 #define fls(x) (32 - __builtin_clz(x))
@@ -77,7 +97,9 @@ uint64_t crc_revbits(uint64_t v, int length)
 // num_bytes: length of bytes
 // crc_info: CRC parameters to use
 // return: CRC of bytes
-uint64_t crc64(uint8_t bytes[], int num_bytes, CRC_INFO *crc_info)
+//
+// This is the bit at a time version. crc64 gives the same result faster.
+uint64_t crc64_bitwise(uint8_t bytes[], int num_bytes, CRC_INFO *crc_info)
 {
    int64_t crc;
    // This improves performance vs. accessing directly in loop for the
@@ -105,6 +127,263 @@ uint64_t crc64(uint8_t bytes[], int num_bytes, CRC_INFO *crc_info)
       return crc & (((uint64_t) 1 << crc_info->length)-1);
 }
 
+// Tables for calculating the CRC a byte or 8 bytes at a time. The CRC
+// is kept left justified in a 64 bit word so all CRC lengths from 8 to
+// 64 bits use the same code. This is the same as a 64 bit CRC with
+// polynomial poly << (64 - length) so the result only needs to be shifted
+// down at the end.
+#define CRC_TABLE_MAX 16
+typedef struct {
+   // Polynomial and length the table was built for
+   uint64_t poly;
+   uint32_t length;
+   // Polynomial left justified in 64 bits
+   uint64_t poly64;
+   // x^128 and x^192 mod the left justified polynomial for folding with
+   // carry-less multiply
+   uint64_t fold128, fold192;
+   // table[n][i] is the CRC of byte i followed by n zero bytes
+   uint64_t table[8][256];
+} CRC_TABLE;
+
+// Tables are shared by all threads. Once built they aren't modified or
+// freed so the table last used by each thread can be checked without a
+// lock. The number of polynomials used is small so a few entries is
+// sufficient. crc_tables and crc_num_tables are protected by
+// crc_table_mutex.
+static CRC_TABLE *crc_tables[CRC_TABLE_MAX];
+static int crc_num_tables;
+static pthread_mutex_t crc_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread CRC_TABLE *crc_table_last;
+
+// Multiply x^64 mod poly64 by x the specified number of times.
+//
+// poly64: Left justified polynomial
+// shifts: Number of times to multiply by x
+// return: x^(64+shifts) mod poly64
+static uint64_t crc_xpow_mod(uint64_t poly64, int shifts)
+{
+   uint64_t v = poly64;
+   int i;
+
+   for (i = 0; i < shifts; i++) {
+      if (v & ((uint64_t) 1 << 63)) {
+         v = (v << 1) ^ poly64;
+      } else {
+         v = v << 1;
+      }
+   }
+   return v;
+}
+
+// Find or build the lookup tables for the CRC polynomial and length.
+//
+// crc_info: CRC parameters to use. The initial value isn't used
+// return: Table for the polynomial or NULL if too many polynomials used
+static CRC_TABLE *crc_get_table(CRC_INFO *crc_info)
+{
+   CRC_TABLE *tbl = crc_table_last;
+   int i, n, bit;
+   uint64_t crc;
+
+   if (tbl != NULL && tbl->poly == crc_info->poly &&
+         tbl->length == crc_info->length) {
+      return tbl;
+   }
+   pthread_mutex_lock(&crc_table_mutex);
+   for (i = 0; i < crc_num_tables; i++) {
+      tbl = crc_tables[i];
+      if (tbl->poly == crc_info->poly && tbl->length == crc_info->length) {
+         pthread_mutex_unlock(&crc_table_mutex);
+         crc_table_last = tbl;
+         return tbl;
+      }
+   }
+   if (crc_num_tables >= CRC_TABLE_MAX) {
+      pthread_mutex_unlock(&crc_table_mutex);
+      return NULL;
+   }
+   tbl = msg_malloc(sizeof(*tbl), "CRC table");
+
+   tbl->poly = crc_info->poly;
+   tbl->length = crc_info->length;
+   tbl->poly64 = crc_info->poly << (64 - crc_info->length);
+   for (i = 0; i < 256; i++) {
+      crc = (uint64_t) i << 56;
+      for (bit = 0; bit < 8; bit++) {
+         if (crc & ((uint64_t) 1 << 63)) {
+            crc = (crc << 1) ^ tbl->poly64;
+         } else {
+            crc = crc << 1;
+         }
+      }
+      tbl->table[0][i] = crc;
+   }
+   for (n = 1; n < 8; n++) {
+      for (i = 0; i < 256; i++) {
+         crc = tbl->table[n-1][i];
+         tbl->table[n][i] = (crc << 8) ^ tbl->table[0][crc >> 56];
+      }
+   }
+   tbl->fold128 = crc_xpow_mod(tbl->poly64, 64);
+   tbl->fold192 = crc_xpow_mod(tbl->poly64, 128);
+   crc_tables[crc_num_tables++] = tbl;
+   pthread_mutex_unlock(&crc_table_mutex);
+   crc_table_last = tbl;
+   return tbl;
+}
+
+// Get 8 bytes as a big endian value
+static inline uint64_t crc_load_be64(uint8_t *bytes)
+{
+   uint64_t v;
+
+   memcpy(&v, bytes, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   v = __builtin_bswap64(v);
+#endif
+   return v;
+}
+
+// Return left justified crc times x^64 mod the polynomial. This is the
+// same as running 8 zero bytes through the CRC.
+static inline uint64_t crc_table_shift64(CRC_TABLE *tbl, uint64_t crc)
+{
+   return tbl->table[7][crc >> 56] ^ tbl->table[6][(crc >> 48) & 0xff] ^
+      tbl->table[5][(crc >> 40) & 0xff] ^ tbl->table[4][(crc >> 32) & 0xff] ^
+      tbl->table[3][(crc >> 24) & 0xff] ^ tbl->table[2][(crc >> 16) & 0xff] ^
+      tbl->table[1][(crc >> 8) & 0xff] ^ tbl->table[0][crc & 0xff];
+}
+
+#if CRC_CLMUL
+#if defined(__x86_64__)
+#define CRC_CLMUL_TARGET __attribute__((target("pclmul")))
+// Carry-less multiply a and b giving 128 bit result in hi and lo
+static inline CRC_CLMUL_TARGET void crc_clmul(uint64_t a, uint64_t b,
+   uint64_t *hi, uint64_t *lo)
+{
+   __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, a),
+      _mm_set_epi64x(0, b), 0x00);
+   *lo = _mm_cvtsi128_si64(r);
+   *hi = _mm_cvtsi128_si64(_mm_unpackhi_epi64(r, r));
+}
+
+// Return non zero if the CPU has the carry-less multiply instruction
+static int crc_clmul_supported(void)
+{
+   return __builtin_cpu_supports("pclmul");
+}
+#else
+#define CRC_CLMUL_TARGET
+static inline void crc_clmul(uint64_t a, uint64_t b,
+   uint64_t *hi, uint64_t *lo)
+{
+   poly128_t r = vmull_p64(a, b);
+
+   *lo = vgetq_lane_u64(vreinterpretq_u64_p128(r), 0);
+   *hi = vgetq_lane_u64(vreinterpretq_u64_p128(r), 1);
+}
+
+// Only compiled when the compiler was told the CPU has PMULL
+static int crc_clmul_supported(void)
+{
+   return 1;
+}
+#endif
+
+// Non zero if the CPU has the carry-less multiply instruction. Set once
+// by crc_clmul_init using crc_clmul_once.
+static int crc_clmul_ok;
+static pthread_once_t crc_clmul_once = PTHREAD_ONCE_INIT;
+
+static void crc_clmul_init(void)
+{
+   crc_clmul_ok = crc_clmul_supported();
+}
+
+// Calculate the CRC of a multiple of 16 bytes by folding 128 bits at a time
+// with carry-less multiplies. Data is treated as a polynomial with the
+// first bit the highest power. Appending 128 bits to value x gives
+// x * x^128 + data. The two 64 bit halves of x are multiplied by x^192 and
+// x^128 mod the polynomial which keeps the value 128 bits while not
+// changing the remainder.
+//
+// tbl: CRC table for the polynomial
+// crc: Left justified CRC before the bytes
+// bytes: bytes to calculate CRC over
+// num_bytes: Length of bytes. Must be multiple of 16 and at least 16
+// return: Left justified CRC after the bytes
+static CRC_CLMUL_TARGET uint64_t crc_fold(CRC_TABLE *tbl, uint64_t crc,
+   uint8_t *bytes, int num_bytes)
+{
+   uint64_t xhi, xlo, h1, l1, h2, l2;
+   int index;
+
+   xhi = crc_load_be64(&bytes[0]) ^ crc;
+   xlo = crc_load_be64(&bytes[8]);
+   for (index = 16; index < num_bytes; index += 16) {
+      crc_clmul(xhi, tbl->fold192, &h1, &l1);
+      crc_clmul(xlo, tbl->fold128, &h2, &l2);
+      xhi = h1 ^ h2 ^ crc_load_be64(&bytes[index]);
+      xlo = l1 ^ l2 ^ crc_load_be64(&bytes[index + 8]);
+   }
+   // The CRC is x * x^64 mod the polynomial. Reduce the upper half
+   // then use the table to reduce the remaining 64 bits.
+   crc_clmul(xhi, tbl->fold128, &h1, &l1);
+   return crc_table_shift64(tbl, h1 ^ xlo) ^ l1;
+}
+#endif
+
+// Calculate a CRC up to 64 bits long over the specified data.
+// CRC_INFO specifies the CRC length, polynomial, and initial value.
+// The CRC is calculated most significant bit first and gives the same
+// result as crc64_bitwise. Lookup tables are built the first time
+// a polynomial is used.
+//
+// bytes: bytes to calculate CRC over
+// num_bytes: length of bytes
+// crc_info: CRC parameters to use
+// return: CRC of bytes
+uint64_t crc64(uint8_t bytes[], int num_bytes, CRC_INFO *crc_info)
+{
+   CRC_TABLE *tbl;
+   uint64_t crc;
+   int index = 0;
+   int shift;
+
+   // Table is byte at a time so CRC shorter than a byte needs bitwise
+   if (crc_info->length < 8 || crc_info->length > 64) {
+      return crc64_bitwise(bytes, num_bytes, crc_info);
+   }
+   tbl = crc_get_table(crc_info);
+   if (tbl == NULL) {
+      return crc64_bitwise(bytes, num_bytes, crc_info);
+   }
+   shift = 64 - crc_info->length;
+   crc = crc_info->init_value << shift;
+
+#if CRC_CLMUL
+   // Short buffers such as headers are faster with the table
+   if (num_bytes >= 64) {
+      pthread_once(&crc_clmul_once, crc_clmul_init);
+      if (crc_clmul_ok) {
+         index = num_bytes & ~15;
+         crc = crc_fold(tbl, crc, bytes, index);
+      }
+   }
+#endif
+   for (; index + 8 <= num_bytes; index += 8) {
+      crc = crc_table_shift64(tbl, crc ^ crc_load_be64(&bytes[index]));
+   }
+   for (; index < num_bytes; index++) {
+      crc = (crc << 8) ^ tbl->table[0][(crc >> 56) ^ bytes[index]];
+   }
+   if (shift == 0)
+      return crc;
+   else
+      return crc >> shift;
+}
+
 // Correct the specified data given the syndrome (incorrect CRC value) and
 // the CRC parameters. Return is non zero if a correction has been applied.
 // It is possible the correction is wrong if sufficient bits are in error.
@@ -117,7 +396,9 @@ uint64_t crc64(uint8_t bytes[], int num_bytes, CRC_INFO *crc_info)
 // crc_info: CRC/ECC parameters to use
 // return: Length of correction in bits. Zero if no correction possible
 //   also bytes modified if return value is non zero.
-int ecc64(uint8_t bytes[], int num_bytes, uint64_t syndrome, CRC_INFO *crc_info)
+//
+// This is the bit at a time version. ecc64 gives the same result faster.
+int ecc64_bitwise(uint8_t bytes[], int num_bytes, uint64_t syndrome, CRC_INFO *crc_info)
 {
    // Number of bits corrected
    int span;
@@ -164,6 +445,266 @@ int ecc64(uint8_t bytes[], int num_bytes, uint64_t syndrome, CRC_INFO *crc_info)
    return span;
 }
 
+// ECC correction is done by looking up the syndrome in a table of the
+// syndromes every correctable burst at every bit position would give.
+// The table depends on the polynomial, correction span, and number of bytes
+// so is built the first time a combination is used. Tables larger than
+// ECC_TABLE_MAX_ENTRIES use ecc64_bitwise. When the tables would use more
+// than ECC_TABLE_MAX_BYTES the least recently used table not in use is
+// freed. If every table is in use ecc64_bitwise is used.
+#define ECC_TABLE_SLOTS 16
+#define ECC_TABLE_MAX_ENTRIES (1 << 19)
+#define ECC_TABLE_MAX_BYTES (32 * 1024 * 1024)
+typedef struct {
+   // Bit reversed syndrome. Zero is an empty entry
+   uint64_t syndrome;
+   // Number of bits ecc64_bitwise steps the syndrome to find the correction
+   uint32_t bit;
+   // Bit reversed error pattern
+   uint32_t pattern;
+} ECC_ENTRY;
+
+typedef struct {
+   // Polynomial, length, span, and number of bytes the table was built for
+   uint64_t poly;
+   uint32_t length;
+   uint32_t ecc_max_span;
+   int num_bytes;
+   // Bit reversed polynomial used for stepping syndromes
+   uint64_t poly_rev;
+   // Hash table of syndromes. Size is 1 << hash_bits. NULL if slot unused
+   int hash_bits;
+   ECC_ENTRY *entries;
+   // Bytes allocated for entries
+   size_t size;
+   // Number of ecc64 calls using the table. It can't be freed if non zero
+   int users;
+   // Value of ecc_table_counter when last used, for finding least
+   // recently used table
+   uint64_t last_use;
+} ECC_TABLE;
+
+// Tables are shared by all threads. Once built they aren't modified.
+// The slots, users, last_use, and the counters are protected by
+// ecc_table_mutex.
+static ECC_TABLE ecc_tables[ECC_TABLE_SLOTS];
+static size_t ecc_table_bytes;
+static uint64_t ecc_table_counter;
+static pthread_mutex_t ecc_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Return the hash table slot to start searching at for the syndrome
+static inline uint32_t ecc_hash(uint64_t syndrome, int hash_bits)
+{
+   return (syndrome * 0x9e3779b97f4a7c15ull) >> (64 - hash_bits);
+}
+
+// Build the syndrome table. Stepping the bit reversed syndrome forward
+// one bit is what ecc64_bitwise does to search for the error so
+// the syndromes are generated by stepping each possible error pattern
+// backward. If more than one error gives the same syndrome the one
+// ecc64_bitwise would find first is kept.
+//
+// tbl: Table to fill in. Poly, length, ecc_max_span, num_bytes, hash_bits,
+//    and size set
+static void ecc_build_table(ECC_TABLE *tbl)
+{
+   uint32_t pattern;
+   uint32_t bit;
+   uint32_t ndx;
+   uint64_t v;
+   uint32_t mask;
+
+   tbl->poly_rev = (crc_revbits(tbl->poly, tbl->length) << 1) | 1;
+   tbl->entries = msg_malloc(tbl->size, "ECC table");
+   memset(tbl->entries, 0, tbl->size);
+   mask = (1 << tbl->hash_bits) - 1;
+
+   for (pattern = 1; pattern < (1 << tbl->ecc_max_span); pattern++) {
+      v = pattern;
+      for (bit = 1; bit <= tbl->num_bytes * 8; bit++) {
+         // Undo one step of ecc64_bitwise
+         if (v & 1) {
+            v = (v ^ tbl->poly_rev) >> 1;
+         } else {
+            v = v >> 1;
+         }
+         ndx = ecc_hash(v, tbl->hash_bits);
+         while (tbl->entries[ndx].syndrome != 0 &&
+               tbl->entries[ndx].syndrome != v) {
+            ndx = (ndx + 1) & mask;
+         }
+         if (tbl->entries[ndx].syndrome == 0 ||
+               tbl->entries[ndx].bit > bit) {
+            tbl->entries[ndx].syndrome = v;
+            tbl->entries[ndx].bit = bit;
+            tbl->entries[ndx].pattern = pattern;
+         }
+      }
+   }
+}
+
+// Find or build the syndrome table for the CRC parameters. The table
+// must be released with ecc_release_table when done with it.
+//
+// num_bytes: length of bytes
+// crc_info: CRC/ECC parameters to use
+// return: Table or NULL if a table can't be used
+static ECC_TABLE *ecc_get_table(int num_bytes, CRC_INFO *crc_info)
+{
+   ECC_TABLE *tbl = NULL;
+   ECC_TABLE *lru;
+   int num_entries;
+   int hash_bits;
+   size_t size;
+   int i;
+
+   // The table search requires the syndrome to stay within the CRC length
+   // when stepped which needs the low bit of the polynomial set.
+   if (crc_info->length >= 64 || (crc_info->poly & 1) == 0 ||
+         crc_info->ecc_max_span >= 32 ||
+         crc_info->ecc_max_span >= crc_info->length) {
+      return NULL;
+   }
+   if ((uint64_t) num_bytes * 8 * ((1 << crc_info->ecc_max_span) - 1) >
+         ECC_TABLE_MAX_ENTRIES) {
+      return NULL;
+   }
+   num_entries = num_bytes * 8 * ((1 << crc_info->ecc_max_span) - 1);
+   hash_bits = fls(num_entries) + 1;
+   size = sizeof(ECC_ENTRY) << hash_bits;
+
+   pthread_mutex_lock(&ecc_table_mutex);
+   for (i = 0; i < ECC_TABLE_SLOTS; i++) {
+      if (ecc_tables[i].entries != NULL &&
+            ecc_tables[i].poly == crc_info->poly &&
+            ecc_tables[i].length == crc_info->length &&
+            ecc_tables[i].ecc_max_span == crc_info->ecc_max_span &&
+            ecc_tables[i].num_bytes == num_bytes) {
+         tbl = &ecc_tables[i];
+         break;
+      }
+   }
+   if (tbl == NULL) {
+      // Free least recently used tables not in use until we have a free
+      // slot and the new table fits in the memory limit
+      while (1) {
+         lru = NULL;
+         for (i = 0; i < ECC_TABLE_SLOTS; i++) {
+            if (ecc_tables[i].entries == NULL) {
+               tbl = &ecc_tables[i];
+            } else if (ecc_tables[i].users == 0 && (lru == NULL ||
+                  ecc_tables[i].last_use < lru->last_use)) {
+               lru = &ecc_tables[i];
+            }
+         }
+         if ((tbl != NULL && ecc_table_bytes + size <= ECC_TABLE_MAX_BYTES) ||
+               lru == NULL) {
+            break;
+         }
+         free(lru->entries);
+         lru->entries = NULL;
+         ecc_table_bytes -= lru->size;
+      }
+      if (tbl != NULL && ecc_table_bytes + size <= ECC_TABLE_MAX_BYTES) {
+         tbl->poly = crc_info->poly;
+         tbl->length = crc_info->length;
+         tbl->ecc_max_span = crc_info->ecc_max_span;
+         tbl->num_bytes = num_bytes;
+         tbl->hash_bits = hash_bits;
+         tbl->size = size;
+         ecc_build_table(tbl);
+         ecc_table_bytes += size;
+      } else {
+         tbl = NULL;
+      }
+   }
+   if (tbl != NULL) {
+      tbl->users++;
+      tbl->last_use = ++ecc_table_counter;
+   }
+   pthread_mutex_unlock(&ecc_table_mutex);
+   return tbl;
+}
+
+// Release table returned by ecc_get_table so it can be freed.
+//
+// tbl: Table to release
+static void ecc_release_table(ECC_TABLE *tbl)
+{
+   pthread_mutex_lock(&ecc_table_mutex);
+   tbl->users--;
+   pthread_mutex_unlock(&ecc_table_mutex);
+}
+
+// Correct the specified data given the syndrome (incorrect CRC value) and
+// the CRC parameters. Return is non zero if a correction has been applied.
+// The result is the same as ecc64_bitwise.
+//
+// bytes: bytes to calculate CRC over
+// num_bytes: length of bytes
+// syndrome: Value return by crc64
+// crc_info: CRC/ECC parameters to use
+// return: Length of correction in bits. Zero if no correction possible
+//   also bytes modified if return value is non zero.
+int ecc64(uint8_t bytes[], int num_bytes, uint64_t syndrome, CRC_INFO *crc_info)
+{
+   ECC_TABLE *tbl;
+   ECC_ENTRY *entry;
+   uint32_t ndx;
+   int span;
+   int index;
+   int bits_left;
+   int bit;
+
+   if (num_bytes <= 0 || crc_info->ecc_max_span == 0) {
+      return ecc64_bitwise(bytes, num_bytes, syndrome, crc_info);
+   }
+   tbl = ecc_get_table(num_bytes, crc_info);
+   if (tbl == NULL) {
+      return ecc64_bitwise(bytes, num_bytes, syndrome, crc_info);
+   }
+   syndrome = crc_revbits(syndrome, crc_info->length);
+   if (syndrome == 0) {
+      ecc_release_table(tbl);
+      return 0;
+   }
+   ndx = ecc_hash(syndrome, tbl->hash_bits);
+   while (tbl->entries[ndx].syndrome != 0 &&
+         tbl->entries[ndx].syndrome != syndrome) {
+      ndx = (ndx + 1) & ((1 << tbl->hash_bits) - 1);
+   }
+   entry = &tbl->entries[ndx];
+   if (entry->syndrome == 0) {
+      ecc_release_table(tbl);
+      return 0;
+   }
+   span = fls(entry->pattern) - ffs(entry->pattern) + 1;
+
+   // ecc64_bitwise finishes stepping the byte the error was found in so
+   // the correction is byte aligned
+   syndrome = entry->pattern;
+   for (bit = entry->bit; bit % 8 != 0; bit++) {
+      if (syndrome & ((uint64_t) 1 << (crc_info->length-1))) {
+         syndrome = (syndrome << 1) ^ tbl->poly_rev;
+      } else {
+         syndrome = syndrome << 1;
+      }
+   }
+   ecc_release_table(tbl);
+   index = num_bytes - bit / 8;
+
+   // Round up span to handle worst case split across bytes
+   bits_left = crc_info->ecc_max_span + 7;
+   // Apply the correction to all possibly affected bytes
+   while (bits_left > 0 && index < num_bytes) {
+      bytes[index] ^= crc_revbits((syndrome & 0xff),8);
+      index++;
+      syndrome >>= 8;
+      bits_left -= 8;
+   }
+   return span;
+}
+
 // This is a checksum for formats that don't use a CRC
 // bytes: bytes to calculate checksum over
 // num_bytes: length of bytes
@@ -11,6 +11,19 @@
 // A thread is used to read the data from the PRU and update the available delta
 // count
 //
+// When transitions are written to a file the delta thread copies each
+// track to a write buffer and a writer thread writes it to the file. This
+// lets the delta thread be ready for the next read while the file is
+// written. If the writer falls WRITE_BUFFERS tracks behind the delta thread
+// waits for it.
+//
+// With --pipeline_reads the PRU can be asked to read the next head when
+// the current read finishes. The delta thread copies that read to a second
+// buffer while the current read is decoded. It is given to the decoder by
+// deltas_use_next_read or dropped by deltas_cancel_next_read if the current
+// track needs a retry. Reads are only written to the transition file once
+// they are given to the decoder so dropped reads aren't written.
+//
 // Call deltas_setup once to setup the process.
 // Call deltas_start_thread to start the reader thread and optionally start
 //   writing delta data to filedeltas_get_count
@@ -18,7 +31,15 @@
 // Call deltas_get_count to get the number of deltas available
 // Call deltas_wait_read_finished to wait until all deltas are received
 // Call deltas_stop_thread when done with the delta thread
+// Call deltas_start_next_read to have the PRU read another head when the
+//   current read finishes
+// Call deltas_use_next_read to switch to the deltas of that read
+// Call deltas_cancel_next_read to drop that read
 //
+// 10/17/26 DJG Read next head when current read finishes for
+//    --pipeline_reads
+// 10/17/26 DJG Write transition file from separate thread
+// 10/17/26 DJG Added compressed transition file option
 // 06/27/2015 DJG Made CMD_STATUS_READ_OVERRUN a warning instead of fatal error
 // 05/16/2015 DJG Changes for deltas_read_file.c
 // 01/04/2015 DJG Changes for start_time_ns
@@ -60,13 +81,15 @@
 #include "drive.h"
 
 static void *delta_proc(void *arg);
+static void *write_proc(void *arg);
+static void write_deltas(uint16_t deltas[], int num_deltas, int cyl,
+      int head);
+
+// Number of tracks which can be waiting to be written to transition file
+#define WRITE_BUFFERS 2
 
 // Semaphore to control when the delta reader starts looking for more deltas
 static sem_t deltas_sem;
-// Pointer to delta memory
-static uint16_t *deltas;
-// The current cylinder and head processing. Used when writing transitions to file
-static int deltas_cyl, deltas_head;
 // The thread to process deltas
 pthread_t delta_thread;
 // State of thread
@@ -81,19 +104,94 @@ static int num_deltas;
 // Deltas are being received from read thread
 static int streaming;
 
+// A read of a track copied from the PRU
+typedef struct {
+   uint16_t *deltas;
+   // Number of deltas copied
+   int num_deltas;
+   // Non zero when all the deltas have been copied
+   int done;
+   // Non zero when the deltas have been given to the decoder
+   int used;
+   int cyl;
+   int head;
+} READ_BUFFER;
+
+// Reads being decoded and copied. Buffer 0 is returned by deltas_setup
+// and used for reads started by deltas_start_read. Mutex protects the
+// fields and the READ_BUFFERs.
+static struct {
+   pthread_mutex_t mutex;
+   // Signaled when a read is done
+   pthread_cond_t cond;
+   READ_BUFFER buffers[2];
+   // Buffer given to the decoder
+   int use;
+   // Buffer the delta thread is copying to
+   int fill;
+   // Track requested by deltas_start_next_read
+   int next_cyl;
+   int next_head;
+   // Non zero when the PRU has started reading the next head
+   int next_started;
+   // Non zero until the PRU has finished reading
+   int reading;
+   // Size of DDR memory in bytes
+   int ddr_size;
+} reads;
+
+// Non zero if reads are written to transition file
+static int write_transitions;
+
+// Track waiting to be written to transition file
+typedef struct {
+   uint16_t *deltas;
+   // Number of deltas and size of deltas buffer in words
+   int num_deltas;
+   int deltas_size;
+   int cyl;
+   int head;
+} WRITE_BUFFER;
+
+// Transition file writer thread state. Buffers first to first + count - 1
+// modulo WRITE_BUFFERS are waiting to be written. Mutex protects first,
+// count, and shutdown.
+static struct {
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   WRITE_BUFFER buffers[WRITE_BUFFERS];
+   int first;
+   int count;
+   int shutdown;
+   int fd;
+} writer;
+
 // Allocate the memory to hold the deltas and initialize the semaphore.
 // Call once before calling other routines.
 //
 // ddr_mem_size: Size of ddr shared memory in bytes
 void *deltas_setup(int ddr_mem_size) {
-   // Create storage for delta data read from PRU
-   deltas = msg_malloc(ddr_mem_size, "deltas_setup deltas");
+   int i;
+
+   // Create storage for delta data read from PRU. The second buffer is
+   // for reading the next head while the first is decoded
+   for (i = 0; i < ARRAYSIZE(reads.buffers); i++) {
+      reads.buffers[i].deltas = msg_malloc(ddr_mem_size, 
+         "deltas_setup deltas");
+   }
+   reads.ddr_size = ddr_mem_size;
 
    if (sem_init(&deltas_sem, 0, 0) == -1) {
       msg(MSG_FATAL, "Sem creation failed\n");
       exit(1);
    }
-   return deltas;
+   if (pthread_mutex_init(&reads.mutex, NULL) != 0 ||
+         pthread_cond_init(&reads.cond, NULL) != 0) {
+      msg(MSG_FATAL, "Delta read mutex creation failed\n");
+      exit(1);
+   }
+   return reads.buffers[0].deltas;
 }
 
 // Start the delta thread.
@@ -127,26 +225,249 @@ void deltas_stop_thread()
 //
 // cyl, head: Track being read
 void deltas_start_read(int cyl, int head) {
-   deltas_cyl = cyl;
-   deltas_head = head;
+   READ_BUFFER *buf = &reads.buffers[0];
+
+   pthread_mutex_lock(&reads.mutex);
+   buf->cyl = cyl;
+   buf->head = head;
+   buf->num_deltas = 0;
+   buf->done = 0;
+   buf->used = 1;
+   reads.use = 0;
+   reads.fill = 0;
+   reads.next_started = 0;
+   reads.reading = 1;
    // Init state before releasing thread
    deltas_update_count(0, 1);
+   pthread_mutex_unlock(&reads.mutex);
    sem_post(&deltas_sem);
 }
 
-// Write deltas to file. Don't call if transitions_file is -1.
+// Have the PRU read another head on the same cylinder when the current
+// read finishes. Call after the current read has started and at most once
+// for each read.
+//
+// cyl, head: Track to read
+void deltas_start_next_read(int cyl, int head)
+{
+   pthread_mutex_lock(&reads.mutex);
+   reads.next_cyl = cyl;
+   reads.next_head = head;
+   reads.next_started = 0;
+   pthread_mutex_unlock(&reads.mutex);
+   pru_write_word(MEM_PRU0_DATA, PRU0_NEXT_HEAD, 
+      head | (1 << NEXT_HEAD_VALID_BIT));
+}
+
+// Give the decoder the deltas of the read. If all have been copied the
+// read is written to the transition file. Called with reads.mutex locked.
+//
+// buf: Read given to decoder
+static void read_publish(READ_BUFFER *buf)
+{
+   if (buf->done) {
+      // This must be before deltas_update_count to prevent
+      // next read starting while we are still copying deltas
+      if (write_transitions) {
+         write_deltas(buf->deltas, buf->num_deltas, buf->cyl, buf->head);
+      }
+      // All are transferred, tell MFM decoder all deltas available
+      deltas_update_count(buf->num_deltas, 0);
+   } else {
+      deltas_update_count(buf->num_deltas, 1);
+   }
+}
+
+// Switch to the read requested by deltas_start_next_read. Call after the
+// current read has been decoded. The deltas may still be being copied.
+//
+// return: Deltas of the read or NULL if the PRU finished before the
+//    request was seen
+uint16_t *deltas_use_next_read(void)
+{
+   READ_BUFFER *buf;
+
+   pthread_mutex_lock(&reads.mutex);
+   // Once the current read is done we know if the next one started
+   while (!reads.buffers[reads.use].done) {
+      pthread_cond_wait(&reads.cond, &reads.mutex);
+   }
+   if (!reads.next_started) {
+      pthread_mutex_unlock(&reads.mutex);
+      return NULL;
+   }
+   reads.next_started = 0;
+   reads.use = reads.fill;
+   buf = &reads.buffers[reads.use];
+   buf->used = 1;
+   read_publish(buf);
+   pthread_mutex_unlock(&reads.mutex);
+   return buf->deltas;
+}
+
+// Drop the read requested by deltas_start_next_read. Waits for the PRU
+// to finish so the drive can be used.
+void deltas_cancel_next_read(void)
+{
+   pru_write_word(MEM_PRU0_DATA, PRU0_NEXT_HEAD, 0);
+   pthread_mutex_lock(&reads.mutex);
+   // If the PRU already started the read it is never used
+   while (reads.reading) {
+      pthread_cond_wait(&reads.cond, &reads.mutex);
+   }
+   reads.next_started = 0;
+   pthread_mutex_unlock(&reads.mutex);
+}
+
+// Start the transition file writer thread.
+//
+// fd: Transition file to write to
+static void write_start_thread(int fd)
+{
+   writer.fd = fd;
+   writer.first = 0;
+   writer.count = 0;
+   writer.shutdown = 0;
+   if (pthread_mutex_init(&writer.mutex, NULL) != 0 ||
+         pthread_cond_init(&writer.cond, NULL) != 0 ||
+         pthread_create(&writer.thread, NULL, &write_proc, NULL) != 0) {
+      msg(MSG_FATAL, "Unable to create transition file writer thread\n");
+      exit(1);
+   }
+}
+
+// Stop the writer thread after all the queued tracks are written.
+static void write_stop_thread(void)
+{
+   int i;
+
+   pthread_mutex_lock(&writer.mutex);
+   writer.shutdown = 1;
+   pthread_cond_broadcast(&writer.cond);
+   pthread_mutex_unlock(&writer.mutex);
+   pthread_join(writer.thread, NULL);
+   for (i = 0; i < WRITE_BUFFERS; i++) {
+      free(writer.buffers[i].deltas);
+      writer.buffers[i].deltas = NULL;
+      writer.buffers[i].deltas_size = 0;
+   }
+   pthread_cond_destroy(&writer.cond);
+   pthread_mutex_destroy(&writer.mutex);
+}
+
+// Queue deltas to be written to file by the writer thread. The deltas are
+// copied so the caller can reuse the buffer on return.
 //
 // deltas: delta data to write
 // num_deltas: number of deltas to write in words
-static void write_deltas(int fd, uint16_t deltas[], int num_deltas) {
+// cyl, head: Track deltas are from
+static void write_deltas(uint16_t deltas[], int num_deltas, int cyl,
+      int head) {
+   WRITE_BUFFER *buf;
 
-   tran_file_write_track_deltas(fd, deltas, num_deltas, deltas_cyl, deltas_head);
+   pthread_mutex_lock(&writer.mutex);
+   while (writer.count == WRITE_BUFFERS) {
+      pthread_cond_wait(&writer.cond, &writer.mutex);
+   }
+   buf = &writer.buffers[(writer.first + writer.count) % WRITE_BUFFERS];
+   pthread_mutex_unlock(&writer.mutex);
+
+   // The buffer isn't used by the writer thread until count is increased
+   if (num_deltas > buf->deltas_size) {
+      buf->deltas_size = num_deltas;
+      buf->deltas = realloc(buf->deltas, sizeof(*buf->deltas) * num_deltas);
+      if (buf->deltas == NULL) {
+         msg(MSG_FATAL, "Malloc failed transition write buffer\n");
+         exit(1);
+      }
+   }
+   memcpy(buf->deltas, deltas, sizeof(*deltas) * num_deltas);
+   buf->num_deltas = num_deltas;
+   buf->cyl = cyl;
+   buf->head = head;
+
+   pthread_mutex_lock(&writer.mutex);
+   writer.count++;
+   pthread_cond_broadcast(&writer.cond);
+   pthread_mutex_unlock(&writer.mutex);
+}
+
+// This is the thread for writing tracks to the transition file. It writes
+// queued tracks in order until shutdown is requested and no tracks are
+// waiting.
+//
+// arg: Not used
+static void *write_proc(void *arg)
+{
+   WRITE_BUFFER *buf;
+
+   while (1) {
+      pthread_mutex_lock(&writer.mutex);
+      while (writer.count == 0 && !writer.shutdown) {
+         pthread_cond_wait(&writer.cond, &writer.mutex);
+      }
+      if (writer.count == 0) {
+         pthread_mutex_unlock(&writer.mutex);
+         break;
+      }
+      buf = &writer.buffers[writer.first];
+      pthread_mutex_unlock(&writer.mutex);
+
+      tran_file_write_track_deltas(writer.fd, buf->deltas, buf->num_deltas,
+         buf->cyl, buf->head);
+
+      pthread_mutex_lock(&writer.mutex);
+      writer.first = (writer.first + 1) % WRITE_BUFFERS;
+      writer.count--;
+      pthread_cond_broadcast(&writer.cond);
+      pthread_mutex_unlock(&writer.mutex);
+   }
+   return NULL;
+}
+
+// Print message if a read had an error. Fatal errors exit.
+//
+// status: Command status for the read
+// buf: The read
+static void check_read_status(uint32_t status, READ_BUFFER *buf)
+{
+   if (status == CMD_STATUS_OK) {
+      return;
+   }
+   if (status == CMD_STATUS_DELTA_OVERFLOW) {
+      msg(MSG_ERR_SERIOUS, "Delta transition time overflow, raw transitions will not accuractly represent cyl %d head %d\n", 
+         buf->cyl, buf->head);
+   } else if (status == CMD_STATUS_READ_OVERRUN) {
+      msg(MSG_ERR_SERIOUS, "Delta transitions lost, raw transitions will not accuractly represent cyl %d head %d\n",
+         buf->cyl, buf->head);
+   } else {
+      msg(MSG_FATAL, "Fault reading deltas cmd %x status %x cyl %d head %d\n",
+         status, drive_get_drive_status(), buf->cyl, buf->head);
+      drive_print_drive_status(MSG_FATAL, drive_get_drive_status());
+      msg(MSG_FATAL, "CMD_DATA %x delta count %x\n", pru_get_cmd_data(),
+         pru_read_word(MEM_PRU0_DATA, PRU0_WRITE_PTR));
+      exit(1);
+   }
+}
+
+// Mark a read done and give it to the decoder if it's using it. Called
+// with reads.mutex locked.
+//
+// buf: The read
+static void read_done(READ_BUFFER *buf)
+{
+   buf->done = 1;
+   if (buf->used) {
+      read_publish(buf);
+   }
+   pthread_cond_broadcast(&reads.cond);
 }
 
 // This is the thread for processing deltas. 
-// We read a tracks worth of delta from PRU into global deltas then
-// wait for semaphore to repeat. If global thread_state is
-// THREAD_SHUTDOWN then we exit.
+// We read a tracks worth of delta from PRU into the read buffer then
+// wait for semaphore to repeat. If the PRU reads the next head without
+// another command it is copied to the other buffer. If global thread_state
+// is THREAD_SHUTDOWN then we exit.
 //
 // arg: pointer to drive_params if output files should be created or NULL
 //    to not create a file
@@ -160,6 +481,12 @@ static void *delta_proc(void *arg)
    int pru_finished_read = 0;
    // When 1 wait for read to be started
    int wait_read = 1;
+   // Number of next head reads PRU has started for this command
+   uint32_t read_num = 0;
+   // Where in DDR the PRU is putting the deltas
+   int ddr_offset = 0;
+   uint32_t write_ptr;
+   READ_BUFFER *buf = NULL;
    DRIVE_PARAMS *drive_params = (DRIVE_PARAMS *) arg;
 
    // Open file if requested
@@ -168,7 +495,9 @@ static void *delta_proc(void *arg)
             drive_params->transitions_filename,
             drive_params->num_cyl, drive_params->num_head,
             drive_params->cmdline, drive_params->note, 
-            drive_params->start_time_ns);
+            drive_params->start_time_ns, drive_params->compress_transitions);
+      write_start_thread(drive_params->tran_fd);
+      write_transitions = 1;
    }
 
    // And loop reading delta transitions
@@ -176,51 +505,73 @@ static void *delta_proc(void *arg)
       // Wait till read started
       if (wait_read) {
          track_deltas = 0;
+         read_num = 0;
+         ddr_offset = 0;
          sem_wait(&deltas_sem);
          wait_read = 0;
          if (thread_state == THREAD_SHUTDOWN)
             break;
+         pthread_mutex_lock(&reads.mutex);
+         buf = &reads.buffers[reads.fill];
+         pthread_mutex_unlock(&reads.mutex);
+      }
+      // If the PRU has started reading the next head this read is done.
+      // Get the rest of the deltas then switch to the other buffer.
+      if (pru_read_word(MEM_PRU0_DATA, PRU0_READ_NUM) != read_num) {
+         num_bytes = pru_read_word(MEM_PRU0_DATA, PRU0_PREV_WRITE_PTR) -
+            track_deltas * sizeof(buf->deltas[0]); 
+         pru_read_mem(MEM_DDR, &buf->deltas[track_deltas], num_bytes,
+            ddr_offset + track_deltas * sizeof(buf->deltas[0]));
+         track_deltas += num_bytes / sizeof(buf->deltas[0]);
+         check_read_status(pru_read_word(MEM_PRU0_DATA, PRU0_PREV_STATUS),
+            buf);
+         read_num++;
+         ddr_offset = (read_num & 1) * (reads.ddr_size / 2);
+
+         pthread_mutex_lock(&reads.mutex);
+         buf->num_deltas = track_deltas;
+         read_done(buf);
+         reads.fill = !reads.use;
+         buf = &reads.buffers[reads.fill];
+         buf->cyl = reads.next_cyl;
+         buf->head = reads.next_head;
+         buf->num_deltas = 0;
+         buf->done = 0;
+         buf->used = 0;
+         reads.next_started = 1;
+         pthread_mutex_unlock(&reads.mutex);
+         track_deltas = 0;
+         continue;
+      }
+      write_ptr = pru_read_word(MEM_PRU0_DATA, PRU0_WRITE_PTR);
+      // PRU may have started the next head after we checked. The pointer
+      // is then for the next head
+      if (pru_read_word(MEM_PRU0_DATA, PRU0_READ_NUM) != read_num) {
+         continue;
       }
-      num_bytes = pru_read_word(MEM_PRU0_DATA, PRU0_WRITE_PTR) -
-         track_deltas * sizeof(deltas[0]); 
-      pru_read_mem(MEM_DDR, &deltas[track_deltas],
-            num_bytes, track_deltas * sizeof(deltas[0]));
-      track_deltas += num_bytes / sizeof(deltas[0]);
-      deltas_update_count(track_deltas, 1);
+      num_bytes = write_ptr - track_deltas * sizeof(buf->deltas[0]); 
+      pru_read_mem(MEM_DDR, &buf->deltas[track_deltas],
+            num_bytes, ddr_offset + track_deltas * sizeof(buf->deltas[0]));
+      track_deltas += num_bytes / sizeof(buf->deltas[0]);
+      pthread_mutex_lock(&reads.mutex);
+      buf->num_deltas = track_deltas;
+      if (buf->used) {
+         read_publish(buf);
+      }
+      pthread_mutex_unlock(&reads.mutex);
       // If we didn't get very many deltas sleep to reduce overhead
       if (num_bytes < 300) {
          // CMD_STATUS_READ_STARTED indicates read is in progress,
          // CMD_STATUS_OK indicates PRU has finished read
          if (pru_get_cmd_status() != CMD_STATUS_READ_STARTED) {
-            if (pru_get_cmd_status() != CMD_STATUS_OK) {
-               if (pru_get_cmd_status() == CMD_STATUS_DELTA_OVERFLOW) {
-                  msg(MSG_ERR_SERIOUS, "Delta transition time overflow, raw transitions will not accuractly represent cyl %d head %d\n", 
-                     deltas_cyl, deltas_head);
-               } else if (pru_get_cmd_status() == CMD_STATUS_READ_OVERRUN) {
-                  msg(MSG_ERR_SERIOUS, "Delta transitions lost, raw transitions will not accuractly represent cyl %d head %d\n",
-                     deltas_cyl, deltas_head);
-               } else {
-                  msg(MSG_FATAL, "Fault reading deltas cmd %x status %x cyl %d head %d\n",
-                     pru_get_cmd_status(), drive_get_drive_status(),
-                     deltas_cyl, deltas_head);
-                  drive_print_drive_status(MSG_FATAL, drive_get_drive_status());
-                  msg(MSG_FATAL, "CMD_DATA %x delta count %x\n", pru_get_cmd_data(),
-                     pru_read_word(MEM_PRU0_DATA, PRU0_WRITE_PTR));
-                  exit(1);
-               }
-            }
+            check_read_status(pru_get_cmd_status(), buf);
             // PRU says its done. Use pru_finished_read variable to loop one more time
             // to ensure we have read all the deltas
             if (pru_finished_read) {
-               // This must be before update_mfm_deltas to prevent
-               // next read starting while we are still writing deltas
-               if (drive_params != NULL && 
-                     drive_params->transitions_filename != NULL) {
-                  write_deltas(drive_params->tran_fd, deltas, track_deltas);
-               }
-
-               // All are transferred, tell MFM decoder all deltas available
-               deltas_update_count(track_deltas, 0);
+               pthread_mutex_lock(&reads.mutex);
+               read_done(buf);
+               reads.reading = 0;
+               pthread_mutex_unlock(&reads.mutex);
                pru_finished_read = 0;
                // Indicate we should wait for next read
                wait_read = 1;
@@ -233,6 +584,7 @@ static void *delta_proc(void *arg)
       }
    }
    if (drive_params != NULL && drive_params->transitions_filename != NULL) {
+      write_stop_thread();
       tran_file_close(drive_params->tran_fd, 1);
    }
    return NULL;
@@ -270,8 +622,8 @@ int deltas_get_count(int deltas_processed)
 }
 
 // Wait until all deltas received. This is used when writing the deltas to a
-// file but not decoding. The wait ensures the deltas are written before
-// staring the next read.
+// file but not decoding. The wait ensures the deltas are queued for writing
+// before staring the next read.
 //
 // return: number of deltas read
 int deltas_wait_read_finished()
@@ -1,6 +1,8 @@
 // This is a replacement for deltas_read.c for use when reading data from a file
 // instead of a real drive. See deltas_read for more information.
 //
+// 10/17/26 DJG Made num_deltas thread local
+//
 // Copyright 2015 David Gesswein.
 // This file is part of MFM disk utilities.
 //
@@ -22,7 +24,8 @@
 #include "msg.h"
 
 // The number of deltas we have to process
-uint32_t num_deltas;
+// Thread local so mfm_util can decode tracks in parallel threads
+static __thread uint32_t num_deltas;
 
 // Update the count of deltas. Always not streaming for reading files.
 //
@@ -15,6 +15,7 @@
 // 
 // The drive must be at track 0 on startup or drive_seek_track0 called.
 //
+// 10/17/2026 DJG Use simulated drive lines when built with SIM_PRU
 // 06/02/2023 DJG Fixed write fault error reading NEC drive
 // 07/05/2019 DJG Added support for using recovery signal
 // 03/22/2019 DJG Added REV C support
@@ -108,6 +109,10 @@ void drive_select(int drive)
       msg(MSG_FATAL, "Invalid drive %d\n", drive);
       exit(1);
    }
+#ifdef SIM_PRU
+   pru_sim_drive_select(drive);
+   return;
+#endif
    // Open the files once
    if (first_time) {
       int rc;
@@ -185,6 +190,10 @@ void drive_set_head(int head)
       msg(MSG_FATAL, "Invalid head %d\n", head);
       exit(1);
    }
+#ifdef SIM_PRU
+   pru_sim_drive_set_head(head);
+   return;
+#endif
    // Open the files once
    if (first_time) {
       for (i = 0; i < 4; i++) {
@@ -214,6 +223,13 @@ int drive_at_track0(void)
    static int fd = -1;
    char str[128];
    int pin;
+#ifdef SIM_PRU
+   if (pru_exec_cmd(CMD_CHECK_READY, 0)) {
+      drive_print_drive_status(MSG_FATAL, drive_get_drive_status());
+      exit(1);
+   }
+   return pru_sim_drive_at_track0();
+#endif
    if (fd == -1) {
       if (board_get_revision() == 2) {
          pin = GPIO3_TRACK_0_BIT_REVC + GPIO3_START_PIN;
@@ -397,6 +413,10 @@ void drive_enable_recovery(int enable)
    static int first_time = 1;
    static int fd;
 
+#ifdef SIM_PRU
+   // The simulated drive doesn't have recovery mode
+   return;
+#endif
    // Open the files once
    if (first_time) {
       first_time = 0;
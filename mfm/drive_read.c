@@ -6,6 +6,25 @@
 // 
 // The drive must be at track 0 on startup or drive_seek_track0 called.
 //
+// With --defer_retries when a track still has errors and the next retry
+// would seek the track is saved and the rest of the disk read. The saved
+// tracks are then retried in one sweep across the cylinders. Only used when
+// just an extract file is written since the transition and emulation files
+// are written in track order. Not used with --recovery since its retries
+// microstep the head instead of seeking.
+//
+// With --pipeline_reads the PRU is asked to read the next head when the
+// read of a track finishes. The read is used for the next track unless
+// the current track needs a retry.
+//
+// 10/17/26 DJG Added --pipeline_reads to read the next head at the index
+//    pulse that ends the current track
+// 10/17/26 DJG --defer_retries ignored with --recovery
+// 10/17/26 DJG --defer_retries with transition or emulation file is
+//    now an option error
+// 10/17/26 DJG Free decoder state when done
+// 10/17/26 DJG Added --defer_retries to retry tracks needing seeks after
+//    the rest of the disk is read
 // 01/13/25 DJG Fixes for xebec_skew processing. Skew not same on all tracks.
 // 06/02/2023 DJG Fixed write fault error reading NEC drive
 // 07/05/2019 DJG Added support for using recovery signal
@@ -55,43 +74,329 @@
 #include "drive.h"
 #include "board.h"
 
-// Read the disk.
-//  drive params specifies the information needed to decode the drive and what
-//    files should be written from the data read
-//
-// drive_params: Drive parameters
-// deltas: Memory array containing the raw MFM delta time transition data
-void drive_read_disk(DRIVE_PARAMS *drive_params, void *deltas, int max_deltas)
-{
-   // Loop variable
+// Timing stuff for testing
+#ifdef CLOCK_MONOTONIC_RAW
+#define CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define CLOCK CLOCK_MONOTONIC
+#endif
+
+// State for reading the disk that is kept between tracks
+typedef struct {
+   // Memory array for the raw MFM delta time transition data
+   void *deltas;
+   int max_deltas;
+   int recovery_active;
+   // Non zero if the next head should be read when a read finishes
+   int pipeline;
+   // Track the PRU was asked to read next. Head is -1 if none
+   int next_cyl, next_head;
+   // Time last track read started and track read time statistics
+   double last, min, max, tot;
+   int count;
+} READ_STATE;
+
+// Read and retry state for a track. Saved when the retries are deferred
+typedef struct {
    int cyl, head;
-   int cntr;
    // Retry counter, counts up
    int err_cnt;
    // No seek retry counter, counts down
    int no_seek_count;
-   // Read status
-   SECTOR_DECODE_STATUS sector_status = 0;
+   // For retry we do various length seeks. This is the maximum length we will do
+   int seek_len;
+   // Number of retries to do for the track
+   int retries;
+   // Non zero if all the sectors were recovered from multiple reads
+   int recovered;
    // The status of each sector
    SECTOR_STATUS sector_status_list[MAX_SECTORS];
-   // We use this to summarize the list above has any errors
+} TRACK_READ;
+
+// Setup to read a track
+//
+// drive_params: Drive parameters
+// track: Track to setup
+// cyl, head: Track to read
+static void track_read_init(DRIVE_PARAMS *drive_params, TRACK_READ *track,
+   int cyl, int head)
+{
+   track->cyl = cyl;
+   track->head = head;
+   track->err_cnt = 0;
+   track->no_seek_count = drive_params->no_seek_retries;
+   track->seek_len = 1;
+   track->recovered = 0;
+   // Clear sector status here so we can see if different sectors
+   // successfully read on different reads.
+   mfm_init_sector_status_list(track->sector_status_list, 
+      drive_params->num_sectors);
+   if (cyl >= drive_params->noretry_cyl || 
+       head >= drive_params->noretry_head) {
+      track->retries = 0;
+   } else {
+      track->retries = drive_params->retries;
+   }
+}
+
+// Read and decode a track retrying until all sectors are read without
+// error or the retries are used up.
+//
+// drive_params: Drive parameters
+// state: Read state
+// track: Track to read. Retry state is updated
+// defer: Non zero to stop when the next retry needs a seek
+// return: Non zero if the retries were stopped for defer
+static int read_track_retries(DRIVE_PARAMS *drive_params, READ_STATE *state,
+   TRACK_READ *track, int defer)
+{
+   int cyl = track->cyl;
+   int head = track->head;
+   int cntr;
+   // Read status
+   SECTOR_DECODE_STATUS sector_status = 0;
+   // We use this to summarize the sector list has any errors
    int sect_err;
-   // For retry we do various length seeks. This is the maximum length we will do
-   int seek_len;
    // Cylinder difference when a seek error occurs
    int seek_difference;
+   // Non zero if the rest of the retries are deferred
+   int deferred = 0;
+   struct timespec tv_start;
+   double start;
+   // Deltas being decoded
+   void *deltas;
 
-   // Timing stuff for testing
-#ifdef CLOCK_MONOTONIC_RAW
-#define CLOCK CLOCK_MONOTONIC_RAW
-#else
-#define CLOCK CLOCK_MONOTONIC
+   do {
+      // First error retry without seek, second with third without etc
+      // Hopefully by moving head it will settle slightly differently
+      // allowing data to be read
+      if (track->no_seek_count <= 0) {
+         int clip_seek_len = track->seek_len;
+
+         // In recovery mode the drive will perform a microstep instead
+         // of a full cylinder step. The sequency of microsteps positions
+         // will repeat after a drive dependent number of steps
+         if (drive_params->recovery) {
+            if (!state->recovery_active) {
+               drive_enable_recovery(1);
+               state->recovery_active = 1;
+            }
+            drive_step(drive_params->step_speed, 1, 
+               DRIVE_STEP_NO_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
+         } else {
+            if (cyl + track->seek_len >= drive_params->num_cyl) {
+               clip_seek_len = drive_params->num_cyl - cyl - 1;
+            }
+            if (cyl + track->seek_len < 0) {
+               clip_seek_len = -cyl;
+            }
+            //printf("seeking %d %d %d\n",err_cnt, seek_len, seek_len + cyl);
+            if (clip_seek_len != 0) {
+               drive_step(drive_params->step_speed, clip_seek_len, 
+                  DRIVE_STEP_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
+               drive_step(drive_params->step_speed, -clip_seek_len, 
+                  DRIVE_STEP_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
+            }
+            if (track->seek_len < 0) {
+               track->seek_len = track->seek_len * 2;
+               if (track->seek_len <= -drive_params->num_cyl) {
+                  track->seek_len = -1;
+               }
+            }
+            track->seek_len = -track->seek_len;
+            if (track->seek_len == 0) {
+               track->seek_len = 1;
+            }
+         }
+         track->no_seek_count = drive_params->no_seek_retries;
+      }
+      track->no_seek_count--;
+      clock_gettime(CLOCK, &tv_start);
+      start = tv_start.tv_sec + tv_start.tv_nsec / 1e9;
+      if (state->last != 0) {
+#if 0
+         if (start-state->last > 40e-3)
+            printf("gettime delta ms %f\n", (start-state->last) * 1e3);
 #endif
-   struct timespec tv_start;
-   double start, last = 0;
-   double min = 9e9, max = 0, tot = 0;
-   int count = 0;
-   int recovery_active = 0;
+         if (start-state->last > state->max)
+            state->max = start-state->last;
+         if (start-state->last < state->min)
+            state->min = start-state->last;
+         state->tot += start-state->last;
+         state->count++;
+      }
+      state->last = start;
+
+      deltas = NULL;
+      if (state->next_head == head && state->next_cyl == cyl &&
+            track->err_cnt == 0) {
+         // NULL if the PRU finished before it saw the request
+         deltas = deltas_use_next_read();
+      }
+      state->next_head = -1;
+      if (deltas == NULL) {
+         drive_read_track(drive_params, cyl, head, state->deltas,
+            state->max_deltas, 0);
+         deltas = state->deltas;
+      }
+      // Read the next head while this one is decoded. Only if the next
+      // track's first read doesn't need a seek
+      if (state->pipeline && track->err_cnt == 0 && 
+            head + 1 < drive_params->num_head && 
+            drive_params->no_seek_retries > 0) {
+         deltas_start_next_read(cyl, head + 1);
+         state->next_cyl = cyl;
+         state->next_head = head + 1;
+      }
+
+      sector_status = mfm_decode_track(drive_params, cyl, head,
+         deltas, &seek_difference, track->sector_status_list);
+
+      // See if sector list shows any with errors. The sector list
+      // contains the information on the best read for each sector so
+      // even if the last read had errors we may have recovered all the
+      // data without errors.
+      sect_err = 0;
+      for (cntr = 0; cntr < drive_params->num_sectors; cntr++) {
+         if (UNRECOVERED_ERROR(track->sector_status_list[cntr].status)) {
+            sect_err = 1;
+         }
+      }
+      // If next retry needs a seek save it for later
+      if (defer && sect_err && track->err_cnt < track->retries && 
+            track->no_seek_count <= 0) {
+         deferred = 1;
+      }
+      // Retry needs the drive so drop the read of the next head
+      if (sect_err && track->err_cnt < track->retries && !deferred &&
+            state->next_head != -1) {
+         deltas_cancel_next_read();
+         state->next_head = -1;
+      }
+      // Looks like a seek error. Sector headers which don't have the
+      // expected cylinder such as when tracks are spared can trigger
+      // this also
+      if (sector_status & SECT_WRONG_CYL) {
+         if (track->err_cnt < track->retries && !deferred) {
+            msg(MSG_ERR, "Retrying seek cyl %d, cyl off by %d\n", cyl,
+                  seek_difference);
+            drive_step(drive_params->step_speed, seek_difference, 
+               DRIVE_STEP_NO_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
+         }
+      }
+
+      if (UNRECOVERED_ERROR(sector_status) && !sect_err) {
+         track->recovered = 1;
+      }
+   // repeat until we get all the data or run out of retries
+   } while (sect_err && track->err_cnt++ < track->retries && !deferred);
+   if (state->recovery_active) {
+     drive_enable_recovery(0);
+     // My ST225 doesn't follow the manual behavior of inactivating seek
+     // complete after recovery goes inactive while it repositions the 
+     // heads. The heads seem to be moving since I get data from several
+     // cylinders. If a step is done the drive gets confused and needs 
+     // to be power cylcled. This delay seems to make it work.
+     usleep(25000);
+     // Wait for seek complete 
+     if (pru_exec_cmd(CMD_CHECK_READY, 0)) {
+        drive_print_drive_status(MSG_FATAL, drive_get_drive_status());
+        exit(1);
+     }
+     state->recovery_active = 0;
+   }
+   if (deferred) {
+      return 1;
+   }
+   if (track->err_cnt > 0) {
+      if (track->err_cnt == track->retries + 1) {
+         msg(MSG_ERR, "Retries failed cyl %d head %d\n", cyl, head);
+      } else {
+         msg(MSG_INFO, "All sectors recovered %safter %d retries cyl %d head %d\n",
+               track->recovered ? "from multiple reads " : "", track->err_cnt,
+               cyl, head);
+      }
+   }
+   return 0;
+}
+
+// Compare deferred tracks for qsort by cylinder then head
+static int cmp_track_read(const void *t1, const void *t2) {
+   const TRACK_READ *track1 = t1;
+   const TRACK_READ *track2 = t2;
+
+   if (track1->cyl != track2->cyl) {
+      return track1->cyl - track2->cyl;
+   }
+   return track1->head - track2->head;
+}
+
+// Retry the deferred tracks. The tracks are visited in one sweep across
+// the cylinders starting from the end nearest the heads to minimize
+// seeking.
+//
+// drive_params: Drive parameters
+// state: Read state
+// tracks: Deferred tracks
+// num_tracks: Number of tracks
+static void read_deferred_tracks(DRIVE_PARAMS *drive_params, 
+   READ_STATE *state, TRACK_READ *tracks, int num_tracks)
+{
+   int cyl = drive_current_cyl();
+   int i, ndx;
+
+   if (num_tracks == 0) {
+      return;
+   }
+   qsort(tracks, num_tracks, sizeof(*tracks), cmp_track_read);
+   msg(MSG_INFO, "Retrying %d deferred tracks\n", num_tracks);
+   for (i = 0; i < num_tracks; i++) {
+      if (abs(cyl - tracks[num_tracks - 1].cyl) < abs(cyl - tracks[0].cyl)) {
+         ndx = num_tracks - 1 - i;
+      } else {
+         ndx = i;
+      }
+      read_track_retries(drive_params, state, &tracks[ndx], 0);
+      mfm_end_track(drive_params, tracks[ndx].cyl, tracks[ndx].head);
+   }
+}
+
+// Read the disk.
+//  drive params specifies the information needed to decode the drive and what
+//    files should be written from the data read
+//
+// drive_params: Drive parameters
+// deltas: Memory array containing the raw MFM delta time transition data
+void drive_read_disk(DRIVE_PARAMS *drive_params, void *deltas, int max_deltas)
+{
+   // Loop variable
+   int cyl, head;
+   READ_STATE state;
+   // Track being read
+   TRACK_READ track;
+   // Tracks with retries deferred until the rest of the disk is read
+   TRACK_READ *deferred_tracks = NULL;
+   int num_deferred = 0;
+   int max_deferred = 0;
+   int defer = drive_params->defer_retries;
+
+   memset(&state, 0, sizeof(state));
+   state.deltas = deltas;
+   state.max_deltas = max_deltas;
+   state.min = 9e9;
+   state.pipeline = drive_params->pipeline_reads;
+   state.next_head = -1;
+
+   // Xebec skew needs all of the previous tracks. It may be set by
+   // analyze so can't be checked with the other options
+   if (defer && drive_params->xebec_skew) {
+      msg(MSG_INFO, "xebec_skew requires reading tracks in order, --defer_retries ignored\n");
+      defer = 0;
+   }
+   if (defer && drive_params->recovery) {
+      msg(MSG_INFO, "Recovery mode retries don't seek, --defer_retries ignored\n");
+      defer = 0;
+   }
 
    // Start up delta reader
    deltas_start_thread(drive_params);
@@ -102,145 +407,35 @@ void drive_read_disk(DRIVE_PARAMS *drive_params, void *deltas, int max_deltas)
       if (cyl % 5 == 0)
          msg(MSG_PROGRESS, "At cyl %d\r", cyl);
       for (head = 0; head < drive_params->num_head; head++) {
-         int recovered = 0;
-         int retries;
-
-         err_cnt = 0;
-         no_seek_count = drive_params->no_seek_retries;
-         seek_len = 1;
-         // Clear sector status here so we can see if different sectors
-         // successfully read on different reads.
-         mfm_init_sector_status_list(sector_status_list, drive_params->num_sectors);
-         if (cyl >= drive_params->noretry_cyl || 
-             head >= drive_params->noretry_head) {
-            retries = 0;
-         } else {
-            retries = drive_params->retries;
-         }
-         do {
-            // First error retry without seek, second with third without etc
-            // Hopefully by moving head it will settle slightly differently
-            // allowing data to be read
-            if (no_seek_count <= 0) {
-               int clip_seek_len = seek_len;
-
-               // In recovery mode the drive will perform a microstep instead
-               // of a full cylinder step. The sequency of microsteps positions
-               // will repeat after a drive dependent number of steps
-               if (drive_params->recovery) {
-                  if (!recovery_active) {
-                     drive_enable_recovery(1);
-                     recovery_active = 1;
-                  }
-                  drive_step(drive_params->step_speed, 1, 
-                     DRIVE_STEP_NO_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
-               } else {
-                  if (cyl + seek_len >= drive_params->num_cyl) {
-                     clip_seek_len = drive_params->num_cyl - cyl - 1;
-                  }
-                  if (cyl + seek_len < 0) {
-                     clip_seek_len = -cyl;
-                  }
-                  //printf("seeking %d %d %d\n",err_cnt, seek_len, seek_len + cyl);
-                  if (clip_seek_len != 0) {
-                     drive_step(drive_params->step_speed, clip_seek_len, 
-                        DRIVE_STEP_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
-                     drive_step(drive_params->step_speed, -clip_seek_len, 
-                        DRIVE_STEP_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
-                  }
-                  if (seek_len < 0) {
-                     seek_len = seek_len * 2;
-                     if (seek_len <= -drive_params->num_cyl) {
-                        seek_len = -1;
-                     }
-                  }
-                  seek_len = -seek_len;
-                  if (seek_len == 0) {
-                     seek_len = 1;
-                  }
+         track_read_init(drive_params, &track, cyl, head);
+         if (read_track_retries(drive_params, &state, &track, defer)) {
+            if (num_deferred >= max_deferred) {
+               max_deferred = max_deferred * 2 + 16;
+               deferred_tracks = realloc(deferred_tracks, 
+                  sizeof(*deferred_tracks) * max_deferred);
+               if (deferred_tracks == NULL) {
+                  msg(MSG_FATAL, "Malloc failed deferred tracks\n");
+                  exit(1);
                }
-               no_seek_count = drive_params->no_seek_retries;
-            }
-            no_seek_count--;
-            clock_gettime(CLOCK, &tv_start);
-            start = tv_start.tv_sec + tv_start.tv_nsec / 1e9;
-            if (last != 0) {
-#if 0
-               if (start-last > 40e-3)
-                  printf("gettime delta ms %f\n", (start-last) * 1e3);
-#endif
-               if (start-last > max)
-                  max = start-last;
-               if (start-last < min)
-                  min = start-last;
-               tot += start-last;
-               count++;
-            }
-            last = start;
-
-            drive_read_track(drive_params, cyl, head, deltas, max_deltas, 0);
-
-            sector_status = mfm_decode_track(drive_params, cyl, head,
-               deltas, &seek_difference, sector_status_list);
-
-            // See if sector list shows any with errors. The sector list
-            // contains the information on the best read for each sector so
-            // even if the last read had errors we may have recovered all the
-            // data without errors.
-            sect_err = 0;
-            for (cntr = 0; cntr < drive_params->num_sectors; cntr++) {
-               if (UNRECOVERED_ERROR(sector_status_list[cntr].status)) {
-                  sect_err = 1;
-               }
-            }
-            // Looks like a seek error. Sector headers which don't have the
-            // expected cylinder such as when tracks are spared can trigger
-            // this also
-            if (sector_status & SECT_WRONG_CYL) {
-               if (err_cnt < retries) {
-                  msg(MSG_ERR, "Retrying seek cyl %d, cyl off by %d\n", cyl,
-                        seek_difference);
-                  drive_step(drive_params->step_speed, seek_difference, 
-                     DRIVE_STEP_NO_UPDATE_CYL, DRIVE_STEP_FATAL_ERR);
-               }
-            }
-
-            if (UNRECOVERED_ERROR(sector_status) && !sect_err) {
-               recovered = 1;
-            }
-         // repeat until we get all the data or run out of retries
-         } while (sect_err && err_cnt++ < retries);
-         if (recovery_active) {
-           drive_enable_recovery(0);
-           // My ST225 doesn't follow the manual behavior of inactivating seek
-           // complete after recovery goes inactive while it repositions the 
-           // heads. The heads seem to be moving since I get data from several
-           // cylinders. If a step is done the drive gets confused and needs 
-           // to be power cylcled. This delay seems to make it work.
-           usleep(25000);
-           // Wait for seek complete 
-           if (pru_exec_cmd(CMD_CHECK_READY, 0)) {
-              drive_print_drive_status(MSG_FATAL, drive_get_drive_status());
-              exit(1);
-           }
-           recovery_active = 0;
-         }
-         if (err_cnt > 0) {
-            if (err_cnt == retries + 1) {
-               msg(MSG_ERR, "Retries failed cyl %d head %d\n", cyl, head);
-            } else {
-               msg(MSG_INFO, "All sectors recovered %safter %d retries cyl %d head %d\n",
-                     recovered ? "from multiple reads " : "", err_cnt, cyl, head);
             }
+            deferred_tracks[num_deferred++] = track;
+            // Track will be processed when it is retried
+            mfm_track_state_discard_track(drive_params);
+         } else {
+            mfm_end_track(drive_params, cyl, head);
          }
-         mfm_end_track(drive_params, cyl, head);
       }
    }
+   // Deferred tracks aren't read in head order
+   state.pipeline = 0;
+   read_deferred_tracks(drive_params, &state, deferred_tracks, num_deferred);
+   free(deferred_tracks);
 
    mfm_decode_done(drive_params);
+   mfm_decode_free(drive_params);
 
-   printf("Track read time in ms min %f max %f avg %f\n", min * 1e3, 
-         max * 1e3, tot * 1e3 / count);
+   printf("Track read time in ms min %f max %f avg %f\n", state.min * 1e3, 
+         state.max * 1e3, state.tot * 1e3 / state.count);
 
    deltas_stop_thread();
 
@@ -15,6 +15,8 @@
 // Call emu_file_read_header to open file for reading or read/write.
 // Call emu_file_write_track_bits to write next track of emulation file data.
 // Call emu_file_rewrite_track to update a track in emulation file.
+// Call emu_file_rewrite_track_range to update part of a track in emulation
+//    file.
 // Call emu_file_read_track_bits to read next track of emulation file data.
 // Call emu_file_read_cyl to read a cylinder of emulation file data.
 // Call emu_file_write_cyl to write a cylinder of emulation file data.
@@ -31,6 +33,30 @@
 //    from delta format.
 // Call tran_file_seek_track to seek to desired cylinder and head
 //
+// Call emu_tran_open_input to open an input file which may be compressed.
+// Call emu_tran_read, emu_tran_seek, and emu_tran_close to access input
+//    files opened with emu_tran_open_input.
+//
+// Transition files are memory mapped for reading when possible so
+// tran_file_read_track_deltas unpacks the deltas directly from the file
+// data. Files that can't be mapped are read with read().
+//
+// Input files compressed with gzip, xz, or zstd are decompressed by running
+// the decompression program with the output read through a pipe. Only the
+// most recently decompressed data is kept so seeking backward further than
+// that restarts the program. Transition and emulation files are checked
+// for compression only if they don't start with the file header id.
+// Other files are decompressed only if the file name extension matches.
+//
+// Transition files from version 0x01020300 have a track index after the
+// end of file marker so tran_file_seek_track doesn't have to read through
+// the file. For older files the index is built by reading the track
+// headers the first time it's needed.
+//
+// Transition files written with compression enabled have the track data
+// Huffman coded. These files have major version 3 so older programs
+// won't try to read them.
+//
 // Delta format is count of clocks between ones in 200 MHz clocks.
 //
 // All files are read and written little endian. 
@@ -73,7 +99,8 @@
 // Transition file header format. See code for which fields are present
 //    in which file version.
 //    uint8_t[8] File id string 0xee 0x4d 0x46 0x4d 0x0a 0x1a 0x0a 0x0d
-//    uint32_t File type and version. Current 0x01020200
+//    uint32_t File type and version. Current 0x01020300 or 0x01030000
+//       for compressed track data
 //    uint32_t Offset to start of first track header in bytes.
 //    uint32_t Size of the header portion of each track in bytes.
 //    uint32_t Number of cylinders of track data in file.
@@ -91,12 +118,27 @@
 // Transition file track header format 
 //    int32_t Cylinder number of track
 //    int32_t Head number of track
-//    uint32_t Number of bytes of transition data
+//    uint32_t Number of bytes of transition data stored in file
 //    uint32_t Checksum of header and track data. Calculated over bytes 
 //    using crc64 in this program suite. Polynomial 0x140a0445 length 
 //       32 initial value 0xffffffff.
 //    Cylinder and head of -1 indicate no more data.
 //
+// Transition file track index format. Follows the end of file marker in
+//    version 0x01020300 and later. Older programs stop reading at the end
+//    of file marker.
+//    uint32_t 0x58444e49, Value to mark index.
+//    uint32_t Number of tracks in index.
+//    For each track in file order including retries of the same track
+//       int32_t Cylinder number of track
+//       int32_t Head number of track
+//       uint64_t Offset of track header from start of file in bytes
+//    uint64_t Offset of end of file marker from start of file in bytes
+//    uint32_t Checksum of index. Calculated over bytes from the index
+//       marker the same as the track checksum.
+//    uint64_t Offset of index marker from start of file in bytes
+//    End of file marker repeated so the file still ends with one.
+//
 // Transitions are count of clocks between one bits stored as bytes.
 //    A transition of 255 indicates the next 3 bytes are a 24 bit transition
 //    value. A transition value of 254 indicates the next 2 bytes are a 16
@@ -104,6 +146,23 @@
 //    Clock transition count clock frequency is in file header. For 200 MHz
 //    a count of 40 indicates 5 MHz pulse spacing.
 //
+// Compressed track data format for version 0x01030000. The transition
+//    bytes described above are Huffman coded. See huffman.c for format.
+//    uint32_t Number of bytes of transition data before coding
+//    uint8_t Huffman coded transition data
+//
+// 10/17/26 DJG Files opened close on exec so decompression programs only
+//    get the file they read
+// 10/17/26 DJG Only decompress files without header id or with compressed
+//    file extension. Keep limited decompressed data instead of whole file
+// 10/17/26 DJG Added emu_file_rewrite_track_range
+// 10/17/26 DJG Added reading gzip, xz, and zstd compressed input files
+// 10/17/26 DJG Added Huffman coded track data option
+// 10/17/26 DJG Memory map transition file for reading and unpack single
+//    byte deltas a chunk at a time
+// 10/17/26 DJG Added track index to transition file so
+//    tran_file_seek_track doesn't read through the file. Fixed
+//    TRAN_FILE_EOF_SIZE not including checksum.
 // 09/12/23 JST Changes to support 5.10 kernel and --sync option
 // 04/14/19 DJG Pick correct RPM for SA1000 with 8.6 MHz clock rate
 // 03/12/19 DJG Make tran_file_seek_track return EOF if cylinder or head
@@ -138,9 +197,14 @@
 // You should have received a copy of the GNU General Public License
 // along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
 //
+// For pipe2 and dup3
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
@@ -154,6 +218,7 @@
 #include "msg.h"
 #include "emu_tran_file.h"
 #include "crc_ecc.h"
+#include "huffman.h"
 // Only for CLOCKS_TO_NS
 #include "mfm_decoder.h"
 
@@ -168,14 +233,73 @@ uint8_t expected_header_id[] =
    { 0xee, 0x4d, 0x46, 0x4d, 0x0d, 0x0a, 0x1a, 0x00};
 // File type 2, major version 1, minor version 2
 #define EMU_FILE_VERSION 0x02020200
-// File type 1, major version 2, minor version 2
-#define TRAN_FILE_VERSION 0x01020200
+// File type 1, major version 2, minor version 3
+#define TRAN_FILE_VERSION 0x01020300
+// First version with track index
+#define TRAN_FILE_INDEX_VERSION 0x01020300
+// Version for Huffman coded track data. Major version increased since
+// older programs can't decode the track data
+#define TRAN_FILE_COMPRESS_VERSION 0x01030000
 // Size of end of file marker
-#define TRAN_FILE_EOF_SIZE 12
+#define TRAN_FILE_EOF_SIZE 16
+// Transition file index marker
+#define TRAN_INDEX_ID_VALUE 0x58444e49
+// Size of transition file track header
+#define TRAN_TRACK_HEADER_SIZE 12
+// Number of delta bytes unpack_deltas checks at once for escape values.
+// Smaller chunks are unrolled by the compiler instead of vectorized.
+#define UNPACK_CHUNK 32
 
 
 #define ARRAYSIZE(x) (sizeof(x) / sizeof(x[0]))
 
+// Compressed file name extensions and the program to decompress them.
+// Compressed transition and emulation files are also identified by the
+// bytes at the start of the file.
+static struct {
+   char *ext;
+   uint8_t magic[6];
+   int magic_len;
+   char *program;
+} decompressors[] = {
+   {".gz", {0x1f, 0x8b}, 2, "gzip"},
+   {".xz", {0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00}, 6, "xz"},
+   {".zst", {0x28, 0xb5, 0x2f, 0xfd}, 4, "zstd"}
+};
+
+// Bytes of decompressed data kept for seeking backward in compressed input
+// files. Seeks are normally within a track or sector so this is much
+// larger than needed.
+#define INPUT_WINDOW_BYTES (16*1024*1024)
+// Maximum number of compressed input files open at once
+#define MAX_INPUT_STREAMS 4
+
+// Compressed input file. The decompression program output is read through
+// a pipe and the most recent INPUT_WINDOW_BYTES are kept in buf. Seeking
+// before the data in buf restarts the program and skips forward.
+static struct {
+   // Non zero if entry in use
+   int in_use;
+   // File descriptor returned to caller. Read end of pipe from program
+   int fd;
+   // Compressed file
+   int file_fd;
+   // Decompression program and its process id
+   char *program;
+   pid_t pid;
+   // Decompressed data. The byte at offset off is at
+   // buf[off % INPUT_WINDOW_BYTES]
+   uint8_t *buf;
+   // Offset of oldest byte in buf and one past the newest byte
+   off_t start, end;
+   // Current read offset
+   off_t pos;
+   // Non zero when all data has been read from program
+   int eof;
+   // File name for messages
+   char fn[256];
+} input_streams[MAX_INPUT_STREAMS];
+
 static CRC_INFO trans_initial_poly =
 {   .poly = 0x140a0445,
     .length = 32,
@@ -183,6 +307,42 @@ static CRC_INFO trans_initial_poly =
     .ecc_max_span = 0
 };
 
+// Track index entry in transition file
+typedef struct {
+   int32_t cyl;
+   int32_t head;
+   uint64_t offset;
+} TRAN_INDEX_ENTRY;
+
+// Transition file being written. Only one file is written at a time.
+static struct {
+   // File being written or -1 if none
+   int fd;
+   // Non zero if track data is compressed
+   int compress;
+   // Buffer for compressed track data
+   uint8_t *compress_buf;
+   // Track index of file
+   TRAN_INDEX_ENTRY *entries;
+   // Number of entries and size of entries
+   int num_entries;
+   int entries_size;
+} write_file = { .fd = -1 };
+
+// Transition file being read. Only one file at a time is mapped or can
+// have compressed track data.
+static struct {
+   // File being read or -1 if none
+   int fd;
+   // File data if mapped else NULL
+   uint8_t *data;
+   size_t size;
+   // Non zero if track data is compressed
+   int compressed;
+   // Buffer for uncompressed track data
+   uint8_t *uncompress_buf;
+} read_file = { .fd = -1 };
+
 
 // Internal routines for reading and writing file.
 // fd: File descriptor to read/write
@@ -198,13 +358,308 @@ static void emu_file_write(int fd, void *bytes, int len) {
 }
 static void emu_file_read(int fd, void *bytes, int len) {
    int rc;
-   if ((rc = read(fd, bytes, len)) != len) {
+   if ((rc = emu_tran_read(fd, bytes, len)) != len) {
       msg(MSG_FATAL, "Failed to read bytes from emulation file %d %s\n", rc,
             rc == -1 ? strerror(errno) : "");
       exit(1);
    }
 }
 
+// Find compressed input file for file descriptor
+//
+// fd: File descriptor
+// return: Index into input_streams or -1 if fd isn't a compressed file
+static int input_stream_find(int fd)
+{
+   int i;
+
+   for (i = 0; i < ARRAYSIZE(input_streams); i++) {
+      if (input_streams[i].in_use && input_streams[i].fd == fd) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+// Stop decompression program and wait for it to exit
+//
+// s: Index of compressed input file
+// return: Non zero if program exited with an error
+static int input_stream_stop(int s)
+{
+   int status;
+   int rc = 0;
+
+   if (input_streams[s].pid > 0) {
+      if (!input_streams[s].eof) {
+         kill(input_streams[s].pid, SIGTERM);
+      }
+      if (waitpid(input_streams[s].pid, &status, 0) != input_streams[s].pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+         rc = 1;
+      }
+      input_streams[s].pid = -1;
+   }
+   return rc;
+}
+
+// Start decompression program reading from the start of the compressed
+// file. The read end of the pipe is put on the file descriptor the
+// caller has so restarting doesn't change it. Files are opened close on
+// exec so the program only gets the compressed file and the pipe as its
+// stdin and stdout.
+//
+// s: Index of compressed input file
+static void input_stream_start(int s)
+{
+   int pipe_fd[2];
+   pid_t pid;
+
+   if (pipe2(pipe_fd, O_CLOEXEC) != 0 ||
+         lseek(input_streams[s].file_fd, 0, SEEK_SET) != 0) {
+      msg(MSG_FATAL, "Failed to start decompressing %s: %s\n",
+         input_streams[s].fn, strerror(errno));
+      exit(1);
+   }
+   pid = fork();
+   if (pid < 0) {
+      msg(MSG_FATAL, "Failed to start %s: %s\n", input_streams[s].program,
+         strerror(errno));
+      exit(1);
+   }
+   if (pid == 0) {
+      dup2(input_streams[s].file_fd, 0);
+      dup2(pipe_fd[1], 1);
+      execlp(input_streams[s].program, input_streams[s].program, "-dc", NULL);
+      fprintf(stderr, "Failed to run %s: %s\n", input_streams[s].program,
+         strerror(errno));
+      _exit(127);
+   }
+   close(pipe_fd[1]);
+   if (input_streams[s].fd == -1) {
+      input_streams[s].fd = pipe_fd[0];
+   } else {
+      if (dup3(pipe_fd[0], input_streams[s].fd, O_CLOEXEC) < 0) {
+         msg(MSG_FATAL, "Failed to restart decompressing %s: %s\n",
+            input_streams[s].fn, strerror(errno));
+         exit(1);
+      }
+      close(pipe_fd[0]);
+   }
+   input_streams[s].pid = pid;
+   input_streams[s].start = 0;
+   input_streams[s].end = 0;
+   input_streams[s].eof = 0;
+}
+
+// Read the next block of data from the decompression program into the
+// buffer. The oldest data is discarded if the buffer is full.
+//
+// s: Index of compressed input file
+static void input_stream_fill(int s)
+{
+   int ndx = input_streams[s].end % INPUT_WINDOW_BYTES;
+   ssize_t rc;
+
+   do {
+      rc = read(input_streams[s].fd, &input_streams[s].buf[ndx],
+         INPUT_WINDOW_BYTES - ndx);
+   } while (rc < 0 && errno == EINTR);
+   if (rc < 0) {
+      msg(MSG_FATAL, "Failed to read from %s: %s\n", input_streams[s].program,
+         strerror(errno));
+      exit(1);
+   }
+   if (rc == 0) {
+      input_streams[s].eof = 1;
+      if (input_stream_stop(s)) {
+         msg(MSG_FATAL, "Failed to decompress %s with %s\n",
+            input_streams[s].fn, input_streams[s].program);
+         exit(1);
+      }
+   }
+   input_streams[s].end += rc;
+   if (input_streams[s].end - input_streams[s].start > INPUT_WINDOW_BYTES) {
+      input_streams[s].start = input_streams[s].end - INPUT_WINDOW_BYTES;
+   }
+}
+
+// Open input file for reading. Transition and emulation files which
+// don't start with the file header id are checked for gzip, xz, or zstd
+// compression. Other files are decompressed only if the file name has the
+// extension for the compression program. Compressed files must be read
+// with emu_tran_read, emu_tran_seek, and emu_tran_close. Seeking relative
+// to the end of a compressed file isn't supported.
+//
+// fn: File name to open
+// check_header: Non zero if file is a transition or emulation file
+// return: File descriptor or -1 with errno set if open failed
+int emu_tran_open_input(char *fn, int check_header)
+{
+   uint8_t magic[sizeof(expected_header_id)];
+   char *ext;
+   int fd;
+   int i, s;
+
+   fd = open(fn, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      return fd;
+   }
+   if (check_header) {
+      if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+            memcmp(magic, expected_header_id, sizeof(magic)) == 0) {
+         return fd;
+      }
+      for (i = 0; i < ARRAYSIZE(decompressors); i++) {
+         if (memcmp(magic, decompressors[i].magic,
+               decompressors[i].magic_len) == 0) {
+            break;
+         }
+      }
+   } else {
+      ext = emu_tran_compress_ext(fn);
+      for (i = 0; i < ARRAYSIZE(decompressors); i++) {
+         if (ext != NULL && strcmp(ext, decompressors[i].ext) == 0) {
+            break;
+         }
+      }
+   }
+   if (i >= ARRAYSIZE(decompressors)) {
+      return fd;
+   }
+   for (s = 0; s < ARRAYSIZE(input_streams); s++) {
+      if (!input_streams[s].in_use) {
+         break;
+      }
+   }
+   if (s >= ARRAYSIZE(input_streams)) {
+      msg(MSG_FATAL, "Too many compressed files open\n");
+      exit(1);
+   }
+   msg(MSG_INFO, "Decompressing %s with %s\n", fn, decompressors[i].program);
+   input_streams[s].in_use = 1;
+   input_streams[s].fd = -1;
+   input_streams[s].file_fd = fd;
+   input_streams[s].program = decompressors[i].program;
+   input_streams[s].pos = 0;
+   snprintf(input_streams[s].fn, sizeof(input_streams[s].fn), "%s", fn);
+   input_streams[s].buf = msg_malloc(INPUT_WINDOW_BYTES,
+      "Decompressed input buffer");
+   input_stream_start(s);
+
+   return input_streams[s].fd;
+}
+
+// Return the compression extension of file name
+//
+// fn: File name
+// return: Pointer to extension in fn or NULL if not a compressed file name
+char *emu_tran_compress_ext(char *fn)
+{
+   int len = strlen(fn);
+   int ext_len;
+   int i;
+
+   for (i = 0; i < ARRAYSIZE(decompressors); i++) {
+      ext_len = strlen(decompressors[i].ext);
+      if (len > ext_len && strcmp(&fn[len - ext_len],
+            decompressors[i].ext) == 0) {
+         return &fn[len - ext_len];
+      }
+   }
+   return NULL;
+}
+
+// Read from input file opened by emu_tran_open_input
+//
+// fd: File descriptor to read from
+// bytes: Buffer to read into
+// len: Number of bytes to read
+// return: Number of bytes read, less than len at end of file, or -1 on error
+ssize_t emu_tran_read(int fd, void *bytes, size_t len)
+{
+   int s = input_stream_find(fd);
+   size_t count = 0;
+   off_t avail;
+   int ndx;
+
+   if (s < 0) {
+      return read(fd, bytes, len);
+   }
+   if (input_streams[s].pos < input_streams[s].start) {
+      input_stream_stop(s);
+      input_stream_start(s);
+   }
+   while (count < len) {
+      if (input_streams[s].pos >= input_streams[s].end) {
+         if (input_streams[s].eof) {
+            break;
+         }
+         input_stream_fill(s);
+         continue;
+      }
+      ndx = input_streams[s].pos % INPUT_WINDOW_BYTES;
+      avail = input_streams[s].end - input_streams[s].pos;
+      if (avail > INPUT_WINDOW_BYTES - ndx) {
+         avail = INPUT_WINDOW_BYTES - ndx;
+      }
+      if (avail > len - count) {
+         avail = len - count;
+      }
+      memcpy((uint8_t *) bytes + count, &input_streams[s].buf[ndx], avail);
+      count += avail;
+      input_streams[s].pos += avail;
+   }
+   return count;
+}
+
+// Seek in input file opened by emu_tran_open_input
+//
+// fd: File descriptor to seek
+// offset: Offset to seek to
+// whence: SEEK_SET, SEEK_CUR, or SEEK_END. SEEK_END fails with ESPIPE for
+//    compressed files
+// return: New offset or -1 on error
+off_t emu_tran_seek(int fd, off_t offset, int whence)
+{
+   int s = input_stream_find(fd);
+
+   if (s < 0) {
+      return lseek(fd, offset, whence);
+   }
+   if (whence == SEEK_CUR) {
+      offset += input_streams[s].pos;
+   } else if (whence != SEEK_SET) {
+      errno = ESPIPE;
+      return -1;
+   }
+   if (offset < 0) {
+      errno = EINVAL;
+      return -1;
+   }
+   input_streams[s].pos = offset;
+   return offset;
+}
+
+// Close input file opened by emu_tran_open_input
+//
+// fd: File descriptor to close
+void emu_tran_close(int fd)
+{
+   int s = input_stream_find(fd);
+
+   if (s >= 0) {
+      close(input_streams[s].fd);
+      input_stream_stop(s);
+      close(input_streams[s].file_fd);
+      free(input_streams[s].buf);
+      input_streams[s].buf = NULL;
+      input_streams[s].in_use = 0;
+   } else {
+      close(fd);
+   }
+}
+
 // Find the desired cylinder and head in the transition file
 // fd: File descriptor to read from
 // seek_cyl: Cylinder number to find
@@ -224,7 +679,7 @@ int emu_file_seek_track(int fd, int seek_cyl, int seek_head,
    offset = (off_t) seek_cyl * track_size * emu_file_info->num_head + 
       seek_head * track_size + emu_file_info->file_header_size_bytes;
 
-   if (lseek(fd, offset , SEEK_SET) == -1) {
+   if (emu_tran_seek(fd, offset , SEEK_SET) == -1) {
       msg(MSG_FATAL, "Failed to seek in emulation file %s\n", 
             strerror(errno));
       exit(1);
@@ -313,7 +768,7 @@ int  emu_file_write_header(char *fn, int num_cyl, int num_head, char *cmdline,
    }
 
 
-   fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+   fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0664);
    if (fd < 0) {
       msg(MSG_FATAL, "Failed to open emulation file %s: %s\n",
             fn, strerror(errno));
@@ -382,12 +837,12 @@ int emu_file_read_header(char *fn, EMU_FILE_INFO *emu_file_info,
 
    if (rewrite) {
       if (direct) {
-         fd = open(fn, O_RDWR | O_DSYNC);
+         fd = open(fn, O_RDWR | O_DSYNC | O_CLOEXEC);
       } else {
-         fd = open(fn, O_RDWR);
+         fd = open(fn, O_RDWR | O_CLOEXEC);
       }
    } else {
-      fd = open(fn, O_RDONLY);
+      fd = emu_tran_open_input(fn, 1);
    }
    if (fd < 0) {
       msg(MSG_FATAL, "Failed to open emulation file %s: %s\n", 
@@ -442,7 +897,8 @@ int emu_file_read_header(char *fn, EMU_FILE_INFO *emu_file_info,
    // If more data in header ignore it. This allows 
    // minor revisions to add additional fields and old programs still 
    // can process
-   header_left = emu_file_info->file_header_size_bytes - lseek(fd, 0, SEEK_CUR);
+   header_left = emu_file_info->file_header_size_bytes -
+      emu_tran_seek(fd, 0, SEEK_CUR);
    if (header_left > 0) {
       char *ignore = msg_malloc(value, "emu_file_read ignore");
       emu_file_read(fd, ignore, header_left);
@@ -529,6 +985,40 @@ void emu_file_rewrite_track(int fd, EMU_FILE_INFO *emu_file_info,
    }
 }
 
+// Overwrite part of a track with new data
+//
+// fd: File descriptor to write to
+// emu_file_info: Information on emulator file format
+// cyl: Cylinder of track
+// head: Head/track number
+// buf: Track data including header
+// start: Offset in bytes of first byte in track to write
+// len: Number of bytes to write
+void emu_file_rewrite_track_range(int fd, EMU_FILE_INFO *emu_file_info,
+      int cyl, int head, void *buf, int start, int len)
+{
+   off_t offset;
+   int rc;
+   int track_size = emu_file_info->track_data_size_bytes +
+         emu_file_info->track_header_size_bytes;
+   int cyl_size = track_size * emu_file_info->num_head;
+
+   if (start < 0 || len < 0 || start + len > track_size) {
+      msg(MSG_FATAL, "Emulation track range invalid %d %d %d\n",
+            start, len, track_size);
+      exit(1);
+   }
+
+   offset = (off_t) cyl * cyl_size + head * track_size + start +
+         emu_file_info->file_header_size_bytes;
+
+   if ((rc = pwrite(fd, (uint8_t *) buf + start, len, offset)) != len) {
+      msg(MSG_FATAL, "Failed to write emulation track rc %d %s\n", rc,
+            rc == -1 ? strerror(errno): "");
+      exit(1);
+   }
+}
+
 // Read track header and bits
 //
 // fd: File descriptor to read from
@@ -633,12 +1123,176 @@ void emu_file_close(int fd, int write_eof)
          emu_file_write_track_bits(fd, NULL, 0, -1, -1, 0);
       }
       fsync(fd);
-      close(fd);
+      emu_tran_close(fd);
    }
 }
 
 ////// Transition file routines
 
+static void tran_file_write(int fd, void *bytes, int len, CRC_INFO *poly);
+static void tran_file_read(int fd,void *bytes, int len, CRC_INFO *poly);
+
+// Write the track index after the end of file marker then repeat the end
+// of file marker. The end of file marker offset is the last entry.
+//
+// fd: File descriptor to write to
+static void tran_file_write_index(int fd)
+{
+   CRC_INFO poly = trans_initial_poly;
+   uint64_t index_offset;
+   uint64_t value64;
+   uint32_t value;
+   int num_tracks = write_file.num_entries - 1;
+
+   index_offset = lseek(fd, 0, SEEK_CUR);
+   value = TRAN_INDEX_ID_VALUE;
+   tran_file_write(fd, &value, sizeof(value), &poly);
+   value = num_tracks;
+   tran_file_write(fd, &value, sizeof(value), &poly);
+   tran_file_write(fd, write_file.entries,
+      sizeof(write_file.entries[0]) * num_tracks, &poly);
+   value64 = write_file.entries[num_tracks].offset;
+   tran_file_write(fd, &value64, sizeof(value64), &poly);
+   value = poly.init_value;
+   tran_file_write(fd, &value, sizeof(value), &poly);
+   tran_file_write(fd, &index_offset, sizeof(index_offset), &poly);
+   // Don't add repeated marker to index
+   write_file.fd = -1;
+   tran_file_write_track_deltas(fd, NULL, 0, -1, -1);
+}
+
+// Set the first offset of each track and end of file marker offset from
+// index entries.
+//
+// tran_file_info: Information on transition file
+// entries: Index entries in file order
+// num_entries: Number of entries
+// eof_offset: Offset of end of file marker
+static void tran_file_set_offsets(TRAN_FILE_INFO *tran_file_info,
+   TRAN_INDEX_ENTRY *entries, int num_entries, uint64_t eof_offset)
+{
+   int num_tracks = tran_file_info->num_cyl * tran_file_info->num_head;
+   int i, ndx;
+
+   tran_file_info->track_offset = msg_malloc(
+      sizeof(*tran_file_info->track_offset) * num_tracks,
+      "Transition file track offsets");
+   for (i = 0; i < num_tracks; i++) {
+      tran_file_info->track_offset[i] = -1;
+   }
+   for (i = 0; i < num_entries; i++) {
+      if (entries[i].cyl >= 0 && entries[i].cyl < tran_file_info->num_cyl &&
+            entries[i].head >= 0 &&
+            entries[i].head < tran_file_info->num_head) {
+         ndx = entries[i].cyl * tran_file_info->num_head + entries[i].head;
+         // Seek finds the first read of the track
+         if (tran_file_info->track_offset[ndx] == -1) {
+            tran_file_info->track_offset[ndx] = entries[i].offset;
+         }
+      }
+   }
+   tran_file_info->eof_offset = eof_offset;
+}
+
+// Read the track index from the end of the file if present. Files without
+// a good index are handled by tran_file_seek_track building the offsets.
+//
+// fd: File descriptor to read from
+// tran_file_info: Information on transition file. Track offsets set if
+//    index read
+static void tran_file_read_index(int fd, TRAN_FILE_INFO *tran_file_info)
+{
+   CRC_INFO poly = trans_initial_poly;
+   TRAN_INDEX_ENTRY *entries;
+   uint64_t index_offset, eof_offset;
+   uint32_t value, num_tracks, crc;
+   off_t end, start;
+   // Index sizes other than the entries
+   int fixed_size = 4 + 4 + 8 + 4 + 8 + TRAN_FILE_EOF_SIZE;
+
+   start = emu_tran_seek(fd, 0, SEEK_CUR);
+   end = emu_tran_seek(fd, 0, SEEK_END);
+   if (end < tran_file_info->file_header_size_bytes + TRAN_FILE_EOF_SIZE +
+         fixed_size) {
+      emu_tran_seek(fd, start, SEEK_SET);
+      return;
+   }
+   emu_tran_seek(fd, end - TRAN_FILE_EOF_SIZE - sizeof(index_offset), SEEK_SET);
+   tran_file_read(fd, &index_offset, sizeof(index_offset), &poly);
+   if (index_offset < tran_file_info->file_header_size_bytes ||
+         index_offset > end - fixed_size) {
+      emu_tran_seek(fd, start, SEEK_SET);
+      return;
+   }
+   emu_tran_seek(fd, index_offset, SEEK_SET);
+   poly = trans_initial_poly;
+   tran_file_read(fd, &value, sizeof(value), &poly);
+   tran_file_read(fd, &num_tracks, sizeof(num_tracks), &poly);
+   if (value != TRAN_INDEX_ID_VALUE || (uint64_t) num_tracks *
+         sizeof(*entries) != end - index_offset - fixed_size) {
+      msg(MSG_INFO, "Transition file track index not valid, ignored\n");
+      emu_tran_seek(fd, start, SEEK_SET);
+      return;
+   }
+   entries = msg_malloc(sizeof(*entries) * num_tracks,
+      "Transition file index");
+   tran_file_read(fd, entries, sizeof(*entries) * num_tracks, &poly);
+   tran_file_read(fd, &eof_offset, sizeof(eof_offset), &poly);
+   crc = poly.init_value;
+   tran_file_read(fd, &value, sizeof(value), &poly);
+   if (value != crc) {
+      msg(MSG_INFO, "Transition file track index CRC error %x %x, ignored\n",
+         crc, value);
+   } else {
+      tran_file_set_offsets(tran_file_info, entries, num_tracks, eof_offset);
+   }
+   free(entries);
+   emu_tran_seek(fd, start, SEEK_SET);
+}
+
+// Build the track offsets by reading the track headers for files without
+// an index.
+//
+// fd: File descriptor to read from
+// tran_file_info: Information on transition file
+static void tran_file_build_index(int fd, TRAN_FILE_INFO *tran_file_info)
+{
+   CRC_INFO poly = trans_initial_poly;
+   TRAN_INDEX_ENTRY *entries = NULL;
+   int num_entries = 0, entries_size = 0;
+   uint64_t offset;
+   uint32_t cyl, head;
+   uint32_t num_bytes;
+
+   offset = emu_tran_seek(fd, tran_file_info->file_header_size_bytes, SEEK_SET);
+   while (1) {
+      tran_file_read(fd, &cyl, sizeof(cyl), &poly);
+      tran_file_read(fd, &head, sizeof(head), &poly);
+      tran_file_read(fd, &num_bytes, sizeof(num_bytes), &poly);
+      if (cyl == -1 && head == -1) {
+         break;
+      }
+      if (num_entries >= entries_size) {
+         entries_size = entries_size * 2 + 1024;
+         entries = realloc(entries, sizeof(*entries) * entries_size);
+         if (entries == NULL) {
+            msg(MSG_FATAL, "Malloc failed transition file index\n");
+            exit(1);
+         }
+      }
+      entries[num_entries].cyl = cyl;
+      entries[num_entries].head = head;
+      entries[num_entries].offset = offset;
+      num_entries++;
+      if ((offset = emu_tran_seek(fd, num_bytes + 4, SEEK_CUR)) == -1) {
+         msg(MSG_FATAL, "tran_file_seek_track seek failed\n");
+         exit(1);
+      }
+   }
+   tran_file_set_offsets(tran_file_info, entries, num_entries, offset);
+   free(entries);
+}
+
 // Internal routines for reading and writing file.
 // fd: File descriptor to read/write
 // bytes: Data to read/write
@@ -657,7 +1311,7 @@ static void tran_file_write(int fd, void *bytes, int len, CRC_INFO *poly) {
 
 static void tran_file_read(int fd,void *bytes, int len, CRC_INFO *poly) {
    int rc;
-   if ((rc = read(fd, bytes, len)) != len) {
+   if ((rc = emu_tran_read(fd, bytes, len)) != len) {
       msg(MSG_FATAL, "Failed to read word from transition file %d %d %s\n", rc,
             len, rc == -1 ? strerror(errno) : "");
       exit(1);
@@ -673,11 +1327,24 @@ void tran_file_close(int fd, int write_eof)
    if (fd != -1) {
       if (write_eof) {
          tran_file_write_track_deltas(fd, NULL, 0, -1, -1);
+         if (fd == write_file.fd) {
+            tran_file_write_index(fd);
+         }
          fsync(fd);
       }
-      close(fd);
+      if (fd == write_file.fd) {
+         write_file.fd = -1;
+      }
+      if (fd == read_file.fd) {
+         if (read_file.data != NULL) {
+            munmap(read_file.data, read_file.size);
+         }
+         free(read_file.uncompress_buf);
+         read_file.uncompress_buf = NULL;
+         read_file.fd = -1;
+      }
+      emu_tran_close(fd);
    }
-
 }
 // Read emulator file header.
 //
@@ -693,7 +1360,7 @@ int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info)
    int fd;
    int header_left;
 
-   fd = open(fn, O_RDONLY);
+   fd = emu_tran_open_input(fn, 1);
    if (fd < 0) {
       msg(MSG_FATAL, "Failed to open transition file %s: %s\n", 
             fn, strerror(errno));
@@ -707,10 +1374,10 @@ int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info)
    }
    tran_file_read(fd, &value, sizeof(value), &poly);
    tran_file_info->version = value;
-   if ((value & 0xff000000) != (TRAN_FILE_VERSION & 0xff000000) ||
-         (value & 0xff0000) > (TRAN_FILE_VERSION & 0xff0000)) {
+   if ((value & 0xff000000) != (TRAN_FILE_COMPRESS_VERSION & 0xff000000) ||
+         (value & 0xff0000) > (TRAN_FILE_COMPRESS_VERSION & 0xff0000)) {
       msg(MSG_FATAL, "Transition file incorrect type or higher revision than supported %x %x",
-            value, TRAN_FILE_VERSION);
+            value, TRAN_FILE_COMPRESS_VERSION);
       exit(1);
    }
    tran_file_read(fd, &value, sizeof(value), &poly);
@@ -748,7 +1415,8 @@ int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info)
    // If more data than 4 byte checksum in header ignore it. This allows 
    // minor revisions to add additional fields and old programs still 
    // can process
-   header_left = tran_file_info->file_header_size_bytes - lseek(fd, 0, SEEK_CUR);
+   header_left = tran_file_info->file_header_size_bytes -
+      emu_tran_seek(fd, 0, SEEK_CUR);
    if (header_left > 4) {
       char *ignore = msg_malloc(value, "tran_file_read ignore");
       tran_file_read(fd, ignore, header_left, &poly);
@@ -763,6 +1431,39 @@ int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info)
       exit(1);
    }
 
+   tran_file_info->track_offset = NULL;
+   if ((tran_file_info->version & 0xffffff00) >= TRAN_FILE_INDEX_VERSION) {
+      tran_file_read_index(fd, tran_file_info);
+   }
+
+   // Map file so tracks can be unpacked without copying. If it can't be
+   // mapped read() is used.
+   if (read_file.fd == -1) {
+      struct stat st;
+
+      read_file.fd = fd;
+      read_file.data = NULL;
+      read_file.compressed = (tran_file_info->version & 0xffff0000) >=
+         TRAN_FILE_COMPRESS_VERSION;
+      if (read_file.compressed) {
+         read_file.uncompress_buf = msg_malloc(MAX_BYTE_DELTAS,
+            "Transition file uncompress buffer");
+      }
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+         read_file.data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (read_file.data != MAP_FAILED) {
+            posix_madvise(read_file.data, st.st_size, POSIX_MADV_SEQUENTIAL);
+            read_file.size = st.st_size;
+         } else {
+            read_file.data = NULL;
+         }
+      }
+   } else if ((tran_file_info->version & 0xffff0000) >=
+         TRAN_FILE_COMPRESS_VERSION) {
+      msg(MSG_FATAL, "Only one compressed transition file can be read at a time\n");
+      exit(1);
+   }
+
    return fd;
 }
 
@@ -772,9 +1473,10 @@ int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info)
 // num_cyl: Number of cylinder file will contain
 // num_head: Number of tracks per cylinder
 // cmdline: Command line used for generation to store in file
+// compress: Non zero to Huffman code the track data
 // return: file descriptor for file opened
 int tran_file_write_header(char *fn, int num_cyl, int num_head,
-      char *cmdline, char *note, uint32_t start_time_ns) {
+      char *cmdline, char *note, uint32_t start_time_ns, int compress) {
    uint32_t value;
    CRC_INFO poly = trans_initial_poly;
    int fd;
@@ -786,7 +1488,7 @@ int tran_file_write_header(char *fn, int num_cyl, int num_head,
       lcl_note = note;
    }
 
-   fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+   fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0664);
    if (fd < 0) {
       msg(MSG_FATAL, "Failed to open transition file %s: %s\n",
             fn, strerror(errno));
@@ -794,7 +1496,11 @@ int tran_file_write_header(char *fn, int num_cyl, int num_head,
    }
 
    tran_file_write(fd, expected_header_id, sizeof(expected_header_id), &poly);
-   value = TRAN_FILE_VERSION;
+   if (compress) {
+      value = TRAN_FILE_COMPRESS_VERSION;
+   } else {
+      value = TRAN_FILE_VERSION;
+   }
    tran_file_write(fd, &value, sizeof(value), &poly);
    // Offset of first track header
    value = sizeof(expected_header_id) + 4*10 + strlen(cmdline)+1 + 
@@ -834,11 +1540,21 @@ int tran_file_write_header(char *fn, int num_cyl, int num_head,
       msg(MSG_FATAL, "Header size wrong, update code\n");
       exit(1);
    }
+   write_file.fd = fd;
+   write_file.num_entries = 0;
+   write_file.compress = compress;
+   if (compress && write_file.compress_buf == NULL) {
+      write_file.compress_buf = msg_malloc(
+         sizeof(uint32_t) + huffman_max_encoded_size(MAX_BYTE_DELTAS),
+         "Transition file compress buffer");
+   }
 
    return fd;
 }
 
-// Find the desired cylinder and head in the transition file
+// Find the desired cylinder and head in the transition file. If the track
+// was read more than once the first read is found. If not found the file
+// is positioned at the end of file marker.
 // fd: File descriptor to read from
 // seek_cyl: Cylinder number to find
 // seek_head: head number to find
@@ -846,43 +1562,191 @@ int tran_file_write_header(char *fn, int num_cyl, int num_head,
 // return: 0 if track found else 1
 int tran_file_seek_track(int fd, int seek_cyl, int seek_head, 
      TRAN_FILE_INFO *tran_file_info) {
-   int done = 0;
-   uint32_t cyl, head;
-   uint32_t num_bytes;
-   CRC_INFO poly = trans_initial_poly;
-   int rc = 0;
+   int64_t offset;
 
    if (seek_head >= tran_file_info->num_head ||
      seek_cyl >= tran_file_info->num_cyl) {
-     lseek(fd, -TRAN_FILE_EOF_SIZE, SEEK_END);
+     // Compressed files can't seek from the end so use the index
+     if (emu_tran_seek(fd, -TRAN_FILE_EOF_SIZE, SEEK_END) == -1) {
+        if (tran_file_info->track_offset == NULL) {
+           tran_file_build_index(fd, tran_file_info);
+        }
+        emu_tran_seek(fd, tran_file_info->eof_offset, SEEK_SET);
+     }
      return 1;
    } else {
-      lseek(fd, tran_file_info->file_header_size_bytes, SEEK_SET);
-      while (!done) {
-	 tran_file_read(fd, &cyl, sizeof(cyl), &poly);
-	 tran_file_read(fd, &head, sizeof(head), &poly);
-	 tran_file_read(fd, &num_bytes, sizeof(num_bytes), &poly);
-
-	 if (cyl == -1 && head == -1) {
-	    msg(MSG_DEBUG, "Unable to find cylinder %d head %d\n",
-		  seek_cyl, seek_head);
-	    rc = 1;
-	    done = 1;
-	 }
-	 if (cyl == seek_cyl && head == seek_head) {
-	    done = 1;
-	    lseek(fd, -4 * 3, SEEK_CUR);
-	 } else {
-	    if (lseek(fd, num_bytes + 4, SEEK_CUR) == -1) {
-	       msg(MSG_FATAL, "tran_file_seek_track seek failed\n");
-	       exit(1);
-	    }
-	 }
+      if (tran_file_info->track_offset == NULL) {
+         tran_file_build_index(fd, tran_file_info);
+      }
+      offset = tran_file_info->track_offset[seek_cyl * 
+         tran_file_info->num_head + seek_head];
+      if (offset == -1) {
+         msg(MSG_DEBUG, "Unable to find cylinder %d head %d\n",
+            seek_cyl, seek_head);
+         emu_tran_seek(fd, tran_file_info->eof_offset, SEEK_SET);
+         return 1;
       }
-      return rc;
+      if (emu_tran_seek(fd, offset, SEEK_SET) == -1) {
+         msg(MSG_FATAL, "tran_file_seek_track seek failed\n");
+         exit(1);
+      }
+      return 0;
    }
 }
 
+// Unpack transition file track data into deltas. Runs of single byte deltas
+// are converted UNPACK_CHUNK at a time which the compiler can vectorize.
+//
+// deltas_in: Transition file track data
+// num_bytes: Number of bytes of track data
+// deltas: Deltas to return
+// max_deltas: Size of deltas buffer in words
+// return: Number of deltas
+static int unpack_deltas(uint8_t deltas_in[], int num_bytes, uint16_t deltas[],
+   int max_deltas)
+{
+   int deltas_ndx = 0;
+   int i, j;
+   int chunk_end;
+   uint8_t *in;
+   uint16_t *out;
+   uint8_t max;
+   uint32_t value;
+
+   i = 0;
+   while (i < num_bytes) {
+      chunk_end = i + UNPACK_CHUNK;
+      if (chunk_end <= num_bytes && deltas_ndx + UNPACK_CHUNK <= max_deltas) {
+         in = &deltas_in[i];
+         out = &deltas[deltas_ndx];
+         max = 0;
+         for (j = 0; j < UNPACK_CHUNK; j++) {
+            max = in[j] > max ? in[j] : max;
+         }
+         if (max < 254) {
+            for (j = 0; j < UNPACK_CHUNK; j++) {
+               out[j] = in[j];
+            }
+            i += UNPACK_CHUNK;
+            deltas_ndx += UNPACK_CHUNK;
+            continue;
+         }
+      }
+      // Unpack the chunk with the multiple byte delta one at a time
+      while (i < num_bytes && i < chunk_end) {
+         if (deltas_in[i] == 255) {
+            value = deltas_in[i+1] | ((uint32_t) deltas_in[i+2] << 8) | 
+               ((uint32_t) deltas_in[i+3] << 16);
+            i += 4;
+         } else if (deltas_in[i] == 254) {
+            value = deltas_in[i+1] | ((uint32_t) deltas_in[i+2] << 8);
+            i += 3;
+         } else {
+            value = deltas_in[i++];
+         }
+         if (deltas_ndx >= max_deltas) {
+            msg(MSG_FATAL, "Transition file deltas overflow %d %d\n", 
+                deltas_ndx, max_deltas);
+            exit(1);
+         }
+         deltas[deltas_ndx++] = value;
+      }
+   }
+   return deltas_ndx;
+}
+
+// Convert transition file track data to deltas. Compressed track data is
+// uncompressed first.
+//
+// data: Transition file track data
+// num_bytes: Number of bytes of track data
+// compressed: Non zero if track data is compressed
+// deltas: Deltas to return
+// max_deltas: Size of deltas buffer in words
+// return: Number of deltas
+static int tran_file_unpack_track(uint8_t data[], int num_bytes, int compressed,
+   uint16_t deltas[], int max_deltas)
+{
+   uint32_t uncompressed_bytes;
+
+   if (!compressed) {
+      return unpack_deltas(data, num_bytes, deltas, max_deltas);
+   }
+   if (num_bytes < sizeof(uncompressed_bytes)) {
+      msg(MSG_FATAL, "Transition file compressed track too short %d\n",
+         num_bytes);
+      exit(1);
+   }
+   memcpy(&uncompressed_bytes, data, sizeof(uncompressed_bytes));
+   if (uncompressed_bytes > MAX_BYTE_DELTAS ||
+         huffman_decode(&data[sizeof(uncompressed_bytes)],
+         num_bytes - sizeof(uncompressed_bytes), read_file.uncompress_buf,
+         uncompressed_bytes) != 0) {
+      msg(MSG_FATAL, "Transition file compressed track data not valid\n");
+      exit(1);
+   }
+   return unpack_deltas(read_file.uncompress_buf, uncompressed_bytes, deltas,
+      max_deltas);
+}
+
+// Read transition track from the mapped file and return as deltas. The
+// file position is used and updated the same as reading the file.
+//
+// fd: File descriptor to read from
+// deltas: Deltas to return
+// max_deltas: Size of deltas buffer in words
+// cyl: Cylinder number of track read
+// head: head number of track read
+// return: Number of deltas read in words. -1 if end of file found.
+static int tran_file_read_track_map(int fd, uint16_t deltas[], int max_deltas,
+    int *cyl, int *head)
+{
+   uint8_t *track;
+   uint32_t value;
+   int32_t num_bytes;
+   uint32_t crc;
+   off_t pos;
+   int rc;
+
+   pos = lseek(fd, 0, SEEK_CUR);
+   if (pos < 0 || pos + TRAN_TRACK_HEADER_SIZE + 4 > read_file.size) {
+      msg(MSG_FATAL, "Failed to read track header from transition file\n");
+      exit(1);
+   }
+   track = &read_file.data[pos];
+   memcpy(&value, &track[0], sizeof(value));
+   *cyl = value;
+   memcpy(&value, &track[4], sizeof(value));
+   *head = value;
+   memcpy(&num_bytes, &track[8], sizeof(num_bytes));
+
+   rc = 0;
+   if (*cyl == -1 && *head == -1) {
+      num_bytes = 0;
+      rc = -1;
+   } else {
+      if (num_bytes < 0 || pos + TRAN_TRACK_HEADER_SIZE + num_bytes + 4 >
+            read_file.size) {
+         msg(MSG_FATAL, "Failed to read track data from transition file %d\n",
+            num_bytes);
+         exit(1);
+      }
+   }
+   crc = crc64(track, TRAN_TRACK_HEADER_SIZE + num_bytes, &trans_initial_poly);
+   memcpy(&value, &track[TRAN_TRACK_HEADER_SIZE + num_bytes], sizeof(value));
+   // CRC is calculated big endian so final CRC won't be zero so we compare
+   if (value != crc) {
+      msg(MSG_FATAL, "Transition file track CRC error %x %x\n", crc, value);
+      exit(1);
+   }
+   if (rc != -1) {
+      rc = tran_file_unpack_track(&track[TRAN_TRACK_HEADER_SIZE], num_bytes,
+         read_file.compressed, deltas, max_deltas);
+   }
+   lseek(fd, pos + TRAN_TRACK_HEADER_SIZE + num_bytes + 4, SEEK_SET);
+   return rc;
+}
+
 // Read transition track and return as deltas
 //
 // fd: File descriptor to read from
@@ -899,16 +1763,18 @@ int tran_file_read_track_deltas(int fd, uint16_t deltas[], int max_deltas,
    CRC_INFO poly = trans_initial_poly;
    int32_t num_bytes;
    int rc;
-   int deltas_ndx = 0;
-   int i;
    uint32_t crc;
 
+   if (fd == read_file.fd && read_file.data != NULL) {
+      return tran_file_read_track_map(fd, deltas, max_deltas, cyl, head);
+   }
    tran_file_read(fd, &value, sizeof(value), &poly);
    *cyl = value;
    tran_file_read(fd, &value, sizeof(value), &poly);
    *head = value;
    tran_file_read(fd, &num_bytes, sizeof(num_bytes), &poly);
 
+   rc = 0;
    if (*cyl == -1 && *head == -1) {
       rc = -1;
    } else {
@@ -918,26 +1784,6 @@ int tran_file_read_track_deltas(int fd, uint16_t deltas[], int max_deltas,
          exit(1);
       }
       tran_file_read(fd, deltas_in, num_bytes, &poly);
-      i = 0;
-      while (i < num_bytes) {
-         if (deltas_in[i] == 255) {
-            value = deltas_in[i+1] | ((uint32_t) deltas_in[i+2] << 8) | 
-               ((uint32_t) deltas_in[i+3] << 16);
-            i += 4;
-         } else if (deltas_in[i] == 254) {
-            value = deltas_in[i+1] | ((uint32_t) deltas_in[i+2] << 8);
-            i += 3;
-         } else {
-            value = deltas_in[i++];
-         }
-         if (deltas_ndx >= max_deltas) {
-            msg(MSG_FATAL, "Transition file deltas overflow %d %d\n", 
-                deltas_ndx, max_deltas);
-            exit(1);
-         }
-         deltas[deltas_ndx++] = value;
-      }
-      rc = deltas_ndx;
    }
    crc = poly.init_value;
    tran_file_read(fd, &value, sizeof(value), &poly);
@@ -946,6 +1792,10 @@ int tran_file_read_track_deltas(int fd, uint16_t deltas[], int max_deltas,
       msg(MSG_FATAL, "Transition file track CRC error %x %x\n", crc, value);
       exit(1);
    }
+   if (rc != -1) {
+      rc = tran_file_unpack_track(deltas_in, num_bytes,
+         fd == read_file.fd && read_file.compressed, deltas, max_deltas);
+   }
    return rc;
 }
 
@@ -960,6 +1810,7 @@ void tran_file_write_track_deltas(int fd, uint16_t *deltas, int num_deltas, int
 {
    uint8_t deltas_out[MAX_BYTE_DELTAS];
    int deltas_ndx = 0;
+   int num_bytes;
    uint32_t value;
    int i;
    CRC_INFO poly = trans_initial_poly;
@@ -967,6 +1818,23 @@ void tran_file_write_track_deltas(int fd, uint16_t *deltas, int num_deltas, int
    if (fd == -1) {
       return;
    }
+   // The end of file marker offset is the last index entry
+   if (fd == write_file.fd) {
+      if (write_file.num_entries >= write_file.entries_size) {
+         write_file.entries_size = write_file.entries_size * 2 + 1024;
+         write_file.entries = realloc(write_file.entries,
+            sizeof(*write_file.entries) * write_file.entries_size);
+         if (write_file.entries == NULL) {
+            msg(MSG_FATAL, "Malloc failed transition file index\n");
+            exit(1);
+         }
+      }
+      write_file.entries[write_file.num_entries].cyl = cyl;
+      write_file.entries[write_file.num_entries].head = head;
+      write_file.entries[write_file.num_entries].offset = 
+         lseek(fd, 0, SEEK_CUR);
+      write_file.num_entries++;
+   }
    value = cyl;
    tran_file_write(fd, &value, sizeof(value), &poly);
    value = head;
@@ -1009,10 +1877,26 @@ if (deltas[i] == 0) {
             deltas_out[deltas_ndx++] = deltas[i];
          }
       }
-      // Write length and data
-      value = deltas_ndx;
-      tran_file_write(fd, &value, sizeof(value), &poly);
-      tran_file_write(fd, deltas_out, deltas_ndx, &poly);
+      if (fd == write_file.fd && write_file.compress) {
+         // Uncompressed length is the start of the track data
+         value = deltas_ndx;
+         memcpy(write_file.compress_buf, &value, sizeof(value));
+         num_bytes = sizeof(value) + huffman_encode(deltas_out, deltas_ndx,
+            &write_file.compress_buf[sizeof(value)]);
+         // Readers use a MAX_BYTE_DELTAS buffer for the stored data
+         if (num_bytes > MAX_BYTE_DELTAS) {
+            msg(MSG_FATAL, "Too many compressed transitions %d\n", num_bytes);
+            exit(1);
+         }
+         value = num_bytes;
+         tran_file_write(fd, &value, sizeof(value), &poly);
+         tran_file_write(fd, write_file.compress_buf, num_bytes, &poly);
+      } else {
+         // Write length and data
+         value = deltas_ndx;
+         tran_file_write(fd, &value, sizeof(value), &poly);
+         tran_file_write(fd, deltas_out, deltas_ndx, &poly);
+      }
    }
    value = poly.init_value;
    tran_file_write(fd, &value, sizeof(value), &poly);
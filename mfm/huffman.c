@@ -0,0 +1,291 @@
+// Huffman coding of bytes for compressing transition file track data.
+//
+// Call huffman_encode to compress bytes
+// Call huffman_decode to decompress bytes
+// Call huffman_max_encoded_size to get the output buffer size needed
+//
+// The encoded data is the code length of each byte value followed by the
+// canonical Huffman codes MSB first. The code lengths are stored as
+// 4 bit values, two per byte with the even byte value in the low 4 bits.
+// A length of 0 indicates the byte value isn't used. Code lengths are
+// limited to HUFFMAN_MAX_BITS so decoding can use a single table lookup.
+//
+// Transition data is mostly the delta times for 2, 3, and 4 bit cells so
+// the bytes have about 3.6 bits of information. Huffman coding gets most
+// of the possible compression and decodes quickly.
+//
+// 10/17/26 DJG Initial version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "huffman.h"
+
+// Number of byte values
+#define NUM_SYMBOLS 256
+// Size of code length table in encoded data
+#define LENGTHS_SIZE (NUM_SYMBOLS / 2)
+
+// Find the Huffman code length for each symbol. If any code is longer than
+// HUFFMAN_MAX_BITS the counts are reduced to flatten the tree and the
+// lengths found again.
+//
+// counts: Number of times each symbol is used
+// lengths: Returns code length for each symbol. 0 if not used
+static void find_lengths(uint32_t counts[], uint8_t lengths[])
+{
+   // Nodes 0 to NUM_SYMBOLS-1 are the symbols, the rest are internal
+   uint32_t weight[NUM_SYMBOLS * 2];
+   int parent[NUM_SYMBOLS * 2];
+   int active[NUM_SYMBOLS * 2];
+   uint32_t scaled[NUM_SYMBOLS];
+   int num_nodes, num_used;
+   int i, n, min1, min2, len, max_len;
+   int shift = 0;
+
+   do {
+      num_nodes = NUM_SYMBOLS;
+      num_used = 0;
+      for (i = 0; i < NUM_SYMBOLS; i++) {
+         scaled[i] = counts[i] >> shift;
+         // Don't let reducing the counts drop a used symbol
+         if (counts[i] != 0 && scaled[i] == 0) {
+            scaled[i] = 1;
+         }
+         weight[i] = scaled[i];
+         parent[i] = -1;
+         active[i] = scaled[i] != 0;
+         num_used += active[i];
+         lengths[i] = 0;
+      }
+      if (num_used == 1) {
+         // One symbol still needs a one bit code
+         for (i = 0; i < NUM_SYMBOLS; i++) {
+            lengths[i] = active[i];
+         }
+         return;
+      }
+      // Combine the two lowest weight nodes until one is left
+      for (n = 1; n < num_used; n++) {
+         min1 = min2 = -1;
+         for (i = 0; i < num_nodes; i++) {
+            if (!active[i]) {
+               continue;
+            }
+            if (min1 == -1 || weight[i] < weight[min1]) {
+               min2 = min1;
+               min1 = i;
+            } else if (min2 == -1 || weight[i] < weight[min2]) {
+               min2 = i;
+            }
+         }
+         weight[num_nodes] = weight[min1] + weight[min2];
+         parent[num_nodes] = -1;
+         active[num_nodes] = 1;
+         parent[min1] = parent[min2] = num_nodes;
+         active[min1] = active[min2] = 0;
+         num_nodes++;
+      }
+      max_len = 0;
+      for (i = 0; i < NUM_SYMBOLS; i++) {
+         if (scaled[i] != 0) {
+            for (len = 0, n = i; parent[n] != -1; n = parent[n]) {
+               len++;
+            }
+            lengths[i] = len;
+            if (len > max_len) {
+               max_len = len;
+            }
+         }
+      }
+      shift++;
+   } while (max_len > HUFFMAN_MAX_BITS);
+}
+
+// Assign canonical codes from the code lengths. Codes of the same length
+// are assigned in symbol order.
+//
+// lengths: Code length of each symbol
+// codes: Returns code for each symbol
+static void assign_codes(uint8_t lengths[], uint32_t codes[])
+{
+   int len_count[HUFFMAN_MAX_BITS + 1];
+   uint32_t next_code[HUFFMAN_MAX_BITS + 1];
+   uint32_t code = 0;
+   int i;
+
+   memset(len_count, 0, sizeof(len_count));
+   for (i = 0; i < NUM_SYMBOLS; i++) {
+      len_count[lengths[i]]++;
+   }
+   len_count[0] = 0;
+   for (i = 1; i <= HUFFMAN_MAX_BITS; i++) {
+      code = (code + len_count[i - 1]) << 1;
+      next_code[i] = code;
+   }
+   for (i = 0; i < NUM_SYMBOLS; i++) {
+      if (lengths[i] != 0) {
+         codes[i] = next_code[lengths[i]]++;
+      }
+   }
+}
+
+// Return the largest size huffman_encode can return.
+//
+// num_bytes: Number of bytes to encode
+// return: Size in bytes
+int huffman_max_encoded_size(int num_bytes)
+{
+   return LENGTHS_SIZE + (num_bytes * HUFFMAN_MAX_BITS + 7) / 8 + 8;
+}
+
+// Compress bytes with Huffman coding.
+//
+// in: Bytes to compress
+// num_in: Number of bytes to compress
+// out: Compressed bytes. Must be huffman_max_encoded_size(num_in) bytes
+// return: Number of bytes in out
+int huffman_encode(uint8_t in[], int num_in, uint8_t out[])
+{
+   uint32_t counts[NUM_SYMBOLS];
+   uint8_t lengths[NUM_SYMBOLS];
+   uint32_t codes[NUM_SYMBOLS];
+   uint64_t bit_buf = 0;
+   int bit_cnt = 0;
+   int out_ndx;
+   int i;
+
+   memset(counts, 0, sizeof(counts));
+   for (i = 0; i < num_in; i++) {
+      counts[in[i]]++;
+   }
+   find_lengths(counts, lengths);
+   assign_codes(lengths, codes);
+   for (i = 0; i < LENGTHS_SIZE; i++) {
+      out[i] = lengths[i * 2] | (lengths[i * 2 + 1] << 4);
+   }
+   out_ndx = LENGTHS_SIZE;
+   for (i = 0; i < num_in; i++) {
+      bit_buf = (bit_buf << lengths[in[i]]) | codes[in[i]];
+      bit_cnt += lengths[in[i]];
+      while (bit_cnt >= 8) {
+         bit_cnt -= 8;
+         out[out_ndx++] = bit_buf >> bit_cnt;
+      }
+   }
+   if (bit_cnt > 0) {
+      out[out_ndx++] = bit_buf << (8 - bit_cnt);
+   }
+   return out_ndx;
+}
+
+// Decompress bytes compressed with huffman_encode. The codes are decoded
+// with a table indexed by the next HUFFMAN_MAX_BITS bits. The bit buffer
+// has the next bit in bit 63. Each refill of the buffer from a 64 bit read
+// leaves at least 56 bits so 4 codes can be decoded between refills.
+//
+// in: Compressed bytes
+// num_in: Number of compressed bytes
+// out: Decompressed bytes
+// num_out: Number of bytes to decompress
+// return: 0 if OK, -1 if compressed data is not valid
+int huffman_decode(uint8_t in[], int num_in, uint8_t out[], int num_out)
+{
+   uint8_t lengths[NUM_SYMBOLS];
+   uint32_t codes[NUM_SYMBOLS];
+   // Symbol in low 8 bits and code length in upper bits. 0 for not valid
+   uint16_t table[1 << HUFFMAN_MAX_BITS];
+   uint64_t bit_buf = 0;
+   int bit_cnt = 0;
+   int in_ndx;
+   int i, j, k, entry;
+   uint64_t v;
+
+   if (num_in < LENGTHS_SIZE) {
+      return -1;
+   }
+   for (i = 0; i < LENGTHS_SIZE; i++) {
+      lengths[i * 2] = in[i] & 0xf;
+      lengths[i * 2 + 1] = in[i] >> 4;
+      if (lengths[i * 2] > HUFFMAN_MAX_BITS ||
+            lengths[i * 2 + 1] > HUFFMAN_MAX_BITS) {
+         return -1;
+      }
+   }
+   assign_codes(lengths, codes);
+   memset(table, 0, sizeof(table));
+   for (i = 0; i < NUM_SYMBOLS; i++) {
+      if (lengths[i] != 0) {
+         int shift = HUFFMAN_MAX_BITS - lengths[i];
+         int first = codes[i] << shift;
+
+         // Lengths that don't form a valid code can overflow the table
+         if (first + (1 << shift) > (1 << HUFFMAN_MAX_BITS)) {
+            return -1;
+         }
+         for (j = 0; j < (1 << shift); j++) {
+            table[first + j] = i | (lengths[i] << 8);
+         }
+      }
+   }
+   in_ndx = LENGTHS_SIZE;
+   i = 0;
+   // Bits past bit_cnt in the buffer are the following input bits so
+   // or'ing in the next read doesn't change them.
+   while (i + 4 <= num_out && in_ndx + 8 <= num_in) {
+      for (v = 0, j = 0; j < 8; j++) {
+         v = (v << 8) | in[in_ndx + j];
+      }
+      bit_buf |= v >> bit_cnt;
+      in_ndx += (63 - bit_cnt) >> 3;
+      bit_cnt |= 56;
+      for (k = 0; k < 4; k++) {
+         entry = table[bit_buf >> (64 - HUFFMAN_MAX_BITS)];
+         if (entry == 0) {
+            return -1;
+         }
+         out[i++] = entry;
+         bit_buf <<= entry >> 8;
+         bit_cnt -= entry >> 8;
+      }
+   }
+   // Near the end of the data refill a byte at a time. Past the end zeros
+   // are used and the number of bits used is checked below.
+   for (; i < num_out; i++) {
+      while (bit_cnt <= 56) {
+         bit_buf |= (uint64_t) (in_ndx < num_in ? in[in_ndx] : 0) <<
+            (56 - bit_cnt);
+         bit_cnt += 8;
+         in_ndx++;
+      }
+      entry = table[bit_buf >> (64 - HUFFMAN_MAX_BITS)];
+      if (entry == 0) {
+         return -1;
+      }
+      out[i] = entry;
+      bit_buf <<= entry >> 8;
+      bit_cnt -= entry >> 8;
+   }
+   // Check we didn't use bits past the end of the data
+   if ((int64_t) in_ndx * 8 - bit_cnt > (int64_t) num_in * 8) {
+      return -1;
+   }
+   return 0;
+}
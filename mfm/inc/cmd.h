@@ -17,7 +17,12 @@
 // The command status. All commands other than CMD_READ_TRACK
 // return their status when done. CMD_READ_TRACK returns
 // CMD_STATUS_READ_STARTED when the read has started and CMD_STATUS_OK
-// or an error status when the read is finished.
+// or an error status when the read is finished. If PRU0_NEXT_HEAD is set
+// when a read finishes the PRU selects that head and reads it without
+// waiting for another index pulse. PRU0_READ_NUM is incremented and the
+// previous read's write pointer and status are put in PRU0_PREV_WRITE_PTR
+// and PRU0_PREV_STATUS. Reads alternate between the halves of the DDR
+// memory. The command status is only set when the last read finishes.
 #define CMD_STATUS_WAIT_READY 0x100
 #define CMD_STATUS_OK       0x200
 #define CMD_STATUS_READY_ERR 0x300
@@ -39,6 +44,13 @@
                                     // capturing transitions
 #define PRU_DATARAM_ADDR  0x1c      // Physical address of the PRU memory
 #define PRU0_BOARD_REVISION 0x20    // 0 = A etc
+#define PRU0_NEXT_HEAD    0x24      // Head to read when read finishes
+#define PRU0_READ_NUM     0x28      // Number of next head reads started
+#define PRU0_PREV_WRITE_PTR 0x2c    // Delta write pointer of previous read
+#define PRU0_PREV_STATUS  0x30      // Status of previous read
+
+// Bit set in PRU0_NEXT_HEAD with the head number to request a read
+#define NEXT_HEAD_VALID_BIT 8
 
 #define REVB_DETECT_PIN  46 // GPIO 1_14
 #define REVC_DETECT_PIN  61 // GPIO 1_29
@@ -60,6 +72,11 @@
 #define GPIO1_WRITE_FAULT_BIT 19
 #define R31_READY_BIT         4
 #define R31_INDEX_BIT         5
+// Head select lines are GPIO0 bits starting at this bit
+// Rev A
+#define GPIO0_HEAD_SEL_SHIFT_REVA 2
+// Rev B,C
+#define GPIO0_HEAD_SEL_SHIFT  8
 
 // Address in PRU code for stopping current operation
 #define RESTART_ADDR 0x400
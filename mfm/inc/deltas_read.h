@@ -9,6 +9,9 @@
 #define READ_DELTAS_H_
 
 void deltas_start_read(int cyl, int head);
+void deltas_start_next_read(int cyl, int head);
+uint16_t *deltas_use_next_read(void);
+void deltas_cancel_next_read(void);
 void deltas_start_thread(DRIVE_PARAMS *drive_params);
 void deltas_stop_thread();
 void *deltas_setup(int ddr_mem_size);
@@ -1,6 +1,12 @@
 /*
  * emu_tran_file.h
  *
+ * 10/17/26 DJG Added emu_tran_read, emu_tran_seek, emu_tran_close, and
+ *    emu_tran_compress_ext
+ * 10/17/26 DJG Added emu_file_rewrite_track_range
+ * 10/17/26 DJG Added emu_tran_open_input
+ * 10/17/26 DJG Added compress option to tran_file_write_header
+ * 10/17/26 DJG Added track offsets to TRAN_FILE_INFO
  * 09/12/23 JST Changes to support 5.10 kernel and --sync option
  * 11/09/14 DJG Added new function prototypes for emulator file
  * 	buffering and structure changes for buffering and other new
@@ -12,6 +18,8 @@
 #ifndef EMU_TRAN_FILE_H_
 #define EMU_TRAN_FILE_H_
 
+#include <sys/types.h>
+
 // Information on disk image file for emulator
 typedef struct emu_file_info {
       // File version information
@@ -51,6 +59,12 @@ typedef struct tran_file_info {
    char *decode_cmdline;
       // And description of file
    char *note;
+      // Offset of first read of each track indexed by
+      // cyl * num_head + head, -1 if not in file. NULL until read from
+      // file index or built by tran_file_seek_track
+   int64_t *track_offset;
+      // Offset of end of file marker
+   int64_t eof_offset;
 } TRAN_FILE_INFO;
 
 int emu_file_write_header(char *fn, int num_cyl, int num_head, char *cmdline,
@@ -72,9 +86,11 @@ void emu_file_write_cyl(int fd, EMU_FILE_INFO *emu_file_info, int cyl,
       void *buf, int buf_size);
 void emu_file_rewrite_track(int fd, EMU_FILE_INFO *emu_file_info,
       int cyl, int head, void *buf, int buf_size);
+void emu_file_rewrite_track_range(int fd, EMU_FILE_INFO *emu_file_info,
+      int cyl, int head, void *buf, int start, int len);
 
 int tran_file_write_header(char *fn, int num_cyl, int num_head, char *cmdline,
-      char *note, uint32_t start_time_ns);
+      char *note, uint32_t start_time_ns, int compress);
 int tran_file_read_header(char *fn, TRAN_FILE_INFO *tran_file_info);
 int tran_file_seek_track(int fd, int seek_cyl, int seek_head, TRAN_FILE_INFO *tran_file_info);
 int tran_file_read_track_deltas(int fd,uint16_t deltas[], int max_deltas, int *cyl,
@@ -82,6 +98,12 @@ int tran_file_read_track_deltas(int fd,uint16_t deltas[], int max_deltas, int *c
 void tran_file_write_track_deltas(int fd,uint16_t *deltas, int num_words, int cyl, int head);
 void tran_file_close(int fd, int write_eof);
 
+int emu_tran_open_input(char *fn, int check_header);
+ssize_t emu_tran_read(int fd, void *bytes, size_t len);
+off_t emu_tran_seek(int fd, off_t offset, int whence);
+void emu_tran_close(int fd);
+char *emu_tran_compress_ext(char *fn);
+
 float emu_rps(int sample_rate_hz);
 
 #endif /* EMU_TRAN_FILE_H_ */
@@ -0,0 +1,13 @@
+// Huffman coding of bytes used for compressed transition file track data.
+//
+// 10/17/26 DJG Initial version
+#ifndef HUFFMAN_H_
+#define HUFFMAN_H_
+
+// Maximum code length. Decode table has 2^HUFFMAN_MAX_BITS entries
+#define HUFFMAN_MAX_BITS 12
+
+int huffman_max_encoded_size(int num_bytes);
+int huffman_encode(uint8_t in[], int num_in, uint8_t out[]);
+int huffman_decode(uint8_t in[], int num_in, uint8_t out[], int num_out);
+#endif /* HUFFMAN_H_ */
@@ -1,6 +1,22 @@
 #ifndef MFM_DECODER_H_
 #define MFM_DECODER_H_
 //
+// 10/17/26 DJG Added pipeline_reads
+// 10/17/26 DJG Added per job decode context and previous track fixes to
+//    TRACK_STATE so --jobs output matches decoding in order
+// 10/17/26 DJG Added alt_pll
+// 10/17/26 DJG Added fuse_reads and FUSE_STATE
+// 10/17/26 DJG Added defer_retries and mfm_track_state_discard_track
+// 10/17/26 DJG Added compress_transitions
+// 10/17/26 DJG Added mfm_decode_track_bits and mfm_decode_bits_ok
+// 10/17/26 DJG Added mfm_decode_raw_bytes
+// 10/17/26 DJG Added mfm_save_raw_steps
+// 10/17/26 DJG Added PLL_TRACK to TRACK_STATE
+// 10/17/26 DJG Added float_pll
+// 10/17/26 DJG Added CRC_CAPTURE for faster analyze
+// 10/17/26 DJG Moved decoder state into DECODE_CONTEXT and TRACK_STATE
+//    referenced from DRIVE_PARAMS so decoder is reentrant.
+// 10/17/26 DJG Added jobs option and TRACK_STATE for parallel decoding
 // 05/15/26 DJG Added SHUGART_CD9963 & HP9133XV controller
 // 09/10/25 DJG Fixed ext2emu marking bad sectors when interleave used
 // 06/12/25 DJG/DV Add CONTROLLER_MICROBEE_WD1002_05
@@ -177,6 +193,11 @@ struct alt_struct {
    int length;
 };
 
+// Decoder state. Defined below
+typedef struct track_state TRACK_STATE;
+typedef struct decode_context DECODE_CONTEXT;
+typedef struct pll_track PLL_TRACK;
+
 // This is the main structure defining the drive characteristics
 typedef struct {
    // The number of cylinders, heads, and sectors per track
@@ -376,6 +397,29 @@ typedef struct {
    int xebec_skew;
    // Value set on command line
    int xebec_skew_cmdline;
+   // Number of threads to decode tracks with. Only used by mfm_util
+   int jobs;
+   // Non zero to use original floating point PLL
+   int float_pll;
+   // Non zero to compress transition file track data
+   int compress_transitions;
+   // Non zero to retry tracks needing a seek after the rest of the disk is
+   // read. Only used by mfm_read when just an extract file is written
+   int defer_retries;
+   // Non zero to combine the data of sectors with errors from multiple
+   // reads of the track
+   int fuse_reads;
+   // Non zero to decode tracks with errors again with alternate PLL
+   // settings. Only used by mfm_util
+   int alt_pll;
+   // Non zero to read the next head at the index pulse that ends the
+   // current track. Only used by mfm_read
+   int pipeline_reads;
+   // Decoder state for the entire disk. Allocated by mfm_decode_setup
+   DECODE_CONTEXT *decode_ctx;
+   // Decoder state for the track being decoded. Allocated by 
+   // mfm_decode_setup. Each thread decoding tracks in parallel needs its own
+   TRACK_STATE *track_state;
    // Extra data needed. Data in this structure is big endian
    union {
       struct s_CD9963_sect0 {
@@ -4204,9 +4248,166 @@ typedef struct {
    int ignore; // Non zero ignore this sector. Its a non used spare sector
 } SECTOR_STATUS;
 
+// Bytes checked by mfm_crc_bytes saved so other CRC parameters can be
+// checked without decoding the track again. See mfm_crc_capture_set.
+typedef struct {
+   // Each entry is an int length followed by the bytes
+   uint8_t *buf;
+   int len;
+   int size;
+   // Non zero if bytes other than a header were checked
+   int non_header;
+} CRC_CAPTURE;
+
+// Maximum number of reads of a sector saved for --fuse_reads
+#define FUSE_MAX_READS 15
+// Data of sectors with errors from the reads of a track. Used to recover
+// sectors which were never read without errors by combining multiple reads
+typedef struct {
+   // Track reads are from
+   int cyl, head;
+   // Length of saved data and CRC
+   int len[MAX_SECTORS];
+   // Number of reads saved and next entry to write
+   int num_reads[MAX_SECTORS];
+   int next_read[MAX_SECTORS];
+   // Saved data. FUSE_MAX_READS entries of len for each sector. Allocated
+   // when first needed
+   uint8_t *reads[MAX_SECTORS];
+} FUSE_STATE;
+
+// Per track decoding state. The emulation file track words, header and
+// data mark locations, the sector status of the last track decoded, and
+// the information the *_process_data routines save between the header and
+// data of a sector are kept here so different tracks can be decoded in
+// parallel by different threads.
+struct track_state {
+   // Hold for sector status and cylinder and head it was for. We save the
+   // data so when the cylinder and head changes we can print the final
+   // status. The same track may be reread.
+   SECTOR_STATUS last_sector_list[MAX_SECTORS];
+   int last_cyl;
+   int last_head;
+   // Best_track is the best track read as one read. Best_fixed_track is
+   // the best track by putting together multiple reads
+   uint32_t best_track_words[MAX_TRACK_WORDS];
+   int best_track_weight;
+   int best_track_num_words;
+   uint32_t best_fixed_track_words[MAX_TRACK_WORDS];
+   int best_fixed_track_weight;
+   int best_fixed_track_num_words;
+   uint32_t current_track_words[MAX_TRACK_WORDS];
+   int current_track_words_ndx;
+   int last_sector_start_word;
+   int header_track_word_ndx;
+   int data_bit;
+   int data_word_ndx;
+   // For examining track timing
+   int header_track_tot_bit_count;;
+   int data_tot_bit_count;
+   // Temporary storage for last header found. Only one stored at a time
+   struct {
+      int bit_count;
+      int bit_offset;
+      int tot_bit_count;
+      int word_ndx;
+   } mark_data;
+   // Indexed by from sector. Value is to sector
+   int remap_list[MAX_SECTORS];
+   // If non zero writes to the extract and metadata files are saved in
+   // write_log instead of being performed. mfm_track_state_done performs
+   // them.
+   int log_writes;
+   uint8_t *write_log;
+   int write_log_len;
+   int write_log_size;
+   // If not NULL mfm_crc_bytes saves the bytes here and fails the check
+   CRC_CAPTURE *crc_capture;
+   // Bit cell counts from the PLL for the track. See mfm_pll_track_start
+   PLL_TRACK *pll_track;
+   // Sector data with errors for --fuse_reads. Allocated when first needed
+   FUSE_STATE *fuse;
+   // Copy of the drive_params decode context used when decoding a track
+   // in a different thread. Allocated by mfm_track_state_setup
+   DECODE_CONTEXT *decode_ctx;
+   // Track decoded before this one when decoding in a different thread.
+   // Decoding the first read can update the previous track's
+   // best_fixed_track_words. The words are saved in prev_fixed_words
+   // with prev_fixed_valid marking the ones set and copied to the
+   // previous track by mfm_track_state_start_track.
+   int prev_cyl;
+   int prev_head;
+   uint32_t *prev_fixed_words;
+   uint8_t *prev_fixed_valid;
+   int prev_fixed_count;
+
+   // Saved by the *_process_data routines from the header for processing
+   // the data. Not all decoders use all fields.
+   int sector_size;
+   int bad_block;
+   SECTOR_STATUS sector_status;
+   int alt_assigned;
+   int is_alternate;
+   int alt_assigned_handled;
+   // Used by xebec_process_data for printing and checking sector order.
+   // last_cyl_print is -2 when decoding in a different thread since the
+   // previous track isn't known. The first message printed is then saved
+   // in print_capture at print_capture_pos for first_cyl_print and
+   // first_head_print so mfm_track_state_start_track can remove it if the
+   // previous track printed the same message.
+   int last_head_print;
+   int last_cyl_print;
+   int first_head_print;
+   int first_cyl_print;
+   struct msg_capture *print_capture;
+   int print_capture_pos;
+   int last_sector;
+   int first_sector;
+};
+
+// Decoding state for the entire disk. Formats that use the fields that
+// carry information between tracks can't be decoded in parallel. See
+// mfm_track_state_parallel_ok.
+struct decode_context {
+   // These are only allocated and used with --ignore_seek_errors.
+   // sector_good shows what sectors were good/bad
+   // for the entire disk. It also makes sure a good sector won't be overwritten with a
+   // bad sector. A disk I was reading you saw multiple cylinders when
+   // reading a track so track at a time error information wasn't accurate.
+   //    Lower value better data.
+   //    sector_good & ECC MASK not zero number of bits corrected. 
+   uint8_t (*sector_good)[MAX_HEAD][MAX_SECTORS];
+   // CRC of sector data. This detects if good or ECC corrected data differs
+   // between reads
+   uint64_t (*sector_crc)[MAX_HEAD][MAX_SECTORS];
+   // Cylinders found in headers for --ignore_seek_errors
+   int cyl_found[4096];
+   // Last LBA address processed for detecting bad sectors
+   int last_lba_addr;
+
+   // Adaptec spare sector handling
+   int first_spare_bad_sector;
+   // Shugart CD9963 zone sector skipping
+   int sectors_skipped_zone;
+   int sectors_skipped_track;
+   int last_zone;
+   // Souyz Neon sector group of last sector
+   int last_sector_group;
+   // Dilog DQ614 header byte 2 of last sector
+   int last_byte2;
+   // IMS A820 time of last track read
+   int total_track_time;
+   // ND100 last alternate remap entry found
+   int last_remap;
+};
+
 SECTOR_DECODE_STATUS mfm_decode_track(DRIVE_PARAMS *drive_parms, int cyl, 
    int head, uint16_t deltas[], int *seek_difference, 
    SECTOR_STATUS bad_sector_list[]);
+SECTOR_DECODE_STATUS mfm_decode_track_bits(DRIVE_PARAMS *drive_params,
+   int cyl, int head, uint32_t words[], int num_words, int sample_rate_hz,
+   int *seek_difference, SECTOR_STATUS sector_status_list[]);
+int mfm_decode_bits_ok(DRIVE_PARAMS *drive_params, int sample_rate_hz);
 SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_parms, int cyl, 
    int head, uint16_t deltas[], int *seek_difference, 
    SECTOR_STATUS bad_sector_list[]);
@@ -4300,14 +4501,21 @@ SECTOR_DECODE_STATUS perq_process_data(STATE_TYPE *state, uint8_t bytes[],
 
 int mfm_save_raw_word(DRIVE_PARAMS *drive_params, int all_raw_bits_count, 
    int int_bit_pos, int raw_word);
+int mfm_save_raw_steps(DRIVE_PARAMS *drive_params, PLL_TRACK *track,
+   int all_raw_bits_count, int start_step, int end_step, int start_bit);
+void mfm_decode_raw_bytes(PLL_TRACK *track, int start_bit, uint8_t bytes[],
+   int num_bytes);
 // Use data stored by mfm_mark_location instead of data passed in to
 //   mfm_mark_header_location or mfm_mark_data_location
 #define MARK_STORED -999
-void mfm_mark_header_location(int bit_count, int bit_offset, int tot_bit_count);
-void mfm_mark_data_location(int bit_count, int bit_offset, int tot_bit_count);
-void mfm_mark_location(int bit_count, int bit_offset, int tot_bit_count);
+void mfm_mark_header_location(DRIVE_PARAMS *drive_params, int bit_count,
+   int bit_offset, int tot_bit_count);
+void mfm_mark_data_location(DRIVE_PARAMS *drive_params, int bit_count,
+   int bit_offset, int tot_bit_count);
+void mfm_mark_location(DRIVE_PARAMS *drive_params, int bit_count,
+   int bit_offset, int tot_bit_count);
 void mfm_mark_end_data(int bit_count, DRIVE_PARAMS *drive_params, int cyl, int head);
-int mfm_get_data_bit_count();
+int mfm_get_data_bit_count(DRIVE_PARAMS *drive_params);
 
 void mfm_handle_alt_track_ch(DRIVE_PARAMS *drive_params, unsigned int bad_cyl, 
       unsigned int bad_head, unsigned int good_cyl, unsigned int good_head);
@@ -4317,10 +4525,29 @@ int mfm_fix_head(DRIVE_PARAMS *drive_params, int exp_head, int head);
 
 void mfm_end_track(DRIVE_PARAMS *drive_params,
    unsigned int cyl, unsigned int head);
-void mfm_clear_remap_list(void);
-void mfm_remap_track_sectors(unsigned int from_sector, unsigned int to_sector);
+void mfm_clear_remap_list(DRIVE_PARAMS *drive_params);
+void mfm_remap_track_sectors(DRIVE_PARAMS *drive_params,
+   unsigned int from_sector, unsigned int to_sector);
 void mfm_remap_track(DRIVE_PARAMS *drive_params, 
    unsigned int cyl, unsigned int head);
 
+int mfm_track_state_parallel_ok(DRIVE_PARAMS *drive_params);
+TRACK_STATE *mfm_track_state_alloc(void);
+void mfm_track_state_free(TRACK_STATE *state);
+void mfm_track_state_setup(DRIVE_PARAMS *drive_params,
+   DRIVE_PARAMS *job_drive_params, TRACK_STATE *state, int prev_cyl,
+   int prev_head);
+void mfm_track_state_start_track(DRIVE_PARAMS *drive_params,
+   DRIVE_PARAMS *job_drive_params);
+void mfm_track_state_end_track(DRIVE_PARAMS *drive_params);
+void mfm_track_state_discard_track(DRIVE_PARAMS *drive_params);
+TRACK_STATE *mfm_track_state_done(DRIVE_PARAMS *drive_params,
+   DRIVE_PARAMS *job_drive_params);
+void mfm_decode_free(DRIVE_PARAMS *drive_params);
+
+void mfm_crc_capture_set(DRIVE_PARAMS *drive_params, CRC_CAPTURE *capture);
+int mfm_crc_capture_match(DRIVE_PARAMS *drive_params, CRC_CAPTURE *capture);
+void mfm_crc_capture_free(CRC_CAPTURE *capture);
+
 #undef DEF_EXTERN
 #endif /* MFM_DECODER_H_ */
@@ -0,0 +1,119 @@
+// PLL used by the decoders to convert delta transition times into number
+// of bit cells between transitions.
+//
+// 10/17/26 DJG Added alternate PLL settings
+// 10/17/26 DJG Added emulation file bits to PLL_TRACK
+// 10/17/26 DJG Added packed raw bits and pattern search to PLL_TRACK
+// 10/17/26 DJG Added PLL_TRACK to convert a track once for all decoders
+// 10/17/26 DJG Initial version. Moved from the decoders and added
+//    fixed point version
+#ifndef MFM_PLL_H_
+#define MFM_PLL_H_
+
+// Number of fraction bits in fixed point times
+#define PLL_FRAC_BITS 16
+
+// Number of bit cell counts mfm_pll_block returns at most. Decoders
+// use this size for their PLL_BITS array
+#define PLL_BLOCK 64
+
+// Number of PLL settings for mfm_pll_set_alt including the normal one
+#define MFM_PLL_NUM_ALT 7
+
+// One step of the PLL. Deltas larger than max_delta are split into
+// multiple steps.
+typedef struct {
+   // Number of bit cells since the last transition
+   uint16_t bits;
+   // 200 MHz clocks processed by this step
+   uint16_t delta;
+} PLL_BITS;
+
+typedef struct {
+   // Non zero to use the original floating point PLL
+   int use_float;
+   // Deltas larger than this are processed in multiple steps. 0 for no limit
+   int max_delta;
+   // Part of delta still to process
+   int remaining_delta;
+   // Floating point PLL. avg_bit_sep_time is the "VCO" frequency
+   // in 200 MHz clocks. Clock time is the clock edge time from the VCO.
+   float avg_bit_sep_time;
+   float nominal_bit_sep_time;
+   float clock_time;
+   float filter_state;
+   // Fixed point PLL. Times are 200 MHz clocks << PLL_FRAC_BITS
+   int64_t clock_time_fix;
+   int32_t avg_bit_sep_time_fix;
+   int32_t nominal_bit_sep_time_fix;
+   int64_t filter_state_fix;
+   // 2^48 / nominal_bit_sep_time_fix for estimating number of bits
+   uint64_t nominal_recip;
+   // Loop filter coefficients and decision window offset in fractions of
+   // a bit cell. See mfm_pll_set_alt. The fixed point coefficients are
+   // scaled by 2^30 and offset by 2^PLL_FRAC_BITS
+   float coef_a, coef_b;
+   float window_offset;
+   int64_t coef_a_fix, coef_b_fix;
+   int32_t window_offset_fix;
+} MFM_PLL;
+
+// Bit cell counts for a track. If the same deltas are decoded again with
+// the same PLL settings the counts are reused.
+struct pll_track {
+   // Bit cell count and time for each PLL step
+   PLL_BITS *steps;
+   int num_steps;
+   int steps_size;
+   // PLL state while the deltas are being converted
+   MFM_PLL pll;
+   // Deltas being converted, next to convert, number available and
+   // number available at the previous check
+   uint16_t *deltas;
+   int delta_ndx;
+   int num_deltas;
+   int last_deltas;
+   // Non zero when all the deltas for the track have been converted
+   int complete;
+   // The raw MFM bits for the steps packed MSB first. Bit position p,
+   // the sum of the step bits so far, is bit 31 - (p + 31) % 32 of
+   // word (p + 31) / 32 so words from 1 on match the emulation file
+   // words. Bits before p = 1 only have the bit for a first step of 0 bits.
+   uint32_t *raw_words;
+   int raw_words_size;
+   // Number of bits in raw_words
+   int num_raw_bits;
+   // Number of steps that were 0 bits. These steps don't add a bit to
+   // raw_words so the bit position doesn't identify the step.
+   int zero_bit_steps;
+   // Emulation file bits to make the steps from instead of deltas, number
+   // of words, and 200 MHz clocks per bit cell << 32
+   uint32_t *bit_words;
+   int bit_num_words;
+   uint64_t bit_clocks;
+   // PLL settings and hash of deltas the steps are for
+   float nominal_bit_sep_time;
+   int split_delta;
+   int use_float;
+   uint64_t deltas_hash;
+   // Alternate PLL setting to use and setting the steps are for
+   int alt;
+   int alt_used;
+};
+
+void mfm_pll_init(MFM_PLL *pll, float nominal_bit_sep_time, int split_delta,
+   int use_float);
+void mfm_pll_set_alt(MFM_PLL *pll, int alt);
+int mfm_pll_block(MFM_PLL *pll, uint16_t deltas[], int *ndx, int num_deltas,
+   PLL_BITS bits[]);
+PLL_TRACK *mfm_pll_track_start(DRIVE_PARAMS *drive_params, uint16_t deltas[],
+   float nominal_bit_sep_time, int split_delta);
+void mfm_pll_track_set_alt(DRIVE_PARAMS *drive_params, int alt);
+void mfm_pll_track_set_bits(DRIVE_PARAMS *drive_params, uint32_t words[],
+   int num_words, int sample_rate_hz);
+int mfm_pll_track_get_count(PLL_TRACK *track, int steps_processed);
+void mfm_pll_track_free(PLL_TRACK *track);
+int mfm_pll_track_find(PLL_TRACK *track, uint64_t pattern, int pattern_bits,
+   int start_bit, int end_bit);
+uint32_t mfm_pll_track_raw_word(PLL_TRACK *track, int bit_pos);
+#endif /* MFM_PLL_H_ */
@@ -3,6 +3,10 @@
  *
  *  Created on: Dec 20, 2013
  *      Author: djg
+ *  10/17/26 DJG Added msg_capture_clear
+ *  10/17/26 DJG Added msg_capture_get, msg_capture_pos, and
+ *     msg_capture_remove
+ *  10/17/26 DJG Added message capture functions
  *  11/09/14 DJG Added new function
  *  09/06/14 DJG Added extra class of messages
  */
@@ -28,4 +32,14 @@ uint32_t msg_set_err_mask(uint32_t mask);
 uint32_t msg_get_err_mask(void);
 void *msg_malloc(size_t size, char *msgstr);
 void msg_set_logfile(FILE *file, uint32_t mask);
+
+typedef struct msg_capture MSG_CAPTURE;
+MSG_CAPTURE *msg_capture_alloc(void);
+void msg_capture_free(MSG_CAPTURE *cap);
+void msg_capture_set(MSG_CAPTURE *cap);
+void msg_capture_replay(MSG_CAPTURE *cap);
+MSG_CAPTURE *msg_capture_get(void);
+int msg_capture_pos(MSG_CAPTURE *cap);
+void msg_capture_remove(MSG_CAPTURE *cap, int pos);
+void msg_capture_clear(MSG_CAPTURE *cap);
 #endif /* MSG_H_ */
@@ -0,0 +1,33 @@
+// Simulated PRU for running the programs on a Linux system without the
+// beaglebone PRU and disk interface board. Built with make SIM_PRU=1.
+//
+// 10/17/26 DJG Initial version
+#ifndef PRU_SIM_H_
+#define PRU_SIM_H_
+
+// Size of the simulated shared DDR memory in bytes
+#define PRU_SIM_DDR_SIZE (4*1024*1024)
+
+// Routine run in a thread to simulate the program loaded on a PRU.
+// pru is the PRU number
+typedef void (*PRU_SIM_PROGRAM)(int pru);
+
+// Provided by the simulated drive or host for the program. Returns NULL
+// if the PRU program file isn't simulated
+PRU_SIM_PROGRAM pru_sim_find_program(char *filename);
+
+void pru_sim_idle_program(int pru);
+int pru_sim_get_ddr(void **ddrmem, uint32_t *ddr_phys_addr);
+int pru_sim_stopping(int pru);
+void pru_sim_signal_event(unsigned int host_interrupt);
+pthread_t pru_sim_main_thread(void);
+uint64_t pru_sim_time_ns(void);
+void pru_sim_sleep_until_ns(uint64_t time_ns);
+void pru_sim_sleep_ns(uint64_t ns);
+double pru_sim_env(char *name, double default_value);
+
+// Drive control lines set by drive.c
+void pru_sim_drive_select(int drive);
+void pru_sim_drive_set_head(int head);
+int pru_sim_drive_at_track0(void);
+#endif /* PRU_SIM_H_ */
@@ -0,0 +1,13 @@
+// Replacement for the am335x_pru_package pruss_intc_mapping.h used when
+// building with the simulated PRU. The simulator doesn't use the
+// interrupt controller setup.
+//
+// 10/17/26 DJG Initial version
+#ifndef PRUSS_INTC_MAPPING_H
+#define PRUSS_INTC_MAPPING_H
+
+#define PRU0_ARM_INTERRUPT 19
+#define PRU1_ARM_INTERRUPT 20
+
+#define PRUSS_INTC_INITDATA { {0}, {{0, 0}}, {{0, 0}}, 0 }
+#endif
@@ -0,0 +1,57 @@
+// Replacement for the am335x_pru_package prussdrv.h used when building
+// with the simulated PRU. Only the parts used by these programs are
+// provided. See pru_sim.c
+//
+// 10/17/26 DJG Initial version
+#ifndef PRUSSDRV_H
+#define PRUSSDRV_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define NUM_PRU_HOSTIRQS 8
+#define NUM_PRU_HOSTS 10
+#define NUM_PRU_CHANNELS 10
+#define NUM_PRU_SYS_EVTS 64
+
+#define PRUSS0_PRU0_DATARAM 0
+#define PRUSS0_PRU1_DATARAM 1
+#define PRUSS0_PRU0_IRAM 2
+#define PRUSS0_PRU1_IRAM 3
+#define PRUSS0_SHARED_DATARAM 4
+
+#define PRU_EVTOUT_0 0
+#define PRU_EVTOUT_1 1
+
+typedef struct __sysevt_to_channel_map {
+   short sysevt;
+   short channel;
+} tsysevt_to_channel_map;
+
+typedef struct __channel_to_host_map {
+   short channel;
+   short host;
+} tchannel_to_host_map;
+
+typedef struct __pruintc_initdata {
+   char sysevts_enabled[NUM_PRU_SYS_EVTS];
+   tsysevt_to_channel_map sysevt_to_channel_map[NUM_PRU_SYS_EVTS];
+   tchannel_to_host_map channel_to_host_map[NUM_PRU_CHANNELS];
+   unsigned int host_enable_bitmask;
+} tpruss_intc_initdata;
+
+int prussdrv_init(void);
+int prussdrv_open(unsigned int host_interrupt);
+int prussdrv_pru_disable(unsigned int prunum);
+int prussdrv_pruintc_init(const tpruss_intc_initdata *prussintc_init_data);
+int prussdrv_map_prumem(unsigned int pru_ram_id, void **address);
+unsigned int prussdrv_get_phys_addr(const void *address);
+void *prussdrv_get_virt_addr(unsigned int phyaddr);
+unsigned int prussdrv_pru_wait_event(unsigned int host_interrupt);
+int prussdrv_pru_clear_event(unsigned int host_interrupt,
+   unsigned int sysevent);
+int prussdrv_exec_program(int prunum, const char *filename);
+int prussdrv_exit(void);
+
+#include "pru_sim.h"
+#endif
@@ -6,6 +6,8 @@
 // call mfm_init_sector_status_list before decoding each track
 // call mfm_update_deltas before decoding each track
 // call mfm_decode_track to decode the track or
+//   call mfm_decode_track_bits to decode emulation file bits if
+//   mfm_decode_bits_ok says they can be used or
 //   call mfm_wait_all_deltas to just wait for all deltas to be received and
 //   possibly written to a file
 // call mfm_check_deltas to get number of deltas in the buffer
@@ -16,11 +18,43 @@
 // call mfm_decode_done when all tracks have been processed
 // call mfm_handle_alt_track_ch to add alternate track to list
 // call mfm_fix_head to adjust head value in header if needed
+// call mfm_decode_free to free the decoder state when done with drive_params
+// call mfm_crc_capture_set and mfm_crc_capture_match to test CRC parameters
+//   without decoding the track for each
+// call mfm_track_state_alloc, mfm_track_state_setup,
+//   mfm_track_state_start_track, mfm_track_state_end_track, and
+//   mfm_track_state_done to decode tracks in parallel threads.
+//   mfm_track_state_parallel_ok says if format allows it.
+// call mfm_track_state_discard_track to drop a track that will be decoded
+//   again later
+//
+// All decoder state is kept in drive_params decode_ctx and track_state so
+// different drive_params can be decoded at the same time. Tracks from the
+// same disk may be decoded in parallel using a copy of drive_params with a
+// different track_state and decode_ctx from mfm_track_state_setup.
 //
 // TODO: make it use sector number information and checking CRC at data length to write data
 // for sectors with bad headers. See if resyncing PLL at write boundaries improves performance when
 // data bits are shifted at write boundaries.
 //
+// 10/17/26 DJG Extract files opened close on exec
+// 10/17/26 DJG Give each track state its own decode context and save
+//    changes to the previous track so --jobs output matches decoding in
+//    order. Dilog DQ614 can't be decoded in parallel, ROHM PBX can.
+// 10/17/26 DJG Added --fuse_reads to recover sectors by combining reads
+// 10/17/26 DJG Added mfm_track_state_discard_track for deferred retries
+// 10/17/26 DJG Added mfm_decode_track_bits to decode emulation file bits
+//    without converting them to deltas
+// 10/17/26 DJG Added mfm_decode_raw_bytes for decoding bytes from packed bits
+// 10/17/26 DJG Added mfm_save_raw_steps for decoders skipping steps
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Added mfm_crc_capture routines so analyze can test CRC
+//    parameters against headers saved from one decode of the track.
+// 10/17/26 DJG Moved remaining static decoder state into DECODE_CONTEXT and
+//    TRACK_STATE passed in DRIVE_PARAMS so decoder is reentrant.
+// 10/17/26 DJG Moved emulation track and last track state into TRACK_STATE
+//    and added mfm_track_state routines so tracks can be decoded in parallel.
 // 05/15/26 DJG Ensure entire track written before mfm_remap_track called.
 // 05/15/26 DJG Added SHUGART_CD9963 & HP9133XV controller
 // 06/12/25 DJG/DV Add CONTROLLER_MICROBEE_WD1002_05
@@ -175,26 +209,23 @@
 #include <math.h>
 #include <stdint.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "msg.h"
 #include "crc_ecc.h"
 #include "emu_tran_file.h"
 #include "mfm_decoder.h"
 #include "deltas_read.h"
+#include "mfm_pll.h"
 
 #define ARRAYSIZE(x)  (sizeof(x) / sizeof(x[0]))
 
-// Hold for sector status and cylinder and head it was for. We save the
-// data so when the cylinder and head changes we can print the final status.
-// The same track may be reread.
-static SECTOR_STATUS last_sector_list[MAX_SECTORS];
-static int last_cyl;
-static int last_head;
-
-static int cyl_found[4096];
-
-// Last LBA address processed for detecting bad sectors
-static int last_lba_addr;
+// Header for each write saved in write_log. Data follows header
+typedef struct {
+   int fd;
+   int len;
+   off_t offset;
+} WRITE_LOG_ENTRY;
 
 static void update_emu_track_sector(DRIVE_PARAMS *drive_params,
        SECTOR_STATUS *sector_status, int sect_rel0,
@@ -203,27 +234,18 @@ void update_emu_track_words(DRIVE_PARAMS * drive_params,
       SECTOR_STATUS sector_status_list[], int write_track, int new_track,
       int cyl, int head);
 static void print_missing_cyl(DRIVE_PARAMS *drive_params);
-static void dump_bad(void);
-
-// This is used with --ignore_seek_errors to show what sectors were good/bad
-// for the entire disk. It also makes sure a good sector won't be overwritten with a
-// bad sector. A disk I was reading you saw multiple cylinders when
-// reading a track so track at a time error information wasn't accurate.
-//    Lower value better data.
-//    sector_good & ECC MASK not zero number of bits corrected. 
-static uint8_t sector_good[MAX_CYL][MAX_HEAD][MAX_SECTORS];
+static void dump_bad(DRIVE_PARAMS *drive_params);
+static void log_write(TRACK_STATE *track_state, int fd, uint8_t bytes[],
+      int len, off_t offset);
+
+// Values for DECODE_CONTEXT sector_good
 #define SECTOR_GOOD_BAD 0x80
 #define SECTOR_GOOD_GOOD 0x0
 #define SECTOR_GOOD_ECC_MASK 0x7f
-// CRC of sector data. This detects if good or ECC corrected data differs between
-// reads
-static uint64_t sector_crc[MAX_CYL][MAX_HEAD][MAX_SECTORS];
-static int num_cyl, num_head, num_sectors;
 
 
-// These are various PLL constants I was trying. For efficiency the
-// filter routine is put in the decoders so it can inline and has the
-// "best" PLL constants I found.
+// These are various PLL constants I was trying. The PLL is in mfm_pll.c
+// and has the "best" PLL constants I found.
 #if 0
 int filter_type;
 
@@ -261,18 +283,6 @@ static inline float filter(float v, float *delay)
    return out;
 }
 #endif
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
-{
-   float in, out;
-
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
-}
 
 
 // Compare two integers for qsort
@@ -293,6 +303,7 @@ static int cmpint(const void *i1, const void *i2) {
 // cyl, head: Track status if for
 static void print_sector_list_status(DRIVE_PARAMS *drive_params,
       SECTOR_STATUS *sector_status_list, int cyl, int head) {
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
    int cntr;
    int ecc_corrections = 0;
    int hard_errors = 0;
@@ -361,14 +372,14 @@ static void print_sector_list_status(DRIVE_PARAMS *drive_params,
 
       qsort(lba_addrs, num_sectors - lba_missing, sizeof(lba_addrs[0]), cmpint);
       for (cntr = 0; cntr < num_sectors - lba_missing; cntr++) {
-         if (last_lba_addr + 1 != lba_addrs[cntr]) {
-            msg(MSG_ERR, "Missing LBA address %d", last_lba_addr + 1);
-            if (last_lba_addr + 2 != lba_addrs[cntr]) {
+         if (decode_ctx->last_lba_addr + 1 != lba_addrs[cntr]) {
+            msg(MSG_ERR, "Missing LBA address %d", decode_ctx->last_lba_addr + 1);
+            if (decode_ctx->last_lba_addr + 2 != lba_addrs[cntr]) {
                msg(MSG_ERR, " to %d", lba_addrs[cntr] - 1);
             }
             msg(MSG_ERR, "\n");
          }
-         last_lba_addr = lba_addrs[cntr];
+         decode_ctx->last_lba_addr = lba_addrs[cntr];
       }
    } else {
       // Print CHS errors
@@ -400,6 +411,7 @@ static void print_sector_list_status(DRIVE_PARAMS *drive_params,
          msg(MSG_ERR_SUMMARY,"\n");
       }
       if (ecc_corrections) {
+         int last_cyl = cyl;
          msg(MSG_ERR_SUMMARY, "ECC Corrections on cylinder %d", cyl);
          for (cntr = 0; cntr < num_sectors; cntr++) {
             if (!(sector_status_list[cntr].status & SECT_BAD_HEADER)) {
@@ -444,13 +456,14 @@ static void print_sector_list_status(DRIVE_PARAMS *drive_params,
 static void update_stats(DRIVE_PARAMS *drive_params, int cyl, int head,
       SECTOR_STATUS sector_status_list[])
 {
+   TRACK_STATE *track_state = drive_params->track_state;
    STATS *stats = &drive_params->stats;
    int i;
-   int write_cyl = last_cyl;
+   int write_cyl = track_state->last_cyl;
 
 
    // If track changed and list has been set (last_cyl != -1) then process
-   if (last_cyl != -1 && (cyl != last_cyl || head != last_head)) {
+   if (track_state->last_cyl != -1 && (cyl != track_state->last_cyl || head != track_state->last_head)) {
 // This was start of trying to enable creating emu file with --ignore_seek_errors 
 // Solved issue by using microstepper so this never finished
 // Also needed change below
@@ -465,8 +478,8 @@ static void update_stats(DRIVE_PARAMS *drive_params, int cyl, int head,
          }
          int ndx = 0;
          for (i = 0; i < drive_params->num_sectors; i++) {
-            if (!(last_sector_list[i].status & SECT_BAD_HEADER)) {
-               cyl_list[ndx++] = last_sector_list[i].cyl;
+            if (!(track_state->last_sector_list[i].status & SECT_BAD_HEADER)) {
+               cyl_list[ndx++] = track_state->last_sector_list[i].cyl;
             }
          }
          qsort(cyl_list, ndx, sizeof(cyl_list[0]), cmpint);
@@ -478,9 +491,9 @@ static void update_stats(DRIVE_PARAMS *drive_params, int cyl, int head,
                // If over half same cylinder use it.
             } 
             if (cyl_list[i] != last_entry || i == ndx - 1) {
-               if (count > drive_params->num_sectors / 2 + 1 && last_entry != last_cyl) {
+               if (count > drive_params->num_sectors / 2 + 1 && last_entry != track_state->last_cyl) {
                   printf("Writing read cyl %d to actual cyl %d head %d, count %d\n",
-                     last_cyl, last_entry, last_head, count);
+                     track_state->last_cyl, last_entry, track_state->last_head, count);
                   write_cyl = last_entry;
                }
                count = 1;
@@ -490,33 +503,33 @@ static void update_stats(DRIVE_PARAMS *drive_params, int cyl, int head,
       }
 #endif
       update_emu_track_words(drive_params, sector_status_list, 1, 1, 
-          write_cyl, last_head);
+          write_cyl, track_state->last_head);
       for (i = 0; i < drive_params->num_sectors; i++) {
-         if (last_sector_list[i].status & SECT_ECC_RECOVERED &&
-             !(last_sector_list[i].status & SECT_SPARE_BAD)) {
+         if (track_state->last_sector_list[i].status & SECT_ECC_RECOVERED &&
+             !(track_state->last_sector_list[i].status & SECT_SPARE_BAD)) {
             stats->num_ecc_recovered++;
          }
-         if (last_sector_list[i].status & SECT_SPARE_BAD) {
+         if (track_state->last_sector_list[i].status & SECT_SPARE_BAD) {
             stats->num_spare_bad++;
-         } else if (last_sector_list[i].status & SECT_BAD_HEADER) {
+         } else if (track_state->last_sector_list[i].status & SECT_BAD_HEADER) {
             stats->num_bad_header++;
-         } else if (last_sector_list[i].status & SECT_BAD_DATA) {
+         } else if (track_state->last_sector_list[i].status & SECT_BAD_DATA) {
             stats->num_bad_data++;
          } else {
             stats->num_good_sectors++;
          }
       }
-      print_sector_list_status(drive_params, last_sector_list, 
-         last_cyl, last_head);
+      print_sector_list_status(drive_params, track_state->last_sector_list, 
+         track_state->last_cyl, track_state->last_head);
    } else {
-      update_emu_track_words(drive_params, sector_status_list, 0, last_cyl == -1, cyl, head);
+      update_emu_track_words(drive_params, sector_status_list, 0, track_state->last_cyl == -1, cyl, head);
    }
    // Save the sector information so we can use it when track changes
    if (sector_status_list != NULL) {
-      memcpy(last_sector_list, sector_status_list, sizeof(last_sector_list));
+      memcpy(track_state->last_sector_list, sector_status_list, sizeof(track_state->last_sector_list));
    }
-   last_cyl = cyl;
-   last_head = head;
+   track_state->last_cyl = cyl;
+   track_state->last_head = head;
 }
 
 // Code that needs to happen after all of a track has been processed including all retries
@@ -572,41 +585,25 @@ static SECTOR_DECODE_STATUS mfm_decode_track_deltas(DRIVE_PARAMS *drive_params,
    int raw_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency
-   float avg_bit_sep_time = 20; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   // PLL filter state. Static works better since next track bit timing
-   // similar to previous though a bad track can put it off enough that
-   // the next track has errors. Retry should fix. TODO: Look at
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
    // Count all the raw bits for emulation file
    int all_raw_bits_count = 0;
 
-   num_deltas = deltas_get_count(0);
    raw_word = 0;
-   i = 1;
-   while (num_deltas >= 0) {
+   // Long deltas aren't split for this decode
+   pll_track = mfm_pll_track_start(drive_params, deltas, 20.0, 0);
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas; i++) {
-         track_time += deltas[i];
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += deltas[i];
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock
-         avg_bit_sep_time = 20.0 + filter(clock_time, &filter_state);
+      for (; i < num_steps; i++) {
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 
          if (drive_params->emulation_filename != NULL &&
                all_raw_bits_count + int_bit_pos >= 32) {
@@ -628,7 +625,6 @@ static SECTOR_DECODE_STATUS mfm_decode_track_deltas(DRIVE_PARAMS *drive_params,
          }
          raw_bit_cntr += int_bit_pos;
       }
-      num_deltas = deltas_get_count(i);
    }
    return SECT_NO_STATUS;
 }
@@ -763,6 +759,43 @@ SECTOR_DECODE_STATUS mfm_decode_track(DRIVE_PARAMS * drive_params, int cyl,
    return rc;
 }
 
+// Returns non zero if emulation file bits can be decoded directly with
+// mfm_decode_track_bits. The bits are used without the PLL so they must be
+// at the format's bit rate.
+//
+// drive_params: Drive parameters
+// sample_rate_hz: Bit rate of the emulation file
+int mfm_decode_bits_ok(DRIVE_PARAMS *drive_params, int sample_rate_hz)
+{
+   return sample_rate_hz ==
+      mfm_controller_info[drive_params->controller].clk_rate_hz;
+}
+
+// Decode a track from emulation file bits. The bits are already clock
+// recovered so they are given to the decoder directly instead of being
+// converted to deltas and back to bits with the PLL.
+//
+// drive_params: Drive parameters
+// cyl,head: Physical Track data from
+// words: Emulation file track bits
+// num_words: Number of words in words
+// sample_rate_hz: Bit rate of the emulation file
+// seek_difference: Return of difference between expected cyl and header
+// sector_status_list: Return of status of decoded sector
+// return: Or together of the status of each sector decoded
+SECTOR_DECODE_STATUS mfm_decode_track_bits(DRIVE_PARAMS *drive_params,
+      int cyl, int head, uint32_t words[], int num_words, int sample_rate_hz,
+      int *seek_difference, SECTOR_STATUS sector_status_list[])
+{
+   int rc;
+
+   mfm_pll_track_set_bits(drive_params, words, num_words, sample_rate_hz);
+   rc = mfm_decode_track(drive_params, cyl, head, NULL, seek_difference,
+      sector_status_list);
+   mfm_pll_track_set_bits(drive_params, NULL, 0, 0);
+   return rc;
+}
+
 // This makes the floating point faster with minor simplifications to the floating point processing
 // http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.ddi0344k/Chdiihcd.html
 #ifdef __arm__
@@ -789,25 +822,58 @@ static void enable_runfast()
 void mfm_decode_setup(DRIVE_PARAMS *drive_params, int write_files)
 {
    STATS *stats = &drive_params->stats;
+   DECODE_CONTEXT *decode_ctx;
+   TRACK_STATE *track_state;
 
+   // May be called again to start over so reuse state if already allocated
+   if (drive_params->decode_ctx == NULL) {
+      drive_params->decode_ctx = msg_malloc(sizeof(*drive_params->decode_ctx),
+         "Decode context");
+      memset(drive_params->decode_ctx, 0, sizeof(*drive_params->decode_ctx));
+   }
+   if (drive_params->track_state == NULL) {
+      drive_params->track_state = mfm_track_state_alloc();
+   }
+   decode_ctx = drive_params->decode_ctx;
+   track_state = drive_params->track_state;
 
    // set to value indicating not yet set.
-   last_head = -1;
-   last_cyl = -1;
-   last_lba_addr = -1;
-   memset(cyl_found, 0, sizeof(cyl_found));
-
-   num_cyl = drive_params->num_cyl;
-   num_head = drive_params->num_head;
-   num_sectors = drive_params->num_sectors;
-   memset(sector_good, SECTOR_GOOD_BAD, sizeof(sector_good));
-   memset(sector_crc, 0, sizeof(sector_crc));
+   track_state->last_head = -1;
+   track_state->last_cyl = -1;
+   track_state->log_writes = 0;
+   if (track_state->fuse != NULL) {
+      track_state->fuse->cyl = -1;
+   }
+   decode_ctx->last_lba_addr = -1;
+   memset(decode_ctx->cyl_found, 0, sizeof(decode_ctx->cyl_found));
+   decode_ctx->first_spare_bad_sector = 1;
+   decode_ctx->sectors_skipped_zone = 0;
+   decode_ctx->sectors_skipped_track = 0;
+   decode_ctx->last_zone = 0;
+   decode_ctx->last_sector_group = 0;
+   decode_ctx->last_byte2 = 0;
+   decode_ctx->total_track_time = -1;
+   decode_ctx->last_remap = 0;
 
    if (drive_params->emulation_output && drive_params->ignore_seek_errors) {
       msg(MSG_ERR, "Ignore seek errors is invalid if generating emulation file. Option turned off\n");
       drive_params->ignore_seek_errors = 0;
    }
 
+   // Only needed for ignore seek errors and these are large
+   if (drive_params->ignore_seek_errors) {
+      if (decode_ctx->sector_good == NULL) {
+         decode_ctx->sector_good = msg_malloc(sizeof(*decode_ctx->sector_good) *
+            MAX_CYL, "Sector good");
+         decode_ctx->sector_crc = msg_malloc(sizeof(*decode_ctx->sector_crc) *
+            MAX_CYL, "Sector CRC");
+      }
+      memset(decode_ctx->sector_good, SECTOR_GOOD_BAD, 
+         sizeof(*decode_ctx->sector_good) * MAX_CYL);
+      memset(decode_ctx->sector_crc, 0, 
+         sizeof(*decode_ctx->sector_crc) * MAX_CYL);
+   }
+
 
    if (write_files && drive_params->emulation_filename != NULL &&
          drive_params->emulation_output == 1) {
@@ -834,6 +900,8 @@ void mfm_decode_setup(DRIVE_PARAMS *drive_params, int write_files)
          perror("Unable to create output extracted data file");
          exit(1);
       }
+      // Don't pass to decompression programs
+      fcntl(drive_params->ext_fd, F_SETFD, FD_CLOEXEC);
       if (mfm_controller_info[drive_params->controller].metadata_bytes != 0) {
          char extention[] = ".metadata";
          char fn[strlen(drive_params->extract_filename) + strlen(extention) + 1];
@@ -845,6 +913,7 @@ void mfm_decode_setup(DRIVE_PARAMS *drive_params, int write_files)
             perror("Unable to create metadata output file");
             exit(1);
          }
+         fcntl(drive_params->ext_metadata_fd, F_SETFD, FD_CLOEXEC);
       }
    }
    memset(stats, 0, sizeof(*stats));
@@ -960,7 +1029,7 @@ void mfm_decode_done(DRIVE_PARAMS * drive_params)
    emu_file_close(drive_params->emu_fd, drive_params->emulation_output);
 
    if (drive_params->ignore_seek_errors) {
-      dump_bad();
+      dump_bad(drive_params);
    }
 }
 
@@ -983,6 +1052,7 @@ void mfm_check_header_values(int exp_cyl, int exp_head,
       int *sector_index, int sector_size, int *seek_difference,
       SECTOR_STATUS *sector_status, DRIVE_PARAMS *drive_params,
       SECTOR_STATUS sector_status_list[]) {
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
 
    if (sector_status->ignore) {
       return;
@@ -994,8 +1064,11 @@ void mfm_check_header_values(int exp_cyl, int exp_head,
       return;
    }
 
-   if (sector_status->cyl >= 0 && sector_status->cyl < ARRAYSIZE(cyl_found)) {
-      cyl_found[sector_status->cyl] = 1;
+   // Only used with ignore_seek_errors. Skip otherwise since tracks may be
+   // decoded in parallel.
+   if (drive_params->ignore_seek_errors && sector_status->cyl >= 0 && 
+         sector_status->cyl < ARRAYSIZE(decode_ctx->cyl_found)) {
+      decode_ctx->cyl_found[sector_status->cyl] = 1;
    }
    // If ignore seek error we will still declare an error if greater than 250
    // to make analyze work better.
@@ -1106,23 +1179,56 @@ void mfm_check_header_values(int exp_cyl, int exp_head,
    }
 }
 
+// Save a write to the extract or metadata file in the current track
+// state write log. The writes are performed by mfm_track_state_done.
+//
+// fd: File to write to
+// bytes: Data to write
+// len: Number of bytes to write
+// offset: Location in file to write at
+static void log_write(TRACK_STATE *track_state, int fd, uint8_t bytes[],
+      int len, off_t offset) {
+   WRITE_LOG_ENTRY entry;
+   int need = sizeof(entry) + len;
+
+   if (track_state->write_log_len + need > track_state->write_log_size) {
+      track_state->write_log_size = (track_state->write_log_len + need) * 2;
+      track_state->write_log = realloc(track_state->write_log, 
+         track_state->write_log_size);
+      if (track_state->write_log == NULL) {
+         msg(MSG_FATAL, "Malloc failed write log size %d\n", 
+            track_state->write_log_size);
+         exit(1);
+      }
+   }
+   entry.fd = fd;
+   entry.len = len;
+   entry.offset = offset;
+   memcpy(&track_state->write_log[track_state->write_log_len], &entry,
+      sizeof(entry));
+   track_state->write_log_len += sizeof(entry);
+   memcpy(&track_state->write_log[track_state->write_log_len], bytes, len);
+   track_state->write_log_len += len;
+}
+
 // Dump overall bad sector information for --ignore_seek_error
-static void dump_bad(void) {
+static void dump_bad(DRIVE_PARAMS *drive_params) {
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
    int bad_sector_count = 0;
    int ecc_sector_count = 0;
 
    msg(MSG_INFO, "BAD data with E is data was ECC corrected, likely no error\n");
-   for (int cyl = 0; cyl < num_cyl; cyl++) {
-      for (int head = 0; head < num_head; head++) {
+   for (int cyl = 0; cyl < drive_params->num_cyl; cyl++) {
+      for (int head = 0; head < drive_params->num_head; head++) {
          int printed = 0;
-         for (int sect = 0; sect < num_sectors; sect++) {
-            if (sector_good[cyl][head][sect] != SECTOR_GOOD_GOOD) {
+         for (int sect = 0; sect < drive_params->num_sectors; sect++) {
+            if (decode_ctx->sector_good[cyl][head][sect] != SECTOR_GOOD_GOOD) {
                if (!printed) {
                   msg(MSG_INFO, "BAD cyl %d head %d: ", cyl, head) ;
                   printed = 1;
                }
-               if (sector_good[cyl][head][sect] & SECTOR_GOOD_ECC_MASK) {
-                  msg(MSG_INFO, "%dE(%d) ", sect, sector_good[cyl][head][sect] & SECTOR_GOOD_ECC_MASK);
+               if (decode_ctx->sector_good[cyl][head][sect] & SECTOR_GOOD_ECC_MASK) {
+                  msg(MSG_INFO, "%dE(%d) ", sect, decode_ctx->sector_good[cyl][head][sect] & SECTOR_GOOD_ECC_MASK);
                   ecc_sector_count++;
                } else {
                   msg(MSG_INFO, "%d ", sect);
@@ -1155,6 +1261,8 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
       SECTOR_STATUS *sector_status, SECTOR_STATUS sector_status_list[],
       uint8_t all_bytes[], int all_bytes_len)
 {
+   TRACK_STATE *track_state = drive_params->track_state;
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
    int rc;
    STATS *stats = &drive_params->stats;
    int update;
@@ -1246,11 +1354,11 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
       // If good read or previous good read see if data different. Good is CRC
       // matches with or without ECC correction
       if (!(sector_status->status & SECT_BAD_DATA)) {
-         if (sector_good[sector_status->cyl][sector_status->head][sect_rel0] != SECTOR_GOOD_BAD) {
-            if (crc != sector_crc[sector_status->cyl][sector_status->head][sect_rel0]) {
+         if (decode_ctx->sector_good[sector_status->cyl][sector_status->head][sect_rel0] != SECTOR_GOOD_BAD) {
+            if (crc != decode_ctx->sector_crc[sector_status->cyl][sector_status->head][sect_rel0]) {
                // If neither current read or previous were corrected by ECC
                if (sector_status->ecc_span_corrected_data == 0 &&
-                   (sector_good[sector_status->cyl][sector_status->head][sect_rel0] & SECTOR_GOOD_ECC_MASK) == 0) {
+                   (decode_ctx->sector_good[sector_status->cyl][sector_status->head][sect_rel0] & SECTOR_GOOD_ECC_MASK) == 0) {
                   msg(MSG_INFO, "Found two reads of sector with different content cyl %d head %d sect %d\n",sector_status->cyl,
                       sector_status->head,sect_rel0);
                   // Keep first. Found disk with old format data at end. This
@@ -1264,7 +1372,7 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
             }
          }
          // Update CRC so we can see if we are getting false ECC corrections
-         sector_crc[sector_status->cyl][sector_status->head][sect_rel0] = crc;
+         decode_ctx->sector_crc[sector_status->cyl][sector_status->head][sect_rel0] = crc;
       }
       // ECC correction, Span is only set if we don't have CRC error after correction
       uint8_t new_good;
@@ -1276,11 +1384,11 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
          new_good = SECTOR_GOOD_GOOD;
       }
       // Need to replace same at least once to write data with CRC error.
-      if (sector_good[sector_status->cyl][sector_status->head][sect_rel0] < new_good) {
-         //printf("Not replacing better sector %d %d\n",sector_good[sector_status->cyl][sector_status->head][sect_rel0], new_good);
+      if (decode_ctx->sector_good[sector_status->cyl][sector_status->head][sect_rel0] < new_good) {
+         //printf("Not replacing better sector %d %d\n",decode_ctx->sector_good[sector_status->cyl][sector_status->head][sect_rel0], new_good);
          update = 0;
       } else {
-         sector_good[sector_status->cyl][sector_status->head][sect_rel0] = new_good;
+         decode_ctx->sector_good[sector_status->cyl][sector_status->head][sect_rel0] = new_good;
       }
    }
    if (update) {
@@ -1295,14 +1403,19 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
                            drive_params->num_sectors *
                            drive_params->num_head);
          }
-         if (lseek(drive_params->ext_fd, offset, SEEK_SET) < 0) {
-            msg(MSG_FATAL, "Seek failed decoded data: %s\n", strerror(errno));
-            exit(1);
-         };
-         if ((rc = write(drive_params->ext_fd, bytes, drive_params->sector_size)) !=
-               drive_params->sector_size) {
-            msg(MSG_FATAL, "Write failed, rc %d: %s", rc, strerror(errno));
-            exit(1);
+         if (track_state->log_writes) {
+            log_write(track_state, drive_params->ext_fd, bytes, drive_params->sector_size,
+               offset);
+         } else {
+            if (lseek(drive_params->ext_fd, offset, SEEK_SET) < 0) {
+               msg(MSG_FATAL, "Seek failed decoded data: %s\n", strerror(errno));
+               exit(1);
+            };
+            if ((rc = write(drive_params->ext_fd, bytes, drive_params->sector_size)) !=
+                  drive_params->sector_size) {
+               msg(MSG_FATAL, "Write failed, rc %d: %s", rc, strerror(errno));
+               exit(1);
+            }
          }
       }
       sector_status_list[sect_rel0] = *sector_status;
@@ -1320,6 +1433,7 @@ int mfm_write_sector(uint8_t bytes[], DRIVE_PARAMS * drive_params,
 int mfm_write_metadata(uint8_t bytes[], DRIVE_PARAMS * drive_params,
       SECTOR_STATUS *sector_status)
 {
+   TRACK_STATE *track_state = drive_params->track_state;
    int size = mfm_controller_info[drive_params->controller].metadata_bytes;
    size_t offset;
    int sect_rel0 = sector_status->sector - drive_params->first_sector_number;
@@ -1336,13 +1450,17 @@ int mfm_write_metadata(uint8_t bytes[], DRIVE_PARAMS * drive_params,
                   (off_t) sector_status->cyl * (size *
                        drive_params->num_sectors * drive_params->num_head);
       }
-      if (lseek(drive_params->ext_metadata_fd, offset, SEEK_SET) < 0) {
-         msg(MSG_FATAL, "Seek failed metadata: %s\n", strerror(errno));
-         exit(1);
-      };
-      if ((rc = write(drive_params->ext_metadata_fd, bytes, size)) != size) {
-         msg(MSG_FATAL, "Metadata write failed, rc %d: %s", rc, strerror(errno));
-         exit(1);
+      if (track_state->log_writes) {
+         log_write(track_state, drive_params->ext_metadata_fd, bytes, size, offset);
+      } else {
+         if (lseek(drive_params->ext_metadata_fd, offset, SEEK_SET) < 0) {
+            msg(MSG_FATAL, "Seek failed metadata: %s\n", strerror(errno));
+            exit(1);
+         };
+         if ((rc = write(drive_params->ext_metadata_fd, bytes, size)) != size) {
+            msg(MSG_FATAL, "Metadata write failed, rc %d: %s", rc, strerror(errno));
+            exit(1);
+         }
       }
    }
    return 0;
@@ -1377,6 +1495,35 @@ void mfm_dump_bytes(uint8_t bytes[], int len, int cyl, int head,
 #endif
 }
 
+// Save bytes mfm_crc_bytes was called with.
+//
+// capture: Where to save the bytes
+// bytes: bytes to save
+// bytes_crc_len: Length of bytes including CRC
+// state: Where we are in the decoding process
+static void crc_capture_save(CRC_CAPTURE *capture, uint8_t bytes[], 
+   int bytes_crc_len, int state)
+{
+   int need = sizeof(bytes_crc_len) + bytes_crc_len;
+
+   if (state != PROCESS_HEADER) {
+      capture->non_header = 1;
+      return;
+   }
+   if (capture->len + need > capture->size) {
+      capture->size = (capture->len + need) * 2;
+      capture->buf = realloc(capture->buf, capture->size);
+      if (capture->buf == NULL) {
+         msg(MSG_FATAL, "Malloc failed CRC capture size %d\n", capture->size);
+         exit(1);
+      }
+   }
+   memcpy(&capture->buf[capture->len], &bytes_crc_len, sizeof(bytes_crc_len));
+   capture->len += sizeof(bytes_crc_len);
+   memcpy(&capture->buf[capture->len], bytes, bytes_crc_len);
+   capture->len += bytes_crc_len;
+}
+
 // Perform CRC check of data bytes.
 // drive_params: Drive parameters
 // bytes: bytes to process
@@ -1399,6 +1546,13 @@ SECTOR_DECODE_STATUS mfm_crc_bytes(DRIVE_PARAMS *drive_params,
    SECTOR_DECODE_STATUS status = SECT_NO_STATUS;
    CHECK_TYPE check_type;
 
+   if (drive_params->track_state->crc_capture != NULL) {
+      crc_capture_save(drive_params->track_state->crc_capture, bytes,
+         bytes_crc_len, state);
+      *crc_ret = 1; // Non zero indicates error
+      return status;
+   }
+
    if (state == PROCESS_HEADER) {
       start = mfm_controller_info[drive_params->controller].header_crc_ignore;
       crc_info = drive_params->header_crc;
@@ -1511,6 +1665,120 @@ SECTOR_DECODE_STATUS mfm_crc_bytes(DRIVE_PARAMS *drive_params,
    return status;
 }
 
+// Minimum number of reads of a sector to combine for --fuse_reads
+#define FUSE_MIN_READS 3
+
+// Save the data of a sector with a CRC error and if enough reads of the
+// sector have been saved try to recover it by combining the reads. The
+// bytes start at the data sync mark so the reads are aligned. The vote is
+// on the decoded data bits, not the raw MFM bits from the PLL, so only
+// reads that decoded the same number of bits after the sync mark line up.
+// Each bit is set to the value most of the reads have. When there is a tie the value
+// from the current read is used. If the combined data passes the CRC, with
+// ECC correction if needed, it replaces the bytes.
+//
+// drive_params: Drive parameters
+// bytes: bytes of sector data with CRC error. Updated if recovered
+// bytes_crc_len: Length of bytes including CRC
+// cyl,head: Physical Track data from
+// crc_ret: Set to zero if data recovered
+// ecc_span: Number of bits corrected with ECC if data recovered
+// init_status: Set to SECT_AMBIGUOUS_CRC if zero CRC may be due to zero data
+// return: Status from checking CRC of combined data
+static SECTOR_DECODE_STATUS fuse_sector(DRIVE_PARAMS *drive_params,
+   uint8_t bytes[], int bytes_crc_len, int cyl, int head, uint64_t *crc_ret,
+   int *ecc_span, SECTOR_DECODE_STATUS *init_status)
+{
+   TRACK_STATE *track_state = drive_params->track_state;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
+   FUSE_STATE *fuse = track_state->fuse;
+   SECTOR_DECODE_STATUS status = SECT_NO_STATUS;
+   uint8_t fused[bytes_crc_len];
+   uint8_t *read;
+   int sect_rel0 = sector_status->sector - drive_params->first_sector_number;
+   int num_reads;
+   int i, bit, read_ndx, count;
+   int fused_ecc_span = 0;
+   uint64_t crc;
+
+   // Weaker checks are too likely to match combined data that is wrong
+   if (mfm_controller_info[drive_params->controller].data_check != CHECK_CRC ||
+         track_state->crc_capture != NULL) {
+      return status;
+   }
+   // Need to know which sector the data is from
+   if (sector_status->status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER) ||
+         sector_status->is_lba || sector_status->ignore ||
+         sector_status->cyl != cyl || sector_status->head != head ||
+         sect_rel0 < 0 || sect_rel0 >= drive_params->num_sectors) {
+      return status;
+   }
+   if (fuse == NULL) {
+      fuse = msg_malloc(sizeof(*fuse), "Fuse state");
+      memset(fuse, 0, sizeof(*fuse));
+      fuse->cyl = -1;
+      track_state->fuse = fuse;
+   }
+   // Start over on new track
+   if (fuse->cyl != cyl || fuse->head != head) {
+      memset(fuse->num_reads, 0, sizeof(fuse->num_reads));
+      fuse->cyl = cyl;
+      fuse->head = head;
+   }
+   if (fuse->num_reads[sect_rel0] == 0 || 
+         fuse->len[sect_rel0] != bytes_crc_len) {
+      fuse->reads[sect_rel0] = realloc(fuse->reads[sect_rel0],
+         FUSE_MAX_READS * bytes_crc_len);
+      if (fuse->reads[sect_rel0] == NULL) {
+         msg(MSG_FATAL, "Malloc failed fuse reads\n");
+         exit(1);
+      }
+      fuse->len[sect_rel0] = bytes_crc_len;
+      fuse->num_reads[sect_rel0] = 0;
+      fuse->next_read[sect_rel0] = 0;
+   }
+   // Save this read replacing the oldest if full
+   memcpy(&fuse->reads[sect_rel0][fuse->next_read[sect_rel0] * bytes_crc_len],
+      bytes, bytes_crc_len);
+   fuse->next_read[sect_rel0] = (fuse->next_read[sect_rel0] + 1) % 
+      FUSE_MAX_READS;
+   if (fuse->num_reads[sect_rel0] < FUSE_MAX_READS) {
+      fuse->num_reads[sect_rel0]++;
+   }
+   num_reads = fuse->num_reads[sect_rel0];
+   if (num_reads < FUSE_MIN_READS) {
+      return status;
+   }
+
+   for (i = 0; i < bytes_crc_len; i++) {
+      fused[i] = 0;
+      for (bit = 0x80; bit != 0; bit >>= 1) {
+         count = 0;
+         for (read_ndx = 0; read_ndx < num_reads; read_ndx++) {
+            read = &fuse->reads[sect_rel0][read_ndx * bytes_crc_len];
+            if (read[i] & bit) {
+               count++;
+            }
+         }
+         if (count * 2 > num_reads || 
+               (count * 2 == num_reads && (bytes[i] & bit))) {
+            fused[i] |= bit;
+         }
+      }
+   }
+   status = mfm_crc_bytes(drive_params, fused, bytes_crc_len, PROCESS_DATA,
+      &crc, &fused_ecc_span, init_status, 1);
+   if (crc == 0) {
+      msg(MSG_INFO, "Recovered sector by combining %d reads cyl %d head %d sector %d\n",
+         num_reads, cyl, head, sector_status->sector);
+      memcpy(bytes, fused, bytes_crc_len);
+      *crc_ret = 0;
+      *ecc_span = fused_ecc_span;
+      fuse->num_reads[sect_rel0] = 0;
+   }
+   return status;
+}
+
 // After we have found a valid header/data mark this routine is
 // used to process the bytes. It checks the CRC and does ECC if needed then
 // calls wd_process_data to finish the processing.
@@ -1540,6 +1808,10 @@ SECTOR_DECODE_STATUS mfm_process_bytes(DRIVE_PARAMS *drive_params,
 
    status = mfm_crc_bytes(drive_params, bytes, bytes_crc_len, *state, &crc,
       &ecc_span, &init_status, 1);
+   if (crc != 0 && *state == PROCESS_DATA && drive_params->fuse_reads) {
+      status |= fuse_sector(drive_params, bytes, bytes_crc_len, cyl, head,
+         &crc, &ecc_span, &init_status);
+   }
    if (*state == PROCESS_HEADER) {
 #if DUMP_HEADER
       static int dump_fd = 0;
@@ -1735,29 +2007,12 @@ SECTOR_DECODE_STATUS mfm_process_bytes(DRIVE_PARAMS *drive_params,
 // make an error free track.
 
 
-// Best_track is the best track read as one read. Best_fixed_track is
-// the best track by putting together multiple reads
-uint32_t best_track_words[MAX_TRACK_WORDS];
-int best_track_weight;
-int best_track_num_words;
-uint32_t best_fixed_track_words[MAX_TRACK_WORDS];
-int best_fixed_track_weight;
-int best_fixed_track_num_words;
-uint32_t current_track_words[MAX_TRACK_WORDS];
-int current_track_words_ndx;
-int last_sector_start_word;
-int header_track_word_ndx;
-int data_bit;
-int data_word_ndx;
-// For examining track timing
-int header_track_tot_bit_count;;
-int data_tot_bit_count;
-
 // Note that last call where data will be written had data for next track.
 void update_emu_track_words(DRIVE_PARAMS * drive_params,
       SECTOR_STATUS sector_status_list[], int write_track, int new_track,
       int cyl, int head)
 {
+   TRACK_STATE *track_state = drive_params->track_state;
    int i;
    int last_weight = 0;
    int best_weight = 0;
@@ -1798,67 +2053,62 @@ void update_emu_track_words(DRIVE_PARAMS * drive_params,
    if (write_track) {
       // If it is at least as good use the track that was from one read
       // since it is more likely to be ok
-      if (best_track_weight >= best_fixed_track_weight) {
-         emu_file_write_track_bits(drive_params->emu_fd, best_track_words,
-               best_track_num_words, cyl, head, 
+      if (track_state->best_track_weight >= track_state->best_fixed_track_weight) {
+         emu_file_write_track_bits(drive_params->emu_fd, track_state->best_track_words,
+               track_state->best_track_num_words, cyl, head, 
                drive_params->emu_track_data_bytes);
       } else {
         //printf("Using fixed %d,%d,%d %d %d\n",best_weight, last_weight,
-        //     best_track_weight, cyl, head);
-         emu_file_write_track_bits(drive_params->emu_fd, best_fixed_track_words,
-               best_fixed_track_num_words, cyl, head,
+        //     track_state->best_track_weight, cyl, head);
+         emu_file_write_track_bits(drive_params->emu_fd, track_state->best_fixed_track_words,
+               track_state->best_fixed_track_num_words, cyl, head,
                drive_params->emu_track_data_bytes);
       }
    }
    // Keep best track. Should be last track the way mfm_read works.
-   if (last_weight > best_track_weight || new_track) {
-      best_track_weight = last_weight;
-      memcpy(best_track_words, current_track_words, current_track_words_ndx *
-            sizeof(best_track_words[0]));
-      best_track_num_words = current_track_words_ndx;
+   if (last_weight > track_state->best_track_weight || new_track) {
+      track_state->best_track_weight = last_weight;
+      memcpy(track_state->best_track_words, track_state->current_track_words, track_state->current_track_words_ndx *
+            sizeof(track_state->best_track_words[0]));
+      track_state->best_track_num_words = track_state->current_track_words_ndx;
    }
    // Take the first track for our best fixed track
    if (new_track && sector_status_list != NULL) {
-      memcpy(best_fixed_track_words, current_track_words, current_track_words_ndx *
-            sizeof(best_track_words[0]));
-      best_fixed_track_num_words = current_track_words_ndx;
+      memcpy(track_state->best_fixed_track_words, track_state->current_track_words, track_state->current_track_words_ndx *
+            sizeof(track_state->best_track_words[0]));
+      track_state->best_fixed_track_num_words = track_state->current_track_words_ndx;
    }
-   best_fixed_track_weight = best_weight;
+   track_state->best_fixed_track_weight = best_weight;
    // Clear for next time
-   current_track_words_ndx = 0;
+   track_state->current_track_words_ndx = 0;
 }
 
-// Temporary storage for last header found. Only one stored at a time
-static struct {
-   int bit_count;
-   int bit_offset;
-   int tot_bit_count;
-   int word_ndx;
-} mark_data;
-
 
 // Mark start of header in track data we are building
 // Bit count is bit location in word
 // bit_offset is difference between proper header location and bit
 //    count when routine called
 // tot_bit_count is for finding header separation
-void mfm_mark_header_location(int bit_count, int bit_offset, int tot_bit_count) {
+void mfm_mark_header_location(DRIVE_PARAMS *drive_params, int bit_count,
+      int bit_offset, int tot_bit_count) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
    if (bit_count == MARK_STORED) {
-      bit_count = mark_data.bit_count;
-      bit_offset = mark_data.bit_offset;
-      tot_bit_count = mark_data.tot_bit_count;
-      header_track_word_ndx = MAX(mark_data.word_ndx - 1, 0);
+      bit_count = track_state->mark_data.bit_count;
+      bit_offset = track_state->mark_data.bit_offset;
+      tot_bit_count = track_state->mark_data.tot_bit_count;
+      track_state->header_track_word_ndx = MAX(track_state->mark_data.word_ndx - 1, 0);
    } else {
-      header_track_word_ndx = MAX(current_track_words_ndx - 1, 0);
+      track_state->header_track_word_ndx = MAX(track_state->current_track_words_ndx - 1, 0);
    }
 #if PRINT_SPACING
-   if (header_track_tot_bit_count != 0 && (tot_bit_count) > 
-        header_track_tot_bit_count) {
+   if (track_state->header_track_tot_bit_count != 0 && (tot_bit_count) > 
+        track_state->header_track_tot_bit_count) {
       msg(MSG_INFO, "Header to header difference %.1f bytes bit count %d\n", 
-        (tot_bit_count - header_track_tot_bit_count) / 16.0, tot_bit_count);
+        (tot_bit_count - track_state->header_track_tot_bit_count) / 16.0, tot_bit_count);
       msg(MSG_INFO, "Data to header difference %.1f header to data %.1f bytes\n", 
-        (tot_bit_count - data_tot_bit_count) / 16.0,
-        (data_tot_bit_count - header_track_tot_bit_count) / 16.0);
+        (tot_bit_count - track_state->data_tot_bit_count) / 16.0,
+        (track_state->data_tot_bit_count - track_state->header_track_tot_bit_count) / 16.0);
    } else {
       msg(MSG_INFO, "First Header %.1f bytes\n", tot_bit_count / 16.0);
    }
@@ -1866,7 +2116,7 @@ void mfm_mark_header_location(int bit_count, int bit_offset, int tot_bit_count)
    // Back up 1 word to ensure we copy the header mark pattern
    // We don't have to be accurate since we can change some of
    // the gap words.
-   header_track_tot_bit_count = tot_bit_count - bit_offset;
+   track_state->header_track_tot_bit_count = tot_bit_count - bit_offset;
 }
 
 // Mark start of data in track data we are building
@@ -1874,34 +2124,39 @@ void mfm_mark_header_location(int bit_count, int bit_offset, int tot_bit_count)
 // bit_offset is difference between proper header location and bit
 //    count when routine called
 // tot_bit_count is for finding header separation
-void mfm_mark_data_location(int bit_count, int bit_offset, int tot_bit_count) {
+void mfm_mark_data_location(DRIVE_PARAMS *drive_params, int bit_count,
+      int bit_offset, int tot_bit_count) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
    if (bit_count == MARK_STORED) {
-      bit_count = mark_data.bit_count;
-      bit_offset = mark_data.bit_offset;
-      tot_bit_count = mark_data.tot_bit_count;
-      data_word_ndx = mark_data.word_ndx;
+      bit_count = track_state->mark_data.bit_count;
+      bit_offset = track_state->mark_data.bit_offset;
+      tot_bit_count = track_state->mark_data.tot_bit_count;
+      track_state->data_word_ndx = track_state->mark_data.word_ndx;
    } else {
       // Here we have to be accurate since we need to just replace the data
-      data_word_ndx = current_track_words_ndx;
+      track_state->data_word_ndx = track_state->current_track_words_ndx;
    }
 
    // Shift to correct bit and word index based on bit_offset
-   data_bit = bit_count - bit_offset;
-   if (data_bit >= 32) {
-      data_bit -= 32;
-      data_word_ndx++;
+   track_state->data_bit = bit_count - bit_offset;
+   if (track_state->data_bit >= 32) {
+      track_state->data_bit -= 32;
+      track_state->data_word_ndx++;
    }
-   if (data_bit < 0) {
-      data_bit += 32;
-      data_word_ndx--;
+   if (track_state->data_bit < 0) {
+      track_state->data_bit += 32;
+      track_state->data_word_ndx--;
    }
-   data_tot_bit_count = tot_bit_count - bit_offset;
+   track_state->data_tot_bit_count = tot_bit_count - bit_offset;
 }
 
 // This returns the bit count for the start of the last data area
 // Only valid after mfm_mark_data_location called
-int mfm_get_data_bit_count() {
-   return data_tot_bit_count;
+int mfm_get_data_bit_count(DRIVE_PARAMS *drive_params) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   return track_state->data_tot_bit_count;
 }
 
 // Mark start of header type to be determined later
@@ -1909,27 +2164,30 @@ int mfm_get_data_bit_count() {
 // bit_offset is difference between proper header location and bit
 //    count when routine called
 // tot_bit_count is for finding header separation
-void mfm_mark_location(int bit_count, int bit_offset, int tot_bit_count) {
-
-   mark_data.word_ndx = current_track_words_ndx;
-   mark_data.bit_count = bit_count;
-   mark_data.bit_offset = bit_offset;
-   mark_data.tot_bit_count = tot_bit_count;
+void mfm_mark_location(DRIVE_PARAMS *drive_params, int bit_count,
+      int bit_offset, int tot_bit_count) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   track_state->mark_data.word_ndx = track_state->current_track_words_ndx;
+   track_state->mark_data.bit_count = bit_count;
+   track_state->mark_data.bit_offset = bit_offset;
+   track_state->mark_data.tot_bit_count = tot_bit_count;
 }
 
 // Mark end of data in track data we are building
 // Bit count is bit location in work
 void mfm_mark_end_data(int bit_count, DRIVE_PARAMS *drive_params, int cyl, int head) {
+   TRACK_STATE *track_state = drive_params->track_state;
 
-   if (drive_params->emu_track_data_bytes > 0 && current_track_words_ndx*4 >=
+   if (drive_params->emu_track_data_bytes > 0 && track_state->current_track_words_ndx*4 >=
           drive_params->emu_track_data_bytes) {
       msg(MSG_ERR, "Warning: Track data truncated writing to emulation file by %d bytes, need %d words cyl %d head %d\n",
-           current_track_words_ndx*4 - drive_params->emu_track_data_bytes+
-           (bit_count+7)/8, current_track_words_ndx, cyl, head);
+           track_state->current_track_words_ndx*4 - drive_params->emu_track_data_bytes+
+           (bit_count+7)/8, track_state->current_track_words_ndx, cyl, head);
       drive_params->stats.emu_data_truncated = 1;
    }
-   if (current_track_words_ndx > drive_params->stats.max_track_words) {
-      drive_params->stats.max_track_words = current_track_words_ndx;
+   if (track_state->current_track_words_ndx > drive_params->stats.max_track_words) {
+      drive_params->stats.max_track_words = track_state->current_track_words_ndx;
    }
 }
 
@@ -1940,6 +2198,7 @@ void mfm_mark_end_data(int bit_count, DRIVE_PARAMS *drive_params, int cyl, int h
 static void update_emu_track_sector(DRIVE_PARAMS *drive_params, SECTOR_STATUS 
       *sector_status, int sect_rel0, uint8_t bytes[], int num_bytes, 
      int update) {
+   TRACK_STATE *track_state = drive_params->track_state;
    int i, bit;
    int word_ndx;
    int last_bit;
@@ -1948,18 +2207,18 @@ static void update_emu_track_sector(DRIVE_PARAMS *drive_params, SECTOR_STATUS
 
    if (sector_status->ecc_span_corrected_data != 0) {
 #if 0
-      printf("updating %d %d to %d, %d\n", sect_rel0, header_track_word_ndx,
-            current_track_words_ndx, num_bytes);
-      printf("word ndx %d bit %d\n", data_word_ndx, data_bit);
+      printf("updating %d %d to %d, %d\n", sect_rel0, track_state->header_track_word_ndx,
+            track_state->current_track_words_ndx, num_bytes);
+      printf("word ndx %d bit %d\n", track_state->data_word_ndx, track_state->data_bit);
 #endif
-      bit_num = 31 - data_bit;
-      word_ndx = data_word_ndx;
+      bit_num = 31 - track_state->data_bit;
+      word_ndx = track_state->data_word_ndx;
       bit_num += 1;
       if (bit_num > 31) {
          bit_num -= 32;
          word_ndx--;
       }
-      last_bit = (current_track_words[word_ndx] & (1 << bit_num)) >> bit_num;
+      last_bit = (track_state->current_track_words[word_ndx] & (1 << bit_num)) >> bit_num;
       bit_num -= 2;
       if (bit_num < 0) {
          bit_num += 32;
@@ -1978,12 +2237,12 @@ static void update_emu_track_sector(DRIVE_PARAMS *drive_params, SECTOR_STATUS
             }
             last_bit = pat64 & 1;
 
-            word64 = ((uint64_t) current_track_words[word_ndx-1] << 32) |
-                  current_track_words[word_ndx];
+            word64 = ((uint64_t) track_state->current_track_words[word_ndx-1] << 32) |
+                  track_state->current_track_words[word_ndx];
             mask64 = 0x3ll << bit_num;
             word64 = (word64 & ~mask64) | (pat64 << bit_num);
-            current_track_words[word_ndx-1] = word64 >> 32;
-            current_track_words[word_ndx] = word64;
+            track_state->current_track_words[word_ndx-1] = word64 >> 32;
+            track_state->current_track_words[word_ndx] = word64;
             bit_num -= 2;
             if (bit_num < 0) {
                bit_num += 32;
@@ -1995,13 +2254,37 @@ static void update_emu_track_sector(DRIVE_PARAMS *drive_params, SECTOR_STATUS
    // If cyl or head changed we are starting a new track so don't copy it
    // here. update_emu_track_words will copy the entire track. If update
    // isn't set this data isn't better so don't copy it.
-   if (sector_status->cyl == last_cyl && sector_status->head == last_head &&
+   if (sector_status->cyl == track_state->last_cyl && sector_status->head == track_state->last_head &&
         update) {
-      int start = MAX(0, header_track_word_ndx -  
+      int start = MAX(0, track_state->header_track_word_ndx -  
          mfm_controller_info[drive_params->controller].copy_extra);
-      for (i = start; i < current_track_words_ndx; i++) {
-         best_fixed_track_words[i] = current_track_words[i];
-      }
+      for (i = start; i < track_state->current_track_words_ndx; i++) {
+         track_state->best_fixed_track_words[i] = track_state->current_track_words[i];
+      }
+   // Decoding the first read of a track in a different thread. The
+   // previous track isn't in this track state so save the words for
+   // mfm_track_state_start_track to copy.
+   } else if (track_state->last_cyl == -1 && track_state->prev_cyl != -1 &&
+        sector_status->cyl == track_state->prev_cyl && 
+        sector_status->head == track_state->prev_head && update) {
+      int start = MAX(0, track_state->header_track_word_ndx -  
+         mfm_controller_info[drive_params->controller].copy_extra);
+      if (track_state->prev_fixed_words == NULL) {
+         track_state->prev_fixed_words = msg_malloc(
+            sizeof(*track_state->prev_fixed_words) * MAX_TRACK_WORDS,
+            "Previous track words");
+         track_state->prev_fixed_valid = msg_malloc(
+            sizeof(*track_state->prev_fixed_valid) * MAX_TRACK_WORDS,
+            "Previous track valid");
+         memset(track_state->prev_fixed_valid, 0, 
+            sizeof(*track_state->prev_fixed_valid) * MAX_TRACK_WORDS);
+      }
+      for (i = start; i < track_state->current_track_words_ndx; i++) {
+         track_state->prev_fixed_words[i] = track_state->current_track_words[i];
+         track_state->prev_fixed_valid[i] = 1;
+      }
+      track_state->prev_fixed_count = MAX(track_state->prev_fixed_count,
+         track_state->current_track_words_ndx);
    }
 }
 
@@ -2016,6 +2299,8 @@ static void update_emu_track_sector(DRIVE_PARAMS *drive_params, SECTOR_STATUS
 int mfm_save_raw_word(DRIVE_PARAMS *drive_params, int all_raw_bits_count, 
    int int_bit_pos, int raw_word)
 {
+   TRACK_STATE *track_state = drive_params->track_state;
+
    uint32_t tmp;
    // Get shift to move unprocessed bits to MSB
    int shift = 32 - all_raw_bits_count;
@@ -2035,19 +2320,19 @@ int mfm_save_raw_word(DRIVE_PARAMS *drive_params, int all_raw_bits_count,
       tmp |= 1;
    }
    // Save word
-   if (current_track_words_ndx < ARRAYSIZE(current_track_words)) {
-      current_track_words[current_track_words_ndx++] = tmp;
+   if (track_state->current_track_words_ndx < ARRAYSIZE(track_state->current_track_words)) {
+      track_state->current_track_words[track_state->current_track_words_ndx++] = tmp;
    } else {
       msg(MSG_FATAL, "Current track words overflow index %d\n", 
-          current_track_words_ndx);
+          track_state->current_track_words_ndx);
       exit(1);
    }
 
    // Add any more zeros in int_bit_pos until it is less than 32. Those
    // bits will be added to raw_word by caller.
    while (int_bit_pos >= 32) {
-      if (current_track_words_ndx < ARRAYSIZE(current_track_words)) {
-         current_track_words[current_track_words_ndx++] = 0;
+      if (track_state->current_track_words_ndx < ARRAYSIZE(track_state->current_track_words)) {
+         track_state->current_track_words[track_state->current_track_words_ndx++] = 0;
          int_bit_pos -= 32;
       } else {
          msg(MSG_FATAL, "Current track words overflow\n");
@@ -2058,6 +2343,97 @@ int mfm_save_raw_word(DRIVE_PARAMS *drive_params, int all_raw_bits_count,
    return int_bit_pos;
 }
 
+// Save the raw words for PLL steps the decoder skipped. This gives the
+// same result as calling mfm_save_raw_word for each step. The words are
+// copied from the PLL_TRACK packed raw bits.
+//
+// drive_params: Drive parameters
+// track: Track the steps are from
+// all_raw_bits_count: How many bits left in raw_word to process
+// start_step: First step skipped
+// end_step: Step after last step skipped
+// start_bit: Bit position before first step skipped
+// return: all_raw_bits_count after the steps
+int mfm_save_raw_steps(DRIVE_PARAMS *drive_params, PLL_TRACK *track,
+   int all_raw_bits_count, int start_step, int end_step, int start_bit)
+{
+   TRACK_STATE *track_state = drive_params->track_state;
+   int end_bit = start_bit;
+   int num_words;
+   int i;
+
+   if (drive_params->emulation_filename == NULL ||
+          !drive_params->emulation_output) {
+      // mfm_save_raw_word returns 0 when not saving words
+      for (i = start_step; i < end_step; i++) {
+         all_raw_bits_count += track->steps[i].bits;
+         if (all_raw_bits_count >= 32) {
+            all_raw_bits_count = 0;
+         }
+      }
+      return all_raw_bits_count;
+   }
+   for (i = start_step; i < end_step; i++) {
+      end_bit += track->steps[i].bits;
+   }
+   // Emulation words are written when all 32 bits are known. Word n
+   // is packed raw word n + 1.
+   num_words = end_bit / 32 - start_bit / 32;
+   if (track_state->current_track_words_ndx + num_words >
+         ARRAYSIZE(track_state->current_track_words)) {
+      msg(MSG_FATAL, "Current track words overflow index %d\n",
+          track_state->current_track_words_ndx + num_words);
+      exit(1);
+   }
+   memcpy(&track_state->current_track_words[track_state->current_track_words_ndx],
+      &track->raw_words[start_bit / 32 + 1], num_words * sizeof(uint32_t));
+   track_state->current_track_words_ndx += num_words;
+   return end_bit % 32;
+}
+
+// Data byte for 16 raw MFM bits. Same as decoding each 4 bits with
+// the decoders code_bits table so invalid codes give the same result.
+static uint8_t decode_table[65536];
+static pthread_once_t decode_table_once = PTHREAD_ONCE_INIT;
+
+// Fill in decode_table
+static void decode_table_init(void)
+{
+   // Data bits for 4 raw bits. Invalid codes are 0
+   static const int code_bits[16] =
+      { 0, 1, 0, 0, 2, 3, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0 };
+   int i;
+
+   for (i = 0; i < ARRAYSIZE(decode_table); i++) {
+      decode_table[i] = (code_bits[(i >> 12) & 0xf] << 6) |
+         (code_bits[(i >> 8) & 0xf] << 4) | (code_bits[(i >> 4) & 0xf] << 2) |
+         code_bits[i & 0xf];
+   }
+}
+
+// Decode data bytes from the PLL_TRACK packed raw bits. Each byte is 16
+// raw bits.
+//
+// track: Track with packed raw bits
+// start_bit: Bit position of the raw bit before the first byte
+// bytes: Where to store the bytes
+// num_bytes: Number of bytes to decode. The raw bits must be available
+void mfm_decode_raw_bytes(PLL_TRACK *track, int start_bit, uint8_t bytes[],
+   int num_bytes)
+{
+   // Bit index in raw_words of the first bit of the byte
+   unsigned int ndx = start_bit + 1 + 31;
+   uint64_t v;
+   int i;
+
+   pthread_once(&decode_table_once, decode_table_init);
+   for (i = 0; i < num_bytes; i++, ndx += 16) {
+      v = ((uint64_t) track->raw_words[ndx / 32] << 32) |
+         track->raw_words[ndx / 32 + 1];
+      bytes[i] = decode_table[(v << (ndx % 32)) >> 48];
+   }
+}
+
 // This adds to alternate track link list the data that needs to be
 // swapped to put the good data in the proper location in the extracted
 // data file for replacing entire track.
@@ -2170,13 +2546,12 @@ void mfm_handle_alt_LBA(DRIVE_PARAMS *drive_params, unsigned int bad_LBA,
    }
 }
 
-// Indexed by from sector. Value is to sector
-int remap_list[MAX_SECTORS];
-
 // Clear the remap list
-void mfm_clear_remap_list(void) {
-   for (int i = 0; i < ARRAYSIZE(remap_list); i++) {
-      remap_list[i] = -1;
+void mfm_clear_remap_list(DRIVE_PARAMS *drive_params) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   for (int i = 0; i < ARRAYSIZE(track_state->remap_list); i++) {
+      track_state->remap_list[i] = -1;
    }
 }
 
@@ -2186,13 +2561,15 @@ void mfm_clear_remap_list(void) {
 // drive_params: Drive parameters
 // from_sector: Sector that should be moved
 // to_sector: Sector it should be moved to
-void mfm_remap_track_sectors(unsigned int from_sector, unsigned int to_sector) {
+void mfm_remap_track_sectors(DRIVE_PARAMS *drive_params,
+      unsigned int from_sector, unsigned int to_sector) {
+   TRACK_STATE *track_state = drive_params->track_state;
 
-   if (from_sector >= ARRAYSIZE(remap_list)) {
+   if (from_sector >= ARRAYSIZE(track_state->remap_list)) {
       msg(MSG_FATAL, "remap_list overflow\n");
       exit(1);
    }
-   remap_list[from_sector] = to_sector;
+   track_state->remap_list[from_sector] = to_sector;
 }
       
 // This is used to remap sectors on a track. Used for --xebec_skew option.
@@ -2203,6 +2580,7 @@ void mfm_remap_track_sectors(unsigned int from_sector, unsigned int to_sector) {
 // head: Head to remap
 void mfm_remap_track(DRIVE_PARAMS *drive_params,
    unsigned int cyl, unsigned int head) {
+   TRACK_STATE *track_state = drive_params->track_state;
    off_t offset;
    uint8_t data_in[MAX_SECTOR_SIZE * MAX_SECTORS];
    uint8_t data_out[MAX_SECTOR_SIZE * MAX_SECTORS];
@@ -2225,9 +2603,9 @@ void mfm_remap_track(DRIVE_PARAMS *drive_params,
          exit(1);
       }
       int remap_entries = 0;
-      for (int i = 0; i < ARRAYSIZE(remap_list); i++) {
-         if (remap_list[i] != -1) {
-            memcpy(&data_out[remap_list[i] * drive_params->sector_size],
+      for (int i = 0; i < ARRAYSIZE(track_state->remap_list); i++) {
+         if (track_state->remap_list[i] != -1) {
+            memcpy(&data_out[track_state->remap_list[i] * drive_params->sector_size],
                &data_in[i * drive_params->sector_size],
                drive_params->sector_size);
             remap_entries++;
@@ -2250,11 +2628,12 @@ void mfm_remap_track(DRIVE_PARAMS *drive_params,
 //
 // drive_params: Drive parameters
 static void print_missing_cyl(DRIVE_PARAMS *drive_params) {
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
    int i;
    int cyl_missing = 0;
 
    for (i = 0; i < drive_params->num_cyl; i++) {
-      if (cyl_found[i] == 0) {
+      if (decode_ctx->cyl_found[i] == 0) {
          cyl_missing = 1;
          break;
       }
@@ -2262,7 +2641,7 @@ static void print_missing_cyl(DRIVE_PARAMS *drive_params) {
    if (cyl_missing) {
       printf("Cylinders not found\n");
       for (i = 0; i < drive_params->num_cyl; i++) {
-         if (cyl_found[i] == 0) {
+         if (decode_ctx->cyl_found[i] == 0) {
             printf("  %d\n",i);
          }
       }
@@ -2285,3 +2664,314 @@ int mfm_fix_head(DRIVE_PARAMS *drive_params, int exp_head, int head) {
       return head;
    }
 }
+
+// Returns non zero if tracks for this format can be decoded in parallel
+// using mfm_track_state functions. Some formats carry information between
+// tracks when decoding so tracks must be decoded in order.
+//
+// drive_params: Drive parameters
+int mfm_track_state_parallel_ok(DRIVE_PARAMS *drive_params) {
+   if (drive_params->ignore_seek_errors || drive_params->xebec_skew) {
+      return 0;
+   }
+   switch (drive_params->controller) {
+      // First spared sector found changes format_adjust
+      case CONTROLLER_ADAPTEC:
+      case CONTROLLER_ADAPTEC_4000_18SECTOR_512B:
+      // Sector 0 and zone information used by following tracks
+      case CONTROLLER_SHUGART_CD9963:
+      // Track timing from previous track used
+      case CONTROLLER_IMS_A820:
+      // Messages printed only when value changes from previous track
+      case CONTROLLER_SOUYZ_NEON:
+      case CONTROLLER_DILOG_DQ614:
+      case CONTROLLER_ND100_3041:
+         return 0;
+      default:
+         return 1;
+   }
+}
+
+// Allocate a track state for decoding a track in a different thread.
+// return: Track state
+TRACK_STATE *mfm_track_state_alloc(void) {
+   TRACK_STATE *state;
+
+   state = msg_malloc(sizeof(*state), "Track state");
+   memset(state, 0, sizeof(*state));
+   state->last_cyl = -1;
+   state->last_head = -1;
+   state->prev_cyl = -1;
+   state->prev_head = -1;
+   return state;
+}
+
+// Free a track state from mfm_track_state_alloc
+//
+// state: Track state to free
+void mfm_track_state_free(TRACK_STATE *state) {
+   if (state != NULL) {
+      free(state->write_log);
+      free(state->prev_fixed_words);
+      free(state->prev_fixed_valid);
+      free(state->decode_ctx);
+      mfm_pll_track_free(state->pll_track);
+      if (state->fuse != NULL) {
+         for (int i = 0; i < MAX_SECTORS; i++) {
+            free(state->fuse->reads[i]);
+         }
+         free(state->fuse);
+      }
+      free(state);
+   }
+}
+
+// Prepare for decoding a track with job_drive_params. Writes to the
+// extract files are saved until mfm_track_state_done is called. The
+// decode context is copied so the job doesn't change the drive_params one.
+// Formats allowed by mfm_track_state_parallel_ok don't change it between
+// tracks so the copies don't need to be merged back.
+//
+// drive_params: Parameters for drive
+// job_drive_params: Returns copy of drive_params to decode track with
+// state: Track state to decode track with
+// prev_cyl, prev_head: Track decoded before this one or -1 if none
+void mfm_track_state_setup(DRIVE_PARAMS *drive_params, 
+      DRIVE_PARAMS *job_drive_params, TRACK_STATE *state, int prev_cyl,
+      int prev_head) {
+   STATS *stats = &job_drive_params->stats;
+
+   *job_drive_params = *drive_params;
+   job_drive_params->track_state = state;
+   if (state->decode_ctx == NULL) {
+      state->decode_ctx = msg_malloc(sizeof(*state->decode_ctx), 
+         "Track decode context");
+   }
+   *state->decode_ctx = *drive_params->decode_ctx;
+   // Only used with --ignore_seek_errors which decodes tracks in order
+   state->decode_ctx->sector_good = NULL;
+   state->decode_ctx->sector_crc = NULL;
+   job_drive_params->decode_ctx = state->decode_ctx;
+   memset(stats, 0, sizeof(*stats));
+   stats->min_sect = INT_MAX;
+   stats->min_head = INT_MAX;
+   stats->min_cyl = INT_MAX;
+   job_drive_params->alt_llist = NULL;
+
+   state->last_cyl = -1;
+   state->last_head = -1;
+   state->current_track_words_ndx = 0;
+   state->log_writes = 1;
+   state->write_log_len = 0;
+   if (state->fuse != NULL) {
+      state->fuse->cyl = -1;
+   }
+   state->prev_cyl = prev_cyl;
+   state->prev_head = prev_head;
+   if (state->prev_fixed_count > 0) {
+      memset(state->prev_fixed_valid, 0, 
+         sizeof(*state->prev_fixed_valid) * state->prev_fixed_count);
+      state->prev_fixed_count = 0;
+   }
+   state->last_cyl_print = -2;
+   state->last_head_print = -2;
+   state->first_cyl_print = -2;
+   state->first_head_print = -2;
+   state->print_capture = NULL;
+}
+
+// Apply the changes decoding with job_drive_params made to the previous
+// track so the results are the same as decoding the tracks in order. Call
+// before printing the messages from the job and before 
+// mfm_track_state_end_track.
+//
+// drive_params: Parameters for drive. Track state holds previous track
+// job_drive_params: Parameters track decoded with
+void mfm_track_state_start_track(DRIVE_PARAMS *drive_params, 
+      DRIVE_PARAMS *job_drive_params) {
+   TRACK_STATE *state = job_drive_params->track_state;
+   TRACK_STATE *last_state = drive_params->track_state;
+   int i;
+
+   for (i = 0; i < state->prev_fixed_count; i++) {
+      if (state->prev_fixed_valid[i]) {
+         last_state->best_fixed_track_words[i] = state->prev_fixed_words[i];
+      }
+   }
+   // Remove message the previous track already printed. If none printed
+   // keep the value from the previous track.
+   if (state->first_cyl_print != -2) {
+      if (state->first_cyl_print == last_state->last_cyl_print &&
+            state->first_head_print == last_state->last_head_print) {
+         msg_capture_remove(state->print_capture, state->print_capture_pos);
+      }
+   } else if (state->last_cyl_print == -2) {
+      state->last_cyl_print = last_state->last_cyl_print;
+      state->last_head_print = last_state->last_head_print;
+   }
+   state->print_capture = NULL;
+}
+
+// Process the last track decoded with the drive_params track state. This
+// writes the emulation file track, updates statistics, and prints the sector
+// errors for the track.
+//
+// drive_params: Parameters for drive
+void mfm_track_state_end_track(DRIVE_PARAMS *drive_params) {
+   update_stats(drive_params, -1, -1, NULL);
+}
+
+// Forget the last track decoded with the drive_params track state without
+// processing it. Used when the track will be decoded again later so
+// statistics and errors are only updated once.
+//
+// drive_params: Parameters for drive
+void mfm_track_state_discard_track(DRIVE_PARAMS *drive_params) {
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   track_state->last_cyl = -1;
+   track_state->last_head = -1;
+   track_state->current_track_words_ndx = 0;
+}
+
+// Perform the extract file writes saved when decoding with job_drive_params
+// and merge the statistics and alternate track list into drive_params. The
+// job track state holds the last track decoded so it becomes the 
+// drive_params track state. Must be called in the order the tracks were read.
+//
+// drive_params: Parameters for drive. Stats and alternate track list updated
+// job_drive_params: Parameters track decoded with
+// return: Previous drive_params track state for reuse
+TRACK_STATE *mfm_track_state_done(DRIVE_PARAMS *drive_params, 
+      DRIVE_PARAMS *job_drive_params) {
+   STATS *stats = &drive_params->stats;
+   STATS *job_stats = &job_drive_params->stats;
+   TRACK_STATE *state = job_drive_params->track_state;
+   TRACK_STATE *last_state = drive_params->track_state;
+   WRITE_LOG_ENTRY entry;
+   ALT_INFO *alt_info, *alt_next, *alt_reversed = NULL;
+   int ndx = 0;
+   int rc;
+
+   while (ndx < state->write_log_len) {
+      memcpy(&entry, &state->write_log[ndx], sizeof(entry));
+      ndx += sizeof(entry);
+      if ((rc = pwrite(entry.fd, &state->write_log[ndx], entry.len,
+            entry.offset)) != entry.len) {
+         msg(MSG_FATAL, "Write failed, rc %d: %s", rc, strerror(errno));
+         exit(1);
+      }
+      ndx += entry.len;
+   }
+   state->write_log_len = 0;
+   state->log_writes = 0;
+
+   stats->max_sect = MAX(job_stats->max_sect, stats->max_sect);
+   stats->min_sect = MIN(job_stats->min_sect, stats->min_sect);
+   stats->max_head = MAX(job_stats->max_head, stats->max_head);
+   stats->min_head = MIN(job_stats->min_head, stats->min_head);
+   stats->max_cyl = MAX(job_stats->max_cyl, stats->max_cyl);
+   stats->min_cyl = MIN(job_stats->min_cyl, stats->min_cyl);
+   stats->max_ecc_span = MAX(job_stats->max_ecc_span, stats->max_ecc_span);
+   stats->max_track_words = MAX(job_stats->max_track_words, 
+      stats->max_track_words);
+   stats->emu_data_truncated |= job_stats->emu_data_truncated;
+
+   // List is newest first. Reverse it so we add in the order found with
+   // the same duplicate check as mfm_handle_alt_track_ch.
+   for (alt_info = job_drive_params->alt_llist; alt_info != NULL; 
+         alt_info = alt_next) {
+      alt_next = alt_info->next;
+      alt_info->next = alt_reversed;
+      alt_reversed = alt_info;
+   }
+   for (alt_info = alt_reversed; alt_info != NULL; alt_info = alt_next) {
+      alt_next = alt_info->next;
+      if (drive_params->alt_llist == NULL ||
+            alt_info->bad_offset != drive_params->alt_llist->bad_offset ||
+            alt_info->good_offset != drive_params->alt_llist->good_offset) {
+         alt_info->next = drive_params->alt_llist;
+         drive_params->alt_llist = alt_info;
+      } else {
+         free(alt_info);
+      }
+   }
+   job_drive_params->alt_llist = NULL;
+
+   drive_params->track_state = state;
+   job_drive_params->track_state = NULL;
+   return last_state;
+}
+
+// Free the decoder state allocated by mfm_decode_setup. Call after
+// mfm_decode_done if drive_params will not be used for decoding again.
+//
+// drive_params: Parameters for drive
+void mfm_decode_free(DRIVE_PARAMS *drive_params) {
+   if (drive_params->decode_ctx != NULL) {
+      free(drive_params->decode_ctx->sector_good);
+      free(drive_params->decode_ctx->sector_crc);
+      free(drive_params->decode_ctx);
+      drive_params->decode_ctx = NULL;
+   }
+   mfm_track_state_free(drive_params->track_state);
+   drive_params->track_state = NULL;
+}
+
+// Save the bytes checked by mfm_crc_bytes in capture instead of checking
+// them. All checks fail while saving so the track decodes the same as it
+// would with CRC parameters that don't match any header. This allows
+// analyze to decode the track once then test many CRC parameters with
+// mfm_crc_capture_match. The header CRC length and controller must not be
+// changed since they determine the bytes the decoder checks.
+//
+// drive_params: Drive parameters
+// capture: Where to save the bytes, NULL to stop saving
+void mfm_crc_capture_set(DRIVE_PARAMS *drive_params, CRC_CAPTURE *capture) {
+   if (capture != NULL) {
+      capture->len = 0;
+      capture->non_header = 0;
+   }
+   drive_params->track_state->crc_capture = capture;
+}
+
+// Check the headers saved in capture with the drive_params CRC parameters.
+//
+// drive_params: Drive parameters
+// capture: Bytes saved while decoding track
+// return: Non zero if the track needs to be decoded with these parameters. 
+//   A header matched or the saved bytes can't show how the track will decode
+int mfm_crc_capture_match(DRIVE_PARAMS *drive_params, CRC_CAPTURE *capture) {
+   uint64_t crc;
+   int ecc_span;
+   SECTOR_DECODE_STATUS init_status;
+   int bytes_crc_len;
+   int ndx = 0;
+
+   // ECC correction could make a header good so can't tell without decoding
+   if (capture->non_header || drive_params->header_crc.ecc_max_span != 0) {
+      return 1;
+   }
+   while (ndx < capture->len) {
+      memcpy(&bytes_crc_len, &capture->buf[ndx], sizeof(bytes_crc_len));
+      ndx += sizeof(bytes_crc_len);
+      init_status = 0;
+      mfm_crc_bytes(drive_params, &capture->buf[ndx], bytes_crc_len,
+         PROCESS_HEADER, &crc, &ecc_span, &init_status, 0);
+      if (crc == 0) {
+         return 1;
+      }
+      ndx += bytes_crc_len;
+   }
+   return 0;
+}
+
+// Free the memory used by capture.
+//
+// capture: Capture to free buffer of
+void mfm_crc_capture_free(CRC_CAPTURE *capture) {
+   free(capture->buf);
+   capture->buf = NULL;
+   capture->len = 0;
+   capture->size = 0;
+}
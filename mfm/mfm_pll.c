@@ -0,0 +1,714 @@
+// This module is the PLL (phase locked loop) used by the decoders to
+// convert delta transition times into the number of bit cells between
+// transitions.
+// mfm_pll_init initializes the PLL for a track
+// mfm_pll_block converts deltas into bit cell counts
+// mfm_pll_track_start and mfm_pll_track_get_count convert a track's deltas
+//    into bit cell counts for the decoders. The counts are kept so
+//    decoding the same track again such as during analyze doesn't redo
+//    the conversion.
+// mfm_pll_track_set_alt selects one of the alternate PLL settings for
+//    decoding tracks that had errors with the normal settings.
+// mfm_pll_track_set_bits gives the bits from an emulation file to use
+//    instead of deltas. The bits are already clock recovered so the steps
+//    are made directly from them without the PLL.
+// mfm_pll_track_find searches the packed raw bits of the track for a
+//    pattern such as a mark code. mfm_pll_track_raw_word gets the raw
+//    bits ending at a bit position.
+//
+// The fixed point version is the default. It uses integer math and finds
+// the number of bit cells with a multiply instead of stepping the clock one
+// bit cell at a time. The floating point version gives the same results
+// as the previous code in the decoders and can be selected with --float_pll.
+//
+// 10/17/26 DJG Added alternate PLL loop gains and decision windows
+// 10/17/26 DJG Added mfm_pll_track_set_bits to decode emulation file bits
+//    without synthesizing deltas
+// 10/17/26 DJG Added packed raw bits and mfm_pll_track_find
+// 10/17/26 DJG Added mfm_pll_track routines
+// 10/17/26 DJG Initial version. Moved from the decoders and added
+//    fixed point version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "msg.h"
+#include "crc_ecc.h"
+#include "emu_tran_file.h"
+#include "mfm_decoder.h"
+#include "deltas_read.h"
+#include "mfm_pll.h"
+
+// Filter coefficients. The fixed point ones are scaled by 2^PLL_COEF_BITS
+#define PLL_COEF_A 0.034446428576716f
+#define PLL_COEF_B -0.034124999994713f
+#define PLL_COEF_BITS 30
+
+// Alternate PLL settings. The loop gain multiplies the filter coefficients.
+// The window offset moves the point between bit cells where a transition
+// is counted in the next cell, in fractions of a bit cell. Entry 0 is the
+// normal setting.
+static const struct {
+   float gain;
+   float window_offset;
+} alt_settings[MFM_PLL_NUM_ALT] = {
+   {1.0, 0}, {0.5, 0}, {2.0, 0}, {1.0, 0.1}, {1.0, -0.1}, {0.5, 0.1},
+   {0.5, -0.1}
+};
+
+// Number of 64 bit chunks mfm_pll_track_find checks at once
+#define FIND_CHUNKS 16
+
+// Type II PLL. Converted from continuous time
+// by bilinear transformation. Coefficients adjusted to work best with
+// my data. Could use some more work.
+static inline float filter(MFM_PLL *pll, float v, float *delay)
+{
+   float in, out;
+
+   in = v + *delay;
+   out = in * pll->coef_a + *delay * pll->coef_b;
+   *delay = in;
+   return out;
+}
+
+// Fixed point version of filter.
+static inline int32_t filter_fix(MFM_PLL *pll, int64_t v, int64_t *delay)
+{
+   int64_t in, out;
+
+   in = v + *delay;
+   out = (in * pll->coef_a_fix + *delay * pll->coef_b_fix) >> PLL_COEF_BITS;
+   *delay = in;
+   return out;
+}
+
+// Initialize the PLL for decoding a track.
+//
+// pll: PLL state to initialize
+// nominal_bit_sep_time: Bit cell time in 200 MHz clocks
+// split_delta: Non zero to process deltas longer than 22 bit cells in
+//    multiple steps
+// use_float: Non zero to use floating point version
+void mfm_pll_init(MFM_PLL *pll, float nominal_bit_sep_time, int split_delta,
+   int use_float)
+{
+   memset(pll, 0, sizeof(*pll));
+   pll->use_float = use_float;
+   if (split_delta) {
+      pll->max_delta = nominal_bit_sep_time * 22;
+   }
+   pll->nominal_bit_sep_time = nominal_bit_sep_time;
+   pll->avg_bit_sep_time = nominal_bit_sep_time;
+   pll->nominal_bit_sep_time_fix = lrintf(nominal_bit_sep_time *
+      (1 << PLL_FRAC_BITS));
+   pll->avg_bit_sep_time_fix = pll->nominal_bit_sep_time_fix;
+   pll->nominal_recip = ((uint64_t) 1 << 48) / pll->nominal_bit_sep_time_fix;
+   mfm_pll_set_alt(pll, 0);
+}
+
+// Select the PLL loop gain and decision window. Call after mfm_pll_init.
+//
+// pll: PLL state
+// alt: Alternate setting, 0 to MFM_PLL_NUM_ALT - 1. 0 is the normal setting
+void mfm_pll_set_alt(MFM_PLL *pll, int alt)
+{
+   float gain = alt_settings[alt].gain;
+
+   pll->coef_a = PLL_COEF_A * gain;
+   pll->coef_b = PLL_COEF_B * gain;
+   pll->coef_a_fix = pll->coef_a * (1 << PLL_COEF_BITS) + 0.5;
+   pll->coef_b_fix = pll->coef_b * (1 << PLL_COEF_BITS) - 0.5;
+   pll->window_offset = alt_settings[alt].window_offset;
+   pll->window_offset_fix = lrintf(pll->window_offset * (1 << PLL_FRAC_BITS));
+}
+
+// Get the next delta to process. Long deltas are split into max_delta
+// pieces.
+//
+// return: Delta to process
+static inline int next_delta(MFM_PLL *pll, uint16_t deltas[], int *ndx)
+{
+   int delta_process;
+
+   // If no remaining delta process next else finish remaining
+   if (pll->remaining_delta == 0) {
+      delta_process = deltas[(*ndx)++];
+      pll->remaining_delta = delta_process;
+   }  else {
+      delta_process = pll->remaining_delta;
+   }
+   // Don't overflow the decoders 32 bit word
+   if (pll->max_delta != 0 && delta_process > pll->max_delta) {
+      delta_process = pll->max_delta;
+   }
+   pll->remaining_delta -= delta_process;
+   return delta_process;
+}
+
+// Make room for bit index ndx in the packed raw bits. An even number of
+// words plus extra are kept so mfm_pll_track_find can read 64 bit chunks
+// past the end.
+//
+// track: Track to make room in
+// ndx: Bit index needed
+static void grow_raw_words(PLL_TRACK *track, unsigned int ndx)
+{
+   int old_size = track->raw_words_size;
+
+   track->raw_words_size = ((ndx / 32) * 2 + 4096) & ~1;
+   track->raw_words = realloc(track->raw_words,
+      track->raw_words_size * sizeof(*track->raw_words));
+   if (track->raw_words == NULL) {
+      msg(MSG_FATAL, "Malloc failed PLL raw words size %d\n",
+         track->raw_words_size);
+      exit(1);
+   }
+   memset(&track->raw_words[old_size], 0,
+      (track->raw_words_size - old_size) * sizeof(*track->raw_words));
+}
+
+// Make room for more steps.
+//
+// track: Track to make room in
+static void grow_steps(PLL_TRACK *track)
+{
+   track->steps_size = track->steps_size * 2 + 65536;
+   track->steps = realloc(track->steps,
+      track->steps_size * sizeof(*track->steps));
+   if (track->steps == NULL) {
+      msg(MSG_FATAL, "Malloc failed PLL steps size %d\n",
+         track->steps_size);
+      exit(1);
+   }
+}
+
+// Add the raw MFM bits for a step to the packed raw bits. This is done
+// in the PLL loop where it mostly overlaps the PLL calculation.
+//
+// track: Track to add to
+// bits: Number of bit cells for step
+static inline void pack_step(PLL_TRACK *track, int bits)
+{
+   unsigned int ndx;
+
+   track->zero_bit_steps += bits == 0;
+   track->num_raw_bits += bits;
+   ndx = track->num_raw_bits + 31;
+   if (ndx / 32 + 3 > track->raw_words_size) {
+      grow_raw_words(track, ndx + 96);
+   }
+   track->raw_words[ndx / 32] |= 0x80000000u >> (ndx % 32);
+}
+
+// Original floating point PLL
+static int block_float(MFM_PLL *pll, uint16_t deltas[], int *ndx,
+   int num_deltas, PLL_BITS bits[], PLL_TRACK *track)
+{
+   int count;
+   int delta_process;
+   int int_bit_pos;
+   float clock_time = pll->clock_time;
+   float avg_bit_sep_time = pll->avg_bit_sep_time;
+   float half_bit;
+
+   for (count = 0; *ndx < num_deltas && count < PLL_BLOCK; count++) {
+      delta_process = next_delta(pll, deltas, ndx);
+      // This is simulating a PLL/VCO clock sampling the data.
+      clock_time += delta_process;
+      half_bit = avg_bit_sep_time / 2;
+      if (pll->window_offset != 0) {
+         half_bit += avg_bit_sep_time * pll->window_offset;
+      }
+      // Move the clock in current frequency steps and count how many bits
+      // the delta time corresponds to
+      for (int_bit_pos = 0; clock_time > half_bit;
+            clock_time -= avg_bit_sep_time, int_bit_pos++) {
+      }
+      // And then filter based on the time difference between the delta and
+      // the clock. Don't update PLL if this is a long burst without
+      // transitions
+      if (pll->remaining_delta == 0) {
+         avg_bit_sep_time = pll->nominal_bit_sep_time +
+            filter(pll, clock_time, &pll->filter_state);
+      }
+      bits[count].bits = int_bit_pos;
+      bits[count].delta = delta_process;
+      if (track != NULL) {
+         pack_step(track, int_bit_pos);
+      }
+   }
+   pll->clock_time = clock_time;
+   pll->avg_bit_sep_time = avg_bit_sep_time;
+   return count;
+}
+
+// Fixed point PLL. The number of bits is estimated using the nominal bit
+// time then corrected for the current VCO frequency.
+static int block_fix(MFM_PLL *pll, uint16_t deltas[], int *ndx,
+   int num_deltas, PLL_BITS bits[], PLL_TRACK *track)
+{
+   int count;
+   int delta_process;
+   int int_bit_pos;
+   int64_t clock_time = pll->clock_time_fix;
+   int32_t avg_bit_sep_time = pll->avg_bit_sep_time_fix;
+   int32_t half_bit;
+
+   for (count = 0; *ndx < num_deltas && count < PLL_BLOCK; count++) {
+      delta_process = next_delta(pll, deltas, ndx);
+      clock_time += (int64_t) delta_process << PLL_FRAC_BITS;
+      half_bit = avg_bit_sep_time / 2;
+      if (pll->window_offset_fix != 0) {
+         half_bit += ((int64_t) avg_bit_sep_time * pll->window_offset_fix) >>
+            PLL_FRAC_BITS;
+      }
+      int_bit_pos = 0;
+      if (clock_time > half_bit) {
+         int_bit_pos = (((uint64_t) (clock_time - half_bit - 1) *
+            pll->nominal_recip) >> 48) + 1;
+         clock_time -= (int64_t) int_bit_pos * avg_bit_sep_time;
+         // Correct for VCO not at nominal frequency. One step is enough
+         // unless the PLL has moved far from nominal.
+         if (clock_time > half_bit) {
+            clock_time -= avg_bit_sep_time;
+            int_bit_pos++;
+         } else if (clock_time + avg_bit_sep_time <= half_bit) {
+            clock_time += avg_bit_sep_time;
+            int_bit_pos--;
+         }
+         if (clock_time > half_bit ||
+               clock_time + avg_bit_sep_time <= half_bit) {
+            for (; clock_time > half_bit; int_bit_pos++) {
+               clock_time -= avg_bit_sep_time;
+            }
+            for (; clock_time + avg_bit_sep_time <= half_bit; int_bit_pos--) {
+               clock_time += avg_bit_sep_time;
+            }
+         }
+      }
+      if (pll->remaining_delta == 0) {
+         avg_bit_sep_time = pll->nominal_bit_sep_time_fix +
+            filter_fix(pll, clock_time, &pll->filter_state_fix);
+      }
+      bits[count].bits = int_bit_pos;
+      bits[count].delta = delta_process;
+      if (track != NULL) {
+         pack_step(track, int_bit_pos);
+      }
+   }
+   pll->clock_time_fix = clock_time;
+   pll->avg_bit_sep_time_fix = avg_bit_sep_time;
+   return count;
+}
+
+// Convert deltas into the number of bit cells between transitions.
+// Processing stops when PLL_BLOCK steps have been done or
+// all the deltas have been used. Any remaining part of a long delta
+// is processed when more deltas are available.
+//
+// pll: PLL state
+// deltas: Delta transition times in 200 MHz clocks
+// ndx: Next delta to process. Updated to next unprocessed delta
+// num_deltas: Number of deltas available
+// bits: Returns PLL_BLOCK bit cell counts and delta time processed
+// return: Number of entries in bits
+int mfm_pll_block(MFM_PLL *pll, uint16_t deltas[], int *ndx, int num_deltas,
+   PLL_BITS bits[])
+{
+   if (pll->use_float) {
+      return block_float(pll, deltas, ndx, num_deltas, bits, NULL);
+   } else {
+      return block_fix(pll, deltas, ndx, num_deltas, bits, NULL);
+   }
+}
+
+// Hash of the deltas to check if the track is the same as the last one
+// converted. Retries read into the same buffer.
+//
+// deltas: Delta transition times
+// num_deltas: Number of deltas
+// return: Hash value
+static uint64_t deltas_hash(uint16_t deltas[], int num_deltas)
+{
+   uint64_t hash = num_deltas;
+   uint64_t v;
+   int i;
+
+   for (i = 0; i + 4 <= num_deltas; i += 4) {
+      memcpy(&v, &deltas[i], sizeof(v));
+      hash = (hash ^ v) * 0x100000001b3ull;
+   }
+   for (; i < num_deltas; i++) {
+      hash = (hash ^ deltas[i]) * 0x100000001b3ull;
+   }
+   return hash;
+}
+
+// Get the PLL_TRACK for the track state, allocating it if needed.
+//
+// drive_params: Drive parameters. The track state holds the PLL_TRACK
+// return: The PLL_TRACK
+static PLL_TRACK *get_track(DRIVE_PARAMS *drive_params)
+{
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   if (track_state->pll_track == NULL) {
+      track_state->pll_track = msg_malloc(sizeof(*track_state->pll_track),
+         "PLL track");
+      memset(track_state->pll_track, 0, sizeof(*track_state->pll_track));
+   }
+   return track_state->pll_track;
+}
+
+// Clear the steps and raw bits for converting a new track.
+//
+// track: Track to clear
+static void clear_track(PLL_TRACK *track)
+{
+   track->num_steps = 0;
+   track->num_raw_bits = 0;
+   track->zero_bit_steps = 0;
+   if (track->raw_words != NULL) {
+      memset(track->raw_words, 0,
+         track->raw_words_size * sizeof(*track->raw_words));
+   }
+}
+
+// Make the steps from the emulation file bits. The number of bit cells
+// for a step is the distance between ones. The step delta is the time
+// from index of the one less the time of the previous one, rounded to
+// 200 MHz clocks the same as emu_file_read_track_deltas does. Like the
+// deltas the bits before the first one aren't used. Long steps are split
+// like the PLL does so the decoders see the same bits.
+//
+// track: Track to make steps for
+// split_delta: Non zero to split steps longer than 22 bit cells
+static void bits_to_steps(PLL_TRACK *track, int split_delta)
+{
+   int last_pos = -1;
+   int pos, bits, max_bits;
+   int wc;
+   uint32_t word;
+   uint64_t time, last_time = 0;
+
+   // Limit steps so the delta fits in 16 bits
+   max_bits = ((uint64_t) 65535 << 32) / track->bit_clocks;
+   if (split_delta && max_bits > 22) {
+      max_bits = 22;
+   }
+   for (wc = 0; wc < track->bit_num_words; wc++) {
+      word = track->bit_words[wc];
+      while (word != 0) {
+         pos = wc * 32 + __builtin_clz(word);
+         word &= ~(0x80000000u >> (pos % 32));
+         if (last_pos >= 0) {
+            while (pos > last_pos) {
+               bits = MIN(pos - last_pos, max_bits);
+               last_pos += bits;
+               time = ((uint64_t) last_pos * track->bit_clocks +
+                  (1u << 31)) >> 32;
+               if (track->num_steps >= track->steps_size) {
+                  grow_steps(track);
+               }
+               track->steps[track->num_steps].bits = bits;
+               track->steps[track->num_steps].delta = time - last_time;
+               track->num_steps++;
+               pack_step(track, bits);
+               last_time = time;
+            }
+         } else {
+            last_pos = pos;
+            last_time = ((uint64_t) pos * track->bit_clocks +
+               (1u << 31)) >> 32;
+         }
+      }
+   }
+}
+
+// Use emulation file bits instead of deltas for the tracks started until
+// this is called with words NULL. The bits must be at the decoder's
+// bit rate since the PLL isn't used to change it.
+//
+// drive_params: Drive parameters. The track state holds the bits
+// words: Emulation file track bits or NULL to use deltas again
+// num_words: Number of words in words
+// sample_rate_hz: Bit rate of the emulation file
+void mfm_pll_track_set_bits(DRIVE_PARAMS *drive_params, uint32_t words[],
+   int num_words, int sample_rate_hz)
+{
+   PLL_TRACK *track = get_track(drive_params);
+
+   track->bit_words = words;
+   track->bit_num_words = num_words;
+   if (words != NULL) {
+      // 200 MHz clocks per bit cell << 32
+      track->bit_clocks = ((uint64_t) 200000000 << 32) / sample_rate_hz;
+   }
+   // Don't reuse steps from before
+   track->complete = 0;
+}
+
+// Use the alternate PLL setting for the tracks started until this is
+// called with alt 0. Each track state has its own setting so tracks can be
+// decoded in parallel with different settings.
+//
+// drive_params: Drive parameters. The track state holds the setting
+// alt: Alternate setting, 0 to MFM_PLL_NUM_ALT - 1. 0 is the normal setting
+void mfm_pll_track_set_alt(DRIVE_PARAMS *drive_params, int alt)
+{
+   PLL_TRACK *track = get_track(drive_params);
+
+   track->alt = alt;
+}
+
+// Start converting a track of deltas into bit cell counts. The steps
+// are retrieved with mfm_pll_track_get_count. If the previous track
+// converted with this track state had the same deltas and PLL settings
+// its steps are reused. If emulation file bits were given with
+// mfm_pll_track_set_bits the steps are made from them and the deltas
+// and PLL settings other than split_delta aren't used.
+//
+// drive_params: Drive parameters. The track state holds the steps
+// deltas: Delta transition times
+// nominal_bit_sep_time: Bit cell time in 200 MHz clocks
+// split_delta: Non zero to process long deltas in multiple steps
+// return: Bit cell counts for track
+PLL_TRACK *mfm_pll_track_start(DRIVE_PARAMS *drive_params, uint16_t deltas[],
+   float nominal_bit_sep_time, int split_delta)
+{
+   PLL_TRACK *track = get_track(drive_params);
+   int num_deltas;
+
+   if (track->bit_words != NULL) {
+      if (!track->complete || track->split_delta != split_delta) {
+         clear_track(track);
+         track->split_delta = split_delta;
+         bits_to_steps(track, split_delta);
+         track->complete = 1;
+      }
+      return track;
+   }
+   num_deltas = deltas_get_count(0);
+   // Reuse steps only if all the deltas have been read
+   if (track->complete && track->deltas == deltas &&
+         track->num_deltas == num_deltas &&
+         track->nominal_bit_sep_time == nominal_bit_sep_time &&
+         track->split_delta == split_delta &&
+         track->use_float == drive_params->float_pll &&
+         track->alt_used == track->alt &&
+         deltas_get_count(num_deltas) == -1 &&
+         track->deltas_hash == deltas_hash(deltas, num_deltas)) {
+      return track;
+   }
+   clear_track(track);
+   track->deltas = deltas;
+   // The first delta isn't used
+   track->delta_ndx = 1;
+   track->num_deltas = num_deltas;
+   track->last_deltas = 0;
+   track->complete = num_deltas < 0;
+   track->nominal_bit_sep_time = nominal_bit_sep_time;
+   track->split_delta = split_delta;
+   track->use_float = drive_params->float_pll;
+   mfm_pll_init(&track->pll, nominal_bit_sep_time, split_delta,
+      drive_params->float_pll);
+   mfm_pll_set_alt(&track->pll, track->alt);
+   track->alt_used = track->alt;
+   return track;
+}
+
+// Return the number of steps available. If the caller has processed all
+// the steps converted so far more deltas are converted, waiting for them
+// if the track is still being read.
+//
+// track: Track from mfm_pll_track_start
+// steps_processed: Number of steps the caller has processed
+// return: Number of steps available or -1 if all processed
+int mfm_pll_track_get_count(PLL_TRACK *track, int steps_processed)
+{
+   int num;
+
+   while (steps_processed >= track->num_steps && !track->complete) {
+      if (track->delta_ndx < track->num_deltas) {
+         // Convert all the deltas we have
+         while (track->delta_ndx < track->num_deltas) {
+            if (track->num_steps + PLL_BLOCK > track->steps_size) {
+               grow_steps(track);
+            }
+            if (track->use_float) {
+               num = block_float(&track->pll, track->deltas, &track->delta_ndx,
+                  track->num_deltas, &track->steps[track->num_steps], track);
+            } else {
+               num = block_fix(&track->pll, track->deltas, &track->delta_ndx,
+                  track->num_deltas, &track->steps[track->num_steps], track);
+            }
+            track->num_steps += num;
+         }
+      } else {
+         // Finished what we had, any more?
+         // If we didn't get too many last time sleep so delta reader can run.
+         // Thread priorities might be better.
+         if (track->num_deltas - track->last_deltas <= 2000) {
+            usleep(500);
+         }
+         track->last_deltas = track->num_deltas;
+         num = deltas_get_count(track->delta_ndx);
+         if (num < 0) {
+            track->complete = 1;
+            track->deltas_hash = deltas_hash(track->deltas, track->num_deltas);
+         } else {
+            track->num_deltas = num;
+         }
+      }
+   }
+   if (steps_processed >= track->num_steps) {
+      return -1;
+   } else {
+      return track->num_steps;
+   }
+}
+
+// Free PLL_TRACK
+//
+// track: Track to free
+void mfm_pll_track_free(PLL_TRACK *track)
+{
+   if (track != NULL) {
+      free(track->steps);
+      free(track->raw_words);
+      free(track);
+   }
+}
+
+// Get the 64 bit chunk of the packed raw bits. Chunk c holds the bits for
+// positions 64 * c - 31 to 64 * c + 32.
+//
+// track: Track to get bits from
+// c: Chunk to get
+// return: The raw bits
+static inline uint64_t get_chunk(PLL_TRACK *track, int c)
+{
+   if (c < 0) {
+      return 0;
+   }
+   return ((uint64_t) track->raw_words[c * 2] << 32) |
+      track->raw_words[c * 2 + 1];
+}
+
+// Find the first bit position in the packed raw bits where the raw bits
+// ending at that position match pattern. This is the position where
+// raw_word in the decoders would first match the pattern. The chunks are
+// checked with the same shift for all so the compiler can vectorize the
+// compares.
+//
+// track: Track to search
+// pattern: Pattern to search for. The LSB is the last bit
+// pattern_bits: Number of bits in pattern. 64 max
+// start_bit: Search positions after this bit position
+// end_bit: Last bit position to search. Limited to the bits available
+// return: Bit position of match or -1 if not found
+int mfm_pll_track_find(PLL_TRACK *track, uint64_t pattern, int pattern_bits,
+   int start_bit, int end_bit)
+{
+   uint64_t cur[FIND_CHUNKS], prev[FIND_CHUNKS], match[FIND_CHUNKS];
+   // The first bits are checked for all chunks in the group before
+   // the rest are checked.
+   int first_bits = pattern_bits < 16 ? pattern_bits : 16;
+   int start_chunk, end_chunk, c, b, j;
+   uint64_t invert;
+
+   if (end_bit > track->num_raw_bits) {
+      end_bit = track->num_raw_bits;
+   }
+   if (start_bit >= end_bit) {
+      return -1;
+   }
+   // Convert bit positions to bit index in raw_words
+   start_chunk = (start_bit + 1 + 31) / 64;
+   end_chunk = (end_bit + 31) / 64;
+   for (c = start_chunk; c <= end_chunk; c += FIND_CHUNKS) {
+      int num_chunks = end_chunk - c + 1;
+      uint64_t any = 0;
+
+      if (num_chunks > FIND_CHUNKS) {
+         num_chunks = FIND_CHUNKS;
+      }
+      for (b = 0; b < FIND_CHUNKS; b++) {
+         cur[b] = b < num_chunks ? get_chunk(track, c + b) : 0;
+         prev[b] = b < num_chunks ? get_chunk(track, c + b - 1) : 0;
+         invert = (pattern & 1) ? 0 : ~(uint64_t) 0;
+         match[b] = cur[b] ^ invert;
+      }
+      // Bit j of the pattern is j bits before the bit being checked
+      for (j = 1; j < first_bits; j++) {
+         invert = ((pattern >> j) & 1) ? 0 : ~(uint64_t) 0;
+         for (b = 0; b < FIND_CHUNKS; b++) {
+            match[b] &= ((cur[b] >> j) | (prev[b] << (64 - j))) ^ invert;
+         }
+      }
+      for (b = 0; b < num_chunks; b++) {
+         any |= match[b];
+      }
+      if (any == 0) {
+         continue;
+      }
+      for (j = first_bits; j < pattern_bits; j++) {
+         invert = ((pattern >> j) & 1) ? 0 : ~(uint64_t) 0;
+         for (b = 0; b < FIND_CHUNKS; b++) {
+            match[b] &= ((cur[b] >> j) | (prev[b] << (64 - j))) ^ invert;
+         }
+      }
+      for (b = 0; b < num_chunks; b++) {
+         // Remove positions outside the range being searched
+         int first = (c + b) * 64 - 31;
+         if (start_bit + 1 > first) {
+            match[b] &= ~(uint64_t) 0 >> (start_bit + 1 - first);
+         }
+         if (end_bit < first + 63) {
+            match[b] &= ~(~(uint64_t) 0 >> (end_bit - first + 1));
+         }
+         if (match[b] != 0) {
+            return first + __builtin_clzll(match[b]);
+         }
+      }
+   }
+   return -1;
+}
+
+// Return the 32 raw bits ending at bit_pos. This is the raw_word value
+// the decoders have after processing the step ending at bit_pos.
+//
+// track: Track to get bits from
+// bit_pos: Bit position of last bit
+// return: Raw bits
+uint32_t mfm_pll_track_raw_word(PLL_TRACK *track, int bit_pos)
+{
+   int ndx = bit_pos + 31;
+   int word = ndx / 32;
+   int shift = 31 - ndx % 32;
+   uint64_t v;
+
+   v = ((uint64_t) (word > 0 ? track->raw_words[word - 1] : 0) << 32) |
+      track->raw_words[word];
+   return v >> shift;
+}
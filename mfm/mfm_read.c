@@ -5,6 +5,8 @@
 // TODO Make handle more complex interleave like RD53 (cyl to cyl is 8, track
 // to track is -1 or 16)
 //
+// 10/17/26 DJG Don't allow mfm_util --alt_pll option
+// 10/17/26 DJG Don't allow mfm_util --jobs option
 // 10/30/24 DJG Add new option to handle Xebec data skewed one sector from 
 //    header
 // 10/09/23 Remove interleave as option so ext2emu can be parsed better
@@ -119,7 +121,7 @@ int main(int argc, char *argv[])
 
    // Find out what we should do
    // M is only for ext2emu. i no longer used by mfm_read/util
-   parse_cmdline(argc, argv, &drive_params, "Mi", 1, 0, 0, 0);
+   parse_cmdline(argc, argv, &drive_params, "MiJA", 1, 0, 0, 0);
    parse_validate_options(&drive_params, 1);
 
    // If they specified a file name then we read the disk
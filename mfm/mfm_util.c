@@ -1,6 +1,25 @@
 // This is a utility program to process existing MFM delta transition data.
 // Used to extract the sector contents to a file
 //
+// 10/17/26 DJG mfm_util and ext2emu don't allow --pipeline_reads
+// 10/17/26 DJG Alternate PLL decode threads started once and tracks
+//    queued to them
+// 10/17/26 DJG ext2emu only decompresses extracted data files with
+//    compressed file extension
+// 10/17/26 DJG Alternate PLL decodes don't build emulation track words
+// 10/17/26 DJG Each --jobs job gets previous track so output matches
+//    decoding in order. Free decoder state when done
+// 10/17/26 DJG Added --alt_pll to decode tracks with errors again with
+//    alternate PLL settings
+// 10/17/26 DJG ext2emu doesn't allow --fuse_reads
+// 10/17/26 DJG mfm_util and ext2emu don't allow --defer_retries
+// 10/17/26 DJG ext2emu reads compressed extracted data files
+// 10/17/26 DJG mfm_util and ext2emu don't allow --compress_transitions
+// 10/17/26 DJG Decode emulation file bits directly instead of converting
+//    them to deltas when the bit rate matches the format
+// 10/17/26 DJG ext2emu doesn't allow --float_pll
+// 10/17/26 DJG Track state now passed in DRIVE_PARAMS. Free decode jobs
+// 10/17/26 DJG Added --jobs option to decode tracks in parallel threads
 // 05/15/26 DJG Fixed Xebec special list overflow
 // 09/10/25 DJG Fixed ext2emu marking bad sectors when interleave used
 // 06/12/25 DJG Added missing break
@@ -75,6 +94,7 @@
 #include <math.h>
 #include <stdint.h>
 #include <errno.h>
+#include <pthread.h>
 #include <libiberty.h>
 
 #include "msg.h"
@@ -82,6 +102,7 @@
 #include "emu_tran_file.h"
 #define DEF_DATA
 #include "mfm_decoder.h"
+#include "mfm_pll.h"
 #include "parse_cmdline.h"
 #include "analyze.h"
 #include "deltas_read.h"  // Code is from deltas_read_file.c
@@ -95,13 +116,121 @@ typedef struct {
    uint16_t pattern;
 } SPECIAL_LIST;
 
+// One read of a track for parallel decoding
+typedef struct {
+   uint16_t *deltas;
+   // Size of deltas in words
+   int deltas_size;
+   // Emulation file bits when they are decoded directly and size in words
+   uint32_t *words;
+   int words_size;
+   // Number of deltas or words read
+   int num_read;
+   // Messages from decoding this read
+   MSG_CAPTURE *capture;
+   // Messages from reading the next track after this read
+   MSG_CAPTURE *read_capture;
+} JOB_READ;
+
+// All the reads of one track. Decoded by a worker thread and then finished
+// by the main thread in the order the tracks were read.
+typedef struct {
+   int cyl, head;
+   JOB_READ *reads;
+   int num_reads;
+   // Size of reads array
+   int max_reads;
+   // Copy of drive parameters the track is decoded with
+   DRIVE_PARAMS drive_params;
+   TRACK_STATE *track_state;
+   SECTOR_STATUS sector_status_list[MAX_SECTORS];
+   // Messages from --alt_pll decoding after all the reads
+   MSG_CAPTURE *alt_capture;
+   // Non zero when worker has finished decoding the track
+   int done;
+} DECODE_JOB;
+
+// Decode of a track with an alternate PLL setting
+typedef struct alt_decode {
+   // Alternate PLL setting
+   int alt;
+   // Non zero if the track has been decoded with drive_params using
+   // this setting
+   int used;
+   // Track and reads to decode
+   int cyl, head;
+   JOB_READ *reads;
+   int num_reads;
+   // Drive parameters of the track. Worker decodes with a copy
+   DRIVE_PARAMS *drive_params;
+   SECTOR_STATUS sector_status_list[MAX_SECTORS];
+   // Non zero when worker has finished decoding the track
+   int done;
+   // Next decode in queue
+   struct alt_decode *next;
+} ALT_DECODE;
+
+// Threads for alternate PLL decodes and queue of decodes for them
+typedef struct {
+   pthread_mutex_t mutex;
+   // Signaled when a decode is queued or shutdown set
+   pthread_cond_t work_cond;
+   // Signaled when a decode is done
+   pthread_cond_t done_cond;
+   // Queue of decodes waiting for a thread
+   ALT_DECODE *head, *tail;
+   // Non zero when workers should exit
+   int shutdown;
+   pthread_t *threads;
+   int num_threads;
+} ALT_POOL;
+
+// State shared between main thread and worker threads
+typedef struct {
+   pthread_mutex_t mutex;
+   // Signaled when a job is submitted or shutdown set
+   pthread_cond_t work_cond;
+   // Signaled when a job is done
+   pthread_cond_t done_cond;
+   // Circular buffer of jobs
+   DECODE_JOB *jobs;
+   int num_jobs;
+   // Count of jobs submitted for decoding
+   int num_submitted;
+   // Count of jobs taken by worker threads
+   int num_taken;
+   // Non zero when workers should exit
+   int shutdown;
+} JOB_POOL;
+
 void ext2emu(int argc, char *argv[]);
+static int read_track(DRIVE_PARAMS *drive_params, int transition_file,
+      EMU_FILE_INFO *emu_file_info, uint16_t deltas[], uint32_t words[],
+      int *cyl, int *head);
+static void decode_read(DRIVE_PARAMS *drive_params, int cyl, int head,
+      uint16_t deltas[], uint32_t words[], int num_read,
+      int *seek_difference, SECTOR_STATUS sector_status_list[]);
+static void decode_tracks_parallel(DRIVE_PARAMS *drive_params, 
+      int transition_file, EMU_FILE_INFO *emu_file_info, uint16_t deltas[],
+      uint32_t words[], int num_read, int cyl, int head);
+static JOB_READ *save_read(JOB_READ **reads, int *num_reads, int *max_reads,
+      uint16_t deltas[], uint32_t words[], int num_read);
+static void free_reads(JOB_READ *reads, int max_reads);
+static void alt_pll_start(int num_threads);
+static void alt_pll_stop(void);
+static void alt_pll_decode(DRIVE_PARAMS *drive_params, int cyl, int head,
+      JOB_READ reads[], int num_reads, SECTOR_STATUS sector_status_list[]);
+
+static ALT_POOL alt_pool;
 
 // Main routine
 int main (int argc, char *argv[])
 {
    uint16_t deltas[MAX_DELTAS];
-   int num_deltas;
+   // Emulation file bits if decoding them directly, otherwise NULL
+   uint32_t *words = NULL;
+   // Number of deltas or words read
+   int num_read;
    int cyl, head;
    int last_cyl = -1, last_head = -1;
    DRIVE_PARAMS drive_params;
@@ -113,6 +242,10 @@ int main (int argc, char *argv[])
    int transition_file = 1;
    EMU_FILE_INFO emu_file_info;
    TRAN_FILE_INFO tran_file_info;
+   // Reads of the current track for --alt_pll
+   JOB_READ *track_reads = NULL;
+   int num_track_reads = 0;
+   int max_track_reads = 0;
 
    // Handle extracted data to emulator file conversion
    if (strcmp(basename(argv[0]),"ext2emu") == 0) {
@@ -177,7 +310,7 @@ int main (int argc, char *argv[])
 
    // Now parse the full command line. This allows overriding options that
    // were in the transition file header.
-   parse_cmdline(argc, argv, &drive_params, "Mrdi", 0, 0, 0, 0);
+   parse_cmdline(argc, argv, &drive_params, "MrdiCDp", 0, 0, 0, 0);
    // Save final parameters
    drive_params.cmdline = parse_print_cmdline(&drive_params, 0, 0);
 
@@ -198,6 +331,7 @@ int main (int argc, char *argv[])
          if (drive_params.emu_fd == -1) {
             drive_params.emu_fd = emu_file_read_header(
                drive_params.emulation_filename, &emu_file_info, 0, 0);
+            drive_params.emu_file_info = &emu_file_info;
          }
       }
    }
@@ -247,15 +381,38 @@ int main (int argc, char *argv[])
    // Setup decoding of transitions and possible file to write to
    mfm_decode_setup(&drive_params, 1);
 
-   if (transition_file) {
-      num_deltas = tran_file_read_track_deltas(drive_params.tran_fd,
-            deltas, MAX_DELTAS, &cyl, &head);
-   } else {
-      num_deltas = emu_file_read_track_deltas(drive_params.emu_fd,
-            &emu_file_info, deltas, MAX_DELTAS, &cyl, &head);
+   if (drive_params.jobs > 1 && 
+         !mfm_track_state_parallel_ok(&drive_params)) {
+      msg(MSG_INFO, "Format or options require decoding tracks in order, --jobs ignored\n");
+      drive_params.jobs = 1;
+   }
+   if (drive_params.alt_pll && 
+         !mfm_track_state_parallel_ok(&drive_params)) {
+      msg(MSG_INFO, "Format or options require decoding tracks in order, --alt_pll ignored\n");
+      drive_params.alt_pll = 0;
+   }
+
+   // Emulation file bits are already clock recovered so decode them
+   // without converting to deltas for the PLL if they are the right rate
+   if (!transition_file &&
+         mfm_decode_bits_ok(&drive_params, emu_file_info.sample_rate_hz)) {
+      words = msg_malloc(sizeof(*words) * MAX_TRACK_WORDS, "Track words");
+   }
+   num_read = read_track(&drive_params, transition_file, &emu_file_info,
+      deltas, words, &cyl, &head);
+   if (drive_params.jobs > 1) {
+      decode_tracks_parallel(&drive_params, transition_file, &emu_file_info,
+         deltas, words, num_read, cyl, head);
+      mfm_decode_done(&drive_params);
+      mfm_decode_free(&drive_params);
+      free(words);
+      return 0;
+   }
+   if (drive_params.alt_pll) {
+      alt_pll_start(MFM_PLL_NUM_ALT - 1);
    }
    // Read and process a track at a time until all read
-   while (num_deltas >= 0) {
+   while (num_read >= 0) {
       if (cyl % 10 == 0 && head == 0)
          msg(MSG_PROGRESS, "At cyl %d\r", cyl);
       // Only clear status if we are moving to the next track. If retries
@@ -266,11 +423,15 @@ int main (int argc, char *argv[])
          if (last_cyl != -1) {
             mfm_end_track(&drive_params, last_cyl, last_head);
          }
+         num_track_reads = 0;
+      }
+      if (drive_params.alt_pll) {
+         save_read(&track_reads, &num_track_reads, &max_track_reads,
+            deltas, words, num_read);
       }
       //printf("Decoding new track %d %d\n",cyl, head);
-      deltas_update_count(num_deltas, 0);
       // If head & cylinder haven't changed assume it's a retry.
-      mfm_decode_track(&drive_params, cyl, head, deltas,
+      decode_read(&drive_params, cyl, head, deltas, words, num_read,
             &seek_difference, sector_status_list);
 #if 0
       if (1 || status != SECT_HEADER_FOUND) {
@@ -280,7 +441,7 @@ int main (int argc, char *argv[])
             int i;
             sprintf(fn, "trk%d-%d.txt",cyl, head);
             file = fopen(fn, "w");
-            for (i = 0; i < num_deltas; i++) {
+            for (i = 0; i < num_read; i++) {
                fprintf(file, "%d\n",deltas[i]);
             }
             fclose(file);
@@ -289,30 +450,568 @@ int main (int argc, char *argv[])
 #endif
       last_cyl = cyl;
       last_head = head;
-      if (transition_file) {
-         num_deltas = tran_file_read_track_deltas(drive_params.tran_fd,
-               deltas, MAX_DELTAS, &cyl, &head);
-         while (head >= drive_params.num_head) {
-            static int msg_printed = 0;
-            if (!msg_printed) {
-               msg(MSG_INFO, "Warning, data has more heads than specified. Data for head >= %d ignored\n", head);
-               msg_printed = 1;
-            }
-            num_deltas = tran_file_read_track_deltas(drive_params.tran_fd,
-               deltas, MAX_DELTAS, &cyl, &head);
-         }
-      } else {
-         num_deltas = emu_file_read_track_deltas(drive_params.emu_fd,
-               &emu_file_info, deltas, MAX_DELTAS, &cyl, &head);
+      num_read = read_track(&drive_params, transition_file, &emu_file_info,
+         deltas, words, &cyl, &head);
+      // All reads of the track decoded. Try alternate PLL settings before
+      // the sector status list is cleared for the next track
+      if (drive_params.alt_pll && 
+            (num_read < 0 || last_cyl != cyl || last_head != head)) {
+         alt_pll_decode(&drive_params, last_cyl, last_head, 
+            track_reads, num_track_reads, sector_status_list);
       }
    }
    if (last_cyl != -1) {
       mfm_end_track(&drive_params, last_cyl, last_head);
    }
+   if (drive_params.alt_pll) {
+      alt_pll_stop();
+   }
    mfm_decode_done(&drive_params);
+   mfm_decode_free(&drive_params);
+   free_reads(track_reads, max_track_reads);
+   free(words);
    return 0;
 }
 
+// Read the next track from the transition or emulation file. For transition
+// files tracks for heads not in the drive parameters are skipped.
+//
+// drive_params: Drive parameters
+// transition_file: Non zero if reading transition file, zero for emulation
+// emu_file_info: Emulation file information
+// deltas: Where to store the track deltas
+// words: Where to store the emulation file bits. If NULL the emulation
+//    file bits are converted to deltas
+// cyl, head: Returns track read
+// return: Number of deltas or words read, -1 at end of file
+static int read_track(DRIVE_PARAMS *drive_params, int transition_file,
+      EMU_FILE_INFO *emu_file_info, uint16_t deltas[], uint32_t words[],
+      int *cyl, int *head)
+{
+   int num_read;
+
+   if (transition_file) {
+      num_read = tran_file_read_track_deltas(drive_params->tran_fd,
+            deltas, MAX_DELTAS, cyl, head);
+      while (*head >= drive_params->num_head) {
+         static int msg_printed = 0;
+         if (!msg_printed) {
+            msg(MSG_INFO, "Warning, data has more heads than specified. Data for head >= %d ignored\n", *head);
+            msg_printed = 1;
+         }
+         num_read = tran_file_read_track_deltas(drive_params->tran_fd,
+            deltas, MAX_DELTAS, cyl, head);
+      }
+   } else if (words != NULL) {
+      num_read = emu_file_read_track_bits(drive_params->emu_fd,
+            emu_file_info, words, MAX_TRACK_WORDS, cyl, head);
+   } else {
+      num_read = emu_file_read_track_deltas(drive_params->emu_fd,
+            emu_file_info, deltas, MAX_DELTAS, cyl, head);
+   }
+   return num_read;
+}
+
+// Decode a track read by read_track.
+//
+// drive_params: Drive parameters
+// cyl, head: Track read
+// deltas: Track deltas if words is NULL
+// words: Emulation file bits to decode directly or NULL
+// num_read: Number of deltas or words
+// seek_difference: Return of difference between expected cyl and header
+// sector_status_list: Return of status of decoded sector
+static void decode_read(DRIVE_PARAMS *drive_params, int cyl, int head,
+      uint16_t deltas[], uint32_t words[], int num_read,
+      int *seek_difference, SECTOR_STATUS sector_status_list[])
+{
+   if (words != NULL) {
+      mfm_decode_track_bits(drive_params, cyl, head, words, num_read,
+         drive_params->emu_file_info->sample_rate_hz, seek_difference,
+         sector_status_list);
+   } else {
+      deltas_update_count(num_read, 0);
+      mfm_decode_track(drive_params, cyl, head, deltas, seek_difference,
+         sector_status_list);
+   }
+}
+
+// Worker thread for decoding tracks. Decodes jobs in the order submitted
+// with messages and file writes saved for the main thread.
+//
+// arg: JOB_POOL to get jobs from
+static void *decode_worker(void *arg)
+{
+   JOB_POOL *pool = arg;
+   DECODE_JOB *job;
+   int seek_difference;
+   int i;
+
+   pthread_mutex_lock(&pool->mutex);
+   while (1) {
+      while (pool->num_taken == pool->num_submitted && !pool->shutdown) {
+         pthread_cond_wait(&pool->work_cond, &pool->mutex);
+      }
+      if (pool->num_taken == pool->num_submitted) {
+         break;
+      }
+      job = &pool->jobs[pool->num_taken++ % pool->num_jobs];
+      pthread_mutex_unlock(&pool->mutex);
+
+      mfm_init_sector_status_list(job->sector_status_list,
+         job->drive_params.num_sectors);
+      for (i = 0; i < job->num_reads; i++) {
+         msg_capture_set(job->reads[i].capture);
+         decode_read(&job->drive_params, job->cyl, job->head,
+            job->reads[i].deltas, job->reads[i].words, job->reads[i].num_read,
+            &seek_difference, job->sector_status_list);
+      }
+      if (job->drive_params.alt_pll) {
+         msg_capture_set(job->alt_capture);
+         alt_pll_decode(&job->drive_params, job->cyl, job->head, job->reads,
+            job->num_reads, job->sector_status_list);
+      }
+      msg_capture_set(NULL);
+
+      pthread_mutex_lock(&pool->mutex);
+      job->done = 1;
+      pthread_cond_broadcast(&pool->done_cond);
+   }
+   pthread_mutex_unlock(&pool->mutex);
+   return NULL;
+}
+
+// Finish a decoded track in the main thread. Messages are printed and
+// extract and emulation file data written in the same order as decoding
+// the tracks one at a time would.
+//
+// drive_params: Drive parameters
+// job: Track decoded
+// last_cyl, last_head: Previous track finished. Updated to this track
+static void finish_job(DRIVE_PARAMS *drive_params, DECODE_JOB *job,
+      int *last_cyl, int *last_head)
+{
+   int i;
+
+   // Apply changes to the previous track from decoding the job
+   mfm_track_state_start_track(drive_params, &job->drive_params);
+   if (*last_cyl != -1) {
+      mfm_end_track(drive_params, *last_cyl, *last_head);
+   }
+   for (i = 0; i < job->num_reads; i++) {
+      if (job->cyl % 10 == 0 && job->head == 0)
+         msg(MSG_PROGRESS, "At cyl %d\r", job->cyl);
+      msg_capture_replay(job->reads[i].capture);
+      // Previous track is processed when first read of new track decoded.
+      if (i == 0 && *last_cyl != -1) {
+         mfm_track_state_end_track(drive_params);
+      }
+      msg_capture_replay(job->reads[i].read_capture);
+   }
+   msg_capture_replay(job->alt_capture);
+   // Track state from job now holds last track and becomes the 
+   // drive_params state. Job gets the previous state to reuse.
+   job->track_state = mfm_track_state_done(drive_params, &job->drive_params);
+   *last_cyl = job->cyl;
+   *last_head = job->head;
+}
+
+// Decode tracks using drive_params->jobs threads. The main thread reads
+// the file and finishes the tracks in order while the worker threads
+// decode. Each track with all its reads is one job.
+//
+// drive_params: Drive parameters
+// transition_file: Non zero if reading transition file, zero for emulation
+// emu_file_info: Emulation file information
+// deltas: Buffer for reading deltas, contains first track read
+// words: Buffer for reading emulation file bits or NULL if not decoding
+//    them directly. Contains first track read
+// num_read, cyl, head: First track read
+static void decode_tracks_parallel(DRIVE_PARAMS *drive_params, 
+      int transition_file, EMU_FILE_INFO *emu_file_info, uint16_t deltas[],
+      uint32_t words[], int num_read, int cyl, int head)
+{
+   JOB_POOL pool;
+   pthread_t threads[drive_params->jobs];
+   DECODE_JOB *job = NULL;
+   DECODE_JOB *oldest;
+   JOB_READ *read;
+   int num_started = 0;
+   int num_finished = 0;
+   int last_cyl = -1, last_head = -1;
+   int prev_cyl = -1, prev_head = -1;
+   int i;
+
+   memset(&pool, 0, sizeof(pool));
+   pthread_mutex_init(&pool.mutex, NULL);
+   pthread_cond_init(&pool.work_cond, NULL);
+   pthread_cond_init(&pool.done_cond, NULL);
+   // Allow reading ahead enough to keep all threads busy
+   pool.num_jobs = drive_params->jobs * 2;
+   pool.jobs = msg_malloc(sizeof(*pool.jobs) * pool.num_jobs, "Decode jobs");
+   memset(pool.jobs, 0, sizeof(*pool.jobs) * pool.num_jobs);
+   for (i = 0; i < pool.num_jobs; i++) {
+      pool.jobs[i].track_state = mfm_track_state_alloc();
+      pool.jobs[i].alt_capture = msg_capture_alloc();
+   }
+   for (i = 0; i < drive_params->jobs; i++) {
+      if (pthread_create(&threads[i], NULL, &decode_worker, &pool) != 0) {
+         msg(MSG_FATAL, "Unable to create decode thread\n");
+         exit(1);
+      }
+   }
+   // Each decode thread can queue all the alternate settings for a track
+   if (drive_params->alt_pll) {
+      alt_pll_start(drive_params->jobs * (MFM_PLL_NUM_ALT - 1));
+   }
+
+   while (1) {
+      // Read tracks until end of file or all jobs in use
+      while (num_read >= 0) {
+         // Track changed, start decoding the reads we have
+         if (job != NULL && (cyl != job->cyl || head != job->head)) {
+            pthread_mutex_lock(&pool.mutex);
+            pool.num_submitted++;
+            pthread_cond_signal(&pool.work_cond);
+            pthread_mutex_unlock(&pool.mutex);
+            job = NULL;
+         }
+         if (job == NULL) {
+            if (num_started - num_finished >= pool.num_jobs) {
+               break;
+            }
+            job = &pool.jobs[num_started++ % pool.num_jobs];
+            job->cyl = cyl;
+            job->head = head;
+            job->num_reads = 0;
+            job->done = 0;
+            mfm_track_state_setup(drive_params, &job->drive_params,
+               job->track_state, prev_cyl, prev_head);
+            prev_cyl = cyl;
+            prev_head = head;
+         }
+         read = save_read(&job->reads, &job->num_reads, &job->max_reads,
+            deltas, words, num_read);
+         if (read->capture == NULL) {
+            read->capture = msg_capture_alloc();
+            read->read_capture = msg_capture_alloc();
+         }
+         msg_capture_set(read->read_capture);
+         num_read = read_track(drive_params, transition_file, emu_file_info,
+            deltas, words, &cyl, &head);
+         msg_capture_set(NULL);
+      }
+      if (num_read < 0 && job != NULL) {
+         pthread_mutex_lock(&pool.mutex);
+         pool.num_submitted++;
+         pthread_cond_signal(&pool.work_cond);
+         pthread_mutex_unlock(&pool.mutex);
+         job = NULL;
+      }
+      if (num_finished == num_started) {
+         break;
+      }
+      // Wait for oldest track then finish it
+      oldest = &pool.jobs[num_finished % pool.num_jobs];
+      pthread_mutex_lock(&pool.mutex);
+      while (!oldest->done) {
+         pthread_cond_wait(&pool.done_cond, &pool.mutex);
+      }
+      pthread_mutex_unlock(&pool.mutex);
+      finish_job(drive_params, oldest, &last_cyl, &last_head);
+      num_finished++;
+   }
+
+   pthread_mutex_lock(&pool.mutex);
+   pool.shutdown = 1;
+   pthread_cond_broadcast(&pool.work_cond);
+   pthread_mutex_unlock(&pool.mutex);
+   for (i = 0; i < drive_params->jobs; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   if (drive_params->alt_pll) {
+      alt_pll_stop();
+   }
+   if (last_cyl != -1) {
+      mfm_end_track(drive_params, last_cyl, last_head);
+   }
+   for (i = 0; i < pool.num_jobs; i++) {
+      free_reads(pool.jobs[i].reads, pool.jobs[i].max_reads);
+      msg_capture_free(pool.jobs[i].alt_capture);
+      mfm_track_state_free(pool.jobs[i].track_state);
+   }
+   free(pool.jobs);
+}
+
+
+// Save a read of a track. The read buffers are reused when the array
+// is reused for another track.
+//
+// reads: Array of reads. Grown if needed
+// num_reads: Number of reads in array. Incremented
+// max_reads: Size of reads array
+// deltas: Track deltas if words is NULL
+// words: Emulation file bits or NULL
+// num_read: Number of deltas or words
+// return: The saved read
+static JOB_READ *save_read(JOB_READ **reads, int *num_reads, int *max_reads,
+      uint16_t deltas[], uint32_t words[], int num_read)
+{
+   JOB_READ *read;
+
+   if (*num_reads >= *max_reads) {
+      *max_reads = *max_reads * 2 + 4;
+      *reads = realloc(*reads, sizeof(**reads) * *max_reads);
+      if (*reads == NULL) {
+         msg(MSG_FATAL, "Malloc failed decode job reads\n");
+         exit(1);
+      }
+      memset(&(*reads)[*num_reads], 0, sizeof(**reads) *
+         (*max_reads - *num_reads));
+   }
+   read = &(*reads)[(*num_reads)++];
+   if (words != NULL) {
+      if (read->words_size < num_read) {
+         free(read->words);
+         read->words_size = num_read;
+         read->words = msg_malloc(sizeof(*read->words) * num_read,
+            "Decode job words");
+      }
+      memcpy(read->words, words, sizeof(*read->words) * num_read);
+   } else {
+      if (read->deltas_size < num_read) {
+         free(read->deltas);
+         read->deltas_size = num_read;
+         read->deltas = msg_malloc(sizeof(*read->deltas) * num_read,
+            "Decode job deltas");
+      }
+      memcpy(read->deltas, deltas, sizeof(*read->deltas) * num_read);
+   }
+   read->num_read = num_read;
+   return read;
+}
+
+// Free the reads saved by save_read
+//
+// reads: Array of reads
+// max_reads: Size of reads array
+static void free_reads(JOB_READ *reads, int max_reads)
+{
+   int r;
+
+   for (r = 0; r < max_reads; r++) {
+      free(reads[r].deltas);
+      free(reads[r].words);
+      msg_capture_free(reads[r].capture);
+      msg_capture_free(reads[r].read_capture);
+   }
+   free(reads);
+}
+
+// Worker thread for alternate PLL decodes. Decodes all the reads of each
+// track taken from the queue with the setting requested. Decode state and
+// message buffer are reused for each track.
+//
+// arg: Not used
+static void *alt_decode_worker(void *arg)
+{
+   ALT_DECODE *alt;
+   DRIVE_PARAMS drive_params;
+   TRACK_STATE *track_state = mfm_track_state_alloc();
+   // Messages from decoding. Not printed
+   MSG_CAPTURE *capture = msg_capture_alloc();
+   int seek_difference;
+   int i;
+
+   pthread_mutex_lock(&alt_pool.mutex);
+   while (1) {
+      while (alt_pool.head == NULL && !alt_pool.shutdown) {
+         pthread_cond_wait(&alt_pool.work_cond, &alt_pool.mutex);
+      }
+      if (alt_pool.head == NULL) {
+         break;
+      }
+      alt = alt_pool.head;
+      alt_pool.head = alt->next;
+      if (alt_pool.head == NULL) {
+         alt_pool.tail = NULL;
+      }
+      pthread_mutex_unlock(&alt_pool.mutex);
+
+      mfm_track_state_setup(alt->drive_params, &drive_params, track_state,
+         -1, -1);
+      // Only the sector status is used. A setting that loses lock can
+      // produce more emulation track words than fit
+      drive_params.emulation_output = 0;
+      // Messages are only for the final decode
+      msg_capture_set(capture);
+      mfm_pll_track_set_alt(&drive_params, alt->alt);
+      mfm_init_sector_status_list(alt->sector_status_list,
+         drive_params.num_sectors);
+      for (i = 0; i < alt->num_reads; i++) {
+         decode_read(&drive_params, alt->cyl, alt->head,
+            alt->reads[i].deltas, alt->reads[i].words, alt->reads[i].num_read,
+            &seek_difference, alt->sector_status_list);
+      }
+      msg_capture_set(NULL);
+      msg_capture_clear(capture);
+
+      pthread_mutex_lock(&alt_pool.mutex);
+      alt->done = 1;
+      pthread_cond_broadcast(&alt_pool.done_cond);
+   }
+   pthread_mutex_unlock(&alt_pool.mutex);
+   msg_capture_free(capture);
+   mfm_track_state_free(track_state);
+   return NULL;
+}
+
+// Start the threads for alternate PLL decodes
+//
+// num_threads: Number of threads to start
+static void alt_pll_start(int num_threads)
+{
+   int i;
+
+   memset(&alt_pool, 0, sizeof(alt_pool));
+   pthread_mutex_init(&alt_pool.mutex, NULL);
+   pthread_cond_init(&alt_pool.work_cond, NULL);
+   pthread_cond_init(&alt_pool.done_cond, NULL);
+   alt_pool.num_threads = num_threads;
+   alt_pool.threads = msg_malloc(sizeof(*alt_pool.threads) * num_threads,
+      "Alternate PLL threads");
+   for (i = 0; i < num_threads; i++) {
+      if (pthread_create(&alt_pool.threads[i], NULL, &alt_decode_worker,
+            NULL) != 0) {
+         msg(MSG_FATAL, "Unable to create alternate PLL decode thread\n");
+         exit(1);
+      }
+   }
+}
+
+// Stop the threads started by alt_pll_start
+static void alt_pll_stop(void)
+{
+   int i;
+
+   pthread_mutex_lock(&alt_pool.mutex);
+   alt_pool.shutdown = 1;
+   pthread_cond_broadcast(&alt_pool.work_cond);
+   pthread_mutex_unlock(&alt_pool.mutex);
+   for (i = 0; i < alt_pool.num_threads; i++) {
+      pthread_join(alt_pool.threads[i], NULL);
+   }
+   free(alt_pool.threads);
+   pthread_cond_destroy(&alt_pool.work_cond);
+   pthread_cond_destroy(&alt_pool.done_cond);
+   pthread_mutex_destroy(&alt_pool.mutex);
+}
+
+// Count the sectors that have errors in sector_status_list but not in
+// alt_status_list.
+//
+// drive_params: Drive parameters
+// sector_status_list: Status of sectors
+// alt_status_list: Status of sectors with alternate setting
+// return: Number of sectors
+static int count_recovered(DRIVE_PARAMS *drive_params,
+      SECTOR_STATUS sector_status_list[], SECTOR_STATUS alt_status_list[])
+{
+   int count = 0;
+   int i;
+
+   for (i = 0; i < drive_params->num_sectors; i++) {
+      if (UNRECOVERED_ERROR(sector_status_list[i].status) &&
+            !UNRECOVERED_ERROR(alt_status_list[i].status)) {
+         count++;
+      }
+   }
+   return count;
+}
+
+// If the track has sectors with errors decode the reads again with the
+// alternate PLL settings. Each setting is queued to the alternate PLL
+// threads which decode without writing the results. The settings that recovered sectors are then used
+// to decode the track again with drive_params, best first, so the best
+// data for each sector is kept the same as for retries.
+//
+// drive_params: Drive parameters
+// cyl, head: Track read
+// reads: Reads of the track
+// num_reads: Number of reads
+// sector_status_list: Status of sectors from decoding the reads. Updated
+static void alt_pll_decode(DRIVE_PARAMS *drive_params, int cyl, int head,
+      JOB_READ reads[], int num_reads, SECTOR_STATUS sector_status_list[])
+{
+   ALT_DECODE alts[MFM_PLL_NUM_ALT - 1];
+   SECTOR_STATUS no_errors[MAX_SECTORS];
+   int recovered, best_recovered, best;
+   int seek_difference;
+   int i;
+
+   // Emulation file bits don't use the PLL
+   if (num_reads == 0 || reads[0].words != NULL) {
+      return;
+   }
+   memset(no_errors, 0, sizeof(no_errors));
+   if (count_recovered(drive_params, sector_status_list, no_errors) == 0) {
+      return;
+   }
+   for (i = 0; i < ARRAYSIZE(alts); i++) {
+      alts[i].alt = i + 1;
+      alts[i].cyl = cyl;
+      alts[i].head = head;
+      alts[i].reads = reads;
+      alts[i].num_reads = num_reads;
+      alts[i].drive_params = drive_params;
+      alts[i].used = 0;
+      alts[i].done = 0;
+      alts[i].next = NULL;
+   }
+   pthread_mutex_lock(&alt_pool.mutex);
+   for (i = 0; i < ARRAYSIZE(alts); i++) {
+      if (alt_pool.tail == NULL) {
+         alt_pool.head = &alts[i];
+      } else {
+         alt_pool.tail->next = &alts[i];
+      }
+      alt_pool.tail = &alts[i];
+   }
+   pthread_cond_broadcast(&alt_pool.work_cond);
+   for (i = 0; i < ARRAYSIZE(alts); i++) {
+      while (!alts[i].done) {
+         pthread_cond_wait(&alt_pool.done_cond, &alt_pool.mutex);
+      }
+   }
+   pthread_mutex_unlock(&alt_pool.mutex);
+
+   // Decode with the settings that recover the most sectors still with
+   // errors until no more can be recovered
+   do {
+      best_recovered = 0;
+      best = -1;
+      for (i = 0; i < ARRAYSIZE(alts); i++) {
+         recovered = count_recovered(drive_params, sector_status_list,
+            alts[i].sector_status_list);
+         if (!alts[i].used && recovered > best_recovered) {
+            best_recovered = recovered;
+            best = i;
+         }
+      }
+      if (best >= 0) {
+         msg(MSG_INFO, "Alternate PLL setting %d recovered %d sectors cyl %d head %d\n",
+            alts[best].alt, best_recovered, cyl, head);
+         alts[best].used = 1;
+         mfm_pll_track_set_alt(drive_params, alts[best].alt);
+         for (i = 0; i < num_reads; i++) {
+            decode_read(drive_params, cyl, head, reads[i].deltas, 
+               reads[i].words, reads[i].num_read, &seek_difference, 
+               sector_status_list);
+         }
+         mfm_pll_track_set_alt(drive_params, 0);
+      }
+   } while (best >= 0);
+}
 
 // Reverse bit ordering in word
 // value: Value to reverse
@@ -520,13 +1219,13 @@ static void get_data(DRIVE_PARAMS *drive_params, uint8_t track[], int length) {
        drive_params->num_sectors + sector -
        drive_params->first_sector_number;
 
-   if (lseek(drive_params->ext_fd, 
+   if (emu_tran_seek(drive_params->ext_fd, 
           block * drive_params->sector_size, SEEK_SET) == -1) {
       msg(MSG_FATAL, "Failed to seek to sector in extracted data file %s\n", 
            strerror(errno));
       exit(1);
    }
-   if ((rc = read(drive_params->ext_fd, track, 
+   if ((rc = emu_tran_read(drive_params->ext_fd, track, 
          drive_params->sector_size)) != drive_params->sector_size) {
       msg(MSG_FATAL, "Failed to read extracted data file rc %d %s\n", rc,
             rc == -1 ? strerror(errno): "");
@@ -552,13 +1251,13 @@ static void get_metadata(DRIVE_PARAMS *drive_params, uint8_t track[], int length
        drive_params->num_sectors + get_sector(drive_params) -
        drive_params->first_sector_number;
 
-   if (lseek(drive_params->ext_metadata_fd, 
+   if (emu_tran_seek(drive_params->ext_metadata_fd, 
           block * drive_params->metadata_bytes, SEEK_SET) == -1) {
       msg(MSG_FATAL, "Failed to seek to sector in extracted metadata file %s\n", 
            strerror(errno));
       exit(1);
    }
-   if ((rc = read(drive_params->ext_metadata_fd, track, 
+   if ((rc = emu_tran_read(drive_params->ext_metadata_fd, track, 
          drive_params->metadata_bytes)) != drive_params->metadata_bytes) {
       msg(MSG_FATAL, "Failed to read extracted metadata file rc %d %s\n", rc,
             rc == -1 ? strerror(errno): "");
@@ -1096,7 +1795,7 @@ void ext2emu(int argc, char *argv[])
    int calc_size;
    CONTROLLER *controller;
 
-   parse_cmdline(argc, argv, &drive_params, "sgjdlu3rat", 1, 0, 0, 1);
+   parse_cmdline(argc, argv, &drive_params, "sgjdlu3ratJPCDFAp", 1, 0, 0, 1);
 
    parse_validate_options_listed(&drive_params, "hcemf");
 
@@ -1122,7 +1821,7 @@ void ext2emu(int argc, char *argv[])
    // Save final parameters
    drive_params.cmdline = parse_print_cmdline(&drive_params, 0, 1);
 
-   drive_params.ext_fd = open(drive_params.extract_filename, O_RDONLY);
+   drive_params.ext_fd = emu_tran_open_input(drive_params.extract_filename, 0);
    if (drive_params.ext_fd < 0) {
       msg(MSG_FATAL, "Unable to open extract file: %s\n", strerror(errno));
       exit(1);
@@ -1130,11 +1829,20 @@ void ext2emu(int argc, char *argv[])
    if (drive_params.metadata_bytes != 0) {
       char extention[] = ".metadata";
       char fn[strlen(drive_params.extract_filename) + strlen(extention) + 1];
+      char *compress_ext;
 
+      // For compressed file name.gz the metadata file is name.metadata.gz
       strcpy(fn, drive_params.extract_filename);
-      strcat(fn, extention);
+      compress_ext = emu_tran_compress_ext(drive_params.extract_filename);
+      if (compress_ext != NULL) {
+         fn[compress_ext - drive_params.extract_filename] = 0;
+         strcat(fn, extention);
+         strcat(fn, compress_ext);
+      } else {
+         strcat(fn, extention);
+      }
 
-      drive_params.ext_metadata_fd = open(fn, O_RDONLY);
+      drive_params.ext_metadata_fd = emu_tran_open_input(fn, 0);
       if (drive_params.ext_metadata_fd < 0) {
          msg(MSG_FATAL, "Unable to open extract tag file: %s\n", strerror(errno));
          exit(1);
@@ -1150,8 +1858,8 @@ void ext2emu(int argc, char *argv[])
    calc_size = drive_params.sector_size * drive_params.num_sectors * 
         drive_params.num_head * drive_params.num_cyl;
       // Warn if the extracted data file doesn't match the expected size for
-      // the parameters specified
-   if (calc_size != finfo.st_size) {
+      // the parameters specified. Size of compressed file isn't known.
+   if (S_ISREG(finfo.st_mode) && calc_size != finfo.st_size) {
       msg(MSG_INFO, "Calculated extract file size %d bytes, actual size %jd\n",
         calc_size, (intmax_t) finfo.st_size); }
 
@@ -1200,6 +1908,10 @@ void ext2emu(int argc, char *argv[])
         track_filled, track_length);
    }
    emu_file_close(drive_params.emu_fd, 1);
+   emu_tran_close(drive_params.ext_fd);
+   if (drive_params.metadata_bytes != 0) {
+      emu_tran_close(drive_params.ext_metadata_fd);
+   }
 }
 
 
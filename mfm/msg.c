@@ -5,7 +5,18 @@
 // Call msg_get_err_mask to get current error mask
 // Call msg_malloc to malloc with error message if fail
 // Call msg_set_logfile to log fatal errors to the log file
+// Call msg_capture_set to save messages from the calling thread in a buffer
+//   instead of printing them
+// Call msg_capture_replay to print the saved messages
+// Call msg_capture_get and msg_capture_pos to find a saved message and
+//   msg_capture_remove to remove it before it is printed
+// Call msg_capture_clear to discard the saved messages
 //
+// 10/17/26 DJG Added msg_capture_clear
+// 10/17/26 DJG Added msg_capture_get, msg_capture_pos, and
+//    msg_capture_remove
+// 10/17/26 DJG Added message capture so decoding threads can have their
+//    messages printed in track order
 // 05/17/15 DJG Added ability to log errors to a file
 // 11/09/14 DJG added new msg_malloc so I don't have to keep checking return
 //
@@ -29,6 +40,7 @@
 #include <stdint.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef CLOCK_MONOTONIC_RAW
 #define CLOCK CLOCK_MONOTONIC_RAW
@@ -45,6 +57,50 @@ static uint64_t err_mask = 0xffffffff;
 static FILE *logfile = NULL;
 uint32_t logfile_err_mask;
 
+// Buffer for saving messages. Each message is stored as the level, length
+// of the text including terminating null, then the text.
+struct msg_capture {
+   char *buf;
+   int len;
+   int size;
+};
+
+// If not null messages from this thread are saved in the buffer
+static __thread MSG_CAPTURE *capture = NULL;
+
+// Save the message in the capture buffer
+//
+// level: Error level of message
+// format: Format string for message
+// va: Arguments for format
+static void msg_capture_save(uint32_t level, char *format, va_list va) {
+   va_list va_copy_len;
+   int len;
+   int need;
+
+   va_copy(va_copy_len, va);
+   len = vsnprintf(NULL, 0, format, va_copy_len) + 1;
+   va_end(va_copy_len);
+
+   need = sizeof(level) + sizeof(len) + len;
+   if (capture->len + need > capture->size) {
+      capture->size = (capture->len + need) * 2;
+      capture->buf = realloc(capture->buf, capture->size);
+      if (capture->buf == NULL) {
+         // Print directly. Don't want to recurse into capture
+         fprintf(stderr, "Malloc failed message capture size %d\n", 
+            capture->size);
+         exit(1);
+      }
+   }
+   memcpy(&capture->buf[capture->len], &level, sizeof(level));
+   capture->len += sizeof(level);
+   memcpy(&capture->buf[capture->len], &len, sizeof(len));
+   capture->len += sizeof(len);
+   vsnprintf(&capture->buf[capture->len], len, format, va);
+   capture->len += len;
+}
+
 // Print an error message.
 //
 // level: Error level used to determine if message should be printed
@@ -56,6 +112,16 @@ void msg(uint32_t level, char *format, ...) {
 
 
    va_start(va, format);
+   // Fatal messages are printed immediately since we are likely about to
+   // exit.
+   if (capture != NULL && !(level & MSG_FATAL)) {
+      if ((err_mask & level) || 
+            (logfile != NULL && (level & logfile_err_mask))) {
+         msg_capture_save(level, format, va);
+      }
+      va_end(va);
+      return;
+   }
    if (err_mask & level) {
       // Overwrite progress message with spaces in case new message is shorter
       if (last_progress && !(level & MSG_PROGRESS)) {
@@ -112,3 +178,84 @@ void msg_set_logfile(FILE *file, uint32_t mask) {
    logfile = file;
    logfile_err_mask = mask;
 }
+
+// Allocate an empty message capture buffer
+// return: Capture buffer
+MSG_CAPTURE *msg_capture_alloc(void) {
+   MSG_CAPTURE *cap;
+
+   cap = msg_malloc(sizeof(*cap), "Message capture");
+   cap->buf = NULL;
+   cap->len = 0;
+   cap->size = 0;
+   return cap;
+}
+
+// Free capture buffer
+// cap: Buffer to free
+void msg_capture_free(MSG_CAPTURE *cap) {
+   if (cap != NULL) {
+      free(cap->buf);
+      free(cap);
+   }
+}
+
+// Set buffer to save messages from the calling thread in.
+// cap: Buffer to save in, NULL to print messages normally
+void msg_capture_set(MSG_CAPTURE *cap) {
+   capture = cap;
+}
+
+// Get the buffer messages from the calling thread are saved in
+// return: Buffer or NULL if messages are printed normally
+MSG_CAPTURE *msg_capture_get(void) {
+   return capture;
+}
+
+// Get the position the next message will be saved at
+// cap: Buffer to check
+// return: Position in buffer
+int msg_capture_pos(MSG_CAPTURE *cap) {
+   return cap->len;
+}
+
+// Remove a saved message
+// cap: Buffer holding message
+// pos: Position from msg_capture_pos before message was saved
+void msg_capture_remove(MSG_CAPTURE *cap, int pos) {
+   int len;
+   int need;
+
+   if (pos < cap->len) {
+      memcpy(&len, &cap->buf[pos + sizeof(uint32_t)], sizeof(len));
+      need = sizeof(uint32_t) + sizeof(len) + len;
+      memmove(&cap->buf[pos], &cap->buf[pos + need], cap->len - pos - need);
+      cap->len -= need;
+   }
+}
+
+// Discard the saved messages
+// cap: Buffer to empty
+void msg_capture_clear(MSG_CAPTURE *cap) {
+   cap->len = 0;
+}
+
+// Print the saved messages in the order they were generated then empty
+// the buffer. Messages are passed through msg so error mask and log file
+// are handled the same as if they were printed when generated.
+// cap: Buffer to print
+void msg_capture_replay(MSG_CAPTURE *cap) {
+   int ndx = 0;
+   uint32_t level;
+   int len;
+
+   while (ndx < cap->len) {
+      memcpy(&level, &cap->buf[ndx], sizeof(level));
+      ndx += sizeof(level);
+      memcpy(&len, &cap->buf[ndx], sizeof(len));
+      ndx += sizeof(len);
+      msg(level, "%s", &cap->buf[ndx]);
+      ndx += len;
+   }
+   cap->len = 0;
+}
@@ -2,6 +2,10 @@
 //
 // TODO: Too much code is being duplicated adding new formats. 
 //
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Moved static variables into TRACK_STATE and DECODE_CONTEXT
+// 10/17/26 DJG Made static variables thread local for mfm_util --jobs
 // 05/19/24 DJG Changed filter_state to not be static. Bad data can cause it
 //    to get stuck in state that will prevent decoding following tracks.
 // 10/13/23 DJG Added CONTROLLER_ND100_3041
@@ -53,21 +57,9 @@
 #include "mfm_decoder.h"
 #include "msg.h"
 #include "deltas_read.h"
+#include "mfm_pll.h"
 
 
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
-{
-   float in, out;
-                 
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
-}
-
 // Compare two uint16_t values
 int cmp_uint16_t(const void *p1, const void *p2)
 {
@@ -148,86 +140,87 @@ SECTOR_DECODE_STATUS northstar_process_data(STATE_TYPE *state, uint8_t bytes[],
          SECTOR_STATUS sector_status_list[], int ecc_span,
          SECTOR_DECODE_STATUS init_status)
 {
-   static int sector_size;
-   static int bad_block;
-   static SECTOR_STATUS sector_status;
-   // Set if track has flag set that it may have an alternate assigned. Need
-   // to process sector data to get remapping info
-   static int alt_assigned = 0; 
+   // Values saved between processing the header and data are kept in
+   // the track state. track_state->alt_assigned is set if track has flag set that it may
+   // have an alternate assigned. Need to process sector data to get
+   // remapping info
+   TRACK_STATE *track_state = drive_params->track_state;
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
 
    if (*state == PROCESS_HEADER) {
-      alt_assigned = 0;
-      memset(&sector_status, 0, sizeof(sector_status));
-      sector_status.status |= init_status | SECT_HEADER_FOUND;
-      sector_status.ecc_span_corrected_header = ecc_span;
+      track_state->alt_assigned = 0;
+      memset(sector_status, 0, sizeof(*sector_status));
+      sector_status->status |= init_status | SECT_HEADER_FOUND;
+      sector_status->ecc_span_corrected_header = ecc_span;
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
 
       if (drive_params->controller == CONTROLLER_NORTHSTAR_ADVANTAGE) {
-	 sector_status.cyl = bytes[1] | (((int) bytes[0] & 0xf0) << 4);
-	 sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
-	 sector_status.sector = bytes[0] & 0xf;
+	 sector_status->cyl = bytes[1] | (((int) bytes[0] & 0xf0) << 4);
+	 sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
+	 sector_status->sector = bytes[0] & 0xf;
 	 // Don't know how/if these are encoded in header
-	 sector_size = drive_params->sector_size;
-	 bad_block = 0;
+	 track_state->sector_size = drive_params->sector_size;
+	 track_state->bad_block = 0;
 	 msg(MSG_DEBUG,
 	    "Got exp %d,%d cyl %d head %d sector %d size %d bad block %d\n",
-	       exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-	       sector_status.sector, sector_size, bad_block);
+	       exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+	       sector_status->sector, track_state->sector_size, track_state->bad_block);
 
-	 mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-	       seek_difference, &sector_status, drive_params, sector_status_list);
+	 mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+	       seek_difference, sector_status, drive_params, sector_status_list);
 
 	 *state = DATA_SYNC;
       } else if (drive_params->controller == CONTROLLER_SUPERBRAIN) {
-	 sector_status.cyl = bytes[1];
-	 sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2]);
-	 sector_status.sector = bytes[3];
+	 sector_status->cyl = bytes[1];
+	 sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2]);
+	 sector_status->sector = bytes[3];
 	 // Don't know how/if these are encoded in header
-	 sector_size = drive_params->sector_size;
-	 bad_block = 0;
+	 track_state->sector_size = drive_params->sector_size;
+	 track_state->bad_block = 0;
 
          if (bytes[0] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[0], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[0], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
 
 
 	 msg(MSG_DEBUG,
 	    "Got exp %d,%d cyl %d head %d sector %d size %d bad block %d\n",
-	       exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-	       sector_status.sector, sector_size, bad_block);
+	       exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+	       sector_status->sector, track_state->sector_size, track_state->bad_block);
 
-	 mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-	       seek_difference, &sector_status, drive_params, sector_status_list);
+	 mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+	       seek_difference, sector_status, drive_params, sector_status_list);
 
 	 *state = DATA_SYNC2;
       } else if (drive_params->controller == CONTROLLER_ND100_3041) {
-	 sector_status.cyl = (bytes[2] << 3) | (bytes[3] >> 5);
-	 sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[1] & 0xf);
-	 sector_status.sector = bytes[3] & 0x1f;
+	 sector_status->cyl = (bytes[2] << 3) | (bytes[3] >> 5);
+	 sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[1] & 0xf);
+	 sector_status->sector = bytes[3] & 0x1f;
          int spare = bytes[1] & 0xf0;
          if (!(spare == 0 || spare == 0x10)) {
             msg(MSG_INFO, "Spare flag %02x on cyl %d head %d sector %d\n",
-                  spare, sector_status.cyl, sector_status.head, sector_status.sector);
+                  spare, sector_status->cyl, sector_status->head, sector_status->sector);
          }
          // Same flag used for bad track and spare track. Bad track has
          // spare track cylinder and head repeated through the sector data.
          if (spare == 0x10) {
-            alt_assigned = 1;
+            track_state->alt_assigned = 1;
          }
 
 	 // Not encoded in header
-	 sector_size = drive_params->sector_size;
+	 track_state->sector_size = drive_params->sector_size;
 
-	 bad_block = 0;
+	 track_state->bad_block = 0;
 
          if (bytes[0] != 0x0) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[0], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[0], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
 
 
@@ -239,46 +232,45 @@ SECTOR_DECODE_STATUS northstar_process_data(STATE_TYPE *state, uint8_t bytes[],
          } else {
 	    msg(MSG_DEBUG,
 	       "Got exp %d,%d cyl %d head %d sector %d size %d bad block %d\n",
-	          exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-	          sector_status.sector, sector_size, bad_block);
+	          exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+	          sector_status->sector, track_state->sector_size, track_state->bad_block);
 
-	    mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-	       seek_difference, &sector_status, drive_params, sector_status_list);
+	    mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+	       seek_difference, sector_status, drive_params, sector_status_list);
 
 	    *state = DATA_SYNC2;
          }
       }
    } else if (*state == PROCESS_DATA) {
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
+      sector_status->ecc_span_corrected_data = ecc_span;
 
       if (drive_params->controller == CONTROLLER_SUPERBRAIN) {
          if (bytes[0] != 0xf8) {
             msg(MSG_INFO, "Invalid data id byte %02x on cyl %d head %d sector %d\n",
-               bytes[0], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_DATA;
+               bytes[0], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_DATA;
          }
       }
 
       // Try to determine if this is a bad track that was remapped or is a
       // spare cylinder
-      if (drive_params->controller == CONTROLLER_ND100_3041 && alt_assigned &&
-           !(sector_status.status & SECT_BAD_HEADER)) {
-         uint16_t remap[sector_size/2];
+      if (drive_params->controller == CONTROLLER_ND100_3041 && track_state->alt_assigned &&
+           !(sector_status->status & SECT_BAD_HEADER)) {
+         uint16_t remap[track_state->sector_size/2];
          uint16_t last;
          int count;
          uint16_t new_map = 0;
-         static int last_remap = 0;
 
-         for (int i = 0; i < sector_size/2; i++) {
+         for (int i = 0; i < track_state->sector_size/2; i++) {
             remap[i] = (bytes[i*2] << 8) | bytes[i*2+1];
          }
-         qsort(&remap, sector_size/2, sizeof(uint16_t), cmp_uint16_t);
+         qsort(&remap, track_state->sector_size/2, sizeof(uint16_t), cmp_uint16_t);
          last = remap[0];
          count = 1;
          // Real controller knows where alternate cylinders start
@@ -287,11 +279,11 @@ SECTOR_DECODE_STATUS northstar_process_data(STATE_TYPE *state, uint8_t bytes[],
          // max_different repeated values its the remapping data otherwise
          // its a spare cylinder. Not guaranteed to get it correct.
          int max_different = 30;
-         for (int i = 1; i < sector_size/2; i++) {
+         for (int i = 1; i < track_state->sector_size/2; i++) {
             if (remap[i] == last) {
                count++;
             } else {
-               if (count >= (sector_size/2 - max_different)) {
+               if (count >= (track_state->sector_size/2 - max_different)) {
                   new_map = last;
                   break;
                } else {
@@ -300,39 +292,39 @@ SECTOR_DECODE_STATUS northstar_process_data(STATE_TYPE *state, uint8_t bytes[],
                }
             }
          }
-         if (count >= sector_size/2 - max_different) {
+         if (count >= track_state->sector_size/2 - max_different) {
             new_map = last;
          }
          if (new_map != 0) {
             int new_head = new_map & 0x1f;
             int new_cyl = new_map >> 5;
-            if (new_cyl > sector_status.cyl && 
+            if (new_cyl > sector_status->cyl && 
                  new_head < drive_params->num_head) {
-               mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-                 sector_status.head,  new_cyl, new_head);
-               if (new_map != last_remap) {
+               mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+                 sector_status->head,  new_cyl, new_head);
+               if (new_map != decode_ctx->last_remap) {
                   msg(MSG_INFO, "Remapping cyl,track %d,%d to %d,%d\n",
-                      sector_status.cyl, sector_status.head,  new_cyl, new_head);
+                      sector_status->cyl, sector_status->head,  new_cyl, new_head);
                }
-               last_remap = new_map;
+               decode_ctx->last_remap = new_map;
             } else {
                msg(MSG_ERR, "Ignored invalid bad track remap of %d,%d to %d,%d\n",
-                   sector_status.cyl, sector_status.head,  new_cyl, new_head);
+                   sector_status->cyl, sector_status->head,  new_cyl, new_head);
                
             }
          }
       }
 
    
-      if (!(sector_status.status & SECT_BAD_HEADER)) {
-         if (mfm_write_sector(&bytes[0], drive_params, &sector_status,
+      if (!(sector_status->status & SECT_BAD_HEADER)) {
+         if (mfm_write_sector(&bytes[0], drive_params, sector_status,
                sector_status_list, &bytes[0], total_bytes) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       *state = MARK_ID;
    }
-   return sector_status.status;
+   return sector_status->status;
 }
 
 // Decode a track's worth of deltas.
@@ -364,18 +356,11 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int decoded_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency
-   float avg_bit_sep_time;     // 200 MHz clocks
-   float nominal_bit_sep_time; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   // PLL filter state. Static works better since next track bit timing
-   // similar to previous though a bad track can put it off enough that
-   // the next track has errors. Retry should fix. TODO: Look at
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
    // Counter for debugging
@@ -390,15 +375,6 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // so this avoids them.
    #define MARK_NUM_ZEROS 30
    int sync_count = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
-   // And number from last time
-   int last_deltas = 0;
-   // If we get too large a delta we need to process it in less than 32 bit
-   // word number of bits. This holds remaining number to process
-   int remaining_delta = 0;
-   // Maximum delta to process in one pass
-   int max_delta;
    // Intermediate value
    int tmp_raw_word;
    // Collect bytes to further process here
@@ -432,52 +408,23 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // Adjust time for when data capture started
    next_header_time -= drive_params->start_time_ns / CLOCKS_TO_NS;
 
-   num_deltas = deltas_get_count(0);
-
    raw_word = 0;
-   nominal_bit_sep_time = 200e6 /
-       mfm_controller_info[drive_params->controller].clk_rate_hz;
-   max_delta = nominal_bit_sep_time * 22;
-   avg_bit_sep_time = nominal_bit_sep_time;
-   i = 1;
-   while (num_deltas >= 0) {
+   pll_track = mfm_pll_track_start(drive_params, deltas, 200e6 /
+      mfm_controller_info[drive_params->controller].clk_rate_hz, 1);
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas;) {
-         int delta_process;
-         // If no remaining delta process next else finish remaining
-         if (remaining_delta == 0) {
-            delta_process = deltas[i++];
-            remaining_delta = delta_process;
-         }  else {
-            delta_process = remaining_delta;
-         }
-         // Don't overflow our 32 bit word
-         if (delta_process > max_delta) {
-            delta_process = max_delta;
-         }
-         track_time += delta_process;
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += delta_process;
-         remaining_delta -= delta_process;
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock. Don't update PLL if this is a long burst without
-         // transitions
-         if (remaining_delta == 0) {
-            avg_bit_sep_time = nominal_bit_sep_time + filter(clock_time, &filter_state);
-         }
+      for (; i < num_steps; i++) {
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 #if DEBUG
          //printf("track %d clock %f\n", track_time, clock_time);
          //if (cyl == 70 & head == 5 && track_time > next_header_time)
          if (cyl == 0 && head == 0)
          printf
          ("  delta %d %.2f int %d avg_bit %.2f time %d dec %08x raw %08x\n",
-               deltas[i], clock_time,
-               int_bit_pos, avg_bit_sep_time, track_time, decoded_word,
+               pll_track->steps[i].delta, pll_track->pll.clock_time,
+               int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time, decoded_word,
                raw_word);
 #endif
          if (all_raw_bits_count + int_bit_pos >= 32) {
@@ -552,7 +499,7 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
                decoded_word = 0;
                decoded_bit_cntr = 0;
                state = PROCESS_HEADER;
-               mfm_mark_header_location(all_raw_bits_count, raw_bit_cntr,
+               mfm_mark_header_location(drive_params, all_raw_bits_count, raw_bit_cntr,
                   tot_raw_bit_cntr);
                // Figure out the length of data we should look for
                bytes_crc_len = mfm_controller_info[drive_params->controller].header_bytes +
@@ -568,7 +515,7 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
          } else if (state == DATA_SYNC) {
             state = PROCESS_DATA;
 //printf("Start data %d\n",tot_raw_bit_cntr);
-            mfm_mark_data_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+            mfm_mark_data_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
             // Figure out the length of data we should look for
             bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes +
                 mfm_controller_info[drive_params->controller].data_trailer_bytes +
@@ -611,7 +558,7 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
 	       decoded_bit_cntr = 0;
 	       state = PROCESS_DATA;
    //printf("Start data %d\n",tot_raw_bit_cntr);
-	       mfm_mark_data_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+	       mfm_mark_data_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
 	       // Figure out the length of data we should look for
 	       bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes +
 		   mfm_controller_info[drive_params->controller].data_trailer_bytes +
@@ -669,14 +616,6 @@ SECTOR_DECODE_STATUS northstar_decode_track(DRIVE_PARAMS *drive_params, int cyl,
             }
          }
       }
-      // Finished what we had, any more?
-      // If we didn't get too many last time sleep so delta reader can run.
-      // Thread priorities might be better.
-      if (num_deltas - last_deltas <= 2000) {
-         usleep(500);
-      }
-      last_deltas = num_deltas;
-      num_deltas = deltas_get_count(i);
    }
    if (state == PROCESS_DATA && sector_index <= drive_params->num_sectors) {
       float begin_time =
@@ -9,6 +9,15 @@
 // Copyright 2025 David Gesswein.
 // This file is part of MFM disk utilities.
 //
+// 10/17/26 DJG Added --pipeline_reads option
+// 10/17/26 DJG --defer_retries not allowed when writing transition or
+//    emulation file
+// 10/17/26 DJG Added --alt_pll option
+// 10/17/26 DJG Added --fuse_reads option
+// 10/17/26 DJG Added --defer_retries option
+// 10/17/26 DJG Added --compress_transitions option
+// 10/17/26 DJG Added --float_pll option
+// 10/17/26 DJG Added --jobs option
 // 09/10/25 DJG Fixed ext2emu marking bad sectors when interleave used
 // 01/13/25 DJG Fixes for xebec_skew processing. Skew not same on all tracks.
 // 11/06/24 DJG Allow turning off xebec_skew if set in file.
@@ -457,9 +466,16 @@ static struct option long_options[] = {
          {"track_words", 1, NULL, 'w'},
          {"ignore_seek_errors", 0, NULL, 'I'},
          {"xebec_skew", 2, NULL, 'x'},
+         {"jobs", 1, NULL, 'J'},
+         {"float_pll", 0, NULL, 'P'},
+         {"compress_transitions", 0, NULL, 'C'},
+         {"defer_retries", 0, NULL, 'D'},
+         {"fuse_reads", 0, NULL, 'F'},
+         {"alt_pll", 0, NULL, 'A'},
+         {"pipeline_reads", 0, NULL, 'p'},
          {NULL, 0, NULL, 0}
 };
-static char short_options[] = "s:h:c:g:d:f:j:l:ui:3r:a::q:b:t:e:m:vn:M:w:Ix";
+static char short_options[] = "s:h:c:g:d:f:j:l:ui:3r:a::q:b:t:e:m:vn:M:w:IxJ:PCDFAp";
 
 // Main routine for parsing command lines
 //
@@ -513,6 +529,7 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params,
       drive_params->analyze = 0;
       drive_params->start_time_ns = 0;
       drive_params->header_crc.length = -1; // 0 is valid
+      drive_params->jobs = 1;
    }
    // Handle the options. The long options are converted to the short
    // option name for the switch by getopt_long.
@@ -690,6 +707,34 @@ void parse_cmdline(int argc, char *argv[], DRIVE_PARAMS *drive_params,
             // command line so we can use that
             drive_params->xebec_skew_cmdline = drive_params->xebec_skew;
             break;
+         case 'J':
+            drive_params->jobs = atoi(optarg);
+            if (drive_params->jobs <= 0) {
+               msg(MSG_FATAL,"Jobs must be greater than 0\n");
+               if (!ignore_invalid_options) {
+                  exit(1);
+               }
+               drive_params->jobs = 1;
+            }
+            break;
+         case 'P':
+            drive_params->float_pll = 1;
+            break;
+         case 'C':
+            drive_params->compress_transitions = 1;
+            break;
+         case 'D':
+            drive_params->defer_retries = 1;
+            break;
+         case 'F':
+            drive_params->fuse_reads = 1;
+            break;
+         case 'A':
+            drive_params->alt_pll = 1;
+            break;
+         case 'p':
+            drive_params->pipeline_reads = 1;
+            break;
          default:
             msg(MSG_FATAL, "Didn't process argument %c\n", rc);
             if (!ignore_invalid_options) {
@@ -774,6 +819,14 @@ void parse_validate_options(DRIVE_PARAMS *drive_params, int mfm_read) {
       msg(MSG_FATAL, "\n");
       exit(1);
    }
+   // Transition and emulation files are written in track order so the
+   // retries can't be deferred
+   if (drive_params->defer_retries && 
+         (drive_params->transitions_filename != NULL || 
+         drive_params->emulation_filename != NULL)) {
+      msg(MSG_FATAL, "--defer_retries only valid when just an extract file is written\n");
+      exit(1);
+   }
 }
 
 void parse_validate_options_listed(DRIVE_PARAMS *drive_params, char *opt) {
@@ -18,6 +18,8 @@
 //
 // TODO: Use cache control to make memory transfers faster with PRU
 //
+// 10/17/26 DJG Fix clock mmap error message
+// 10/17/26 DJG Use simulated DDR memory and clock with SIM_PRU
 // 09/17/23 Added pru_exec_program to set correct path for file to load
 // 09/12/23 JST Changes to support 5.10 kernel and --sync option
 // 06/19/19 DJG Added support for 8.5 MHz --rate for Xerox Star and
@@ -89,6 +91,10 @@ static int pru_allocate_ddr_memory(void **ddrmem, uint32_t *ddr_phys_addr)
    uint32_t ddr_offset, ddr_mem_size;
    FILE *fin;
 
+#ifdef SIM_PRU
+   // No UIO device, the simulated PRU has the memory
+   return pru_sim_get_ddr(ddrmem, ddr_phys_addr);
+#endif
    fin = fopen("/sys/class/uio/uio0/maps/map1/addr", "r");
    if (fin == NULL) {
       perror("Unable to open DDR map address");
@@ -468,6 +474,10 @@ static void wait_bits(uint32_t *ptr, uint32_t mask, uint32_t value, char *desc)
    int i;
    int good = 0;
 
+#ifdef SIM_PRU
+   // No clock hardware to wait for
+   return;
+#endif
    // Wait up to a second
    for (i = 0; !good && i < 1000; i++) {
       if ((*ptr & mask) == value) {
@@ -521,6 +531,15 @@ uint32_t pru_set_clock(uint32_t tgt_bitrate_hz, int halt) {
    };
    int ndx;
 
+#ifdef SIM_PRU
+   // No clock registers. Map memory to ignore the clock setup
+   fd = open("/dev/zero", O_RDWR);
+   ptr = mmap(0, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   if (ptr == MAP_FAILED) {
+      msg(MSG_FATAL, "Clock mmap failed %s\n", strerror(errno));
+      exit(1);
+   }
+#else
    fd = open("/dev/uio/prcm/module", O_RDWR);
    ptr = mmap(0, map_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 
       0);
@@ -530,10 +549,11 @@ uint32_t pru_set_clock(uint32_t tgt_bitrate_hz, int halt) {
       ptr = mmap(0, map_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
          0x44e00000);
       if (ptr == MAP_FAILED) {
-         msg(MSG_FATAL, "Clock mmap failed", strerror(errno));
+         msg(MSG_FATAL, "Clock mmap failed %s\n", strerror(errno));
          exit(1);
       }
    }
+#endif
    // Halt so switching clock doesn't mess up PRU
    for (pru_num = 0; pru_num < 2 && halt == PRU_SET_CLOCK_HALT; pru_num++) {
       orig_control_reg[pru_num] = pru_read_word(data_mem_type[pru_num], 
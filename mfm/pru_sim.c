@@ -0,0 +1,387 @@
+// Simulated PRU. This replaces the prussdrv library from am335x_pru_package
+// so mfm_read, mfm_write, and mfm_emu can be run and timed on a Linux system
+// without the beaglebone PRU and disk interface board. Build with
+// make SIM_PRU=1.
+//
+// The PRU memories are allocated from normal memory. The program loaded on
+// each PRU is replaced by a thread running a routine that handles the same
+// commands and memory locations as the PRU code. The routines are found with
+// pru_sim_find_program which is provided by pru_sim_drive.c for mfm_read
+// and mfm_write and pru_sim_host.c for mfm_emu. PRU interrupts to the ARM
+// are semaphores.
+//
+// Simulated time runs MFM_SIM_SPEED times faster than real time. The
+// default is 1 to run at the actual drive timing.
+//
+// Call pru_sim_idle_program for a PRU that doesn't need to do anything
+// Call pru_sim_get_ddr to get the shared DDR memory
+// Call pru_sim_stopping to check if a simulated program should exit
+// Call pru_sim_signal_event to send an interrupt to the ARM
+// Call pru_sim_main_thread to get the thread that called prussdrv_init
+// Call pru_sim_time_ns to get the simulated time
+// Call pru_sim_sleep_until_ns to wait until a simulated time
+// Call pru_sim_sleep_ns to wait for simulated time
+// Call pru_sim_env to get a numeric value from the environment
+//
+// 10/17/26 DJG Initial version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+
+#include <prussdrv.h>
+
+#include "msg.h"
+#include "cmd.h"
+#include "pru_setup.h"
+
+// PRU data memory size. The PRU control and debug registers are after
+// the data memory in the mapped region so this includes them.
+#define DATARAM_SIZE (PRU_DEBUG + 0x100)
+#define SHAREDRAM_SIZE (12*1024)
+// Physical address reported for the DDR memory
+#define DDR_PHYS_ADDR 0x80000000
+// Running bit in PRU control register
+#define CONTROL_RUNNING 0x8000
+
+// The simulated PRU memories
+static uint8_t *dataram[2], *sharedram, *ddr;
+
+// The thread simulating each PRU
+static struct {
+   pthread_t thread;
+   PRU_SIM_PROGRAM program;
+   int running;
+   volatile int stop;
+} prus[2];
+
+// Interrupts to the ARM
+static sem_t events[2];
+static unsigned int event_count[2];
+
+static pthread_t main_thread;
+
+// Real time simulation started and simulated time per real time
+static struct timespec start_time;
+static double speed;
+
+// Initialize the simulated PRUs. Must be called from the main thread
+//
+// return: 0
+int prussdrv_init(void)
+{
+   int i;
+
+   dataram[0] = msg_malloc(DATARAM_SIZE, "pru_sim dataram0");
+   dataram[1] = msg_malloc(DATARAM_SIZE, "pru_sim dataram1");
+   sharedram = msg_malloc(SHAREDRAM_SIZE, "pru_sim sharedram");
+   ddr = msg_malloc(PRU_SIM_DDR_SIZE, "pru_sim ddr");
+   memset(dataram[0], 0, DATARAM_SIZE);
+   memset(dataram[1], 0, DATARAM_SIZE);
+   memset(sharedram, 0, SHAREDRAM_SIZE);
+   memset(ddr, 0, PRU_SIM_DDR_SIZE);
+   for (i = 0; i < 2; i++) {
+      sem_init(&events[i], 0, 0);
+   }
+   main_thread = pthread_self();
+   clock_gettime(CLOCK_MONOTONIC, &start_time);
+   speed = pru_sim_env("MFM_SIM_SPEED", 1);
+   if (speed <= 0) {
+      msg(MSG_FATAL, "MFM_SIM_SPEED must be greater than zero\n");
+      exit(1);
+   }
+   msg(MSG_INFO, "Using simulated PRU, speed %.1f times real time\n", speed);
+
+   return 0;
+}
+
+// Open interrupt from PRU. Nothing to do for simulation
+//
+// host_interrupt: Interrupt to open
+// return: 0
+int prussdrv_open(unsigned int host_interrupt)
+{
+   return 0;
+}
+
+// Setup PRU interrupt controller. Nothing to do for simulation
+//
+// prussintc_init_data: Interrupt controller setup
+// return: 0
+int prussdrv_pruintc_init(const tpruss_intc_initdata *prussintc_init_data)
+{
+   return 0;
+}
+
+// Get simulated PRU memory
+//
+// pru_ram_id: Which memory to get
+// address: Returns address of memory
+// return: 0 if OK, -1 if memory isn't simulated
+int prussdrv_map_prumem(unsigned int pru_ram_id, void **address)
+{
+   switch (pru_ram_id) {
+      case PRUSS0_PRU0_DATARAM:
+         *address = dataram[0];
+      break;
+      case PRUSS0_PRU1_DATARAM:
+         *address = dataram[1];
+      break;
+      case PRUSS0_SHARED_DATARAM:
+         *address = sharedram;
+      break;
+      default:
+         return -1;
+   }
+   return 0;
+}
+
+// Get physical address of memory. Only the DDR memory has an address
+//
+// address: Virtual address
+// return: Physical address
+unsigned int prussdrv_get_phys_addr(const void *address)
+{
+   if ((uint8_t *) address >= ddr &&
+         (uint8_t *) address < ddr + PRU_SIM_DDR_SIZE) {
+      return DDR_PHYS_ADDR + ((uint8_t *) address - ddr);
+   }
+   return 0;
+}
+
+// Get virtual address for physical address. Only the DDR memory has an
+// address
+//
+// phyaddr: Physical address
+// return: Virtual address
+void *prussdrv_get_virt_addr(unsigned int phyaddr)
+{
+   if (phyaddr >= DDR_PHYS_ADDR &&
+         phyaddr < DDR_PHYS_ADDR + PRU_SIM_DDR_SIZE) {
+      return ddr + (phyaddr - DDR_PHYS_ADDR);
+   }
+   return NULL;
+}
+
+// Routine for PRU simulation thread
+//
+// arg: PRU number
+static void *pru_proc(void *arg)
+{
+   int pru = (intptr_t) arg;
+
+   prus[pru].program(pru);
+   return NULL;
+}
+
+// Start the simulation of the program for a PRU
+//
+// prunum: PRU number
+// filename: Filename of program to run
+// return: 0 if OK, -1 if program isn't simulated or thread not started
+int prussdrv_exec_program(int prunum, const char *filename)
+{
+   char buf[strlen(filename) + 1];
+   sigset_t all_signals, orig_signals;
+   int rc;
+
+   strcpy(buf, filename);
+   prussdrv_pru_disable(prunum);
+   prus[prunum].program = pru_sim_find_program(basename(buf));
+   if (prus[prunum].program == NULL) {
+      msg(MSG_FATAL, "No simulation of PRU program %s\n", filename);
+      return -1;
+   }
+   prus[prunum].stop = 0;
+   pru_write_word(prunum == 0 ? MEM_PRU0_DATA : MEM_PRU1_DATA,
+      PRU_CONTROL_REG, CONTROL_RUNNING | 2);
+   // Signals are for the main program threads, not the PRU
+   sigfillset(&all_signals);
+   pthread_sigmask(SIG_BLOCK, &all_signals, &orig_signals);
+   rc = pthread_create(&prus[prunum].thread, NULL, pru_proc,
+      (void *) (intptr_t) prunum);
+   pthread_sigmask(SIG_SETMASK, &orig_signals, NULL);
+   if (rc != 0) {
+      msg(MSG_FATAL, "Unable to create PRU %d simulation thread\n", prunum);
+      return -1;
+   }
+   prus[prunum].running = 1;
+
+   return 0;
+}
+
+// Stop the simulation of a PRU
+//
+// prunum: PRU number
+// return: 0
+int prussdrv_pru_disable(unsigned int prunum)
+{
+   if (prus[prunum].running) {
+      prus[prunum].stop = 1;
+      pthread_join(prus[prunum].thread, NULL);
+      prus[prunum].running = 0;
+      pru_write_word(prunum == 0 ? MEM_PRU0_DATA : MEM_PRU1_DATA,
+         PRU_CONTROL_REG, 0);
+   }
+   return 0;
+}
+
+// Wait for interrupt from PRU
+//
+// host_interrupt: Interrupt to wait for
+// return: Number of interrupts received
+unsigned int prussdrv_pru_wait_event(unsigned int host_interrupt)
+{
+   while (sem_wait(&events[host_interrupt]) != 0 && errno == EINTR)
+      ;
+   return ++event_count[host_interrupt];
+}
+
+// Clear interrupt. The semaphore is cleared by the wait
+//
+// host_interrupt: Interrupt to clear
+// sysevent: PRU event to clear
+// return: 0
+int prussdrv_pru_clear_event(unsigned int host_interrupt,
+   unsigned int sysevent)
+{
+   return 0;
+}
+
+// Stop all PRU simulation
+//
+// return: 0
+int prussdrv_exit(void)
+{
+   prussdrv_pru_disable(0);
+   prussdrv_pru_disable(1);
+   return 0;
+}
+
+// Simulated program for a PRU that has nothing to do.
+//
+// pru: PRU number
+void pru_sim_idle_program(int pru)
+{
+   while (!pru_sim_stopping(pru)) {
+      usleep(1000);
+   }
+}
+
+// Get the shared DDR memory
+//
+// ddrmem: Returns pointer to memory (virtual address).
+// ddr_phys_addr: Returns physical address of memory.
+// return: Size of region in bytes.
+int pru_sim_get_ddr(void **ddrmem, uint32_t *ddr_phys_addr)
+{
+   *ddrmem = ddr;
+   *ddr_phys_addr = DDR_PHYS_ADDR;
+   return PRU_SIM_DDR_SIZE;
+}
+
+// Check if simulation of PRU should stop
+//
+// pru: PRU number
+// return: Non zero if the simulated program should return
+int pru_sim_stopping(int pru)
+{
+   return prus[pru].stop;
+}
+
+// Send interrupt to the ARM
+//
+// host_interrupt: Interrupt to send
+void pru_sim_signal_event(unsigned int host_interrupt)
+{
+   sem_post(&events[host_interrupt]);
+}
+
+// Return the thread that initialized the simulation. Signals to the
+// program should be sent to it
+pthread_t pru_sim_main_thread(void)
+{
+   return main_thread;
+}
+
+// Return simulated time since simulation started in nanoseconds
+uint64_t pru_sim_time_ns(void)
+{
+   struct timespec tv;
+
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return ((tv.tv_sec - start_time.tv_sec) * 1e9 +
+      (tv.tv_nsec - start_time.tv_nsec)) * speed;
+}
+
+// Wait until the specified simulated time
+//
+// time_ns: Simulated time in nanoseconds to wait for
+void pru_sim_sleep_until_ns(uint64_t time_ns)
+{
+   struct timespec tv;
+   uint64_t real_ns = time_ns / speed;
+
+   tv.tv_sec = start_time.tv_sec + real_ns / 1000000000;
+   tv.tv_nsec = start_time.tv_nsec + real_ns % 1000000000;
+   if (tv.tv_nsec >= 1000000000) {
+      tv.tv_sec++;
+      tv.tv_nsec -= 1000000000;
+   }
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tv, NULL) ==
+      EINTR)
+      ;
+}
+
+// Wait for the specified simulated time
+//
+// ns: Simulated time in nanoseconds to wait
+void pru_sim_sleep_ns(uint64_t ns)
+{
+   pru_sim_sleep_until_ns(pru_sim_time_ns() + ns);
+}
+
+// Get a numeric value from an environment variable
+//
+// name: Environment variable name
+// default_value: Value to return if variable not set
+// return: Value
+double pru_sim_env(char *name, double default_value)
+{
+   char *value = getenv(name);
+   char *end;
+   double rc;
+
+   if (value == NULL) {
+      return default_value;
+   }
+   rc = strtod(value, &end);
+   if (end == value || *end != 0) {
+      msg(MSG_FATAL, "Invalid value %s for %s\n", value, name);
+      exit(1);
+   }
+   return rc;
+}
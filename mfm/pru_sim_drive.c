@@ -0,0 +1,506 @@
+// Simulated drive and PRU program for mfm_read and mfm_write. Used with the
+// simulated PRU in pru_sim.c when built with make SIM_PRU=1.
+//
+// The drive contents are loaded from the transition or emulation file
+// specified by the MFM_SIM_DISK environment variable. Compressed files
+// are handled the same as for mfm_util. If MFM_SIM_DISK isn't set the
+// drive is unformatted. The PRU commands in cmd.h are performed with the
+// drive timing. A track read waits for the index pulse then the deltas are
+// put in the DDR memory as they would be read from the disk. Seeks take
+// STEP_NS for each cylinder stepped plus SETTLE_NS. The rotation speed is
+// set from the file sample rate or MFM_SIM_RPM. If the file has multiple
+// reads of a track from retries, each read of the track returns the next
+// one so retries see the same data the original read did. Reads of the
+// next head set in PRU0_NEXT_HEAD are chained like the PRU does.
+//
+// Tracks written by mfm_write replace the track contents in memory. They
+// are not written back to the file.
+//
+// Call pru_sim_find_program to get the simulated PRU program
+// Call pru_sim_drive_select to set the drive select lines
+// Call pru_sim_drive_set_head to set the head select lines
+// Call pru_sim_drive_at_track0 to get the track 0 signal
+//
+// 10/17/26 DJG Read next head in PRU0_NEXT_HEAD when read finishes
+// 10/17/26 DJG Initial version
+//
+// Copyright 2026 David Gesswein.
+// This file is part of MFM disk utilities.
+//
+// MFM disk utilities is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// MFM disk utilities is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with MFM disk utilities.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <prussdrv.h>
+#include <pruss_intc_mapping.h>
+
+#include "msg.h"
+#include "crc_ecc.h"
+#include "emu_tran_file.h"
+#include "mfm_decoder.h"
+#include "cmd.h"
+#include "cmd_write.h"
+#include "pru_setup.h"
+
+// Largest track in deltas
+#define SIM_MAX_DELTAS 131072
+// Time for each cylinder stepped for slow and fast (buffered) seeks
+#define SLOW_STEP_NS 3000000
+#define FAST_STEP_NS 200000
+// Time for heads to settle after stepping
+#define SETTLE_NS 15000000
+// How often read deltas are sent to the DDR memory
+#define READ_UPDATE_NS 100000
+// Time after the end of the track the PRU continues capturing in 200 MHz
+// clocks
+#define END_CAPTURE_CLOCKS 640
+// Time the PRU waits after changing the head for the next head read
+#define HEAD_SETTLE_CLOCKS 2000
+// Delta between transitions of an unformatted track in 200 MHz clocks
+#define BLANK_DELTA 40
+
+typedef struct sim_track {
+   uint16_t *deltas;
+   int num_deltas;
+   // Next read of the same track from the file or NULL
+   struct sim_track *next;
+   // For the first read, number of reads and times the track has been read
+   int num_reads;
+   int read_count;
+} SIM_TRACK;
+
+static struct {
+   // Track contents. Tracks with no deltas read as blank
+   SIM_TRACK tracks[MAX_CYL][MAX_HEAD];
+   SIM_TRACK blank;
+   // Time for a rotation in nanoseconds
+   uint64_t rotation_ns;
+   // Drive control line state
+   int cyl;
+   int head;
+   int selected;
+} drive;
+
+// Set the drive select lines
+//
+// drive: Drive to select, 0 for none
+void pru_sim_drive_select(int drive_num)
+{
+   drive.selected = drive_num != 0;
+}
+
+// Set the head select lines
+//
+// head: Head to select
+void pru_sim_drive_set_head(int head)
+{
+   drive.head = head;
+}
+
+// Return non zero if the heads are at track 0
+int pru_sim_drive_at_track0(void)
+{
+   return drive.cyl == 0;
+}
+
+// Load the drive contents from the file. All reads of each track are kept
+// in the order found.
+//
+// fn: Transition or emulation file name
+// return: Sample rate of data in file
+static int load_file(char *fn)
+{
+   // File id string and version
+   uint8_t id[12];
+   uint16_t *deltas;
+   int fd, cyl, head, num_deltas;
+   int is_emu;
+   EMU_FILE_INFO emu_file_info;
+   TRAN_FILE_INFO tran_file_info;
+   SIM_TRACK *track;
+   int sample_rate_hz;
+
+   // The most significant byte of the version is the file type
+   fd = emu_tran_open_input(fn, 1);
+   if (fd < 0 || emu_tran_read(fd, id, sizeof(id)) != sizeof(id)) {
+      msg(MSG_FATAL, "Unable to read %s\n", fn);
+      exit(1);
+   }
+   emu_tran_close(fd);
+   is_emu = id[11] == 2;
+
+   if (is_emu) {
+      fd = emu_file_read_header(fn, &emu_file_info, 0, 0);
+      sample_rate_hz = emu_file_info.sample_rate_hz;
+   } else {
+      fd = tran_file_read_header(fn, &tran_file_info);
+      sample_rate_hz = tran_file_info.sample_rate_hz;
+   }
+   deltas = msg_malloc(SIM_MAX_DELTAS * sizeof(*deltas), "pru_sim deltas");
+   while (1) {
+      if (is_emu) {
+         num_deltas = emu_file_read_track_deltas(fd, &emu_file_info, deltas,
+            SIM_MAX_DELTAS, &cyl, &head);
+      } else {
+         num_deltas = tran_file_read_track_deltas(fd, deltas, SIM_MAX_DELTAS,
+            &cyl, &head);
+      }
+      if (num_deltas < 0) {
+         break;
+      }
+      if (cyl < 0 || cyl >= MAX_CYL || head < 0 || head >= MAX_HEAD) {
+         msg(MSG_FATAL, "Track cyl %d head %d out of range\n", cyl, head);
+         exit(1);
+      }
+      track = &drive.tracks[cyl][head];
+      if (track->deltas != NULL) {
+         while (track->next != NULL) {
+            track = track->next;
+         }
+         track->next = msg_malloc(sizeof(*track), "pru_sim track read");
+         memset(track->next, 0, sizeof(*track));
+         track = track->next;
+      }
+      track->deltas = msg_malloc(num_deltas * sizeof(*deltas),
+         "pru_sim track");
+      memcpy(track->deltas, deltas, num_deltas * sizeof(*deltas));
+      track->num_deltas = num_deltas;
+      drive.tracks[cyl][head].num_reads++;
+   }
+   free(deltas);
+   if (is_emu) {
+      emu_file_close(fd, 0);
+   } else {
+      tran_file_close(fd, 0);
+   }
+   return sample_rate_hz;
+}
+
+// Load the drive contents and setup the drive timing
+static void load_drive(void)
+{
+   char *fn = getenv("MFM_SIM_DISK");
+   int sample_rate_hz = 10000000;
+   double rpm;
+   int i;
+
+   if (fn == NULL) {
+      msg(MSG_INFO, "MFM_SIM_DISK not set, simulating unformatted drive\n");
+   } else {
+      sample_rate_hz = load_file(fn);
+      msg(MSG_INFO, "Simulating drive from %s\n", fn);
+   }
+   rpm = pru_sim_env("MFM_SIM_RPM", emu_rps(sample_rate_hz) * 60);
+   if (rpm <= 0) {
+      msg(MSG_FATAL, "MFM_SIM_RPM must be greater than zero\n");
+      exit(1);
+   }
+   drive.rotation_ns = 60e9 / rpm;
+
+   // Unformatted tracks have regular transitions
+   drive.blank.num_deltas = drive.rotation_ns / CLOCKS_TO_NS / BLANK_DELTA;
+   drive.blank.deltas = msg_malloc(drive.blank.num_deltas *
+      sizeof(*drive.blank.deltas), "pru_sim blank track");
+   for (i = 0; i < drive.blank.num_deltas; i++) {
+      drive.blank.deltas[i] = BLANK_DELTA;
+   }
+}
+
+// Return the track under the selected head. Successive calls for the
+// same track cycle through the reads of the track.
+static SIM_TRACK *get_track(void)
+{
+   SIM_TRACK *track;
+   int i;
+
+   if (drive.head >= MAX_HEAD) {
+      return &drive.blank;
+   }
+   track = &drive.tracks[drive.cyl][drive.head];
+   if (track->deltas == NULL) {
+      return &drive.blank;
+   }
+   for (i = track->read_count++ % track->num_reads; i > 0; i--) {
+      track = track->next;
+   }
+   return track;
+}
+
+// Update the drive status lines. Lines are active low.
+static void update_status(void)
+{
+   uint32_t status = 0xffffffff;
+
+   if (drive.selected) {
+      status &= ~(BIT_MASK(R31_DRIVE_SEL) | BIT_MASK(R31_READY_BIT) |
+         BIT_MASK(R31_SEEK_COMPLETE_BIT));
+   }
+   pru_write_word(MEM_PRU0_DATA, PRU0_STATUS, status);
+}
+
+// Wait for the start of the index pulse
+//
+// return: Simulated time of index
+static uint64_t wait_index(void)
+{
+   uint64_t index_ns;
+
+   index_ns = (pru_sim_time_ns() / drive.rotation_ns + 1) * drive.rotation_ns;
+   pru_sim_sleep_until_ns(index_ns);
+   return index_ns;
+}
+
+// Move the heads
+//
+// steps: Cylinders to step, negative is towards cylinder 0
+// step_ns: Time for each step
+static void seek(int steps, int step_ns)
+{
+   int new_cyl = drive.cyl + steps;
+   int moved;
+
+   if (new_cyl < 0) {
+      new_cyl = 0;
+   }
+   if (new_cyl >= MAX_CYL) {
+      new_cyl = MAX_CYL - 1;
+   }
+   moved = abs(new_cyl - drive.cyl);
+   if (moved != 0) {
+      pru_sim_sleep_ns((uint64_t) moved * step_ns + SETTLE_NS);
+   }
+   drive.cyl = new_cyl;
+}
+
+// Put the deltas of a track in the DDR memory as they pass under the head.
+//
+// track: Track to read
+// start_ns: Simulated time the deltas start at
+// skip_clocks: Clocks after start_ns before capture starts. The deltas
+//    before capture starts are added to the first delta like the PRU does
+// ddr_offset: Byte offset in DDR memory to put the deltas
+// return: Bytes of deltas put in DDR memory
+static int read_deltas(SIM_TRACK *track, uint64_t start_ns,
+   uint32_t skip_clocks, int ddr_offset)
+{
+   uint32_t clocks = 0, time_clocks;
+   uint16_t first_delta;
+   int ndx = 0, first, skip;
+
+   while (ndx < track->num_deltas - 1 && 
+         clocks + track->deltas[ndx] <= skip_clocks) {
+      clocks += track->deltas[ndx++];
+   }
+   skip = ndx;
+   first_delta = MIN(clocks + track->deltas[skip], 0xffff);
+   pru_sim_sleep_until_ns(start_ns + (uint64_t) skip_clocks * CLOCKS_TO_NS);
+   while (ndx < track->num_deltas) {
+      pru_sim_sleep_ns(READ_UPDATE_NS);
+      time_clocks = (pru_sim_time_ns() - start_ns) / CLOCKS_TO_NS;
+      first = ndx;
+      while (ndx < track->num_deltas &&
+            clocks + track->deltas[ndx] <= time_clocks) {
+         clocks += track->deltas[ndx++];
+      }
+      if (first == skip && ndx > first) {
+         pru_write_mem(MEM_DDR, &first_delta, sizeof(first_delta),
+            ddr_offset);
+         first++;
+      }
+      pru_write_mem(MEM_DDR, &track->deltas[first],
+         (ndx - first) * sizeof(track->deltas[0]),
+         ddr_offset + (first - skip) * sizeof(track->deltas[0]));
+      // Deltas must be in memory before the count is updated
+      __sync_synchronize();
+      pru_write_word(MEM_PRU0_DATA, PRU0_WRITE_PTR,
+         (ndx - skip) * sizeof(track->deltas[0]));
+   }
+   return (ndx - skip) * sizeof(track->deltas[0]);
+}
+
+// Read the track under the selected head. After the read starts the deltas
+// are put in the DDR memory as they pass under the head. If PRU0_NEXT_HEAD
+// is set when the read finishes that head is read next into the other half
+// of the DDR memory.
+static void read_track(void)
+{
+   uint32_t start_clocks;
+   uint32_t next_head;
+   uint32_t read_num = 0;
+   uint32_t skip_clocks = 0;
+   uint64_t index_ns;
+   int ddr_half, num_bytes;
+
+   ddr_half = (pru_read_word(MEM_PRU0_DATA, PRU_DDR_SIZE) + 1) / 2;
+   start_clocks = pru_read_word(MEM_PRU0_DATA, PRU0_START_TIME_CLOCKS);
+   pru_write_word(MEM_PRU0_DATA, PRU0_WRITE_PTR, 0);
+   pru_write_word(MEM_PRU0_DATA, PRU0_NEXT_HEAD, 0);
+   pru_write_word(MEM_PRU0_DATA, PRU0_READ_NUM, 0);
+   pru_write_word(MEM_PRU0_DATA, PRU0_CMD, CMD_STATUS_READ_STARTED);
+   index_ns = wait_index();
+   while (1) {
+      num_bytes = read_deltas(get_track(), 
+         index_ns + (uint64_t) start_clocks * CLOCKS_TO_NS, skip_clocks,
+         (read_num & 1) * ddr_half);
+      // Capture ends slightly past the next index
+      index_ns += drive.rotation_ns;
+      pru_sim_sleep_until_ns(index_ns + 
+         (uint64_t) (start_clocks + END_CAPTURE_CLOCKS) * CLOCKS_TO_NS);
+      next_head = pru_read_word(MEM_PRU0_DATA, PRU0_NEXT_HEAD);
+      if (!(next_head & (1 << NEXT_HEAD_VALID_BIT))) {
+         break;
+      }
+      pru_write_word(MEM_PRU0_DATA, PRU0_NEXT_HEAD, 0);
+      drive.head = next_head & 0xf;
+      pru_write_word(MEM_PRU0_DATA, PRU0_PREV_WRITE_PTR, num_bytes);
+      pru_write_word(MEM_PRU0_DATA, PRU0_PREV_STATUS, CMD_STATUS_OK);
+      pru_write_word(MEM_PRU0_DATA, PRU0_READ_NUM, ++read_num);
+      pru_write_word(MEM_PRU0_DATA, PRU0_WRITE_PTR, 0);
+      // Data isn't captured until the new head settles
+      skip_clocks = END_CAPTURE_CLOCKS + HEAD_SETTLE_CLOCKS;
+   }
+}
+
+// Write the track under the selected head from the DDR memory. The MFM
+// clock and data bits are converted to deltas.
+static void write_track(void)
+{
+   int header_bytes = pru_read_word(MEM_PRU1_DATA,
+      PRU1_DRIVE0_TRACK_HEADER_BYTES);
+   int data_bytes = pru_read_word(MEM_PRU1_DATA,
+      PRU1_DRIVE0_TRACK_DATA_BYTES);
+   int head = pru_read_word(MEM_PRU1_DATA, PRU1_CUR_HEAD);
+   // Pulse width is two bit cells
+   int bit_clocks = (pru_read_word(MEM_PRU0_DATA,
+      PRU0_DEFAULT_PULSE_WIDTH) + 1) / 2;
+   uint32_t words[data_bytes / sizeof(uint32_t)];
+   SIM_TRACK *track, *next;
+   uint16_t *deltas;
+   int num_deltas = 0;
+   int bits = 0;
+   int i, bit;
+
+   if (head >= MAX_HEAD) {
+      msg(MSG_FATAL, "Simulated write to head %d\n", head);
+      exit(1);
+   }
+   pru_read_mem(MEM_DDR, words, sizeof(words),
+      (header_bytes + data_bytes) * head + header_bytes);
+   deltas = msg_malloc(SIM_MAX_DELTAS * sizeof(*deltas), "pru_sim write");
+   for (i = 0; i < ARRAYSIZE(words); i++) {
+      for (bit = 31; bit >= 0; bit--) {
+         bits++;
+         if ((words[i] >> bit) & 1) {
+            if (num_deltas < SIM_MAX_DELTAS && bits * bit_clocks <= 0xffff) {
+               deltas[num_deltas++] = bits * bit_clocks;
+            }
+            bits = 0;
+         }
+      }
+   }
+   wait_index();
+   pru_sim_sleep_ns(drive.rotation_ns);
+
+   // The written data replaces all the reads of the track
+   track = &drive.tracks[drive.cyl][head];
+   free(track->deltas);
+   while (track->next != NULL) {
+      next = track->next->next;
+      free(track->next->deltas);
+      free(track->next);
+      track->next = next;
+   }
+   track->deltas = deltas;
+   track->num_deltas = num_deltas;
+   track->num_reads = 1;
+   track->read_count = 0;
+}
+
+// Simulated PRU program for reading and writing the drive. Performs the
+// commands from the ARM.
+//
+// pru: PRU number
+static void drive_program(int pru)
+{
+   uint32_t cmd, status;
+
+   load_drive();
+   while (!pru_sim_stopping(pru)) {
+      update_status();
+      cmd = pru_read_word(MEM_PRU0_DATA, PRU0_CMD);
+      // Status values are left in command location after command done
+      if (cmd == CMD_NONE || cmd >= CMD_STATUS_WAIT_READY) {
+         usleep(50);
+         continue;
+      }
+      status = CMD_STATUS_OK;
+      switch (cmd) {
+         case CMD_EXIT:
+            // mfm_write waits for both PRU to finish
+            pru_sim_signal_event(PRU_EVTOUT_0);
+            pru_sim_signal_event(PRU_EVTOUT_1);
+         break;
+         case CMD_READ_TRACK:
+            read_track();
+         break;
+         case CMD_RPM:
+            wait_index();
+            wait_index();
+            pru_write_word(MEM_PRU0_DATA, PRU0_CMD_DATA,
+               drive.rotation_ns / CLOCKS_TO_NS);
+         break;
+         case CMD_SEEK_FAST:
+            seek(pru_read_word(MEM_PRU0_DATA, PRU0_CMD_DATA), FAST_STEP_NS);
+         break;
+         case CMD_SEEK_SLOW:
+         case CMD_SEEK_SLOW_TRACK0:
+            seek(pru_read_word(MEM_PRU0_DATA, PRU0_CMD_DATA), SLOW_STEP_NS);
+         break;
+         case CMD_CHECK_READY:
+            if (!drive.selected) {
+               status = CMD_STATUS_READY_ERR;
+            }
+         break;
+         case CMD_WRITE_TRACK:
+            write_track();
+         break;
+         default:
+            msg(MSG_FATAL, "Unknown simulated PRU command %d\n", cmd);
+            exit(1);
+      }
+      update_status();
+      pru_write_word(MEM_PRU0_DATA, PRU0_CMD, status);
+   }
+}
+
+// Return the simulated PRU program for the PRU program file.
+//
+// filename: PRU program file name without directory
+// return: Simulated program or NULL if not simulated
+PRU_SIM_PROGRAM pru_sim_find_program(char *filename)
+{
+   if (strcmp(filename, "prucode0.bin") == 0 ||
+         strcmp(filename, "mfm_write0.bin") == 0) {
+      // Status lines are valid as soon as the program is started
+      update_status();
+      return drive_program;
+   }
+   if (strcmp(filename, "mfm_write1.bin") == 0) {
+      return pru_sim_idle_program;
+   }
+   return NULL;
+}
@@ -5,6 +5,8 @@
 //    Use the enhanced capture modules (eCAP) to measure the time
 //    between MFM transitions. The data is put in the shared DDR memory. The
 //    data 16 bit count of 200 MHz clocks between transitions.
+//    If the ARM sets PRU0_NEXT_HEAD before the read finishes the next head
+//    is selected and read at the same index pulse.
 // CMD_RPM:
 //    Measure drive RPM
 // CMD_SEEK_FAST:
@@ -22,6 +24,8 @@
 // PRU0_CMD_DATA
 //
 // Time is in 200 MHz clocks
+// 10/17/26 DJG Read head in PRU0_NEXT_HEAD when read finishes so the
+//   next head is read without waiting for another revolution
 // 09/08/21 DJG Fixed shared SRAM address. Shared SRAM not currently used.
 // 03/22/19 DJG Added REV C support
 // 02/17/19 DJG Capture sligtly past index to try to capture all data when
@@ -72,6 +76,8 @@
 
 // Maximum time to wait for an index pulse
 #define INDEX_TIMEOUT 5000000 // 25 milliseonds
+// Time to wait for read data after changing head select
+#define HEAD_SETTLE_TIME 2000 // 10 microseconds
 
 START:
    // Enable OCP master port
@@ -134,6 +140,14 @@ read_track:
    CALL     wait_ready
    QBNE     wait_cmd, r3, 0
 
+   // Previous read may have used other half of DDR
+   LBCO     r23, CONST_PRURAM, PRU_DDR_ADDR, 4
+   LBCO     r22, CONST_PRURAM, PRU_DDR_SIZE, 4
+   // ARM sets next head after it sees the read has started
+   MOV      r1, 0
+   SBCO     r1, CONST_PRURAM, PRU0_NEXT_HEAD, 4
+   SBCO     r1, CONST_PRURAM, PRU0_READ_NUM, 4
+
    // R21 will be Offset in DDR buffer to write to. PRU0_WRITE_PTR
    // is the word the ARM reads to find how many deltas have been written
    MOV      r21, 0                   
@@ -171,17 +185,19 @@ wait_start_time:
 wait_start_loop:
    LBBO     r0, CYCLE_CNTR, 0, 4
    QBLT     wait_start_loop, r3, r0   // Try again if we haven't timed out
+   MOV      r6, 0                     // Start time of capture is now
 
      // Trigger cap1 on rising edges. Reset count on trigger to get delta time
      //Enable cap1-4 buffer registers. Divide by 1, stop on emulation suspend
      // continuous mode, wrap after 4, no rearm, counter free run, no sync
      // capture mode. Reset sequencer
+     // r6 is clocks since the capture should have started. It is put in
+     // the count so the first delta includes it.
 start_read:
    MOV      r7, CMD_STATUS_OK    // Command status in r7
    MOV      r0, 0                // Stop capture
    SBCO     r0, CONST_ECAP, 0x28, 4
-   MOV      r0, 0x0              // Clear count
-   SBCO     r0, CONST_ECAP, 0, 4
+   SBCO     r6, CONST_ECAP, 0, 4 // Set count
    // This will trigger on both edges. Might be possible to use the inforation
    // to help decode poor bits
    //MOV      r0, 0x1e01ee
@@ -306,8 +322,67 @@ store:
    ADD      r21, r21, r2            // Inc pointer
    SBCO     r21, CONST_PRURAM, PRU0_WRITE_PTR, 4   // write ptr 
 no_queued:
+   // If ARM has requested another head read it starting at this index.
+   // Otherwise we are done
+   LBCO     r0, CONST_PRURAM, PRU0_NEXT_HEAD, 4
+   QBBS     next_head, r0, NEXT_HEAD_VALID_BIT
    SBCO     r7, CONST_PRURAM, PRU0_CMD, 4 // Indicate command completed ok
    JMP      wait_cmd   
+
+next_head:
+   // Clear request so ARM can make the next one when it sees this read
+   // has started
+   MOV      r1, 0
+   SBCO     r1, CONST_PRURAM, PRU0_NEXT_HEAD, 4
+   // Select the head. Lines are inverted by driver so set bit selects.
+   // Position of lines depends on board revision.
+   AND      r0, r0, 0xf
+   MOV      r2, GPIO0_HEAD_SEL_SHIFT
+   LBCO     r1, CONST_PRURAM, PRU0_BOARD_REVISION, 4
+   QBNE     head_sel, r1, 0
+   MOV      r2, GPIO0_HEAD_SEL_SHIFT_REVA
+head_sel:
+   LSL      r3, r0, r2
+   XOR      r4, r0, 0xf
+   LSL      r4, r4, r2
+   MOV      r1, GPIO0 | GPIO_SETDATAOUT
+   SBBO     r3, r1, 0, 4
+   MOV      r1, GPIO0 | GPIO_CLEARDATAOUT
+   SBBO     r4, r1, 0, 4
+
+   // Give ARM final pointer and status of the read just finished then
+   // tell it the next read has started. The read number must be
+   // updated before the write pointer is cleared.
+   SBCO     r21, CONST_PRURAM, PRU0_PREV_WRITE_PTR, 4
+   SBCO     r7, CONST_PRURAM, PRU0_PREV_STATUS, 4
+   LBCO     r0, CONST_PRURAM, PRU0_READ_NUM, 4
+   ADD      r0, r0, 1
+   SBCO     r0, CONST_PRURAM, PRU0_READ_NUM, 4
+   MOV      r21, 0
+   SBCO     r21, CONST_PRURAM, PRU0_WRITE_PTR, 4
+
+   // Even reads use first half of DDR and odd reads the second half so
+   // the ARM can still be copying the previous read
+   LBCO     r23, CONST_PRURAM, PRU_DDR_ADDR, 4
+   LBCO     r22, CONST_PRURAM, PRU_DDR_SIZE, 4
+   LSR      r22, r22, 1             // Half size - 1
+   QBBC     head_settle_start, r0, 0
+   ADD      r23, r23, r22
+   ADD      r23, r23, 1
+
+   // Timer was cleared at the index. Wait for the read data from the new
+   // head then start capture with the time since the start time of the
+   // read so the deltas have the same timing as a normal read.
+head_settle_start:
+   LBBO     r3, CYCLE_CNTR, 0, 4
+   MOV      r2, HEAD_SETTLE_TIME
+   ADD      r3, r3, r2
+head_settle:
+   LBBO     r0, CYCLE_CNTR, 0, 4
+   QBLT     head_settle, r3, r0
+   LBCO     r1, CONST_PRURAM, PRU0_START_TIME_CLOCKS, 4
+   SUB      r6, r0, r1
+   JMP      start_read
 overflow:
    MOV      r1, CMD_STATUS_READ_OVERFLOW
    SBCO     r1, CONST_PRURAM, PRU0_CMD, 4 // Error
@@ -6,6 +6,10 @@
 // We probably should be able to do better than just the PLL since we can 
 // look ahead.
 //
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Moved static variables into TRACK_STATE
+// 10/17/26 DJG Made static variables thread local for mfm_util --jobs
 // 12/08/22 DJG Changed error message
 // 07/20/22 DJG Process sector if bytes decoded exactly matches needed
 // 03/17/22 DJG Handle large deltas and improved error message
@@ -53,6 +57,7 @@
 #include "emu_tran_file.h"
 #include "mfm_decoder.h"
 #include "deltas_read.h"
+#include "mfm_pll.h"
 
 // Side of data to skip after header or data area. 
 #define HEADER_IGNORE_BYTES 10
@@ -60,19 +65,6 @@
 // may look like a sector start byte.
 #define DATA_IGNORE_BYTES 10
 
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
-{
-   float in, out;
-
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
-}
-
 // Decode bytes into header or sector data for the various formats we know about.
 // The decoded data will be written to a file if one was specified.
 // Since processing a header with errors can overwrite other good sectors this routine
@@ -153,65 +145,65 @@ SECTOR_DECODE_STATUS tagged_process_data(STATE_TYPE *state, uint8_t bytes[],
       SECTOR_STATUS sector_status_list[], int ecc_span, 
       SECTOR_DECODE_STATUS init_status)
 {
-   static int sector_size;
-   // Non zero if sector is a bad block, has alternate track assigned,
-   // or is an alternate track
-   static SECTOR_STATUS sector_status;
+   // Values saved between processing the header and data are kept in
+   // the track state
+   TRACK_STATE *track_state = drive_params->track_state;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
 
    if (*state == PROCESS_HEADER) {
-      memset(&sector_status, 0, sizeof(sector_status));
-      sector_status.status |= init_status | SECT_HEADER_FOUND;
-      sector_status.ecc_span_corrected_header = ecc_span;
+      memset(sector_status, 0, sizeof(*sector_status));
+      sector_status->status |= init_status | SECT_HEADER_FOUND;
+      sector_status->ecc_span_corrected_header = ecc_span;
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
 
       if (drive_params->controller == CONTROLLER_XEROX_6085 ||
             drive_params->controller == CONTROLLER_TELENEX_AUTOSCOPE) {
-         sector_status.cyl = bytes[2]<< 8;
-         sector_status.cyl |= bytes[3];
+         sector_status->cyl = bytes[2]<< 8;
+         sector_status->cyl |= bytes[3];
 
          // More is in here but what is not documented in manual
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
          if ((bytes[4] & 0xf0) != 0) {
             msg(MSG_INFO, "byte 4 upper bits not zero: %02x on cyl %d head %d sector %d\n",
-                bytes[4], sector_status.cyl, sector_status.head, sector_status.sector);
+                bytes[4], sector_status->cyl, sector_status->head, sector_status->sector);
            msg(MSG_INFO, "May indicate bad block or alternate sector\n");
            // Rest of format matches CONTROLLER_OMTI_5510 so this byte may also
          }
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[5];
+         sector_status->sector = bytes[5];
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_XEROX_8010) {
-         sector_status.cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4]);
-         sector_size = drive_params->sector_size;
+         sector_status->cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4]);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[5];
+         sector_status->sector = bytes[5];
 
          if ((bytes[1])  != 0x41) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else {
          msg(MSG_FATAL,"Unknown controller type %d\n",drive_params->controller);
          exit(1);
       }
 
-      mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-            seek_difference, &sector_status, drive_params, sector_status_list);
+      mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+            seek_difference, sector_status, drive_params, sector_status_list);
 
       msg(MSG_DEBUG,
          "Got exp %d,%d cyl %d head %d sector %d,%d size %d\n",
-            exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-            sector_status.sector, *sector_index, sector_size);
+            exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+            sector_status->sector, *sector_index, track_state->sector_size);
       if ((drive_params->controller == CONTROLLER_XEROX_6085) ||
        (drive_params->controller == CONTROLLER_XEROX_8010)) {
          *state = MARK_DATA1;
@@ -219,32 +211,32 @@ SECTOR_DECODE_STATUS tagged_process_data(STATE_TYPE *state, uint8_t bytes[],
          *state = MARK_DATA;
       }
    } else if (*state == PROCESS_HEADER2) {
-      sector_status.status |= init_status;
+      sector_status->status |= init_status;
       if (drive_params->controller == CONTROLLER_XEROX_8010) {
          if (bytes[1] != 0x43) {
             msg(MSG_INFO, "Invalid tag id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-               bytes[1], exp_cyl, sector_status.cyl,
-               exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               bytes[1], exp_cyl, sector_status->cyl,
+               exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else {
       if (bytes[1] != 0xfc) {
          msg(MSG_INFO, "Invalid tag id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-               bytes[1], exp_cyl, sector_status.cyl,
-               exp_head, sector_status.head, sector_status.sector);
-         sector_status.status |= SECT_BAD_HEADER;
+               bytes[1], exp_cyl, sector_status->cyl,
+               exp_head, sector_status->head, sector_status->sector);
+         sector_status->status |= SECT_BAD_HEADER;
       }
       }
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
+      sector_status->ecc_span_corrected_data = ecc_span;
       *state = MARK_DATA;
-      if (!(sector_status.status & SECT_BAD_HEADER)) {
-         mfm_write_metadata(&bytes[2], drive_params, &sector_status);
+      if (!(sector_status->status & SECT_BAD_HEADER)) {
+         mfm_write_metadata(&bytes[2], drive_params, sector_status);
       }
    } else { // Data
       // Value and where to look for header mark byte
@@ -256,28 +248,28 @@ SECTOR_DECODE_STATUS tagged_process_data(STATE_TYPE *state, uint8_t bytes[],
       if (bytes[id_byte_index] != id_byte_expected && crc == 0) {
          msg(MSG_INFO,"Invalid data id byte %02x expected %02x on cyl %d head %d sector %d\n", 
                bytes[id_byte_index], id_byte_expected,
-               sector_status.cyl, sector_status.head, sector_status.sector);
-         sector_status.status |= SECT_BAD_DATA;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
-      if (!(sector_status.status & SECT_BAD_HEADER)) {
+      sector_status->ecc_span_corrected_data = ecc_span;
+      if (!(sector_status->status & SECT_BAD_HEADER)) {
          int dheader_bytes = mfm_controller_info[drive_params->controller].data_header_bytes;
 
-         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, &sector_status,
+         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, sector_status,
                sector_status_list, &bytes[1], total_bytes-1) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       *state = MARK_ID;
    }
 
-   return sector_status.status;
+   return sector_status->status;
 }
 
 // Decode a track's worth of deltas.
@@ -309,15 +301,11 @@ SECTOR_DECODE_STATUS tagged_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int decoded_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency
-   float avg_bit_sep_time;     // 200 MHz clocks
-   float nominal_bit_sep_time; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
    // Counter for debugging
@@ -335,15 +323,6 @@ SECTOR_DECODE_STATUS tagged_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // also ignoring known write splice location should help.
 #define MARK_NUM_ZEROS 2
    int zero_count = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
-   // And number from last time
-   int last_deltas = 0;
-   // If we get too large a delta we need to process it in less than 32 bit
-   // word number of bits. This holds remaining number to process
-   int remaining_delta = 0;
-   // Maximum delta to process in one pass
-   int max_delta;
    // Intermediate value
    int tmp_raw_word;
    // Collect bytes to further process here
@@ -365,49 +344,21 @@ SECTOR_DECODE_STATUS tagged_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int first_addr_mark_ns = 0;
 
 
-   num_deltas = deltas_get_count(0);
    raw_word = 0;
-   nominal_bit_sep_time = 200e6 /
-       mfm_controller_info[drive_params->controller].clk_rate_hz;
-   max_delta = nominal_bit_sep_time * 22;
-   avg_bit_sep_time = nominal_bit_sep_time;
-   i = 1;
-   while (num_deltas >= 0) {
+   pll_track = mfm_pll_track_start(drive_params, deltas, 200e6 /
+      mfm_controller_info[drive_params->controller].clk_rate_hz, 1);
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas;) {
-         int delta_process;
-         // If no remaining delta process next else finish remaining
-         if (remaining_delta == 0) {
-            delta_process = deltas[i++];
-            remaining_delta = delta_process;
-         }  else {
-            delta_process = remaining_delta;
-         }
-         // Don't overflow our 32 bit word
-         if (delta_process > max_delta) {
-            delta_process = max_delta;
-         }
-         track_time += delta_process;
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += delta_process;
-         remaining_delta -= delta_process;
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock. Don't update PLL if this is a long burst without
-         // transitions
-         if (remaining_delta == 0) {
-            avg_bit_sep_time = nominal_bit_sep_time + filter(clock_time, &filter_state);
-         }
+      for (; i < num_steps; i++) {
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 #if 0
          if (cyl == 819 && head == 0) {
          printf
          ("  delta %d %d clock %.2f int bit pos %d avg_bit %.2f time %d\n",
-               deltas[i], i, clock_time,
-               int_bit_pos, avg_bit_sep_time, track_time);
+               pll_track->steps[i].delta, i, pll_track->pll.clock_time,
+               int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time);
          }
 #endif
          if (all_raw_bits_count + int_bit_pos >= 32) {
@@ -476,7 +427,7 @@ last_tot_raw_bit_cntr = tot_raw_bit_cntr;
                byte_cntr = 1;
                if (state == MARK_ID) {
                   state = PROCESS_HEADER;
-                  mfm_mark_header_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+                  mfm_mark_header_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = mfm_controller_info[drive_params->controller].header_bytes + 
                         drive_params->header_crc.length / 8;
@@ -489,7 +440,7 @@ last_tot_raw_bit_cntr = tot_raw_bit_cntr;
                   bytes_needed = bytes_crc_len + HEADER_IGNORE_BYTES;
                } else {
                   state = PROCESS_DATA;
-                  mfm_mark_data_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+                  mfm_mark_data_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes + 
                         mfm_controller_info[drive_params->controller].data_trailer_bytes + 
@@ -580,14 +531,6 @@ last_tot_raw_bit_cntr = tot_raw_bit_cntr;
             }
          }
       }
-      // Finished what we had, any more?
-      // If we didn't get too many last time sleep so delta reader can run.
-      // Thread priorities might be better.
-      if (num_deltas - last_deltas <= 2000) {
-         usleep(500);
-      }
-      last_deltas = num_deltas;
-      num_deltas = deltas_get_count(i);
    }
    if (state == PROCESS_DATA && sector_index <= drive_params->num_sectors) {
       float begin_time =
@@ -14,6 +14,12 @@
 // Code has somewhat messy implementation that should use the new data
 // on format to drive processing. Also needs to be added to other decoders.
 //
+// 10/17/26 DJG Decode whole bytes from packed raw bits with mfm_decode_raw_bytes
+// 10/17/26 DJG Skip to possible marks found in packed raw bits
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Moved static variables into TRACK_STATE and DECODE_CONTEXT
+// 10/17/26 DJG Made static variables thread local for mfm_util --jobs
 // 05/15/26 DJG Added SHUGART_CD9963 & HP9133XV controller
 // 06/12/25 DJG/DV Add CONTROLLER_MICROBEE_WD1002_05
 // 01/20/25 SH  Add ext2emu support for corvus_omni
@@ -146,6 +152,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdint.h>
+#include <limits.h>
 #include <arpa/inet.h>
 
 #include "msg.h"
@@ -153,6 +160,7 @@
 #include "emu_tran_file.h"
 #include "mfm_decoder.h"
 #include "deltas_read.h"
+#include "mfm_pll.h"
 
 // Side of data to skip after header or data area. 
 #define HEADER_IGNORE_BYTES 10
@@ -167,25 +175,6 @@ static unsigned char rev_lookup[16] = {
    0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf };
 #define REV_BYTE(n)( (rev_lookup[n&0xf] << 4) | rev_lookup[n>>4])
 
-// Number of bad sectors skipped for track or zone.
-// Used by CONTROLLER_SHUGART_CD9963
-static int sectors_skipped_zone = 0;
-static int sectors_skipped_track = 0;
-static int last_zone = 0;
-
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
-{
-   float in, out;
-
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
-}
-
 // Return non zero if cylinder passed in is last cylinder on drive
 static int IsOutermostCylinder(DRIVE_PARAMS *drive_params, int cyl)
 {
@@ -1176,92 +1165,90 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
       SECTOR_STATUS sector_status_list[], int ecc_span,
       SECTOR_DECODE_STATUS init_status)
 {
-   static int sector_size;
-   // Non zero if sector is a bad block, has alternate track assigned,
-   // or is an alternate track
-   static int bad_block, alt_assigned, is_alternate, alt_assigned_handled;
-   static SECTOR_STATUS sector_status;
-   // 0 after first sector marked spare/bad found. Only used for Adaptec 
-   static int first_spare_bad_sector = 1;
+   // Values saved between processing the header and data are kept in
+   // the track state
+   TRACK_STATE *track_state = drive_params->track_state;
+   DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
 
    if (*state == PROCESS_HEADER) {
       // Clear these since not used by all formats
-      alt_assigned = 0;
-      alt_assigned_handled = 0;
-      is_alternate = 0;
-      bad_block = 0;
-
-      memset(&sector_status, 0, sizeof(sector_status));
-      sector_status.status |= init_status | SECT_HEADER_FOUND;
-      sector_status.ecc_span_corrected_header = ecc_span;
+      track_state->alt_assigned = 0;
+      track_state->alt_assigned_handled = 0;
+      track_state->is_alternate = 0;
+      track_state->bad_block = 0;
+
+      memset(sector_status, 0, sizeof(*sector_status));
+      sector_status->status |= init_status | SECT_HEADER_FOUND;
+      sector_status->ecc_span_corrected_header = ecc_span;
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
 
       if (drive_params->controller == CONTROLLER_OMTI_5510 ||
             drive_params->controller == CONTROLLER_OMTI_5200_18SECTOR_512B) {
-         sector_status.cyl = bytes[2]<< 8;
-         sector_status.cyl |= bytes[3];
+         sector_status->cyl = bytes[2]<< 8;
+         sector_status->cyl |= bytes[3];
 
          // More is in here but what is not documented in manual
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
-         bad_block = bytes[4] >> 7;;
-         alt_assigned = (bytes[4] & 0x40) >> 6;
-         is_alternate = (bytes[4] & 0x20) >> 5;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
+         track_state->bad_block = bytes[4] >> 7;;
+         track_state->alt_assigned = (bytes[4] & 0x40) >> 6;
+         track_state->is_alternate = (bytes[4] & 0x20) >> 5;
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[5];
+         sector_status->sector = bytes[5];
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_MORROW_MD11 ||
            drive_params->controller == CONTROLLER_UNKNOWN1) {
-         sector_status.cyl = bytes[3]<< 8;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = bytes[3]<< 8;
+         sector_status->cyl |= bytes[2];
 
          // More is in here but what is not documented in manual
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
-         bad_block = bytes[4] >> 7;;
-         alt_assigned = (bytes[4] & 0x40) >> 6;
-         is_alternate = (bytes[4] & 0x20) >> 5;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4] & 0xf);
+         track_state->bad_block = bytes[4] >> 7;;
+         track_state->alt_assigned = (bytes[4] & 0x40) >> 6;
+         track_state->is_alternate = (bytes[4] & 0x20) >> 5;
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[5];
+         sector_status->sector = bytes[5];
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_UNKNOWN2) {
-         sector_status.cyl = bytes[3]<< 8;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = bytes[3]<< 8;
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4]);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4]);
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[5];
+         sector_status->sector = bytes[5];
          if (bytes[1] != 0x0b) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SHUGART_SA1400) {
-         sector_status.cyl = bytes[2];
+         sector_status->cyl = bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3]);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3]);
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DEC_RQDX3 &&
           !IsOutermostCylinder(drive_params, exp_cyl)) {
@@ -1272,34 +1259,34 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             // handle multiple formats for a disk so the entire disk can
             // be read without error. Other DEC controllers that use
             // same format don't seem to do this.
-         sector_status.cyl = (bytes[3] & 0xf0) << 4;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = (bytes[3] & 0xf0) << 4;
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_status.sector = bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         sector_status->sector = bytes[4];
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
          // TODO: Figure out a better way to deal with sector number invalid
          // when bad block.
-         bad_block = (sector_status.sector == 255);
-         if (bad_block) {
-            sector_status.status |= SECT_BAD_SECTOR_NUMBER | SECT_SPARE_BAD;
+         track_state->bad_block = (sector_status->sector == 255);
+         if (track_state->bad_block) {
+            sector_status->status |= SECT_BAD_SECTOR_NUMBER | SECT_SPARE_BAD;
             // TODO: Print added here since count not properly updated due
             // to not knowing sector number
             msg(MSG_INFO,"Bad block set on cyl %d, head %d, sector %d\n",
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
          }
          // Don't know what's in this byte. Print a message so it can be
          // investigated if not the 2 seen previously.
          if (bytes[5] != 0x2) {
             msg(MSG_INFO, "Header Byte 5 not 2, byte %02x on cyl %d head %d sector %d\n",
-                  bytes[5], sector_status.cyl, sector_status.head, sector_status.sector);
+                  bytes[5], sector_status->cyl, sector_status->head, sector_status->sector);
          }
 
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DJ_II ) {
          // Controller David Junior II
@@ -1336,8 +1323,8 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int cyl_high;
          int hdr_offset, hdr_mask;
 
-         sector_size = drive_params->sector_size; // Sectore size need from user
-         bad_block = 0;
+         track_state->sector_size = drive_params->sector_size; // Sectore size need from user
+         track_state->bad_block = 0;
          
          cyl_high = ((~bytes[5] ) >> 7) & 0x01; // Get ~T8 from byte 5 and invert it
          //Format change after cylinder d512. Can detect if T4 bit is not inverted in second copy.
@@ -1345,39 +1332,39 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             cyl_high |= (((~bytes[4] ) >> 5) & 0x07) << 1;  //Get ~TB,~TA,~T9 from byte 4 and invert it
          }
 
-         sector_status.cyl = cyl_high << 8;
-         sector_status.cyl |= bytes[2]; // Adding low cyl
+         sector_status->cyl = cyl_high << 8;
+         sector_status->cyl |= bytes[2]; // Adding low cyl
 
          // Bad block is 8 bytes long keeps the current track/sect head information in the last 4 bytes
          if (bytes[6] != 0x00 && bytes[7] != 0x00 && bytes[8] != 0x00){ 
-            int new_cyl = sector_status.cyl;
+            int new_cyl = sector_status->cyl;
             int new_head = bytes[3] & 7;
 
-            bad_block=0;
+            track_state->bad_block=0;
             cyl_high = ((~bytes[9] ) >> 7) & 0x01;
             if (!((bytes[6] ^ bytes[8]) & 0x10)) {
                cyl_high |= (((~bytes[8] ) >> 5) & 0x07) << 1; 
             }
-            sector_status.cyl = cyl_high << 8;
-            sector_status.cyl |= bytes[6];
-            sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[7] & 0xe0) >> 5 );
-            sector_status.sector = (bytes[7] & 0x1f);
+            sector_status->cyl = cyl_high << 8;
+            sector_status->cyl |= bytes[6];
+            sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[7] & 0xe0) >> 5 );
+            sector_status->sector = (bytes[7] & 0x1f);
 
-            mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-               sector_status.head, new_cyl, new_head);
+            mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+               sector_status->head, new_cyl, new_head);
 
             hdr_offset = 4;
             hdr_mask = 0x7f;
          } else {
             // Is it spare track header?
             if ((bytes[3] & 0x78) == 0x58 && (bytes[5] & 0x78) == 0x58) {
-               sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x07));
+               sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x07));
                // No sector in header. Code needs sectors to be unique so we number them
-               sector_status.sector = *sector_index; 
+               sector_status->sector = *sector_index; 
                hdr_mask = 0x7;
             } else {
-               sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0xe0) >> 5 );
-               sector_status.sector = (bytes[3] & 0x1f) ; // Get sectors from byte 3
+               sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0xe0) >> 5 );
+               sector_status->sector = (bytes[3] & 0x1f) ; // Get sectors from byte 3
                hdr_mask = 0x7f;
             }
             hdr_offset = 0;
@@ -1387,14 +1374,14 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
                 ((bytes[3 + hdr_offset] & hdr_mask) != (~bytes[5 + hdr_offset] & hdr_mask))) {
             msg(MSG_INFO, "Header mismatch %x %x %x %x on cyl %d head %d sector %d\n",
                bytes[2], bytes[3], bytes[4], bytes[5],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
 
          if (bytes[1] != 0xfd) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DJ_II_210 || drive_params->controller == CONTROLLER_DJ_II_301 ) {
          // File martensson/trans_file.zip
@@ -1424,168 +1411,168 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
 
          int cyl_high;
 
-         sector_size = drive_params->sector_size; // Sectore size need from user
-         bad_block = 0;
+         track_state->sector_size = drive_params->sector_size; // Sectore size need from user
+         track_state->bad_block = 0;
          
          cyl_high = (bytes[2]   & 0x07); // Get high from byte 2
-         sector_status.cyl = cyl_high << 8;
-         sector_status.cyl |= bytes[3]; // Adding low cyl
+         sector_status->cyl = cyl_high << 8;
+         sector_status->cyl |= bytes[3]; // Adding low cyl
 
          if (bytes[4] >> 6 == 0x01){  //alternativ track
-            int new_cyl = sector_status.cyl;
+            int new_cyl = sector_status->cyl;
             int new_head = (bytes[7] & 0xe0) >> 5;
 
-            bad_block=0;
-            sector_status.cyl = cyl_high << 8;
-            sector_status.cyl |= bytes[6];
-            sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[7] & 0xe0) >> 5 );
-            sector_status.sector = (bytes[7] & 0x1f);
+            track_state->bad_block=0;
+            sector_status->cyl = cyl_high << 8;
+            sector_status->cyl |= bytes[6];
+            sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[7] & 0xe0) >> 5 );
+            sector_status->sector = (bytes[7] & 0x1f);
 
-            mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-               sector_status.head, new_cyl, new_head);
+            mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+               sector_status->head, new_cyl, new_head);
          }else if(bytes[4] >> 6 == 0x02) {
             // Handle bad
-            bad_block=1;
+            track_state->bad_block=1;
          }else{
-            sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[2] & 0xF8) >> 3 );
-            sector_status.sector = (bytes[4] & 0x3f) ; // Get sectors from byte 4
+            sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[2] & 0xF8) >> 3 );
+            sector_status->sector = (bytes[4] & 0x3f) ; // Get sectors from byte 4
          }
 
 
          if (bytes[1] != 0xfd) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          
          
          } else if (drive_params->controller == CONTROLLER_MYARC_HFDC) {
          int ecc_size[] = { 4, -1, -1, -1,  -1, -1, -1 ,-1 ,
                            -1, -1, -1, -1,  -1,  7,  6,  5};
-         sector_status.cyl = (bytes[3] & 0xf0) << 4;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = (bytes[3] & 0xf0) << 4;
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_status.sector = bytes[4];
-         bad_block = bytes[5] >> 7;;
-         sector_size = 128 << (bytes[5] & 0x7);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         sector_status->sector = bytes[4];
+         track_state->bad_block = bytes[5] >> 7;;
+         track_state->sector_size = 128 << (bytes[5] & 0x7);
          if (drive_params->data_crc.length/8 != ecc_size[(bytes[5] & 0x70) >> 4]) {
             msg(MSG_INFO, "CRC size mismatch header byte %x on cyl %d head %d sector %d\n",
-                  bytes[5], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[5], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
 
-         if (bytes[1] != (0xfe ^ (sector_status.cyl >> 8))) {
+         if (bytes[1] != (0xfe ^ (sector_status->cyl >> 8))) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SHUGART_1610) {
-         sector_status.cyl = (bytes[3] & 0x70) << 4;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = (bytes[3] & 0x70) << 4;
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x7);
-         sector_status.sector = bytes[4];
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x7);
+         sector_status->sector = bytes[4];
+         track_state->sector_size = drive_params->sector_size;
          int flag = ((bytes[3] & 0x80) >> 6) | ((bytes[3] & 0x8) >> 3);
-         bad_block = (flag == 2);
-         alt_assigned = (flag == 3);
-         if (alt_assigned) {
+         track_state->bad_block = (flag == 2);
+         track_state->alt_assigned = (flag == 3);
+         if (track_state->alt_assigned) {
             // header has cyl and head of alternate track. Return cyl and
             // head of expected track to avoid error messages. Alt track
             // handling will swap the extracted data in the end.
             mfm_handle_alt_track_ch(drive_params, exp_cyl, exp_head,
-              sector_status.cyl, sector_status.head);
-            sector_status.cyl = exp_cyl;
-            sector_status.head = exp_head;
-            alt_assigned_handled = 1;
+              sector_status->cyl, sector_status->head);
+            sector_status->cyl = exp_cyl;
+            sector_status->head = exp_head;
+            track_state->alt_assigned_handled = 1;
          }
-         is_alternate = (flag == 1);
-         if (is_alternate) {
+         track_state->is_alternate = (flag == 1);
+         if (track_state->is_alternate) {
             // header has cyl and head of track alternate of. Return cyl and
             // head of expected track.
-            sector_status.cyl = exp_cyl;
-            sector_status.head = exp_head;
+            sector_status->cyl = exp_cyl;
+            sector_status->head = exp_head;
          }
 
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SHUGART_CD9963) {
-         sector_status.cyl = (bytes[3] & 0x70) << 4;
-         sector_status.cyl |= bytes[2];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x7);
-         sector_status.sector = bytes[4];
+         sector_status->cyl = (bytes[3] & 0x70) << 4;
+         sector_status->cyl |= bytes[2];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x7);
+         sector_status->sector = bytes[4];
          // Sector 255 is bad sectors that are skipped. The highest sector
          // numbers won't be used on the track to renumber it to that so we
          // don't print errors
          if (bytes[4] == 255) {
-            sectors_skipped_track++;
-            sector_status.sector = drive_params->num_sectors - 
-              sectors_skipped_track + drive_params->first_sector_number;
+            decode_ctx->sectors_skipped_track++;
+            sector_status->sector = drive_params->num_sectors - 
+              decode_ctx->sectors_skipped_track + drive_params->first_sector_number;
             msg(MSG_INFO, "Bad sector spared on cyl %d head %d physical sector %d\n",
-                  sector_status.cyl, sector_status.head, *sector_index);
+                  sector_status->cyl, sector_status->head, *sector_index);
          }
 
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_IBM_3174) {
-         sector_status.cyl = (bytes[3] & 0xe0) << 3;
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl = (bytes[3] & 0xe0) << 3;
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x1f);
-         sector_status.sector = bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x1f);
+         sector_status->sector = bytes[4];
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
          // Don't know what's in this byte. Print a message so it can be
          // investigated if not the 2 seen previously.
          if (bytes[5] != 0x2) {
             msg(MSG_INFO, "Header Byte 5 not 2, byte %02x on cyl %d head %d sector %d\n",
-                  bytes[5], sector_status.cyl, sector_status.head, sector_status.sector);
+                  bytes[5], sector_status->cyl, sector_status->head, sector_status->sector);
          }
 
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_MVME320) {
-         sector_status.cyl = (bytes[2] << 8) | bytes[3];
+         sector_status->cyl = (bytes[2] << 8) | bytes[3];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4]);
-         sector_status.sector = bytes[5];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4]);
+         sector_status->sector = bytes[5];
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
          // Don't know what's in this byte. Print a message so it can be
          // investigated if not the 2 seen previously.
          if (bytes[6] != 0x01) {
             msg(MSG_INFO, "Header Byte 6 not 1, byte %02x on cyl %d head %d sector %d\n",
-                  bytes[6], sector_status.cyl, sector_status.head, sector_status.sector);
+                  bytes[6], sector_status->cyl, sector_status->head, sector_status->sector);
          }
 
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d head %d sector %d\n",
-                  bytes[1], sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_MOTOROLA_VME10) {
-         sector_status.cyl = (bytes[2] << 8) | bytes[3];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4] >> 5);
-         sector_status.sector = bytes[4] & 0x1f;
-         sector_size = drive_params->sector_size;
+         sector_status->cyl = (bytes[2] << 8) | bytes[3];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4] >> 5);
+         sector_status->sector = bytes[4] & 0x1f;
+         track_state->sector_size = drive_params->sector_size;
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_WD_1006 ||
             drive_params->controller == CONTROLLER_RQDX2 || 
@@ -1604,114 +1591,113 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int sector_size_lookup[4] = {256, 512, 1024, 128};
          int cyl_high_lookup[16] = {0,1,2,3,-1,-1,-1,-1,4,5,6,7,-1,-1,-1,-1};
          int cyl_high;
-         static int last_sector_group = 0;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
          if (drive_params->controller == CONTROLLER_RQDX2) {
-            sector_size = 512;
+            track_state->sector_size = 512;
          } else {
-            sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
+            track_state->sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
          } 
-         bad_block = (bytes[3] & 0x80) >> 7;
+         track_state->bad_block = (bytes[3] & 0x80) >> 7;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
          if (drive_params->controller == CONTROLLER_WD_MICROENGINE &&
-               sector_status.sector == 0xff) {
+               sector_status->sector == 0xff) {
             // Spare sector, ignore
-            sector_status.ignore = 1;
+            sector_status->ignore = 1;
             // This seems to fix for example with 2 heads
-            if (bad_block) {
-               sector_status.head ^= 0xf;
+            if (track_state->bad_block) {
+               sector_status->head ^= 0xf;
             }
          }
          // These may be spare sectors but example had no bad blocks so
          // don't know how they are handled
          if (drive_params->controller == CONTROLLER_HP9133XV) {
-            if (sector_status.sector == 0xff) {
-               sector_status.ignore = 1;
+            if (sector_status->sector == 0xff) {
+               sector_status->ignore = 1;
             } else if (*sector_index == 31) {
                msg(MSG_INFO, "Last sector not 255 on cyl %d,%d head %d,%d sector %d\n",
-                  exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
+                  exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
             }
          }
          // 3B1 with P5.1 stores 4th head bit in bit 5 of sector number field.
          if (drive_params->controller == CONTROLLER_WD_3B1) {
-            sector_status.head = sector_status.head | ((sector_status.sector & 0xe0) >> 2);
-            sector_status.sector &= 0x1f;
+            sector_status->head = sector_status->head | ((sector_status->sector & 0xe0) >> 2);
+            sector_status->sector &= 0x1f;
          }
          if (drive_params->controller == CONTROLLER_SOUYZ_NEON) {
-            sector_status.sector = bytes[4] % 32;
-            if (bytes[4] / 32 != last_sector_group) {
-               last_sector_group = bytes[4] / 32;
+            sector_status->sector = bytes[4] % 32;
+            if (bytes[4] / 32 != decode_ctx->last_sector_group) {
+               decode_ctx->last_sector_group = bytes[4] / 32;
                msg(MSG_INFO, "New sector group found %d,%d at head %d cylinder %d\n",
-                bytes[4], last_sector_group, sector_status.head, sector_status.cyl);
+                bytes[4], decode_ctx->last_sector_group, sector_status->head, sector_status->cyl);
             }
          }
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_NEC_4800) {
          int cyl_high_lookup[16] = {0,1,2,3,-1,-1,-1,-1,4,5,6,7,-1,-1,-1,-1};
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xc];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_size = drive_params->sector_size;
-         sector_status.sector = bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         track_state->sector_size = drive_params->sector_size;
+         sector_status->sector = bytes[4];
 
-         alt_assigned = (bytes[3] & 0x80) >> 7;
+         track_state->alt_assigned = (bytes[3] & 0x80) >> 7;
 
-         if (alt_assigned) {
+         if (track_state->alt_assigned) {
             // Each sector is marked separatly but looks like all sectors are
             // assigned alternate track.
             mfm_handle_alt_track_ch(drive_params, 
                exp_cyl, exp_head,
-               sector_status.cyl, sector_status.head);
-            alt_assigned_handled = 1;
-            sector_status.cyl = exp_cyl;
-            sector_status.head = exp_head;
+               sector_status->cyl, sector_status->head);
+            track_state->alt_assigned_handled = 1;
+            sector_status->cyl = exp_cyl;
+            sector_status->head = exp_head;
             if (drive_params->ignore_seek_errors) {
                msg(MSG_INFO, "--ignore_seek_error may make alternate track replacement replace wrong track\n");
             }
          } else {
-            is_alternate = (bytes[3] & 0x40) >> 6;
-            if (is_alternate) {
+            track_state->is_alternate = (bytes[3] & 0x40) >> 6;
+            if (track_state->is_alternate) {
                // Set to actual cylinder and head
-               sector_status.cyl = exp_cyl;
-               sector_status.head = exp_head;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = exp_head;
             }
          }
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DIMENSION_68000) {
-         sector_status.cyl = ((bytes[2] & 0xf) << 8) | bytes[3];
+         sector_status->cyl = ((bytes[2] & 0xf) << 8) | bytes[3];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] >> 4);
-         sector_size = drive_params->sector_size;
-         sector_status.sector = bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] >> 4);
+         track_state->sector_size = drive_params->sector_size;
+         sector_status->sector = bytes[4];
 
          // Bad track
          if (bytes[5] == 5) {
@@ -1719,23 +1705,23 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             // head of expected track to avoid error messages. Alt track
             // handling will swap the extracted data in the end.
             mfm_handle_alt_track_ch(drive_params, exp_cyl, exp_head,
-              sector_status.cyl, sector_status.head);
-            sector_status.cyl = exp_cyl;
-            sector_status.head = exp_head;
-            alt_assigned_handled = 1;
+              sector_status->cyl, sector_status->head);
+            sector_status->cyl = exp_cyl;
+            sector_status->head = exp_head;
+            track_state->alt_assigned_handled = 1;
          // Alternate track
          } else if (bytes[5] == 9) {
-            is_alternate = 1;
+            track_state->is_alternate = 1;
             // header has cyl and head of track alternate of. Return cyl and
             // head of expected track.
-            sector_status.cyl = exp_cyl;
-            sector_status.head = exp_head;
+            sector_status->cyl = exp_cyl;
+            sector_status->head = exp_head;
          // normal
          } else if (bytes[5] != 1) {
                msg(MSG_INFO, "Invalid byte 5 %02x on cyl %d,%d head %d,%d sector %d\n",
   
-                  bytes[5], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
+                  bytes[5], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
          }
       } else if (drive_params->controller == CONTROLLER_ISBC_214_128B || 
             drive_params->controller == CONTROLLER_ISBC_214_256B || 
@@ -1747,33 +1733,33 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
-         bad_block = (bytes[3] & 0x80) >> 7;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         track_state->sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
+         track_state->bad_block = (bytes[3] & 0x80) >> 7;
 
-         sector_status.sector = bytes[4] & 0x3f;
+         sector_status->sector = bytes[4] & 0x3f;
          if ((bytes[4] & 0xc0) == 0x40) {
-            is_alternate = 1;
+            track_state->is_alternate = 1;
          } else if ((bytes[4] & 0xc0) == 0x80) {
-            alt_assigned = 1;
+            track_state->alt_assigned = 1;
          } else if ((bytes[4] & 0xc0) != 0x00) {
             msg(MSG_INFO, "Invalid format type byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[4], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[4], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_TEKTRONIX_6130) {
          int sector_size_lookup[4] = {256, 512, 1024, 128};
@@ -1781,45 +1767,45 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x40) >> 3) );
-         sector_status.sector = bytes[4] & 0x3f;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x40) >> 3) );
+         sector_status->sector = bytes[4] & 0x3f;
 
-         sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
-         bad_block = (bytes[3] & 0x80) >> 7;
+         track_state->sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
+         track_state->bad_block = (bytes[3] & 0x80) >> 7;
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ELEKTRONIKA_85) {
          int cyl_high_lookup[16] = {0,1,2,3,-1,-1,-1,-1,4,5,6,7,-1,-1,-1,-1};
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_MIGHTYFRAME ||
                drive_params->controller == CONTROLLER_DG_MV2000) {
@@ -1828,88 +1814,88 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
          if (drive_params->controller == CONTROLLER_MIGHTYFRAME) {
-            sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x20) >> 2));
+            sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x20) >> 2));
          } else { // DG MV/2000
-            sector_status.head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x80) >> 4));
+            sector_status->head = mfm_fix_head(drive_params, exp_head, (bytes[3] & 0x7) | ((bytes[4] & 0x80) >> 4));
          }
-         sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
-         bad_block = (bytes[3] & 0x80) >> 7;
+         track_state->sector_size = sector_size_lookup[(bytes[3] & 0x60) >> 5];
+         track_state->bad_block = (bytes[3] & 0x80) >> 7;
 
-         sector_status.sector = bytes[4] & 0x1f;
+         sector_status->sector = bytes[4] & 0x1f;
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_WANG_2275) {
-         sector_status.cyl = bytes[2] | ((bytes[3] & 0xf0) << 4);
+         sector_status->cyl = bytes[2] | ((bytes[3] & 0xf0) << 4);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if (bytes[1] !=  0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if ((drive_params->controller == CONTROLLER_WANG_2275_B) ||
         (drive_params->controller == CONTROLLER_IBM_5288)) {
-         sector_status.cyl = bytes[2] | ((bytes[3] & 0xe0) << 3);
+         sector_status->cyl = bytes[2] | ((bytes[3] & 0xe0) << 3);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x1f);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x1f);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if (bytes[1] !=  0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_CALLAN) {
-         sector_status.cyl = bytes[2] | ((bytes[3] & 0xf0) << 4);
+         sector_status->cyl = bytes[2] | ((bytes[3] & 0xf0) << 4);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x0f);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0x0f);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
-         bad_block = 0;
+         sector_status->sector = bytes[4];
+         track_state->bad_block = 0;
 
          if (bytes[1] !=  0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_EDAX_PV9900) {
-         sector_status.cyl = bytes[1] | (bytes[2] << 8);
+         sector_status->cyl = bytes[1] | (bytes[2] << 8);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[4]);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[4]);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[3];
+         sector_status->sector = bytes[3];
 
       } else if (drive_params->controller == CONTROLLER_DTC_520_256B ||
               drive_params->controller == CONTROLLER_DTC_520_512B ||
               drive_params->controller == CONTROLLER_DTC) {
          int head_mask[] = {1, 1, 1, 3, 3, 7, 7, 7, 7};
 
-         bad_block = (bytes[3] & 0x80) >> 7;
+         track_state->bad_block = (bytes[3] & 0x80) >> 7;
 
-         sector_status.cyl = bytes[2] | ((bytes[3] & 0x70) << 4);
+         sector_status->cyl = bytes[2] | ((bytes[3] & 0x70) << 4);
 
          int head = bytes[3] & 0xf;
          // When bad block set in PC-X.7z additional bits were set. Also
@@ -1918,80 +1904,80 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          if (drive_params->num_head < ARRAYSIZE(head_mask)) {
             head = head & head_mask[drive_params->num_head];
          }
-         sector_status.head = mfm_fix_head(drive_params, exp_head, head);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, head);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if (bytes[1] !=  0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ALTOS) {
-         sector_status.cyl = ((bytes[1] & 0xf) << 5) | (bytes[2] >> 3);
+         sector_status->cyl = ((bytes[1] & 0xf) << 5) | (bytes[2] >> 3);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0x7);
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0x7);
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[3];
+         sector_status->sector = bytes[3];
 
          if ((bytes[1] & 0xf0) !=  0xe0) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_MACBOTTOM ||
              drive_params->controller == CONTROLLER_CTM9016 ||
              drive_params->controller == CONTROLLER_FUJITSU_K_10R ||
              drive_params->controller == CONTROLLER_ACORN_A310_PODULE) {
-         sector_status.cyl = bytes[2] | (bytes[1] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3]);
-         sector_status.sector = bytes[4];
-         sector_size = drive_params->sector_size;
+         sector_status->cyl = bytes[2] | (bytes[1] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3]);
+         sector_status->sector = bytes[4];
+         track_state->sector_size = drive_params->sector_size;
       } else if (drive_params->controller == CONTROLLER_ADAPTEC ||
             drive_params->controller == CONTROLLER_ADAPTEC_4000_18SECTOR_512B) {
          uint32_t lba_addr;
          lba_addr = (bytes[2] << 16) | (bytes[3] << 8) | bytes[4];
-         sector_status.lba_addr = lba_addr;
-         sector_status.is_lba = 1;
+         sector_status->lba_addr = lba_addr;
+         sector_status->is_lba = 1;
 
          // We can't determine what the actual cylinder sector and head is.
          // If we track rotation time we can take a guess at sector
          // TODO: Add this when driven by track format information
-         sector_status.sector = *sector_index;
-         sector_status.head = exp_head;
-         sector_status.cyl = exp_cyl;
+         sector_status->sector = *sector_index;
+         sector_status->head = exp_head;
+         sector_status->cyl = exp_cyl;
 
          if (lba_addr & 0x800000) {
             msg(MSG_DEBUG, "Sector marked bad/spare LBA %x on cyl %d head %d physical sector %d\n",
-                  lba_addr, exp_cyl, exp_head, sector_status.sector);
-            sector_status.status |= SECT_SPARE_BAD;
-            sector_status.status |= SECT_BAD_LBA_NUMBER;
-            if ((bytes[5] & 0xf) == 0x1 && first_spare_bad_sector) {
+                  lba_addr, exp_cyl, exp_head, sector_status->sector);
+            sector_status->status |= SECT_SPARE_BAD;
+            sector_status->status |= SECT_BAD_LBA_NUMBER;
+            if ((bytes[5] & 0xf) == 0x1 && decode_ctx->first_spare_bad_sector) {
                drive_params->format_adjust = FORMAT_ADAPTEC_COUNT_BAD_BLOCKS;
             }
-            first_spare_bad_sector = 0;
+            decode_ctx->first_spare_bad_sector = 0;
          }
 
-//printf("lba %d sect %d head %d cyl %d\n", lba_addr, sector_status.sector,
-//   sector_status.head, sector_status.cyl);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+//printf("lba %d sect %d head %d cyl %d\n", lba_addr, sector_status->sector,
+//   sector_status->head, sector_status->cyl);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
          // If FORMAT_ADAPTEC_COUNT_BAD_BLOCKS all bits are used
          if (bytes[5] != 0 && bytes[5] != 0x40 && bytes[5] != 0x80 &&
              drive_params->format_adjust != FORMAT_ADAPTEC_COUNT_BAD_BLOCKS) {
             msg(MSG_INFO, "Unknown header flag byte %02x on cyl %d head %d physical sector %d\n",
-                  bytes[5], exp_cyl, exp_head, sector_status.sector);
+                  bytes[5], exp_cyl, exp_head, sector_status->sector);
          }
 
          if (bytes[1] !=  0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d physical sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_NEWBURYDATA) {
          //int cyl_high_lookup[16] = {0,1,2,3,-1,-1,-1,-1,4,5,6,7,-1,-1,-1,-1};
@@ -1999,34 +1985,34 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          int cyl_high;
 
          cyl_high = cyl_high_lookup[(bytes[1] & 0xf) ^ 0xe];
-         sector_status.cyl = 0;
+         sector_status->cyl = 0;
          if (cyl_high != -1) {
-            sector_status.cyl = cyl_high << 8;
+            sector_status->cyl = cyl_high << 8;
          }
-         sector_status.cyl |= bytes[2];
+         sector_status->cyl |= bytes[2];
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] >> 4);
-         bad_block = 0;
-         sector_size = drive_params->sector_size;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] >> 4);
+         track_state->bad_block = 0;
+         track_state->sector_size = drive_params->sector_size;
 
-         sector_status.sector = bytes[3] & 0xf;
+         sector_status->sector = bytes[3] & 0xf;
 
          if (cyl_high == -1) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SYMBOLICS_3620) {
-         sector_status.cyl = (bytes[3] << 8) | bytes[4];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5]);
-         sector_status.sector = bytes[6];
-         sector_size = drive_params->sector_size;
+         sector_status->cyl = (bytes[3] << 8) | bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5]);
+         sector_status->sector = bytes[6];
+         track_state->sector_size = drive_params->sector_size;
          if (bytes[1] != 0xfe || bytes[2] != 0xfe) {
             msg(MSG_INFO, "Invalid header id bytes %02x, %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], bytes[2], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], bytes[2], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SYMBOLICS_3640) {
          // Bytes that seem to always be at the start of the header. We
@@ -2034,27 +2020,27 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          // they represent.
          uint8_t header_start[] = {0xa1,0x5a,0x96,0x0e,0x0e,0x9e,0x01};
 
-         sector_status.cyl = (REV_BYTE(bytes[8]) >> 4) | (REV_BYTE(bytes[9]) << 4);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, (REV_BYTE(bytes[7]) >> 6) | ((REV_BYTE(bytes[8]) & 0x3) << 2));
-         sector_status.sector = REV_BYTE(bytes[7]) & 0x7;
+         sector_status->cyl = (REV_BYTE(bytes[8]) >> 4) | (REV_BYTE(bytes[9]) << 4);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, (REV_BYTE(bytes[7]) >> 6) | ((REV_BYTE(bytes[8]) & 0x3) << 2));
+         sector_status->sector = REV_BYTE(bytes[7]) & 0x7;
          if ((bytes[7] & 0x1c) != 0 || (bytes[8] & 0x30) != 0 || 
                (bytes[10] & 0xfe) != 0 ) {
             msg(MSG_INFO,"Unexpected bits set %02x %02x %02x on cyl %d,%d head %d,%d sector %d\n",
-                bytes[7], bytes[8], bytes[10], exp_cyl, sector_status.cyl,
-                exp_head, sector_status.head, sector_status.sector);
+                bytes[7], bytes[8], bytes[10], exp_cyl, sector_status->cyl,
+                exp_head, sector_status->head, sector_status->sector);
          }
          // Not encoded in header so use what was provided.
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
 
          if (memcmp(bytes, header_start, sizeof(header_start)) != 0) {
             int i;
 
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
             for (i = 0; i < sizeof(header_start); i++) {
                 if (bytes[i] != header_start[i]) {
                    msg(MSG_INFO, "Header byte %d differ %02x %02x on cyl %d,%d head %d,%d sector %d\n",
-                      i, bytes[i], header_start[i], exp_cyl, sector_status.cyl,
-                      exp_head, sector_status.head, sector_status.sector);
+                      i, bytes[i], header_start[i], exp_cyl, sector_status->cyl,
+                      exp_head, sector_status->head, sector_status->sector);
                 }
              }
          }
@@ -2063,317 +2049,316 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             if (bytes[3] == 0xff) {
                // Bad block. Everything other than unknown byte set to 0xff
                // Set what we know and mark bad so it won't be used.
-               sector_status.cyl = exp_cyl;
-               sector_status.head = mfm_fix_head(drive_params, exp_head, exp_head);
-               sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = mfm_fix_head(drive_params, exp_head, exp_head);
+               sector_status->status |= SECT_BAD_HEADER;
                msg(MSG_INFO,"Spare sector used on cyl %d, head %d, physical sector %d\n",
-                  sector_status.cyl, sector_status.head, *sector_index);
+                  sector_status->cyl, sector_status->head, *sector_index);
             } else {
                // Controller area only had sector and possibly cylinder
-               sector_status.cyl = bytes[3];
-               sector_status.head = mfm_fix_head(drive_params, exp_head, exp_head);
-               sector_status.sector = bytes[4];
+               sector_status->cyl = bytes[3];
+               sector_status->head = mfm_fix_head(drive_params, exp_head, exp_head);
+               sector_status->sector = bytes[4];
             }
          } else {
             uint8_t byte5 = bytes[5];
             uint8_t byte2 = bytes[2];
 
-            sector_status.cyl = (((bytes[2] & 0xc0) << 2) | bytes[3]) + 1;
-            sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
+            sector_status->cyl = (((bytes[2] & 0xc0) << 2) | bytes[3]) + 1;
+            sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
             if (byte5 == 0x4) {
                msg(MSG_INFO, "Cylinder %d head %d assigned alternate cyl %d head %d. Extract data fixed\n",
-                  exp_cyl, exp_head, sector_status.cyl, sector_status.head);
+                  exp_cyl, exp_head, sector_status->cyl, sector_status->head);
                byte5 = 0;
                mfm_handle_alt_track_ch(drive_params, exp_cyl, exp_head, 
-                    sector_status.cyl, sector_status.head);
+                    sector_status->cyl, sector_status->head);
                // Return where sector is. Alternate track handling will
                // swap data at end
-               sector_status.cyl = exp_cyl;
-               sector_status.head = exp_head;
-               alt_assigned = 1;
-               alt_assigned_handled = 1;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = exp_head;
+               track_state->alt_assigned = 1;
+               track_state->alt_assigned_handled = 1;
             }
             if (byte5 == 0x8) {
-               is_alternate = 1;
+               track_state->is_alternate = 1;
                // Clear various bits set so check below doesn't report
                // unexpected values
                byte5 = 0;
                byte2 = byte2 & ~0x20;
                // Return where sector is. Header has what original track was.
                // Alternate track handling will swap data at end
-               sector_status.cyl = exp_cyl;
-               sector_status.head = exp_head;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = exp_head;
             }
             if (byte5 != 0x0 || (bytes[4] & 0xe0) != 0 || 
                  (byte2 & 0x30) != 0) {
                msg(MSG_INFO, "Unexpected bytes  %02x, %02x, %02x on cyl %d,%d head %d,%d sector %d\n",
-                     bytes[2], bytes[4], byte5, exp_cyl, sector_status.cyl,
-                     exp_head, sector_status.head, sector_status.sector);
+                     bytes[2], bytes[4], byte5, exp_cyl, sector_status->cyl,
+                     exp_head, sector_status->head, sector_status->sector);
             }
-            sector_status.sector = bytes[4];
-            if (sector_status.sector == 254) {
-               sector_status.status |= SECT_ANALYZE_SPARE;
+            sector_status->sector = bytes[4];
+            if (sector_status->sector == 254) {
+               sector_status->status |= SECT_ANALYZE_SPARE;
             }
          }
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SEAGATE_ST11MB) {
          if (bytes[2] == 0xff) {
             // First track formatted differently. Controller uses.
             // Controller area only had sector and possibly cylinder
-            sector_status.cyl = bytes[3];
-            sector_status.head = mfm_fix_head(drive_params, exp_head, exp_head);
-            sector_status.sector = bytes[4];
+            sector_status->cyl = bytes[3];
+            sector_status->head = mfm_fix_head(drive_params, exp_head, exp_head);
+            sector_status->sector = bytes[4];
          } else {
-            sector_status.cyl = (((bytes[2] & 0xc0) << 2) | bytes[3]) + 1;
-            sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
-            sector_status.sector = bytes[4];
+            sector_status->cyl = (((bytes[2] & 0xc0) << 2) | bytes[3]) + 1;
+            sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] & 0xf);
+            sector_status->sector = bytes[4];
 
             uint8_t byte5 = bytes[5];
             uint8_t byte2 = bytes[2];
 
             if (byte5 == 0x4) {
                msg(MSG_INFO, "Cylinder %d head %d assigned alternate cyl %d head %d. Extract data fixed\n",
-                  exp_cyl, exp_head, sector_status.cyl, sector_status.head);
+                  exp_cyl, exp_head, sector_status->cyl, sector_status->head);
                byte5 = 0;
                mfm_handle_alt_track_ch(drive_params, exp_cyl, exp_head, 
-                    sector_status.cyl, sector_status.head);
+                    sector_status->cyl, sector_status->head);
                // Return where sector is. Alternate track handling will
                // swap data at end
-               sector_status.cyl = exp_cyl;
-               sector_status.head = exp_head;
-               alt_assigned = 1;
-               alt_assigned_handled = 1;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = exp_head;
+               track_state->alt_assigned = 1;
+               track_state->alt_assigned_handled = 1;
             }
             if (byte5 == 0x8) {
-               is_alternate = 1;
+               track_state->is_alternate = 1;
                // Clear various bits set so check below doesn't report
                // unexpected values
                byte5 = 0;
                byte2 = byte2 & ~0x20;
                // Return where sector is. Header has what original track was.
                // Alternate track handling will swap data at end
-               sector_status.cyl = exp_cyl;
-               sector_status.head = exp_head;
+               sector_status->cyl = exp_cyl;
+               sector_status->head = exp_head;
             }
             if ((byte5 != 0x0 && byte5 != 0x80) || 
                  ((bytes[4] & 0xe0) != 0 && bytes[4] != 0xfe && bytes[4] != 0xff) ||
                  (byte2 & 0x30) != 0) {
                msg(MSG_INFO, "Unexpected bytes  %02x, %02x, %02x on cyl %d,%d head %d,%d sector %d\n",
-                     bytes[2], bytes[4], bytes[5], exp_cyl, sector_status.cyl,
-                     exp_head, sector_status.head, sector_status.sector);
+                     bytes[2], bytes[4], bytes[5], exp_cyl, sector_status->cyl,
+                     exp_head, sector_status->head, sector_status->sector);
             }
          }
          // This will mark sectors from track with alternate track assigned 
          // as bad. Headers don't have valid sector number. Data is all 0x6c
          if ((bytes[4] & 0xe0) == 0xe0) {
-            sector_status.status |= SECT_SPARE_BAD;
-            sector_status.status |= SECT_BAD_SECTOR_NUMBER;
-            sector_status.status |= SECT_ANALYZE_SPARE;
+            sector_status->status |= SECT_SPARE_BAD;
+            sector_status->status |= SECT_BAD_SECTOR_NUMBER;
+            sector_status->status |= SECT_ANALYZE_SPARE;
          }
-         sector_size = drive_params->sector_size;
+         track_state->sector_size = drive_params->sector_size;
          if (bytes[1] != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ALTOS_586) {
-         sector_status.cyl = bytes[2] | ((bytes[3] & 0x7) << 8);
+         sector_status->cyl = bytes[2] | ((bytes[3] & 0x7) << 8);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] >> 4);
-         sector_size = drive_params->sector_size;
-         bad_block = (bytes[3] & 0x8) != 0;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] >> 4);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = (bytes[3] & 0x8) != 0;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if (bytes[1]  != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ATT_3B2 ||
              drive_params->controller == CONTROLLER_ATT_3B2_17sector) {
-         sector_status.cyl = bytes[2] | ((bytes[1] ^ 0xff) << 8);
+         sector_status->cyl = bytes[2] | ((bytes[1] ^ 0xff) << 8);
 
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3]);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3]);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if ((bytes[1] & 0xf0)  != 0xf0) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ISBC_215_128B ||
             drive_params->controller == CONTROLLER_ISBC_215_256B ||
             drive_params->controller == CONTROLLER_ISBC_215_512B ||
             drive_params->controller == CONTROLLER_ISBC_215_1024B) {
-         sector_status.cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5]);
-         sector_size = 128 << ((bytes[2] & 0x30) >> 4);
-         sector_status.sector = bytes[4];
-         is_alternate = (bytes[2] & 0xc0) == 0x40;
-         alt_assigned = (bytes[2] & 0xc0) == 0x80;
+         sector_status->cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5]);
+         track_state->sector_size = 128 << ((bytes[2] & 0x30) >> 4);
+         sector_status->sector = bytes[4];
+         track_state->is_alternate = (bytes[2] & 0xc0) == 0x40;
+         track_state->alt_assigned = (bytes[2] & 0xc0) == 0x80;
 
          if (bytes[1]  != 0x19) {
             msg(MSG_INFO, "Invalid header id bytes %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SM_1810_512B) {
-         sector_status.cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5]);
-         sector_size = 128 << ((bytes[2] & 0x30) >> 4);
-         sector_status.sector = bytes[4];
-         is_alternate = (bytes[2] & 0xc0) == 0x40;
-         alt_assigned = (bytes[2] & 0xc0) == 0x80;
+         sector_status->cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5]);
+         track_state->sector_size = 128 << ((bytes[2] & 0x30) >> 4);
+         sector_status->sector = bytes[4];
+         track_state->is_alternate = (bytes[2] & 0xc0) == 0x40;
+         track_state->alt_assigned = (bytes[2] & 0xc0) == 0x80;
 
          if (bytes[1]  != 0xfe) {
             msg(MSG_INFO, "Invalid header id bytes %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DSD_5217_512B) {
-         sector_status.cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5]);
-         sector_size = 128 << ((bytes[2] & 0x30) >> 4);
-         sector_status.sector = bytes[4];
-         is_alternate = (bytes[2] & 0xc0) == 0x40;
-         alt_assigned = (bytes[2] & 0xc0) == 0x80;
+         sector_status->cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5]);
+         track_state->sector_size = 128 << ((bytes[2] & 0x30) >> 4);
+         sector_status->sector = bytes[4];
+         track_state->is_alternate = (bytes[2] & 0xc0) == 0x40;
+         track_state->alt_assigned = (bytes[2] & 0xc0) == 0x80;
          if (bytes[1]  != 0xfe) {
             msg(MSG_INFO, "Invalid header id bytes %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_ROHM_PBX) {
-         sector_status.cyl = bytes[5] | ((bytes[4] & 0xc0) << 2);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
-         sector_size = drive_params->sector_size;
-         sector_status.sector = bytes[4] & 0x3f;
+         sector_status->cyl = bytes[5] | ((bytes[4] & 0xc0) << 2);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3] & 0xf);
+         track_state->sector_size = drive_params->sector_size;
+         sector_status->sector = bytes[4] & 0x3f;
 
          if (bytes[1]  != 0xa1 || bytes[2] != 0xa1) {
             msg(MSG_INFO, "Invalid header id bytes %02x, %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], bytes[2], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], bytes[2], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_CONVERGENT_AWS ||
           drive_params->controller == CONTROLLER_CONVERGENT_AWS_SA1000) {
-         sector_status.cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[2] >> 4);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->cyl = bytes[3] | ((bytes[2] & 0xf) << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[2] >> 4);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = bytes[4];
+         sector_status->sector = bytes[4];
 
          if ((bytes[1])  != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DILOG_DQ614) {
-         sector_status.cyl = bytes[5] | (bytes[4] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[6]);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->cyl = bytes[5] | (bytes[4] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[6]);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = bytes[7] & 0x7f;
+         sector_status->sector = bytes[7] & 0x7f;
        
-         static int last_byte2 = 0;
-         if ((bytes[2] & 0x1f) != last_byte2) {
-            last_byte2 = bytes[2];
+         if ((bytes[2] & 0x1f) != decode_ctx->last_byte2) {
+            decode_ctx->last_byte2 = bytes[2];
             msg(MSG_INFO, "Possible start of partition %d at cyl %d head %d sector %d\n",
-                  bytes[2], sector_status.cyl,
-                  sector_status.head, sector_status.sector);
+                  bytes[2], sector_status->cyl,
+                  sector_status->head, sector_status->sector);
          }
          if ((bytes[3])  != 0x33) {
             msg(MSG_INFO, "Byte 3 %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[3], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[3], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if ((bytes[1])  != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_DILOG_DQ604) {
-         sector_status.cyl = bytes[5] | (bytes[4] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[6]);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->cyl = bytes[5] | (bytes[4] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[6]);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = bytes[7];
+         sector_status->sector = bytes[7];
        
          if ((bytes[3])  != 0x00) {
             msg(MSG_INFO, "Byte 3 %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[3], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[3], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if ((bytes[1])  != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SM1040) {
-         sector_status.cyl = bytes[5] | (bytes[4] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[6]);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->cyl = bytes[5] | (bytes[4] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[6]);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = bytes[7] & 0x7f;
+         sector_status->sector = bytes[7] & 0x7f;
        
          if ((bytes[9])  != 0x64) {
             msg(MSG_INFO, "Byte 9 %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[3], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[3], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if ((bytes[8])  != 0x02) {
             msg(MSG_INFO, "Byte 8 %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[3], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[3], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if ((bytes[3])  != 0x13) {
             msg(MSG_INFO, "Byte 3 %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[3], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[3], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if ((bytes[1])  != 0xfe) {
             msg(MSG_INFO, "Invalid header id byte %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_OMTI_20L) {
-         sector_status.cyl = bytes[2] | (bytes[1] << 8);
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[3]);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
+         sector_status->cyl = bytes[2] | (bytes[1] << 8);
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[3]);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
 
-         sector_status.sector = 0;
+         sector_status->sector = 0;
 
-         if (!(sector_status.status & SECT_BAD_HEADER)) {
-            mfm_write_metadata(&bytes[4], drive_params, &sector_status);
+         if (!(sector_status->status & SECT_BAD_HEADER)) {
+            mfm_write_metadata(&bytes[4], drive_params, sector_status);
          }
 
       } else {
@@ -2381,38 +2366,38 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          exit(1);
       }
 
-      if (sector_status.is_lba) {
+      if (sector_status->is_lba) {
          msg(MSG_DEBUG,
             "Got LBA %d exp %d,%d cyl %d head %d sector %d,%d size %d bad block %d\n",
-               sector_status.lba_addr, exp_cyl, exp_head, sector_status.cyl, 
-               sector_status.head, sector_status.sector, *sector_index, 
-               sector_size, bad_block);
+               sector_status->lba_addr, exp_cyl, exp_head, sector_status->cyl, 
+               sector_status->head, sector_status->sector, *sector_index, 
+               track_state->sector_size, track_state->bad_block);
       } else {
          msg(MSG_DEBUG,
             "Got exp %d,%d cyl %d head %d sector %d,%d size %d bad block %d\n",
-               exp_cyl, exp_head, sector_status.cyl, sector_status.head, 
-               sector_status.sector, *sector_index, sector_size, bad_block);
+               exp_cyl, exp_head, sector_status->cyl, sector_status->head, 
+               sector_status->sector, *sector_index, track_state->sector_size, track_state->bad_block);
       }
 
-      if (bad_block) {
-         sector_status.status |= SECT_SPARE_BAD;
+      if (track_state->bad_block) {
+         sector_status->status |= SECT_SPARE_BAD;
          msg(MSG_INFO,"Bad block set on cyl %d, head %d, sector %d\n",
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
       }
-      if (is_alternate) {
+      if (track_state->is_alternate) {
          msg(MSG_DEBUG,"Alternate track set on cyl %d, head %d, sector %d\n",
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
       }
 
-      mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-            seek_difference, &sector_status, drive_params, sector_status_list);
+      mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+            seek_difference, sector_status, drive_params, sector_status_list);
 
       // The 3640 doesn't have a 0xa1 data header, search for its special sync
       if (drive_params->controller == CONTROLLER_SYMBOLICS_3640) {
          *state = MARK_DATA1;
       } else if (drive_params->controller == CONTROLLER_ROHM_PBX) {
          *state = MARK_DATA2;
-      } else if (drive_params->controller == CONTROLLER_ALTOS_586 && bad_block) {
+      } else if (drive_params->controller == CONTROLLER_ALTOS_586 && track_state->bad_block) {
          // If bad block marked no data area is written
          *state = MARK_ID;
       } else {
@@ -2425,7 +2410,7 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
       int id_byte_mask = 0xff;
       int write_sector = 1;
 
-      sector_status.status |= init_status;
+      sector_status->status |= init_status;
 
       if (drive_params->controller == CONTROLLER_MYARC_HFDC) {
          if (bytes[1] == 0xf8) {
@@ -2469,9 +2454,9 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
       } else if (drive_params->controller == CONTROLLER_SYMBOLICS_3620) {
          if (bytes[2] != 0xf8) {
             msg(MSG_INFO, "Invalid data id bytes %02x on cyl %d,%d head %d,%d sector %d\n",
-                  bytes[1], bytes[2], exp_cyl, sector_status.cyl,
-                  exp_head, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+                  bytes[1], bytes[2], exp_cyl, sector_status->cyl,
+                  exp_head, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SYMBOLICS_3640) {
          id_byte_expected = 0xf0;
@@ -2484,7 +2469,7 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             bytes[i] = ~bytes[i];
          }
       } else if (drive_params->controller == CONTROLLER_UNKNOWN1) {
-         id_byte_expected = sector_status.sector;
+         id_byte_expected = sector_status->sector;
       } else if (drive_params->controller == CONTROLLER_UNKNOWN2) {
          id_byte_expected = 0x0d;
       } else if (drive_params->controller == CONTROLLER_WANG_2275) {
@@ -2506,7 +2491,7 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          id_byte_expected = 0;
          id_byte_index = -1;
          // No header so calculate sector number from position on track
-         sector_status.sector = round((mfm_get_data_bit_count() - 936) / 4298.0);
+         sector_status->sector = round((mfm_get_data_bit_count(drive_params) - 936) / 4298.0);
       } else if (drive_params->controller == CONTROLLER_DSD_5217_512B) {
          if (bytes[1] == 0xf8) {
             id_byte_expected = 0xf8;
@@ -2519,8 +2504,8 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             crc == 0) {
          msg(MSG_INFO,"Invalid data id byte %02x expected %02x on cyl %d head %d sector %d\n", 
                bytes[id_byte_index], id_byte_expected,
-               sector_status.cyl, sector_status.head, sector_status.sector);
-         sector_status.status |= SECT_BAD_DATA;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+         sector_status->status |= SECT_BAD_DATA;
       }
       if ((drive_params->controller == CONTROLLER_ISBC_215_128B ||
            drive_params->controller == CONTROLLER_ISBC_215_256B ||
@@ -2532,7 +2517,7 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
            drive_params->controller == CONTROLLER_MICROBEE_WD1002_05 ||
            drive_params->controller == CONTROLLER_SM_1810_512B ||
            drive_params->controller == CONTROLLER_DSD_5217_512B)
-           && alt_assigned) {
+           && track_state->alt_assigned) {
          // For defective tracks each sectors has repeating 4 byte sequence
          // Alt cyl high, alt cyl low, alt head?, 0x00. Entire track is always
          // reassigned. Only sample with alternate assigned was from iSBC 215
@@ -2547,8 +2532,8 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             acyl = (bytes[i] << 8) + bytes[i+1];
             ahead = bytes[i+2];
             if (acyl == last_acyl && ahead == last_ahead) {
-               mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-                 sector_status.head, acyl, ahead);
+               mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+                 sector_status->head, acyl, ahead);
                break;
             }
             last_acyl = acyl;
@@ -2556,34 +2541,34 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          }
          if (i >= 128) {
             msg(MSG_ERR,"Unable to find alternate track cyl %d head %d\n",
-               sector_status.cyl, sector_status.head);
+               sector_status->cyl, sector_status->head);
          }
-         alt_assigned_handled = 1;
+         track_state->alt_assigned_handled = 1;
       }
       if ((drive_params->controller == CONTROLLER_OMTI_5510 ||
            drive_params->controller == CONTROLLER_OMTI_5200_18SECTOR_512B)
-              && alt_assigned) {
-          mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-            sector_status.head, (bytes[2] << 8) + bytes[3], bytes[4]);
-         alt_assigned_handled = 1;
+              && track_state->alt_assigned) {
+          mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+            sector_status->head, (bytes[2] << 8) + bytes[3], bytes[4]);
+         track_state->alt_assigned_handled = 1;
       }
       if ((drive_params->controller == CONTROLLER_DTC ||
              drive_params->controller == CONTROLLER_DTC_520_256B ||
-             drive_params->controller == CONTROLLER_DTC_520_512B ) && bad_block) {
+             drive_params->controller == CONTROLLER_DTC_520_512B ) && track_state->bad_block) {
          if (crc64(&bytes[2], 6, &drive_params->header_crc) == 0) {
-             mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-               sector_status.head, bytes[2] << 4 | bytes[3], 
+             mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+               sector_status->head, bytes[2] << 4 | bytes[3], 
                bytes[4] & 0xf);
-             alt_assigned = 1;
-             alt_assigned_handled = 1;
+             track_state->alt_assigned = 1;
+             track_state->alt_assigned_handled = 1;
          };
       }
       if (drive_params->controller == CONTROLLER_SHUGART_CD9963 && 
-         !(sector_status.status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER))) {
+         !(sector_status->status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER))) {
 
          struct s_CD9963_sect0 *s = &drive_params->u.CD9963_sect0;
-         if (sector_status.head == 0 && sector_status.cyl == 0 && 
-            sector_status.sector == 0) {
+         if (sector_status->head == 0 && sector_status->cyl == 0 && 
+            sector_status->sector == 0) {
             memcpy(s, &bytes[mfm_controller_info[drive_params->controller].data_header_bytes], 
               sizeof(drive_params->u.CD9963_sect0));
             if (ntohs(s->sectSize) != drive_params->sector_size) {
@@ -2607,7 +2592,7 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
                    s->nZones1, s->nZones2);
             }
 
-            mfm_write_metadata((uint8_t *) &drive_params->u.CD9963_sect0, drive_params, &sector_status);
+            mfm_write_metadata((uint8_t *) &drive_params->u.CD9963_sect0, drive_params, sector_status);
             write_sector = 0;
 
          } else {
@@ -2615,12 +2600,12 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             // Assume zone size is power of two
             int size_zones = ceil((float) drive_params->num_cyl / s->nZones1);
             size_zones = pow(2, ceil(log2(size_zones)));
-            int zone = sector_status.cyl / size_zones;
+            int zone = sector_status->cyl / size_zones;
             // Count resets each zone since zone table has count for start of
             // zone
-            if (zone != last_zone) {
-               sectors_skipped_zone = 0;
-               last_zone = zone;
+            if (zone != decode_ctx->last_zone) {
+               decode_ctx->sectors_skipped_zone = 0;
+               decode_ctx->last_zone = zone;
             }
             int offset;
             if (zone == 0) {
@@ -2628,39 +2613,39 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
             } else {
                offset = ntohs(s->zones[zone-1]);
             }
-            offset += sectors_skipped_zone;
+            offset += decode_ctx->sectors_skipped_zone;
             // Remapping sectors easiest of we treat drive a LBA
-            int LBA = (sector_status.cyl * drive_params->num_head +
-                sector_status.head) * drive_params->num_sectors +
-                sector_status.sector - offset;
-            sector_status.lba_addr = LBA;
-            sector_status.is_lba = 1;
+            int LBA = (sector_status->cyl * drive_params->num_head +
+                sector_status->head) * drive_params->num_sectors +
+                sector_status->sector - offset;
+            sector_status->lba_addr = LBA;
+            sector_status->is_lba = 1;
          }
       }
 
       if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
+      sector_status->ecc_span_corrected_data = ecc_span;
       // TODO: If bad sector number the stats such as count of spare/bad
       // sectors is not updated. We need to know the sector # to update
       // our statistics array. This happens with RQDX3
-      if (!(sector_status.status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER)) && write_sector) {
+      if (!(sector_status->status & (SECT_BAD_HEADER | SECT_BAD_SECTOR_NUMBER)) && write_sector) {
          int dheader_bytes = mfm_controller_info[drive_params->controller].data_header_bytes;
 
          // Bytes[1] is because 0xa1 can't be updated from bytes since
          // won't get encoded as special sync pattern
-         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, &sector_status,
+         if (mfm_write_sector(&bytes[dheader_bytes], drive_params, sector_status,
                sector_status_list, &bytes[1], total_bytes-1) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       // Spare sectors normally are filled with same value if not used. This
       // may show if sector is used but not detected.
-      if (sector_status.status & SECT_ANALYZE_SPARE && !(sector_status.status &
+      if (sector_status->status & SECT_ANALYZE_SPARE && !(sector_status->status &
           SECT_BAD_DATA) && id_byte_index >= 0) {
          int spare_same = 1;
          for (int i = id_byte_index+2; 
@@ -2671,12 +2656,12 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          }
          if (!spare_same) { 
             msg(MSG_INFO,"Spare sectors not all same value cyl %d head %d sector %d\n",
-              sector_status.cyl, sector_status.head, sector_status.sector);
+              sector_status->cyl, sector_status->head, sector_status->sector);
          }
       }
-      if (alt_assigned && !alt_assigned_handled) {
+      if (track_state->alt_assigned && !track_state->alt_assigned_handled) {
          msg(MSG_INFO,"Assigned alternate track not corrected on cyl %d, head %d, sector %d\n",
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
       }
       // OMTI_20L only has one sector header so stay in MARK_DATA and inc
       // sector count
@@ -2684,13 +2669,157 @@ SECTOR_DECODE_STATUS wd_process_data(STATE_TYPE *state, uint8_t bytes[],
          (*sector_index)++;
          *state = MARK_DATA;
          // Clear status for next sector
-         sector_status.status = init_status | SECT_HEADER_FOUND;
+         sector_status->status = init_status | SECT_HEADER_FOUND;
       } else {
          *state = MARK_ID;
       }
    }
 
-   return sector_status.status;
+   return sector_status->status;
+}
+
+// MFM encoded zeros for two steps. This is two raw_word values of
+// 0x55555555 two bits apart which is enough for MARK_NUM_ZEROS of 2.
+#define ZERO_PAIR_PATTERN 0x155555555ull
+#define ZERO_PAIR_BITS 34
+
+// Skip the steps that end before end_bit. The variables are updated as
+// if each step was processed by the loop in wd_decode_track except for
+// decoding.
+//
+// drive_params: Drive parameters
+// pll_track: Steps for track
+// i: Next step to process
+// num_steps: Number of steps available
+// end_bit: Skip steps ending before this bit position
+// tot_raw_bit_cntr, raw_bit_cntr, track_time, all_raw_bits_count,
+//    raw_word: Decoder state updated for the steps skipped
+// return: Next step to process
+static int skip_steps(DRIVE_PARAMS *drive_params, PLL_TRACK *pll_track,
+   int i, int num_steps, int end_bit, int *tot_raw_bit_cntr,
+   int *raw_bit_cntr, int *track_time, int *all_raw_bits_count,
+   unsigned int *raw_word)
+{
+   int start_step = i;
+   int start_bit = *tot_raw_bit_cntr;
+   int bit_pos = start_bit;
+
+   for (; i < num_steps && bit_pos + pll_track->steps[i].bits < end_bit;
+         i++) {
+      bit_pos += pll_track->steps[i].bits;
+      *track_time += pll_track->steps[i].delta;
+   }
+   if (i != start_step) {
+      *all_raw_bits_count = mfm_save_raw_steps(drive_params, pll_track,
+         *all_raw_bits_count, start_step, i, start_bit);
+      *raw_bit_cntr += bit_pos - start_bit;
+      *tot_raw_bit_cntr = bit_pos;
+      *raw_word = mfm_pll_track_raw_word(pll_track, bit_pos);
+   }
+   return i;
+}
+
+// While looking for a mark skip the steps before the next place the mark
+// pattern is found in the packed raw bits.
+//
+// drive_params: Drive parameters
+// pll_track: Steps for track
+// i: Next step to process
+// num_steps: Number of steps available
+// mark_pattern: Mark to look for
+// tot_raw_bit_cntr, raw_bit_cntr, track_time, all_raw_bits_count,
+//    raw_word, zero_count: Decoder state updated for the steps skipped
+// return: Next step to process
+static int skip_to_mark(DRIVE_PARAMS *drive_params, PLL_TRACK *pll_track,
+   int i, int num_steps, int mark_pattern, int *tot_raw_bit_cntr,
+   int *raw_bit_cntr, int *track_time, int *all_raw_bits_count,
+   unsigned int *raw_word, int *zero_count)
+{
+   int start_step = i;
+   int start_bit = *tot_raw_bit_cntr;
+   int mark_bit;
+   int zero_start;
+
+   // Bit positions don't identify steps with zero bits
+   if (pll_track->zero_bit_steps != 0) {
+      return i;
+   }
+   mark_bit = mfm_pll_track_find(pll_track, mark_pattern, 16, start_bit,
+      pll_track->num_raw_bits);
+   if (mark_bit < 0) {
+      mark_bit = INT_MAX;
+   }
+   i = skip_steps(drive_params, pll_track, i, num_steps, mark_bit,
+      tot_raw_bit_cntr, raw_bit_cntr, track_time, all_raw_bits_count,
+      raw_word);
+   if (i == start_step) {
+      return i;
+   }
+   // Once MARK_NUM_ZEROS is reached it is kept until a mark is found.
+   // Otherwise look for two zero steps in a row. If zero_count is 1 the
+   // step before start_step was zero so the first step can complete a pair.
+   if (*zero_count < 2) {
+      zero_start = start_bit;
+      if (*zero_count == 0) {
+         zero_start += pll_track->steps[start_step].bits;
+      }
+      if (mfm_pll_track_find(pll_track, ZERO_PAIR_PATTERN, ZERO_PAIR_BITS,
+            zero_start, *tot_raw_bit_cntr) >= 0) {
+         *zero_count = 2;
+      } else if (*raw_word == 0x55555555) {
+         *zero_count = 1;
+      } else {
+         *zero_count = 0;
+      }
+   }
+   return i;
+}
+
+// Decode whole bytes of a header or data field from the packed raw bits
+// instead of 4 raw bits at a time. Only bytes where the loop in
+// wd_decode_track doesn't need to do anything other than store the byte
+// are decoded. The steps the bytes came from are skipped so the loop
+// continues after the last byte decoded.
+//
+// drive_params: Drive parameters
+// pll_track: Steps for track
+// i: Next step to process
+// num_steps: Number of steps available
+// bytes: Where to store the bytes
+// byte_cntr: Number of bytes in bytes. Updated for bytes decoded
+// end_byte: Decode bytes before this one
+// tot_raw_bit_cntr, raw_bit_cntr, track_time, all_raw_bits_count,
+//    raw_word, decoded_word: Decoder state updated for the steps skipped
+// return: Next step to process
+static int decode_bytes(DRIVE_PARAMS *drive_params, PLL_TRACK *pll_track,
+   int i, int num_steps, uint8_t bytes[], int *byte_cntr, int end_byte,
+   int *tot_raw_bit_cntr, int *raw_bit_cntr, int *track_time,
+   int *all_raw_bits_count, unsigned int *raw_word,
+   unsigned int *decoded_word)
+{
+   // Bit position of the last raw bit decoded
+   int decoded_bit = *tot_raw_bit_cntr - *raw_bit_cntr;
+   int num_bytes = end_byte - *byte_cntr;
+   int end_bit;
+
+   if (num_bytes > (pll_track->num_raw_bits - decoded_bit) / 16) {
+      num_bytes = (pll_track->num_raw_bits - decoded_bit) / 16;
+   }
+   if (num_bytes <= 0) {
+      return i;
+   }
+   mfm_decode_raw_bytes(pll_track, decoded_bit, &bytes[*byte_cntr],
+      num_bytes);
+   *byte_cntr += num_bytes;
+   *decoded_word = bytes[*byte_cntr - 1];
+   end_bit = decoded_bit + num_bytes * 16;
+   // Skip to the step that ends at or after the last bit decoded. That
+   // step's bits after end_bit are decoded by the loop.
+   i = skip_steps(drive_params, pll_track, i, num_steps, end_bit,
+      tot_raw_bit_cntr, raw_bit_cntr, track_time, all_raw_bits_count,
+      raw_word);
+   *raw_bit_cntr = *tot_raw_bit_cntr - end_bit;
+   return i;
 }
 
 // Decode a track's worth of deltas.
@@ -2722,15 +2851,11 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int decoded_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency
-   float avg_bit_sep_time;     // 200 MHz clocks
-   float nominal_bit_sep_time; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
    // Counter for debugging
@@ -2748,15 +2873,6 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // also ignoring known write splice location should help.
 #define MARK_NUM_ZEROS 2
    int zero_count = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
-   // And number from last time
-   int last_deltas = 0;
-   // If we get too large a delta we need to process it in less than 32 bit
-   // word number of bits. This holds remaining number to process
-   int remaining_delta = 0;
-   // Maximum delta to process in one pass
-   int max_delta;
    // Intermediate value
    int tmp_raw_word;
    // Collect bytes to further process here
@@ -2780,52 +2896,58 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // First address mark time in ns 
    int first_addr_mark_ns = 0;
 
-   sectors_skipped_zone += sectors_skipped_track;
-   sectors_skipped_track = 0;
+   // Only used by CONTROLLER_SHUGART_CD9963 which decodes tracks in order
+   if (drive_params->controller == CONTROLLER_SHUGART_CD9963) {
+      DECODE_CONTEXT *decode_ctx = drive_params->decode_ctx;
+
+      decode_ctx->sectors_skipped_zone += decode_ctx->sectors_skipped_track;
+      decode_ctx->sectors_skipped_track = 0;
+   }
 
-   num_deltas = deltas_get_count(0);
    raw_word = 0;
-   nominal_bit_sep_time = 200e6 /
-       mfm_controller_info[drive_params->controller].clk_rate_hz;
-   max_delta = nominal_bit_sep_time * 22;
-   avg_bit_sep_time = nominal_bit_sep_time;
-   i = 1;
-   while (num_deltas >= 0) {
+   pll_track = mfm_pll_track_start(drive_params, deltas, 200e6 /
+      mfm_controller_info[drive_params->controller].clk_rate_hz, 1);
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas;) {
-         int delta_process;
-         // If no remaining delta process next else finish remaining
-         if (remaining_delta == 0) {
-            delta_process = deltas[i++];
-            remaining_delta = delta_process;
-         }  else {
-            delta_process = remaining_delta;
-         }
-         // Don't overflow our 32 bit word
-         if (delta_process > max_delta) {
-            delta_process = max_delta;
-         }
-         track_time += delta_process;
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += delta_process;
-         remaining_delta -= delta_process;
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock. Don't update PLL if this is a long burst without
-         // transitions
-         if (remaining_delta == 0) {
-            avg_bit_sep_time = nominal_bit_sep_time + filter(clock_time, &filter_state);
+      for (; i < num_steps; i++) {
+         // Most steps can't be a mark. Skip to the next possible one
+         if ((state == MARK_ID || state == MARK_DATA) &&
+               drive_params->controller != CONTROLLER_EDAX_PV9900) {
+            i = skip_to_mark(drive_params, pll_track, i, num_steps,
+               drive_params->controller == CONTROLLER_DIMENSION_68000 ?
+                  0x44a1 : 0x4489,
+               &tot_raw_bit_cntr, &raw_bit_cntr, &track_time,
+               &all_raw_bits_count, &raw_word, &zero_count);
+            if (i >= num_steps) {
+               break;
+            }
          }
+         // Decode the bytes where nothing else needs to be done directly
+         // from the raw bits. The last byte and bytes near the end of a
+         // header are left for the bit at a time decode below since they
+         // are checked as they are decoded.
+         if ((state == PROCESS_HEADER || state == PROCESS_DATA) &&
+               decoded_bit_cntr == 0) {
+            int end_byte = bytes_needed - 1;
+
+            if (byte_cntr < header_bytes_needed - 1) {
+               end_byte = MIN(end_byte, header_bytes_needed - 1);
+            } else if (byte_cntr <= header_bytes_needed) {
+               end_byte = byte_cntr;
+            }
+            i = decode_bytes(drive_params, pll_track, i, num_steps, bytes,
+               &byte_cntr, end_byte, &tot_raw_bit_cntr, &raw_bit_cntr,
+               &track_time, &all_raw_bits_count, &raw_word, &decoded_word);
+         }
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 #if 0
          if (cyl == 819 && head == 0) {
          printf
          ("  delta %d %d clock %.2f int bit pos %d avg_bit %.2f time %d\n",
-               deltas[i], i, clock_time,
-               int_bit_pos, avg_bit_sep_time, track_time);
+               pll_track->steps[i].delta, i, pll_track->pll.clock_time,
+               int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time);
          }
 #endif
 #if 0
@@ -2834,8 +2956,8 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
 
             printf
                ("  DD %d,%d,%d,%.2f,%d,%.2f,%d\n", pass++,
-                  deltas[i], i, clock_time,
-                  int_bit_pos, avg_bit_sep_time, track_time);
+                  pll_track->steps[i].delta, i, pll_track->pll.clock_time,
+                  int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time);
          }
 #endif
          if (all_raw_bits_count + int_bit_pos >= 32) {
@@ -2953,13 +3075,13 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
                }
                if (state == MARK_ID) {
                   state = PROCESS_HEADER;
-                  mfm_mark_header_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+                  mfm_mark_header_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = header_bytes_crc_len;
                   bytes_needed = header_bytes_needed;
                } else {
                   state = PROCESS_DATA;
-                  mfm_mark_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+                  mfm_mark_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes + 
                         mfm_controller_info[drive_params->controller].data_trailer_bytes + 
@@ -2985,7 +3107,7 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
             if ((tot_raw_bit_cntr - header_raw_bit_count) > 530 && 
                   ((raw_word & 0xf) == 0x9)) {
                state = PROCESS_DATA;
-               mfm_mark_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+               mfm_mark_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                // Write sector assumes one sync byte at the start of the data
                // so we store the 0x01 sync byte.
                bytes[0] = 0x01;
@@ -3013,7 +3135,7 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
 //printf("DATA2 %x\n", raw_word);
             if ((raw_word & 0xf) == 0x9) {
                state = PROCESS_DATA;
-               mfm_mark_location(all_raw_bits_count, 0, tot_raw_bit_cntr);
+               mfm_mark_location(drive_params, all_raw_bits_count, 0, tot_raw_bit_cntr);
                // Figure out the length of data we should look for
                bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes + 
                      mfm_controller_info[drive_params->controller].data_trailer_bytes + 
@@ -3076,7 +3198,7 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
                         // it as a header. Poly != 0 for my testing
                         if (crc == 0 && !(init_status & SECT_AMBIGUOUS_CRC) && drive_params->header_crc.poly != 0) {
 //printf("Switched header %x\n", init_status);
-                           mfm_mark_header_location(MARK_STORED, 0, 0);
+                           mfm_mark_header_location(drive_params, MARK_STORED, 0, 0);
                            mfm_mark_end_data(all_raw_bits_count, drive_params, cyl, head);
                            state = PROCESS_HEADER;
                            bytes_crc_len = header_bytes_crc_len;
@@ -3093,7 +3215,7 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
                            state == PROCESS_DATA) {
                         // Didn't find header so mark location previously found
                         // as data
-                        mfm_mark_data_location(MARK_STORED, 0, 0);
+                        mfm_mark_data_location(drive_params, MARK_STORED, 0, 0);
                      }
                   } 
                   if (byte_cntr == bytes_needed) {
@@ -3120,14 +3242,6 @@ SECTOR_DECODE_STATUS wd_decode_track(DRIVE_PARAMS *drive_params, int cyl,
             }
          }
       }
-      // Finished what we had, any more?
-      // If we didn't get too many last time sleep so delta reader can run.
-      // Thread priorities might be better.
-      if (num_deltas - last_deltas <= 2000) {
-         usleep(500);
-      }
-      last_deltas = num_deltas;
-      num_deltas = deltas_get_count(i);
    }
    int bits = tot_raw_bit_cntr - 
            mfm_controller_info[drive_params->controller].track_words * 32;
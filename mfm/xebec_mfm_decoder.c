@@ -4,6 +4,12 @@
 // the byte decoding. The data portion of the sector only has the one
 // sync bit.
 //
+// 10/17/26 DJG Save alternate track message location so --jobs can
+//    remove it if the previous track printed it
+// 10/17/26 DJG Use PLL_TRACK so a track is only converted to bits once
+// 10/17/26 DJG Use shared PLL in mfm_pll.c
+// 10/17/26 DJG Moved static variables into TRACK_STATE
+// 10/17/26 DJG Made static variables thread local for mfm_util --jobs
 // 01/13/25 DJG Fixes for xebec_skew processing. Skew not same on all tracks.
 // 10/30/24 DJG Add new option to handle Xebec data skewed one sector from 
 //    header
@@ -78,20 +84,35 @@
 #include "mfm_decoder.h"
 #include "msg.h"
 #include "deltas_read.h"
+#include "mfm_pll.h"
 
 #define DATA_IGNORE_BYTES 8
 
-// Type II PLL. Here so it will inline. Converted from continuous time
-// by bilinear transformation. Coefficients adjusted to work best with
-// my data. Could use some more work.
-static inline float filter(float v, float *delay)
+// Print alternate track message if it's different from the last printed.
+//
+// drive_params: Drive parameters
+// sector_status: Status of sector with alternate track header
+static void print_alternate(DRIVE_PARAMS *drive_params,
+      SECTOR_STATUS *sector_status)
 {
-   float in, out;
-                 
-   in = v + *delay;
-   out = in * 0.034446428576716f + *delay * -0.034124999994713f;
-   *delay = in;
-   return out;
+   TRACK_STATE *track_state = drive_params->track_state;
+
+   if (track_state->last_cyl_print != sector_status->cyl ||
+         track_state->last_head_print != sector_status->head) {
+      // Previous track not known. Save where message is so
+      // mfm_track_state_start_track can remove it if needed
+      if (track_state->last_cyl_print == -2 && msg_capture_get() != NULL) {
+         track_state->print_capture = msg_capture_get();
+         track_state->print_capture_pos =
+            msg_capture_pos(track_state->print_capture);
+         track_state->first_cyl_print = sector_status->cyl;
+         track_state->first_head_print = sector_status->head;
+      }
+      msg(MSG_INFO, "Alternate track set on cyl %d, head %d\n",
+         sector_status->cyl, sector_status->head);
+      track_state->last_cyl_print = sector_status->cyl;
+      track_state->last_head_print = sector_status->head;
+   }
 }
 
 // Decode bytes into header or sector data for the various formats we know about.
@@ -179,21 +200,19 @@ SECTOR_DECODE_STATUS xebec_process_data(STATE_TYPE *state, uint8_t bytes[],
          SECTOR_STATUS sector_status_list[], int ecc_span,
          SECTOR_DECODE_STATUS init_status)
 {
-   static int sector_size;
-   static int bad_block;
-   static SECTOR_STATUS sector_status;
+   // Values saved between processing the header and data are kept in
+   // the track state
+   TRACK_STATE *track_state = drive_params->track_state;
+   SECTOR_STATUS *sector_status = &track_state->sector_status;
    int compare_byte;
-   static int alt_assigned;
    int is_alternate;
-   static int last_head_print = 0;
-   static int last_cyl_print = 0;
 
    if (*state == PROCESS_HEADER) {
-      memset(&sector_status, 0, sizeof(sector_status));
-      sector_status.status |= init_status | SECT_HEADER_FOUND;
-      sector_status.ecc_span_corrected_header = ecc_span;
+      memset(sector_status, 0, sizeof(*sector_status));
+      sector_status->status |= init_status | SECT_HEADER_FOUND;
+      sector_status->ecc_span_corrected_header = ecc_span;
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
 
       if (drive_params->controller == CONTROLLER_XEBEC_104786 ||
@@ -203,17 +222,14 @@ SECTOR_DECODE_STATUS xebec_process_data(STATE_TYPE *state, uint8_t bytes[],
             drive_params->controller == CONTROLLER_TI_2223220 ||
             drive_params->controller == CONTROLLER_XEBEC_S1420 ||
             drive_params->controller == CONTROLLER_EC1841) {
-         static int last_sector;
-         static int first_sector;
-
-         sector_status.cyl = bytes[3]<< 8;
-         sector_status.cyl |= bytes[4];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5] & 0xf);
-         sector_status.sector = bytes[6];
+         sector_status->cyl = bytes[3]<< 8;
+         sector_status->cyl |= bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5] & 0xf);
+         sector_status->sector = bytes[6];
          if (*sector_index == 0) {
-            mfm_clear_remap_list();
-            last_sector = -1; // Start of track so we don't know last sector
-            first_sector = sector_status.sector - drive_params->first_sector_number;
+            mfm_clear_remap_list(drive_params);
+            track_state->last_sector = -1; // Start of track so we don't know last sector
+            track_state->first_sector = sector_status->sector - drive_params->first_sector_number;
          }
          // When xebec_skew is set:
          // This format transfers data from the next sector
@@ -226,48 +242,42 @@ SECTOR_DECODE_STATUS xebec_process_data(STATE_TYPE *state, uint8_t bytes[],
          // Found one disk that the mapping changed after track with read error/bad
          // sectors
          if (drive_params->xebec_skew) {
-            if (last_sector != -1) {
-               mfm_remap_track_sectors(sector_status.sector - drive_params->first_sector_number, last_sector);
+            if (track_state->last_sector != -1) {
+               mfm_remap_track_sectors(drive_params, sector_status->sector - drive_params->first_sector_number, track_state->last_sector);
             }
             // This will keep updating until we get to the last sector of the
             // track which is the remap for the first sector
-            mfm_remap_track_sectors(first_sector, sector_status.sector - drive_params->first_sector_number);
+            mfm_remap_track_sectors(drive_params, track_state->first_sector, sector_status->sector - drive_params->first_sector_number);
          }
-         last_sector = sector_status.sector - drive_params->first_sector_number;
+         track_state->last_sector = sector_status->sector - drive_params->first_sector_number;
          // Don't know how/if these are encoded in header
-         sector_size = drive_params->sector_size;
-         bad_block = (bytes[7] & 2) != 0;
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = (bytes[7] & 2) != 0;
          //Xebec S1410 sets the MSB on cylinder 132 on, not sure what
          //it indicates
          if ((bytes[5] & 0x70) != 0) {
             msg(MSG_ERR, "Upper bits set in head byte: %02x on cyl %d head %d sector %d\n",
                bytes[5],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          if (bytes[0] != 0 || bytes[1] != 0 || bytes[8] != 0) {
             msg(MSG_INFO, "Header gap bytes not zero: %02x, %02x, %02x on cyl %d head %d sector %d\n",
                bytes[0], bytes[1], bytes[8],
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
          }
          compare_byte = 0xc2;
          if (bytes[2] != compare_byte) {
             msg(MSG_ERR, "Header compare byte not 0x%02x: %02x on cyl %d head %d sector %d\n",
                compare_byte, bytes[2],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
          // This must be executed before data processed below
-         alt_assigned = (bytes[7] & 0x01) != 0;
+         track_state->alt_assigned = (bytes[7] & 0x01) != 0;
          is_alternate = (bytes[7] & 0x04) != 0;
          if (is_alternate) {
-            if (last_cyl_print != sector_status.cyl || 
-                  last_head_print != sector_status.head) {
-               msg(MSG_INFO, "Alternate track set on cyl %d, head %d\n",
-                  sector_status.cyl, sector_status.head);
-               last_cyl_print = sector_status.cyl;
-               last_head_print = sector_status.head; 
-            }
+            print_alternate(drive_params, sector_status);
          }
       
          // More stuff likely in here but not documented.
@@ -279,63 +289,57 @@ SECTOR_DECODE_STATUS xebec_process_data(STATE_TYPE *state, uint8_t bytes[],
          if ((bytes[7] & 0xe8) != compare_byte) {
             msg(MSG_ERR, "Header flag byte not %02x value: %02x on cyl %d head %d sector %d\n",
                compare_byte, bytes[7],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       } else if (drive_params->controller == CONTROLLER_SOLOSYSTEMS) {
-         sector_status.cyl = bytes[3]<< 8;
-         sector_status.cyl |= bytes[4];
-         sector_status.head = mfm_fix_head(drive_params, exp_head, bytes[5] & 0x7f);
-         sector_size = drive_params->sector_size;
-         bad_block = 0;
-         sector_status.sector = (bytes[2] >> 1) & 0x1f;
+         sector_status->cyl = bytes[3]<< 8;
+         sector_status->cyl |= bytes[4];
+         sector_status->head = mfm_fix_head(drive_params, exp_head, bytes[5] & 0x7f);
+         track_state->sector_size = drive_params->sector_size;
+         track_state->bad_block = 0;
+         sector_status->sector = (bytes[2] >> 1) & 0x1f;
          if (bytes[0] != 0 || bytes[1] != 0) {
             msg(MSG_INFO, "Header gap bytes not zero: %02x, %02x on cyl %d head %d sector %d\n",
                bytes[0], bytes[1],
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
          }
 
-         alt_assigned = (bytes[6] & 0x01) != 0;
+         track_state->alt_assigned = (bytes[6] & 0x01) != 0;
          is_alternate = (bytes[6] & 0x04) != 0;
          if (is_alternate) {
-            if (last_cyl_print != sector_status.cyl || 
-                  last_head_print != sector_status.head) {
-               msg(MSG_INFO, "Alternate track set on cyl %d, head %d\n",
-                  sector_status.cyl, sector_status.head);
-               last_cyl_print = sector_status.cyl;
-               last_head_print = sector_status.head; 
-            }
+            print_alternate(drive_params, sector_status);
          }
       
          // More stuff likely in here but not documented.
          if ((bytes[6] & 0xea) != 0x80) {
             msg(MSG_ERR, "Header flag byte not expected value: %02x on cyl %d head %d sector %d\n",
                bytes[6],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-            sector_status.status |= SECT_BAD_HEADER;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       msg(MSG_DEBUG,
          "Got exp %d,%d cyl %d head %d sector %d size %d bad block %d\n",
-            exp_cyl, exp_head, sector_status.cyl, sector_status.head, sector_status.sector,
-            sector_size, bad_block);
+            exp_cyl, exp_head, sector_status->cyl, sector_status->head, sector_status->sector,
+            track_state->sector_size, track_state->bad_block);
 
-      if (bad_block) {
-         sector_status.status |= SECT_SPARE_BAD;
+      if (track_state->bad_block) {
+         sector_status->status |= SECT_SPARE_BAD;
          msg(MSG_INFO,"Bad block set on cyl %d, head %d, sector %d\n",
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
       }
 
-      mfm_check_header_values(exp_cyl, exp_head, sector_index, sector_size,
-            seek_difference, &sector_status, drive_params, sector_status_list);
+      mfm_check_header_values(exp_cyl, exp_head, sector_index, track_state->sector_size,
+            seek_difference, sector_status, drive_params, sector_status_list);
 
       *state = DATA_SYNC;
    } else { // Data
-      sector_status.status |= init_status;
+      sector_status->status |= init_status;
       if (bytes[0] != 0 ) {
          msg(MSG_INFO, "Data gap byte not zero 0x%02x on cyl %d head %d sector %d\n",
                bytes[0],
-               sector_status.cyl, sector_status.head, sector_status.sector);
+               sector_status->cyl, sector_status->head, sector_status->sector);
       }
       if (drive_params->controller == CONTROLLER_EC1841 ||
           drive_params->controller == CONTROLLER_SOLOSYSTEMS ||
@@ -348,42 +352,42 @@ SECTOR_DECODE_STATUS xebec_process_data(STATE_TYPE *state, uint8_t bytes[],
       if (bytes[1] != compare_byte) {
          msg(MSG_INFO, "Data compare byte not 0x%02x: 0x%02x on cyl %d head %d sector %d\n",
                compare_byte, bytes[1],
-               sector_status.cyl, sector_status.head, sector_status.sector);
-         sector_status.status |= SECT_BAD_DATA;
+               sector_status->cyl, sector_status->head, sector_status->sector);
+         sector_status->status |= SECT_BAD_DATA;
       }
       // Alternate only checksums the alternate header information. The
       // checksum at the end of the sector is zero
-      if (alt_assigned) {
+      if (track_state->alt_assigned) {
          if (crc64(&bytes[0], 9, &drive_params->header_crc) == 0) {
-            if (last_cyl_print != sector_status.cyl || 
-                  last_head_print != sector_status.head) {
+            if (track_state->last_cyl_print != sector_status->cyl || 
+                  track_state->last_head_print != sector_status->head) {
                msg(MSG_INFO,"cyl %d head %d assigned alternate cyl %d head %d (extract data fixed)\n", 
-                  sector_status.cyl, sector_status.head,
+                  sector_status->cyl, sector_status->head,
                   (bytes[2] << 8) + bytes[3], bytes[4]);
-               last_cyl_print = sector_status.cyl;
-               last_head_print = sector_status.head; 
+               track_state->last_cyl_print = sector_status->cyl;
+               track_state->last_head_print = sector_status->head; 
             }
-            mfm_handle_alt_track_ch(drive_params, sector_status.cyl, 
-               sector_status.head, (bytes[2] << 8) + bytes[3], bytes[4]);
+            mfm_handle_alt_track_ch(drive_params, sector_status->cyl, 
+               sector_status->head, (bytes[2] << 8) + bytes[3], bytes[4]);
          } else {
-            sector_status.status |= SECT_BAD_DATA;
+            sector_status->status |= SECT_BAD_DATA;
          }
       } else if (crc != 0) {
-         sector_status.status |= SECT_BAD_DATA;
+         sector_status->status |= SECT_BAD_DATA;
       }
       if (ecc_span != 0) {
-         sector_status.status |= SECT_ECC_RECOVERED;
+         sector_status->status |= SECT_ECC_RECOVERED;
       }
-      sector_status.ecc_span_corrected_data = ecc_span;
-      if (!(sector_status.status & SECT_BAD_HEADER)) {
-         if (mfm_write_sector(&bytes[2], drive_params, &sector_status,
+      sector_status->ecc_span_corrected_data = ecc_span;
+      if (!(sector_status->status & SECT_BAD_HEADER)) {
+         if (mfm_write_sector(&bytes[2], drive_params, sector_status,
                sector_status_list, &bytes[0], total_bytes) == -1) {
-            sector_status.status |= SECT_BAD_HEADER;
+            sector_status->status |= SECT_BAD_HEADER;
          }
       }
       *state = MARK_ID;
    }
-   return sector_status.status;
+   return sector_status->status;
 }
 
 // Decode a track's worth of deltas.
@@ -415,18 +419,11 @@ SECTOR_DECODE_STATUS xebec_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    int decoded_bit_cntr = 0;
    // loop counter
    int i;
-   // These are variables for the PLL filter. avg_bit_sep_time is the
-   // "VCO" frequency
-   float avg_bit_sep_time;     // 200 MHz clocks
-   float nominal_bit_sep_time; // 200 MHz clocks
-   // Clock time is the clock edge time from the VCO.
-   float clock_time = 0;
+   // Bit cell counts from PLL for the track and number available
+   PLL_TRACK *pll_track;
+   int num_steps;
    // How many bits the last delta corresponded to
    int int_bit_pos;
-   // PLL filter state. Static works better since next track bit timing
-   // similar to previous though a bad track can put it off enough that
-   // the next track has errors. Retry should fix. TODO: Look at
-   float filter_state = 0;
    // Time in track for debugging
    int track_time = 0;
    // Counter for debugging
@@ -442,15 +439,6 @@ SECTOR_DECODE_STATUS xebec_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    // Sample with short number of zero words abc80.gz
 #define MARK_NUM_ZEROS_EC1841 0
    int sync_count = 0;
-   // Number of deltas available so far to process
-   int num_deltas;
-   // And number from last time
-   int last_deltas = 0;
-   // If we get too large a delta we need to process it in less than 32 bit
-   // word number of bits. This holds remaining number to process
-   int remaining_delta = 0;
-   // Maximum delta to process in one pass
-   int max_delta;
    // Intermediate value
    int tmp_raw_word;
    // Collect bytes to further process here
@@ -478,50 +466,21 @@ SECTOR_DECODE_STATUS xebec_decode_track(DRIVE_PARAMS *drive_params, int cyl,
    } else {
       mark_num_zero = MARK_NUM_ZEROS;
    }
-   num_deltas = deltas_get_count(0);
-
    raw_word = 0;
-   nominal_bit_sep_time = 200e6 /
-       mfm_controller_info[drive_params->controller].clk_rate_hz;
-   max_delta = nominal_bit_sep_time * 22;
-   avg_bit_sep_time = nominal_bit_sep_time;
-   i = 1;
-   while (num_deltas >= 0) {
+   pll_track = mfm_pll_track_start(drive_params, deltas, 200e6 /
+      mfm_controller_info[drive_params->controller].clk_rate_hz, 1);
+   i = 0;
+   while ((num_steps = mfm_pll_track_get_count(pll_track, i)) >= 0) {
       // We process what we have then check for more.
-      for (; i < num_deltas;) {
-         int delta_process;
-         // If no remaining delta process next else finish remaining
-         if (remaining_delta == 0) {
-            delta_process = deltas[i++];
-            remaining_delta = delta_process;
-         }  else {
-            delta_process = remaining_delta;
-         }
-         // Don't overflow our 32 bit word
-         if (delta_process > max_delta) {
-            delta_process = max_delta;
-         }
-         track_time += delta_process;
-         // This is simulating a PLL/VCO clock sampling the data.
-         clock_time += delta_process;
-         remaining_delta -= delta_process;
-         // Move the clock in current frequency steps and count how many bits
-         // the delta time corresponds to
-         for (int_bit_pos = 0; clock_time > avg_bit_sep_time / 2;
-               clock_time -= avg_bit_sep_time, int_bit_pos++) {
-         }
-         // And then filter based on the time difference between the delta and
-         // the clock. Don't update PLL if this is a long burst without
-         // transitions
-         if (remaining_delta == 0) {
-            avg_bit_sep_time = nominal_bit_sep_time + filter(clock_time, &filter_state);
-         }
+      for (; i < num_steps; i++) {
+         int_bit_pos = pll_track->steps[i].bits;
+         track_time += pll_track->steps[i].delta;
 #if DEBUG
          //printf("track %d clock %f\n", track_time, clock_time);
          printf
          ("  delta %d %.2f int bit pos %d avg_bit %.2f time %d\n",
-               delta_process, clock_time,
-               int_bit_pos, avg_bit_sep_time, track_time);
+               pll_track->steps[i].delta, pll_track->pll.clock_time,
+               int_bit_pos, pll_track->pll.avg_bit_sep_time, track_time);
 #endif
          if (all_raw_bits_count + int_bit_pos >= 32) {
             all_raw_bits_count = mfm_save_raw_word(drive_params, 
@@ -603,7 +562,7 @@ if ((raw_word & 0xff) == 0x49 && head == 0) {
                decoded_bit_cntr = 0;
                if (state == HEADER_SYNC) {
                   state = PROCESS_HEADER;
-                  mfm_mark_header_location(all_raw_bits_count, raw_bit_cntr,
+                  mfm_mark_header_location(drive_params, all_raw_bits_count, raw_bit_cntr,
                       tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = mfm_controller_info[drive_params->controller].header_bytes +
@@ -613,7 +572,7 @@ if ((raw_word & 0xff) == 0x49 && head == 0) {
                   header_bytes_needed = bytes_needed;
                } else {
                   state = PROCESS_DATA;
-                  mfm_mark_data_location(all_raw_bits_count, raw_bit_cntr, 
+                  mfm_mark_data_location(drive_params, all_raw_bits_count, raw_bit_cntr, 
                      tot_raw_bit_cntr);
                   // Figure out the length of data we should look for
                   bytes_crc_len = mfm_controller_info[drive_params->controller].data_header_bytes +
@@ -674,7 +633,7 @@ if ((raw_word & 0xff) == 0x49 && head == 0) {
                         // it as a header. Poly != 0 for my testing
                         if (crc == 0 && !(init_status & SECT_AMBIGUOUS_CRC) && drive_params->header_crc.poly != 0) {
 //printf("Switched header %x\n", init_status);
-                           mfm_mark_header_location(MARK_STORED, 0, 0);
+                           mfm_mark_header_location(drive_params, MARK_STORED, 0, 0);
                            mfm_mark_end_data(all_raw_bits_count, drive_params, cyl, head);
                            state = PROCESS_HEADER;
                            bytes_crc_len = header_bytes_crc_len;
@@ -700,14 +659,6 @@ if ((raw_word & 0xff) == 0x49 && head == 0) {
             }
          }
       }
-      // Finished what we had, any more?
-      // If we didn't get too many last time sleep so delta reader can run.
-      // Thread priorities might be better.
-      if (num_deltas - last_deltas <= 2000) {
-         usleep(500);
-      }
-      last_deltas = num_deltas;
-      num_deltas = deltas_get_count(i);
    }
    if (state == PROCESS_DATA && sector_index <= drive_params->num_sectors) {
       float begin_time =